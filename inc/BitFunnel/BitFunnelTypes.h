@@ -83,6 +83,15 @@ namespace BitFunnel
     static const size_t c_maxShardIdCount = 1ul << c_log2MaxShardIdValue;
     static const size_t c_maxShardIdValue = c_maxShardIdCount - 1;
 
+    // The documents in the BitFunnel index can be grouped into conceptual
+    // groups based on the need of the client. For example, a client can choose
+    // to group documents based on time stamp. Each group is assigned a GroupId
+    // which is a unique identifier for the group that the client can use to
+    // manage the index. Documents which are added while no group is open
+    // belong to c_noGroupId, which may not be used to open a group.
+    typedef size_t GroupId;
+    static const GroupId c_noGroupId = static_cast<GroupId>(-1);
+
     // RowIndex is the ordinal position of a row in a row table.
     // The RowIndex of the first row is zero.
     // RowIndex is limited to fit within a 24-bit field. This constraint exists
@@ -46,5 +46,9 @@ namespace BitFunnel
         // NOTE that parameters controlling ingestion are supplied to the
         // constructor of the object that implements IChunkManifestIngestor.
         virtual void IngestChunk(size_t index) const = 0;
+
+        // Ingests all of the chunks, using threadCount threads. Returns when
+        // every chunk has been ingested.
+        virtual void IngestChunks(size_t threadCount) const = 0;
     };
 }
@@ -24,6 +24,7 @@
 
 #include <iosfwd>                   // std::istream, std::ostream return values.
 #include <memory>                   // std::unique_ptr return value.
+#include <stddef.h>                 // size_t return value.
 
 #include "BitFunnel/IInterface.h"   // Base class.
 
@@ -35,6 +36,24 @@
 
 namespace BitFunnel
 {
+    //*************************************************************************
+    //
+    // IFileMapping
+    //
+    // The contents of a file made addressable in memory. The data is aligned
+    // to at least c_bytesPerCacheLine bytes and remains valid until the
+    // IFileMapping is destroyed. Writes to the data are private to the
+    // IFileMapping and are never written back to the file.
+    //
+    //*************************************************************************
+    class IFileMapping : public IInterface
+    {
+    public:
+        virtual void* GetData() const = 0;
+        virtual size_t GetSize() const = 0;
+    };
+
+
     class IFileSystem : public IInterface
     {
     public:
@@ -44,6 +63,20 @@ namespace BitFunnel
         virtual std::unique_ptr<std::istream>
             OpenForRead(char const * filename,
                         std::ios_base::openmode mode = std::ios::in) = 0;
+
+        // Returns the contents of the file as an IFileMapping. Implementations
+        // backed by an operating system file map the file copy-on-write, so
+        // that pages are read on first access and the contents are not
+        // copied up front. Other implementations read the file into memory.
+        virtual std::unique_ptr<IFileMapping>
+            OpenForMapping(char const * filename) = 0;
+
+        // Like OpenForMapping(), for files which are read once from start to
+        // end. Implementations backed by an operating system file advise it
+        // to read ahead and to drop pages after they have been read, and
+        // read the file into memory instead if it cannot be mapped.
+        virtual std::unique_ptr<IFileMapping>
+            OpenForSequentialMapping(char const * filename) = 0;
     };
 }
 
@@ -29,6 +29,7 @@
 #include <stddef.h>                 // size_t parameter.
 #include <string>                   // std::string return value.
 
+#include "BitFunnel/Configuration/IFileSystem.h"    // IFileMapping return value.
 #include "BitFunnel/IInterface.h"   // Base class.
 
 #ifdef __clang__
@@ -116,11 +117,16 @@ namespace BitFunnel
         //virtual FileDescriptor1 DocTable(size_t shard) = 0;
         //virtual FileDescriptor1 ScoreTable(size_t shard) = 0;
         virtual FileDescriptor1 RowDensities(size_t shard) = 0;
+        virtual FileDescriptor1 ShardSnapshot(size_t shard) = 0;
         virtual FileDescriptor1 TermTable(size_t shard) = 0;
         virtual FileDescriptor1 TermTableStatistics(size_t shard) = 0;
 
-        //virtual FileDescriptor2 IndexSlice(size_t shard,
-        //                                   size_t slice) = 0;
+        // These methods return descriptors for files that are parameterized
+        // by a shard number and a second number. The returned
+        // FileDescriptor2 objects provide methods to generate the file names
+        // and open the files.
+        virtual FileDescriptor2 IndexSlice(size_t shard,
+                                           size_t slice) = 0;
     };
 
 
@@ -162,6 +168,7 @@ namespace BitFunnel
         virtual std::string GetName(size_t p1, size_t p2) = 0;
         virtual std::unique_ptr<std::istream> OpenForRead(size_t p1, size_t p2) = 0;
         virtual std::unique_ptr<std::ostream> OpenForWrite(size_t p1, size_t p2) = 0;
+        virtual std::unique_ptr<IFileMapping> OpenForMapping(size_t p1, size_t p2) = 0;
         // virtual std::unique_ptr<std::ostream> OpenTempForWrite(size_t p1, size_t p2) = 0;
         // virtual void Commit(size_t p1, size_t p2) = 0;
         // virtual bool Exists(size_t p1, size_t p2) = 0;
@@ -232,6 +239,7 @@ namespace BitFunnel
         std::string GetName() { return m_file.GetName(m_p1, m_p2); }
         std::unique_ptr<std::istream> OpenForRead() { return m_file.OpenForRead(m_p1, m_p2); }
         std::unique_ptr<std::ostream> OpenForWrite() { return m_file.OpenForWrite(m_p1, m_p2); }
+        std::unique_ptr<IFileMapping> OpenForMapping() { return m_file.OpenForMapping(m_p1, m_p2); }
         // std::unique_ptr<std::ostream> OpenTempForWrite() { return m_file.OpenTempForWrite(m_p1, m_p2); }
         // void Commit() { return m_file.Commit(m_p1, m_p2); }
         // bool Exists() { return m_file.Exists(m_p1, m_p2); }
@@ -32,6 +32,7 @@
 
 namespace BitFunnel
 {
+    class PostingBuffer;
     class Slice;
     class Term;
 
@@ -122,5 +123,9 @@ namespace BitFunnel
 
         // Column in the slice where the document resides.
         DocIndex m_index;
+
+        // When not nullptr, AddPosting() stages postings in this buffer
+        // instead of writing them to the slice directly.
+        PostingBuffer* m_postingBuffer;
     };
 }
@@ -86,6 +86,15 @@ namespace BitFunnel
         // TODO: Remove this temporary function.
         void * GetSliceBuffer(Slice * slice);
 
+        // Creates an ISliceBufferAllocator which maps arenas of
+        // arenaBlockCount blocks on demand and unmaps arenas whose blocks have
+        // all been released. Allocations beyond maxBlockCount blocks throw. A
+        // maxBlockCount of zero means there is no limit.
+        std::unique_ptr<ISliceBufferAllocator>
+            CreateElasticSliceBufferAllocator(size_t blockSize,
+                                              size_t arenaBlockCount,
+                                              size_t maxBlockCount);
+
         std::unique_ptr<IFactSet> CreateFactSet();
 
         std::unique_ptr<IIndexedIdfTable> CreateIndexedIdfTable();
@@ -113,6 +122,17 @@ namespace BitFunnel
         std::unique_ptr<ISliceBufferAllocator>
             CreateSliceBufferAllocator(size_t blockSize, size_t blockCount);
 
+        // Creates an ISliceBufferAllocator with a pool of blockCount blocks
+        // for each distinct NUMA node in shardNumaNodes. Pools are backed by
+        // huge pages of hugePageSize bytes where available. Shard i allocates
+        // from the pool for node shardNumaNodes[i]. An empty shardNumaNodes
+        // creates one pool, with the default memory policy, for all shards.
+        std::unique_ptr<ISliceBufferAllocator>
+            CreateSliceBufferAllocator(size_t blockSize,
+                                       size_t blockCount,
+                                       size_t hugePageSize,
+                                       std::vector<int> const & shardNumaNodes);
+
         std::unique_ptr<ITermTable> CreateTermTable();
         std::unique_ptr<ITermTable> CreateTermTable(std::istream & input);
 
@@ -0,0 +1,56 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <stddef.h>                     // size_t return value.
+#include <vector>                       // std::vector return value.
+
+#include "BitFunnel/BitFunnelTypes.h"   // ShardId parameter.
+#include "BitFunnel/IInterface.h"       // Base class.
+
+
+namespace BitFunnel
+{
+    //*************************************************************************
+    //
+    // IIndexSnapshot is an abstract class or interface for a consistent view
+    // of the slice buffer lists of every Shard in the index. All of the lists
+    // in a snapshot were current at the same instant, so a query which runs
+    // over a snapshot never sees a Slice added to one Shard without also
+    // seeing the Slices added to other Shards before it.
+    //
+    // Snapshots are obtained from IIngestor::GetSnapshot() and, like the
+    // lists returned by IShard::GetSliceBuffers(), remain valid only for the
+    // lifetime of the Token which was held when the snapshot was obtained.
+    //
+    //*************************************************************************
+    class IIndexSnapshot : public IInterface
+    {
+    public:
+        // Returns the number of Shards in the snapshot.
+        virtual size_t GetShardCount() const = 0;
+
+        // Returns the slice buffers of the given Shard.
+        virtual std::vector<void*> const & GetSliceBuffers(ShardId shard) const = 0;
+    };
+}
@@ -24,6 +24,7 @@
 
 #include <iosfwd>                           // std::istream& parameter.
 #include <memory>                           // std::unique_ptr parameter.
+#include <utility>                          // std::pair parameter.
 #include <vector>                           // std::vector return type.
 
 #include "BitFunnel/IInterface.h"           // inherits from IInterface.
@@ -36,19 +37,12 @@ namespace BitFunnel
     class IDocument;
     class IDocumentCache;
     class IFileManager;
+    class IIndexSnapshot;
     class IRecycler;
     class ITokenManager;
     class IShard;
     class ITermToText;
 
-    // BITFUNNELTYPES
-    // The documents in the BitFunnel index can be grouped into conceptual
-    // groups based on the need of the client. For example, a client can choose
-    // to group documents based on time stamp. Each group is assigned a GroupId
-    // which is a unique identifier for the group that the client can use to
-    // manage the index.
-    typedef size_t GroupId;
-
 
     //*************************************************************************
     //
@@ -80,6 +74,21 @@ namespace BitFunnel
                                      ITermToText const * termToText) const = 0;
 
 
+        // Writes a snapshot of each Shard's full Slices to locations defined
+        // by the FileManager. Slices which are still being filled are not
+        // written, and their documents must be re-ingested after
+        // LoadSnapshot(). Statistics are not included; use WriteStatistics()
+        // for those.
+        virtual void WriteSnapshot(IFileManager & fileManager) const = 0;
+
+        // Loads the Slices written by WriteSnapshot() into each Shard and
+        // adds their active documents to the index. The slice buffers are
+        // memory mapped from the files written by WriteSnapshot(). Intended
+        // to be called on an empty index, before any documents are added.
+        // Throws if the snapshot is incompatible with the index's layout.
+        virtual void LoadSnapshot(IFileManager & fileManager) = 0;
+
+
         // Returns a reference to the IDocument cache. This cache holds ingested
         // IDocuments for use in query verification diagnostics.
         virtual IDocumentCache & GetDocumentCache() const = 0;
@@ -93,6 +102,17 @@ namespace BitFunnel
         // value.
         virtual void Add(DocId id, IDocument const & document) = 0;
 
+        // Adds a batch of documents to the index. Equivalent to calling Add()
+        // for each (DocId, IDocument) pair, but allocates columns in runs,
+        // stages postings so that each row is written once per block of 64
+        // documents, avoids interlocked operations in Slices filled by the
+        // batch and makes the documents visible together once all of them
+        // have been ingested. Throws if there is no space for the
+        // documents. If a DocId is already in the index, the rest of the
+        // batch is still added and the error is thrown afterwards.
+        virtual void AddBatch(
+            std::vector<std::pair<DocId, IDocument const *>> const & documents) = 0;
+
         // Removes a document from serving. The document with the specified id
         // will no longer be returned from the queries. Returns true if the
         // document was successfully removed and false otherwise. False means
@@ -104,6 +124,22 @@ namespace BitFunnel
         // some of which may already have been deleted for other reasons.
         virtual bool Delete(DocId id) = 0;
 
+        // Moves the active documents out of each full Slice in which at least
+        // minExpiredRatio of the columns have been expired, packing them into
+        // the Shard's active Slice. A compacted Slice is left fully expired
+        // and is recycled once the queries using it have finished. Returns the
+        // number of Slices compacted.
+        //
+        // Documents stay visible to queries while they are moved. A query
+        // which runs at the instant a document is moved may see both copies.
+        virtual size_t Compact(double minExpiredRatio) = 0;
+
+        // Calls Compact(minExpiredRatio) every intervalInMs milliseconds
+        // until Shutdown() is called. Intended to run on a thread provided by
+        // the host, in the same way as IRecycler::Run().
+        virtual void RunCompactor(double minExpiredRatio,
+                                  unsigned intervalInMs) = 0;
+
         // Sets or clears a fact about a document with the given DocId. The
         // FactHandle must have been previously registered in the IFactSet,
         // otherwise the function throws.
@@ -140,6 +176,12 @@ namespace BitFunnel
 
         virtual ITokenManager& GetTokenManager() const = 0;
 
+        // Returns a consistent view of the slice buffers of all Shards. The
+        // caller must hold a Token from GetTokenManager(), and the snapshot
+        // remains valid until that Token is released. Cheap when no Slices
+        // were added or removed since the previous call.
+        virtual IIndexSnapshot const & GetSnapshot() const = 0;
+
         // Shuts down the index and releases resources allocated to it.
         virtual void Shutdown() = 0;
 
@@ -156,12 +198,18 @@ namespace BitFunnel
         //    - All future addition operations are done in this new group.
         //    - The previous group is closed. A closed group cannot be reopened or
         //      modified.
+        // Throws if groupId is c_noGroupId or is not greater than every group
+        // id opened before.
         virtual void OpenGroup(GroupId groupId) = 0;
 
         // Closes the current group, if any.
         virtual void CloseGroup() = 0;
 
-        // Expires the group with the given id.
+        // Expires the group with the given id. Its documents are removed from
+        // serving and the Slices which hold them are recycled. Expiring a
+        // group again, or an id which was skipped, has no effect. Throws if
+        // no group with this or a greater id was opened, if the group is
+        // still open, or if it still has documents being added.
         virtual void ExpireGroup(GroupId groupId) = 0;
     };
 }
@@ -24,6 +24,7 @@
 
 #include <cstddef>                      // ptrdiff_t return value.
 #include <iosfwd>                       // std::ostream parameter.
+#include <vector>                       // std::vector return value.
 
 #include "BitFunnel/BitFunnelTypes.h"   // DocIndex return value.
 #include "BitFunnel/IInterface.h"       // Base class.
@@ -55,6 +56,13 @@ namespace BitFunnel
         // Returns the offset of the row in the slice buffer in a shard.
         virtual ptrdiff_t GetRowOffset(RowId rowId) const = 0;
 
+        // Returns true if no bit has been set since the slice was created in
+        // the row that starts at rowOffset in the given slice buffer. A false
+        // return does not guarantee that the row has any bits set, since
+        // clearing bits does not update the summary consulted here.
+        virtual bool IsRowEmpty(void const * sliceBuffer,
+                                ptrdiff_t rowOffset) const = 0;
+
         virtual void TemporaryWriteDocumentFrequencyTable(
             std::ostream& out,
             ITermToText const * termToText) const = 0;
@@ -109,6 +109,7 @@ namespace BitFunnel
         virtual void StopIndex() = 0;
 
         virtual IConfiguration const & GetConfiguration() const = 0;
+        virtual IDocumentDataSchema const & GetDocumentDataSchema() const = 0;
         virtual IFileManager & GetFileManager() const = 0;
         virtual IFileSystem & GetFileSystem() const = 0;
         virtual IIngestor & GetIngestor() const = 0;
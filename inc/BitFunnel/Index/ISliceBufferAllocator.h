@@ -25,6 +25,7 @@
 
 #include <stddef.h>
 
+#include "BitFunnel/BitFunnelTypes.h"  // ShardId parameter.
 #include "BitFunnel/IInterface.h"
 
 namespace BitFunnel
@@ -55,8 +56,14 @@ namespace BitFunnel
         // even require a single value to be used for all slices in the Index.
         virtual void* Allocate(size_t byteSize) = 0;
 
+        // Allocates a buffer for a Slice in the given shard. Implementations
+        // may use the shard to choose a pool, e.g. one that is local to the
+        // NUMA node where the shard's queries run.
+        virtual void* Allocate(size_t byteSize, ShardId shard) = 0;
+
         // Returns the allocator when a Slice is being recycled back to the pool
-        // for re-use. Buffer is zero initialized upon return.
+        // for re-use. Buffer is zero initialized upon return. Buffers from
+        // either Allocate() overload may be released here.
         virtual void Release(void* buffer) = 0;
 
         // Returns the size of the single slice buffer.
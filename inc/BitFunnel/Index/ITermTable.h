@@ -23,6 +23,7 @@
 #pragma once
 
 #include <iosfwd>                                   // std::ostream parameter.
+#include <stdint.h>                                 // uint64_t return value.
 
 #include "BitFunnel/IInterface.h"                   // Base class.
 #include "BitFunnel/Index/PackedRowIdSequence.h"    // PackedRowIdSequence return value.
@@ -147,6 +148,13 @@ namespace BitFunnel
         // Writes the contents of the ITermTable to a stream.
         virtual void Write(std::ostream& output) const = 0;
 
+        // Returns a version number which changes each time the TermTable is
+        // modified. Versions are unique across all TermTables in the
+        // process, so a TermTable that is reloaded or replaced never reports
+        // the version of its predecessor. Used to detect stale data derived
+        // from the TermTable, such as cached query plans.
+        virtual uint64_t GetVersion() const = 0;
+
         //
         // Reader methods called by RowIdSequence::const_iterator.
         //
@@ -65,6 +65,19 @@ namespace BitFunnel
             m_data.m_cacheLineCount += amount;
         }
 
+        // Records cache lines that were prefetched before their first access.
+        inline void IncrementPrefetchedCacheLineCount(size_t amount)
+        {
+            m_data.m_prefetchedCacheLineCount += amount;
+        }
+
+        // Records that matching stopped early because the query reached its
+        // match count or time quota.
+        inline void SetTruncated(bool truncated)
+        {
+            m_data.m_truncated = truncated;
+        }
+
         inline void FinishParsing()
         {
             m_data.m_parsingTime = m_stopwatch.ElapsedTime();
@@ -93,6 +106,8 @@ namespace BitFunnel
                 m_matchCount(0ull),
                 m_quadwordCount(0ull),
                 m_cacheLineCount(0ll),
+                m_prefetchedCacheLineCount(0ull),
+                m_truncated(false),
                 m_parsingTime(0.0),
                 m_planningTime(0.0),
                 m_matchingTime(0.0)
@@ -105,6 +120,8 @@ namespace BitFunnel
                 m_matchCount = other.m_matchCount;
                 m_quadwordCount = other.m_quadwordCount;
                 m_cacheLineCount = other.m_cacheLineCount;
+                m_prefetchedCacheLineCount = other.m_prefetchedCacheLineCount;
+                m_truncated = other.m_truncated;
                 m_parsingTime = other.m_parsingTime;
                 m_planningTime = other.m_planningTime;
                 m_matchingTime = other.m_matchingTime;
@@ -131,6 +148,16 @@ namespace BitFunnel
                 return m_cacheLineCount;
             }
 
+            inline size_t GetPrefetchedCacheLineCount()
+            {
+                return m_prefetchedCacheLineCount;
+            }
+
+            inline bool IsTruncated()
+            {
+                return m_truncated;
+            }
+
             inline double GetParsingTime()
             {
                 return m_parsingTime;
@@ -156,6 +183,8 @@ namespace BitFunnel
             size_t m_matchCount;
             size_t m_quadwordCount;
             size_t m_cacheLineCount;
+            size_t m_prefetchedCacheLineCount;
+            bool m_truncated;
             double m_parsingTime;
             double m_planningTime;
             double m_matchingTime;
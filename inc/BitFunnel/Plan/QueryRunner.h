@@ -24,6 +24,9 @@
 
 #include <vector>       // std::vector parameter
 
+#include "BitFunnel/Index/IDocumentDataSchema.h"    // FixedSizeBlobId parameter.
+#include "BitFunnel/Plan/ScoredMatch.h"             // ScoredMatch parameter.
+
 
 namespace BitFunnel
 {
@@ -32,6 +35,9 @@ namespace BitFunnel
     class QueryRunner
     {
     public:
+        // Value for staticRankBlob when the schema has no static rank.
+        static const FixedSizeBlobId c_noStaticRank = static_cast<FixedSizeBlobId>(-1);
+
         class Statistics
         {
         public:
@@ -49,18 +55,40 @@ namespace BitFunnel
             double m_elapsedTime;
         };
 
+        // Runs a single query. The matcher for the query is split across
+        // matcherThreadCount threads. If topK is non-zero, topMatches is
+        // filled with the topK best scoring matches, highest score first.
+        // Each match is scored by the float static rank stored in the
+        // fixed-size blob staticRankBlob. If staticRankBlob is
+        // c_noStaticRank, every match scores 0 and matches are ranked by
+        // ascending DocId. Throws if staticRankBlob is not a blob of at
+        // least four bytes in the index's schema. Matching stops early once
+        // the query has maxMatchCount matches or has spent timeBudget
+        // seconds in the matcher. Zero disables either limit. The returned
+        // data's IsTruncated() reports whether matching stopped early.
         static QueryInstrumentation::Data Run(
             char const * query,
             ISimpleIndex const & index,
             bool useNativeCode,
-            bool countCacheLines);
+            bool countCacheLines,
+            size_t matcherThreadCount,
+            size_t topK,
+            FixedSizeBlobId staticRankBlob,
+            size_t maxMatchCount,
+            double timeBudget,
+            std::vector<ScoredMatch> & topMatches);
 
+        // Runs each query in queries iterations times, spread across
+        // threadCount threads. maxMatchCount and timeBudget limit each
+        // query as in the single query Run() above.
         static Statistics Run(ISimpleIndex const & index,
                               char const * outputDir,
                               size_t threadCount,
                               std::vector<std::string> const & queries,
                               size_t iterations,
                               bool useNativeCode,
-                              bool countCacheLines);
+                              bool countCacheLines,
+                              size_t maxMatchCount,
+                              double timeBudget);
     };
 }
@@ -24,6 +24,7 @@
 
 #include <iosfwd>                       // std::ostream parameter.
 #include <limits>
+#include <stddef.h>                     // size_t parameter.
 #include <stdint.h>                     // uint8_t, uint64_t members.
 
 #include "BitFunnel/BitFunnelTypes.h"   // Rank parameter.
@@ -89,6 +90,13 @@ namespace BitFunnel
              StreamId stream,
              IConfiguration const & configuration);
 
+        // Same as above, but for text whose raw hash has already been
+        // computed by ComputeRawHash() or ComputeRawHashes().
+        Term(Hash rawHash,
+             char const * text,
+             StreamId stream,
+             IConfiguration const & configuration);
+
         // Constructs a term from its components. Common use case it to
         // construct a unigram (GramSize == 1). GramSize parameter exists
         // for TermTableBuilder scenario where adhoc term prototypes are
@@ -192,6 +200,14 @@ namespace BitFunnel
         // Computes the raw hash (based on term characters only) for the specified term text.
         static Hash ComputeRawHash(const char* text);
 
+        // Sets hashes[i] to ComputeRawHash(texts[i]) for each of the count
+        // texts, where lengths[i] is the length of texts[i]. Hashing many
+        // terms in one call is faster than calling ComputeRawHash() for each.
+        static void ComputeRawHashes(char const * const * texts,
+                                     size_t const * lengths,
+                                     size_t count,
+                                     Hash* hashes);
+
         // Hasher for std::unordered_set.
         // Definition is inlined for use by template.
         struct Hasher
@@ -47,19 +47,46 @@ namespace BitFunnel
         std::unique_ptr<IBlockAllocator>
             CreateBlockAllocator(size_t blockSize, size_t totalBlockCount);
 
+        // Creates an IBlockAllocator which caches up to magazineCapacity
+        // blocks per thread, so that most allocations and releases don't
+        // touch the shared free list. Blocks cached by one thread are only
+        // handed to other threads when the shared free list is empty.
+        std::unique_ptr<IBlockAllocator>
+            CreateBlockAllocator(size_t blockSize,
+                                 size_t totalBlockCount,
+                                 size_t magazineCapacity);
+
+        // Creates an IBlockAllocator whose pool is backed by huge pages of
+        // hugePageSize bytes when the system has them available and is bound
+        // to the given NUMA node. Pass zero for hugePageSize to use regular
+        // pages and -1 for numaNode to use the default memory policy.
+        std::unique_ptr<IBlockAllocator>
+            CreateBlockAllocator(size_t blockSize,
+                                 size_t totalBlockCount,
+                                 size_t magazineCapacity,
+                                 size_t hugePageSize,
+                                 int numaNode);
+
         std::unique_ptr<IDiagnosticStream> CreateDiagnosticStream(std::ostream& stream);
 
         // TODO: return unique_ptr.
         IObjectFormatter* CreateObjectFormatter(std::ostream& output);
 
+        // When pinThreads is true, the distributor's threads are pinned to
+        // cores.
         std::unique_ptr<ITaskDistributor>
             CreateTaskDistributor(
                 std::vector<std::unique_ptr<ITaskProcessor>> const & processors,
-                size_t taskCount);
+                size_t taskCount,
+                bool pinThreads = false);
 
         std::unique_ptr<IThreadManager>
             CreateThreadManager(const std::vector<std::unique_ptr<IThreadBase>>& threads);
 
         std::unique_ptr<ITokenManager> CreateTokenManager();
+
+        // Returns an ITokenManager which issues and returns Tokens without
+        // taking a lock. Its Token serial numbers are not monotonic.
+        std::unique_ptr<ITokenManager> CreateEpochTokenManager();
     }
 }
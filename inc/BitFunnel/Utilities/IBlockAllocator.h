@@ -56,5 +56,8 @@ namespace BitFunnel
 
         // Returns the size of the blocks in the pool.
         virtual size_t GetBlockSize() const = 0;
+
+        // Returns true if the block lies within this allocator's pool.
+        virtual bool Contains(uint64_t const * block) const = 0;
     };
 }
@@ -22,6 +22,7 @@
 
 #pragma once
 
+#include <functional>
 #include <stddef.h>
 #include <vector>
 
@@ -37,28 +38,45 @@ namespace BitFunnel
     // Uses multiple threads to dispatch numbered tasks to a vector of objects
     // that derive from ITaskProcessor.
     //
-    // One thread is started for each ITaskProcessor. The ITaskProcessors are
-    // assigned task ids via ITaskProcessor::ProcessTask(). Task ids are handed
-    // out starting from 0 and increasing until all ITaskProcessors are busy.
-    // Each time a thread returns from ProcessTask(), a new task id will be
-    // assigned until all tasks have been processed.
+    // One thread is started for each ITaskProcessor. The task ids from 0 to
+    // taskCount - 1 are spread across the threads, which pass them to their
+    // ITaskProcessor::ProcessTask(). Threads which run out of tasks steal
+    // tasks from busy threads until all tasks have been processed. Each
+    // ITaskProcessor's Finished() method is called on its own thread once
+    // all tasks have been processed.
     //
     // Task coordinator only knows about task ids. The interpretation of the
     // work associated with a particular task id is up to the ITaskProcessor.
     //
+    // A task may split its work into subtasks with RunSubtasks(), which idle
+    // threads of the same distributor help to process.
+    //
     //*************************************************************************
     class ITaskDistributor
     {
     public:
         virtual ~ITaskDistributor() {}
 
-        // TaskDistributorThreads call TryAllocateTask() to get their next task
-        // assignment. If there is work remaining, taskId will be set to the id
-        // of the assigned task and the method will return true. If there are
-        // no tasks remaining, the method will return false.
-        virtual bool TryAllocateTask(size_t& taskId) = 0;
+        // Calls subtask(id) for each id from 0 to subtaskCount - 1 and
+        // returns once all calls have completed. When called from within
+        // ITaskProcessor::ProcessTask() or from another subtask, idle
+        // threads of this distributor may steal subtasks, while the calling
+        // thread processes the rest. Called from any other thread, the
+        // subtasks run sequentially on the calling thread. If subtasks
+        // throw, the first exception is rethrown once all subtasks have
+        // completed.
+        virtual void RunSubtasks(
+            size_t subtaskCount,
+            std::function<void(size_t)> const & subtask) = 0;
 
-        // Waits for all tasks to complete.
+        // Waits for all tasks to complete. If a task threw an exception,
+        // the remaining tasks are still processed and the first exception is
+        // rethrown here.
         virtual void WaitForCompletion() = 0;
+
+        // Returns the ITaskDistributor which owns the calling thread, or
+        // nullptr if the calling thread was not started by an
+        // ITaskDistributor.
+        static ITaskDistributor* GetCurrent();
     };
 }
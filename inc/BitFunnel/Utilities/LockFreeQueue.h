@@ -0,0 +1,202 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <atomic>                       // std::atomic embedded.
+#include <memory>                       // std::unique_ptr embedded.
+#include <stddef.h>                     // size_t embedded.
+
+#include "BitFunnel/BitFunnelTypes.h"   // c_bytesPerCacheLine used for padding.
+#include "BitFunnel/NonCopyable.h"      // Base class.
+
+
+namespace BitFunnel
+{
+    //*************************************************************************
+    //
+    // LockFreeQueue<T> implements a thread safe queue with a fixed capacity
+    // for multiple producers and multiple consumers, without taking locks.
+    // Unlike BlockingQueue<T>, TryEnqueue() and TryDequeue() never block.
+    // They return false when the queue is full or empty, and the caller
+    // decides whether to retry, do other work or give up.
+    //
+    // Each cell of the underlying ring carries a sequence number which tells
+    // producers and consumers whether the cell is ready for them, so a
+    // successful operation costs a single compare-exchange on the shared
+    // enqueue or dequeue position. See Dmitry Vyukov's bounded MPMC queue.
+    //
+    // T must be default constructible and move assignable.
+    //
+    //*************************************************************************
+    template <typename T>
+    class LockFreeQueue : public NonCopyable
+    {
+    public:
+        // Constructs a LockFreeQueue which holds at least capacity items.
+        // The capacity is rounded up to a power of two, and to no less than
+        // two.
+        LockFreeQueue(size_t capacity);
+
+        // Returns true if value was enqueued and false if the queue is full.
+        bool TryEnqueue(T value);
+
+        // Returns true if an item was dequeued into value and false if the
+        // queue is empty.
+        bool TryDequeue(T& value);
+
+        size_t GetCapacity() const;
+
+    private:
+        struct Cell
+        {
+            std::atomic<size_t> m_sequence;
+            T m_value;
+        };
+
+        // Returns the smallest power of two which is at least value and at
+        // least two.
+        static size_t RoundUpCapacity(size_t value);
+
+        const size_t m_mask;
+        std::unique_ptr<Cell[]> m_cells;
+
+        // The enqueue and dequeue positions are written by different threads,
+        // so they are kept on separate cache lines.
+        char m_padding0[c_bytesPerCacheLine];
+        std::atomic<size_t> m_enqueuePosition;
+        char m_padding1[c_bytesPerCacheLine - sizeof(std::atomic<size_t>)];
+        std::atomic<size_t> m_dequeuePosition;
+        char m_padding2[c_bytesPerCacheLine - sizeof(std::atomic<size_t>)];
+    };
+
+
+    //*************************************************************************
+    //
+    // Implementation of LockFreeQueue<T>
+    //
+    //*************************************************************************
+    template <typename T>
+    LockFreeQueue<T>::LockFreeQueue(size_t capacity)
+        : m_mask(RoundUpCapacity(capacity) - 1),
+          m_cells(new Cell[m_mask + 1]),
+          m_enqueuePosition(0),
+          m_dequeuePosition(0)
+    {
+        for (size_t i = 0; i <= m_mask; ++i)
+        {
+            m_cells[i].m_sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+
+    template <typename T>
+    bool LockFreeQueue<T>::TryEnqueue(T value)
+    {
+        size_t position = m_enqueuePosition.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = m_cells[position & m_mask];
+            const size_t sequence = cell.m_sequence.load(std::memory_order_acquire);
+            if (sequence == position)
+            {
+                // The cell is free. Claim it by advancing the position.
+                if (m_enqueuePosition.compare_exchange_weak(position,
+                                                            position + 1,
+                                                            std::memory_order_relaxed))
+                {
+                    cell.m_value = std::move(value);
+                    cell.m_sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (sequence < position)
+            {
+                // The cell still holds the item from the previous lap.
+                return false;
+            }
+            else
+            {
+                // Another producer claimed the cell first.
+                position = m_enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+
+    template <typename T>
+    bool LockFreeQueue<T>::TryDequeue(T& value)
+    {
+        size_t position = m_dequeuePosition.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = m_cells[position & m_mask];
+            const size_t sequence = cell.m_sequence.load(std::memory_order_acquire);
+            if (sequence == position + 1)
+            {
+                // The cell holds an item. Claim it by advancing the position.
+                if (m_dequeuePosition.compare_exchange_weak(position,
+                                                            position + 1,
+                                                            std::memory_order_relaxed))
+                {
+                    value = std::move(cell.m_value);
+                    cell.m_sequence.store(position + m_mask + 1,
+                                          std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (sequence < position + 1)
+            {
+                // No producer has filled the cell yet.
+                return false;
+            }
+            else
+            {
+                // Another consumer claimed the cell first.
+                position = m_dequeuePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+
+    template <typename T>
+    size_t LockFreeQueue<T>::GetCapacity() const
+    {
+        return m_mask + 1;
+    }
+
+
+    template <typename T>
+    size_t LockFreeQueue<T>::RoundUpCapacity(size_t value)
+    {
+        // A ring of one cell can't tell a full cell from an empty one, since
+        // the sequence number a consumer leaves behind equals the next
+        // producer's position. The second TryEnqueue() would then overwrite
+        // an item which hasn't been dequeued.
+        size_t result = 2;
+        while (result < value)
+        {
+            result <<= 1;
+        }
+        return result;
+    }
+}
@@ -28,6 +28,7 @@
 #include "BitFunnel/Chunks/Factories.h"
 #include "BitFunnel/Exceptions.h"
 #include "BuiltinChunkManifest.h"
+#include "ChunkEnumerator.h"
 #include "ChunkIngestor.h"
 #include "ChunkReader.h"
 
@@ -87,4 +88,11 @@ namespace BitFunnel
                     processor);
 
     }
+
+
+    void BuiltinChunkManifest::IngestChunks(size_t threadCount) const
+    {
+        ChunkEnumerator chunkEnumerator(*this, threadCount);
+        chunkEnumerator.WaitForCompletion();
+    }
 }
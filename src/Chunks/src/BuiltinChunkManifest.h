@@ -50,6 +50,8 @@ namespace BitFunnel
 
         virtual void IngestChunk(size_t index) const override;
 
+        virtual void IngestChunks(size_t threadCount) const override;
+
     private:
 
         //
@@ -57,7 +57,16 @@ namespace BitFunnel
 
     void ChunkIngestor::OnDocumentEnter(DocId id)
     {
-        m_currentDocument.reset(new Document(m_config, id));
+        // The Document is reused unless it was handed to the document
+        // cache by OnDocumentExit().
+        if (m_currentDocument == nullptr)
+        {
+            m_currentDocument.reset(new Document(m_config, id));
+        }
+        else
+        {
+            m_currentDocument->Reset(id);
+        }
     }
 
 
@@ -99,8 +108,6 @@ namespace BitFunnel
                                                   id);
             }
         }
-
-        m_currentDocument.reset(nullptr);
     }
 
 
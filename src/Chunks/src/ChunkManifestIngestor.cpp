@@ -20,15 +20,17 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
-#include <fstream>
+#include <memory>
 #include <sstream>
 
 #include "BitFunnel/Chunks/Factories.h"
 #include "BitFunnel/Configuration/IFileSystem.h"
 #include "BitFunnel/Exceptions.h"
 #include "BitFunnel/IFileManager.h"
+#include "ChunkEnumerator.h"
 #include "ChunkIngestor.h"
 #include "ChunkManifestIngestor.h"
+#include "ChunkPipeline.h"
 #include "ChunkReader.h"
 
 
@@ -89,10 +91,13 @@ namespace BitFunnel
             throw error;
         }
 
-        auto input = m_fileSystem.OpenForRead(m_filePaths[index].c_str(),
-                                              std::ios::binary);
-
-        if (input->fail())
+        // The chunk is parsed in place from the mapping, without copying it.
+        std::unique_ptr<IFileMapping> chunk;
+        try
+        {
+            chunk = m_fileSystem.OpenForSequentialMapping(m_filePaths[index].c_str());
+        }
+        catch (RecoverableError const &)
         {
             std::stringstream message;
             message << "Failed to open chunk file '"
@@ -101,15 +106,7 @@ namespace BitFunnel
             throw FatalError(message.str());
         }
 
-        input->seekg(0, input->end);
-        auto length = input->tellg();
-        input->seekg(0, input->beg);
-
-        std::vector<char> chunkData;
-        chunkData.reserve(static_cast<size_t>(length) + 1ull);
-        chunkData.insert(chunkData.begin(),
-                         (std::istreambuf_iterator<char>(*input)),
-                         std::istreambuf_iterator<char>());
+        char const * chunkData = static_cast<char const *>(chunk->GetData());
 
         {
             // Block scopes std::ostream.
@@ -125,9 +122,34 @@ namespace BitFunnel
                                     m_filter,
                                     std::move(output));
 
-            ChunkReader(&chunkData[0],
-                        &chunkData[0] + chunkData.size(),
+            ChunkReader(chunkData,
+                        chunkData + chunk->GetSize(),
                         processor);
         }
     }
+
+
+    void ChunkManifestIngestor::IngestChunks(size_t threadCount) const
+    {
+        // Chunk output files are written in document order, which the
+        // pipeline does not preserve. A single thread is kept on the simple
+        // path for ease of debugging.
+        if (m_fileManager != nullptr || threadCount <= 1)
+        {
+            ChunkEnumerator chunkEnumerator(*this, threadCount);
+            chunkEnumerator.WaitForCompletion();
+        }
+        else
+        {
+            ChunkPipeline pipeline(m_fileSystem,
+                                   m_filePaths,
+                                   m_configuration,
+                                   m_ingestor,
+                                   m_filter,
+                                   m_cacheDocuments,
+                                   threadCount,
+                                   ChunkPipeline::c_defaultRangeByteSize);
+            pipeline.Run();
+        }
+    }
 }
@@ -0,0 +1,470 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <algorithm>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+#include "BitFunnel/Chunks/IChunkProcessor.h"
+#include "BitFunnel/Configuration/IFileSystem.h"
+#include "BitFunnel/Exceptions.h"
+#include "BitFunnel/Index/IDocumentCache.h"
+#include "BitFunnel/Index/IIngestor.h"
+#include "BitFunnel/Utilities/Factories.h"
+#include "BitFunnel/Utilities/IThreadManager.h"
+#include "ChunkPipeline.h"
+#include "ChunkReader.h"
+#include "Document.h"
+
+
+namespace BitFunnel
+{
+    // Capacity of each queue, per thread.
+    static const size_t c_queueCapacityPerThread = 4;
+
+
+    //*************************************************************************
+    //
+    // ChunkPipeline::Range
+    //
+    // A run of whole documents within a mapped chunk. Holds a reference to
+    // the mapping, which is released once all of its runs have been built.
+    //
+    //*************************************************************************
+    class ChunkPipeline::Range
+    {
+    public:
+        Range(std::shared_ptr<IFileMapping> const & chunk,
+              char const * start,
+              char const * end)
+          : m_chunk(chunk),
+            m_start(start),
+            m_end(end)
+        {
+        }
+
+        std::shared_ptr<IFileMapping> m_chunk;
+        char const * m_start;
+        char const * m_end;
+    };
+
+
+    //*************************************************************************
+    //
+    // ChunkPipeline::DocumentBatch
+    //
+    // The documents built from a Range. The first m_count Documents were
+    // kept by the IDocumentFilter. The remaining ones are spares which are
+    // reused by the next Range built into this batch. Entries are null where
+    // a Document was handed to the IDocumentCache.
+    //
+    //*************************************************************************
+    class ChunkPipeline::DocumentBatch
+    {
+    public:
+        DocumentBatch()
+          : m_count(0)
+        {
+        }
+
+        std::vector<std::unique_ptr<Document>> m_documents;
+        size_t m_count;
+
+        // Argument to IIngestor::AddBatch(), kept to reuse its storage.
+        std::vector<std::pair<DocId, IDocument const *>> m_entries;
+    };
+
+
+    //*************************************************************************
+    //
+    // ChunkPipeline::DocumentBatchBuilder
+    //
+    // IChunkProcessor which builds the documents of a Range into a
+    // DocumentBatch.
+    //
+    //*************************************************************************
+    class ChunkPipeline::DocumentBatchBuilder : public IChunkProcessor
+    {
+    public:
+        DocumentBatchBuilder(IConfiguration const & configuration,
+                             IDocumentFilter & filter,
+                             DocumentBatch & batch)
+          : m_configuration(configuration),
+            m_filter(filter),
+            m_batch(batch),
+            m_current(nullptr)
+        {
+        }
+
+        virtual void OnFileEnter() override
+        {
+        }
+
+
+        virtual void OnDocumentEnter(DocId id) override
+        {
+            auto & documents = m_batch.m_documents;
+            if (m_batch.m_count == documents.size())
+            {
+                documents.emplace_back(nullptr);
+            }
+
+            std::unique_ptr<Document> & document = documents[m_batch.m_count];
+            if (document == nullptr)
+            {
+                document.reset(new Document(m_configuration, id));
+            }
+            else
+            {
+                document->Reset(id);
+            }
+            m_current = document.get();
+        }
+
+
+        virtual void OnStreamEnter(Term::StreamId id) override
+        {
+            m_current->OpenStream(id);
+        }
+
+
+        virtual void OnTerm(char const * term) override
+        {
+            m_current->AddTerm(term);
+        }
+
+
+        virtual void OnStreamExit() override
+        {
+            m_current->CloseStream();
+        }
+
+
+        virtual void OnDocumentExit(IChunkWriter & /*writer*/,
+                                    size_t bytesRead) override
+        {
+            m_current->CloseDocument(bytesRead);
+
+            // A rejected Document stays in its slot and is reused by the
+            // next document.
+            if (m_filter.KeepDocument(*m_current))
+            {
+                ++m_batch.m_count;
+            }
+        }
+
+
+        virtual void OnFileExit(IChunkWriter & /*writer*/) override
+        {
+        }
+
+    private:
+        IConfiguration const & m_configuration;
+        IDocumentFilter & m_filter;
+        DocumentBatch & m_batch;
+        Document* m_current;
+    };
+
+
+    //*************************************************************************
+    //
+    // ChunkPipeline::Worker
+    //
+    //*************************************************************************
+    class ChunkPipeline::Worker : public IThreadBase
+    {
+    public:
+        Worker(ChunkPipeline& pipeline)
+          : m_pipeline(pipeline)
+        {
+        }
+
+        virtual void EntryPoint() override
+        {
+            m_pipeline.RunWorker();
+        }
+
+    private:
+        ChunkPipeline& m_pipeline;
+    };
+
+
+    //*************************************************************************
+    //
+    // ChunkPipeline
+    //
+    //*************************************************************************
+    ChunkPipeline::ChunkPipeline(IFileSystem& fileSystem,
+                                 std::vector<std::string> const & filePaths,
+                                 IConfiguration const & configuration,
+                                 IIngestor& ingestor,
+                                 IDocumentFilter& filter,
+                                 bool cacheDocuments,
+                                 size_t threadCount,
+                                 size_t targetRangeByteSize)
+      : m_fileSystem(fileSystem),
+        m_filePaths(filePaths),
+        m_configuration(configuration),
+        m_ingestor(ingestor),
+        m_filter(filter),
+        m_cacheDocuments(cacheDocuments),
+        m_threadCount(std::max(threadCount, static_cast<size_t>(1))),
+        m_targetRangeByteSize(targetRangeByteSize),
+        m_ranges(new LockFreeQueue<Range*>(m_threadCount * c_queueCapacityPerThread)),
+        m_batches(new LockFreeQueue<DocumentBatch*>(m_threadCount * c_queueCapacityPerThread)),
+        m_freeBatches(new LockFreeQueue<DocumentBatch*>(m_threadCount * c_queueCapacityPerThread)),
+        m_nextChunk(0),
+        m_outstanding(0),
+        m_failed(false)
+    {
+    }
+
+
+    ChunkPipeline::~ChunkPipeline()
+    {
+        // Work left behind by a failed Run().
+        Range* range;
+        while (m_ranges->TryDequeue(range))
+        {
+            delete range;
+        }
+
+        DocumentBatch* batch;
+        while (m_batches->TryDequeue(batch))
+        {
+            delete batch;
+        }
+        while (m_freeBatches->TryDequeue(batch))
+        {
+            delete batch;
+        }
+    }
+
+
+    void ChunkPipeline::Run()
+    {
+        std::vector<std::unique_ptr<IThreadBase>> threads;
+        for (size_t i = 0; i < m_threadCount; ++i)
+        {
+            threads.push_back(std::unique_ptr<IThreadBase>(new Worker(*this)));
+        }
+
+        auto threadManager = Factories::CreateThreadManager(threads);
+        threadManager->WaitForThreads();
+
+        if (m_error != nullptr)
+        {
+            std::rethrow_exception(m_error);
+        }
+    }
+
+
+    void ChunkPipeline::RunWorker()
+    {
+        try
+        {
+            while (!m_failed)
+            {
+                if (TryPost() || TryBuild() || TrySplit())
+                {
+                    continue;
+                }
+
+                if (m_nextChunk >= m_filePaths.size() && m_outstanding == 0)
+                {
+                    break;
+                }
+
+                // Other threads are splitting or building the last items.
+                std::this_thread::yield();
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(m_errorLock);
+            if (m_error == nullptr)
+            {
+                m_error = std::current_exception();
+            }
+            m_failed = true;
+        }
+    }
+
+
+    bool ChunkPipeline::TrySplit()
+    {
+        // Count the chunk before claiming it, so that no thread sees the
+        // last chunk claimed and nothing outstanding while it is split.
+        ++m_outstanding;
+        const size_t chunk = m_nextChunk++;
+        if (chunk >= m_filePaths.size())
+        {
+            --m_outstanding;
+            return false;
+        }
+
+        Split(chunk);
+        --m_outstanding;
+        return true;
+    }
+
+
+    bool ChunkPipeline::TryBuild()
+    {
+        Range* range;
+        if (!m_ranges->TryDequeue(range))
+        {
+            return false;
+        }
+
+        Build(std::unique_ptr<Range>(range));
+        return true;
+    }
+
+
+    bool ChunkPipeline::TryPost()
+    {
+        DocumentBatch* batch;
+        if (!m_batches->TryDequeue(batch))
+        {
+            return false;
+        }
+
+        Post(std::unique_ptr<DocumentBatch>(batch));
+        return true;
+    }
+
+
+    void ChunkPipeline::Split(size_t chunk)
+    {
+        std::shared_ptr<IFileMapping> mapping;
+        try
+        {
+            mapping = m_fileSystem.OpenForSequentialMapping(m_filePaths[chunk].c_str());
+        }
+        catch (RecoverableError const &)
+        {
+            std::stringstream message;
+            message << "Failed to open chunk file '"
+                << m_filePaths[chunk]
+                << "'";
+            throw FatalError(message.str());
+        }
+
+        if (mapping->GetSize() == 0)
+        {
+            throw FatalError("Attempt to read empty chunk.");
+        }
+
+        char const * start = static_cast<char const *>(mapping->GetData());
+        std::vector<char const *> boundaries =
+            ChunkReader::SplitDocuments(start,
+                                        start + mapping->GetSize(),
+                                        m_targetRangeByteSize);
+
+        for (size_t i = 0; i + 1 < boundaries.size(); ++i)
+        {
+            std::unique_ptr<Range>
+                range(new Range(mapping, boundaries[i], boundaries[i + 1]));
+
+            ++m_outstanding;
+            if (m_ranges->TryEnqueue(range.get()))
+            {
+                range.release();
+            }
+            else
+            {
+                Build(std::move(range));
+            }
+        }
+    }
+
+
+    void ChunkPipeline::Build(std::unique_ptr<Range> range)
+    {
+        std::unique_ptr<DocumentBatch> batch = GetBatch();
+        {
+            DocumentBatchBuilder builder(m_configuration, m_filter, *batch);
+            ChunkReader::ReadDocuments(range->m_start, range->m_end, builder);
+        }
+        range.reset();
+
+        ++m_outstanding;
+        if (m_batches->TryEnqueue(batch.get()))
+        {
+            batch.release();
+        }
+        else
+        {
+            Post(std::move(batch));
+        }
+
+        --m_outstanding;
+    }
+
+
+    void ChunkPipeline::Post(std::unique_ptr<DocumentBatch> batch)
+    {
+        auto & entries = batch->m_entries;
+        entries.clear();
+        for (size_t i = 0; i < batch->m_count; ++i)
+        {
+            Document const & document = *batch->m_documents[i];
+            entries.push_back(std::make_pair(document.GetDocId(), &document));
+        }
+
+        if (!entries.empty())
+        {
+            m_ingestor.AddBatch(entries);
+        }
+
+        if (m_cacheDocuments)
+        {
+            for (size_t i = 0; i < batch->m_count; ++i)
+            {
+                const DocId id = batch->m_documents[i]->GetDocId();
+                m_ingestor.GetDocumentCache().Add(std::move(batch->m_documents[i]),
+                                                  id);
+            }
+        }
+
+        batch->m_count = 0;
+        if (m_freeBatches->TryEnqueue(batch.get()))
+        {
+            batch.release();
+        }
+
+        --m_outstanding;
+    }
+
+
+    std::unique_ptr<ChunkPipeline::DocumentBatch> ChunkPipeline::GetBatch()
+    {
+        DocumentBatch* batch;
+        if (m_freeBatches->TryDequeue(batch))
+        {
+            return std::unique_ptr<DocumentBatch>(batch);
+        }
+        return std::unique_ptr<DocumentBatch>(new DocumentBatch());
+    }
+}
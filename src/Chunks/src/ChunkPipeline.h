@@ -0,0 +1,148 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <atomic>                               // std::atomic embedded.
+#include <exception>                            // std::exception_ptr embedded.
+#include <memory>                               // std::unique_ptr embedded.
+#include <mutex>                                // std::mutex embedded.
+#include <stddef.h>                             // size_t parameter.
+#include <string>                               // std::string template parameter.
+#include <vector>                               // std::vector parameter.
+
+#include "BitFunnel/NonCopyable.h"              // Base class.
+#include "BitFunnel/Utilities/LockFreeQueue.h"  // std::unique_ptr template parameter.
+
+
+namespace BitFunnel
+{
+    class IConfiguration;
+    class IDocumentFilter;
+    class IFileSystem;
+    class IIngestor;
+
+    //*************************************************************************
+    //
+    // ChunkPipeline
+    //
+    // Ingests a set of chunk files in three stages connected by bounded
+    // LockFreeQueues, so that the work of a large chunk is spread across all
+    // threads instead of falling to the one thread which picked it up.
+    //
+    //   Split:  maps a chunk file and splits it into runs of whole documents.
+    //   Build:  parses a run into Documents, hashing terms and forming
+    //           n-grams, and collects the Documents in a DocumentBatch.
+    //   Post:   adds a DocumentBatch to the index with IIngestor::AddBatch(),
+    //           which allocates columns and sets bits shard by shard.
+    //
+    // Every thread runs every stage, preferring the later stages so that the
+    // queues drain. A thread which finds the next queue full runs the next
+    // stage itself rather than waiting, so no thread idles while there is
+    // work and the queues stay bounded.
+    //
+    // Documents and their postings are not written to chunk output files,
+    // since runs of a chunk are ingested out of order.
+    //
+    //*************************************************************************
+    class ChunkPipeline : public NonCopyable
+    {
+    public:
+        // Default target size of the runs of documents produced by the Split
+        // stage. Large enough to amortize the queue operations and the per
+        // batch work in IIngestor::AddBatch(), small enough that a single
+        // chunk yields work for many threads.
+        static const size_t c_defaultRangeByteSize = 256 * 1024;
+
+        // The Split stage cuts chunks into runs of whole documents of at
+        // least targetRangeByteSize bytes.
+        ChunkPipeline(IFileSystem& fileSystem,
+                      std::vector<std::string> const & filePaths,
+                      IConfiguration const & configuration,
+                      IIngestor& ingestor,
+                      IDocumentFilter& filter,
+                      bool cacheDocuments,
+                      size_t threadCount,
+                      size_t targetRangeByteSize);
+
+        ~ChunkPipeline();
+
+        // Ingests all of the chunks and returns when they have been added to
+        // the index. If any stage throws, the remaining work is abandoned and
+        // the first exception is rethrown.
+        void Run();
+
+    private:
+        class DocumentBatch;
+        class DocumentBatchBuilder;
+        class Range;
+        class Worker;
+
+        // Main loop of each pipeline thread.
+        void RunWorker();
+
+        // Each of these takes one item from its stage's input, if any, and
+        // processes it. Returns false if there was nothing to do.
+        bool TrySplit();
+        bool TryBuild();
+        bool TryPost();
+
+        void Split(size_t chunk);
+        void Build(std::unique_ptr<Range> range);
+        void Post(std::unique_ptr<DocumentBatch> batch);
+
+        // Returns a DocumentBatch from m_freeBatches, or a new one.
+        std::unique_ptr<DocumentBatch> GetBatch();
+
+        //
+        // Constructor parameters.
+        //
+        IFileSystem& m_fileSystem;
+        std::vector<std::string> const & m_filePaths;
+        IConfiguration const & m_configuration;
+        IIngestor& m_ingestor;
+        IDocumentFilter& m_filter;
+        const bool m_cacheDocuments;
+        const size_t m_threadCount;
+        const size_t m_targetRangeByteSize;
+
+        // Queues between the stages. m_freeBatches returns posted
+        // DocumentBatches to the Build stage so that their Documents are
+        // reused.
+        std::unique_ptr<LockFreeQueue<Range*>> m_ranges;
+        std::unique_ptr<LockFreeQueue<DocumentBatch*>> m_batches;
+        std::unique_ptr<LockFreeQueue<DocumentBatch*>> m_freeBatches;
+
+        // Index of the next chunk to split.
+        std::atomic<size_t> m_nextChunk;
+
+        // Number of chunks, runs and batches which have been claimed or
+        // enqueued but not yet processed. An item's successors are counted
+        // before the item itself is done, so the pipeline is finished when
+        // there are no more chunks and this count is zero.
+        std::atomic<size_t> m_outstanding;
+
+        std::atomic<bool> m_failed;
+        std::mutex m_errorLock;
+        std::exception_ptr m_error;
+    };
+}
@@ -20,6 +20,7 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
+#include <cstring>
 #include <sstream>
 
 #include "BitFunnel/Chunks/IChunkProcessor.h"
@@ -65,6 +66,92 @@ namespace BitFunnel
     }
 
 
+    ChunkReader::ChunkReader(IChunkProcessor& processor,
+                             char const * start,
+                             char const * end)
+        : m_processor(processor),
+          m_next(start),
+          m_end(end)
+    {
+    }
+
+
+    // Returns the position following the '\0' which terminates the string
+    // at p.
+    static char const * SkipString(char const * p, char const * end)
+    {
+        void const * terminator =
+            std::memchr(p, 0, static_cast<size_t>(end - p));
+        if (terminator == nullptr)
+        {
+            throw FatalError("Attempt to read beyond end of buffer.");
+        }
+        return static_cast<char const *>(terminator) + 1;
+    }
+
+
+    // Returns the character at p, checking that p is within the buffer.
+    static char PeekAt(char const * p, char const * end)
+    {
+        if (p == end)
+        {
+            throw FatalError("Attempt to read beyond end of buffer.");
+        }
+        return *p;
+    }
+
+
+    std::vector<char const *>
+        ChunkReader::SplitDocuments(char const * start,
+                                    char const * end,
+                                    size_t targetByteSize)
+    {
+        std::vector<char const *> boundaries(1, start);
+
+        // A document is its id, a sequence of streams and an empty string.
+        // A stream is its id, a sequence of terms and an empty string.
+        char const * p = start;
+        while (PeekAt(p, end) != 0)
+        {
+            p = SkipString(p, end);
+            while (PeekAt(p, end) != 0)
+            {
+                p = SkipString(p, end);
+                while (PeekAt(p, end) != 0)
+                {
+                    p = SkipString(p, end);
+                }
+                ++p;
+            }
+            ++p;
+
+            if (static_cast<size_t>(p - boundaries.back()) >= targetByteSize)
+            {
+                boundaries.push_back(p);
+            }
+        }
+
+        if (boundaries.back() != p)
+        {
+            boundaries.push_back(p);
+        }
+
+        return boundaries;
+    }
+
+
+    void ChunkReader::ReadDocuments(char const * start,
+                                    char const * end,
+                                    IChunkProcessor& processor)
+    {
+        ChunkReader reader(processor, start, end);
+        while (reader.m_next != reader.m_end)
+        {
+            reader.ProcessDocument();
+        }
+    }
+
+
     void ChunkReader::ProcessDocument()
     {
         char const * start = m_next;
@@ -22,6 +22,7 @@
 
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 #include <vector>
 
@@ -49,7 +50,30 @@ namespace BitFunnel
                     char const * end,
                     IChunkProcessor& processor);
 
+        // Splits the documents of the chunk in [start, end) into runs of
+        // whole documents of at least targetByteSize bytes, except for the
+        // last run. Returns the boundaries of the runs, starting with start
+        // and ending with the end of the last document, so run i is
+        // [boundaries[i], boundaries[i + 1]). Only the structure of the chunk
+        // is scanned; terms are not examined.
+        static std::vector<char const *>
+            SplitDocuments(char const * start,
+                           char const * end,
+                           size_t targetByteSize);
+
+        // Parses a run of documents returned by SplitDocuments(). Generates
+        // the document, stream and term callbacks, but not OnFileEnter() and
+        // OnFileExit().
+        static void ReadDocuments(char const * start,
+                                  char const * end,
+                                  IChunkProcessor& processor);
+
     private:
+        // Constructs a ChunkReader for ReadDocuments().
+        ChunkReader(IChunkProcessor& processor,
+                    char const * start,
+                    char const * end);
+
         class ChunkWriter : public IChunkWriter
         {
         public:
@@ -21,7 +21,7 @@
 // THE SOFTWARE.
 
 
-#include <new>
+#include <cstring>
 
 #include "BitFunnel/Chunks/Factories.h"
 #include "BitFunnel/Exceptions.h"
@@ -46,11 +46,24 @@ namespace BitFunnel
           m_docId(id),
           m_maxGramSize(configuration.GetMaxGramSize()),
           m_sourceByteSize(0),
+          m_batchCount(0),
           m_streamIsOpen(false)
     {
     }
 
 
+    void Document::Reset(DocId id)
+    {
+        m_docId = id;
+        m_sourceByteSize = 0;
+        m_batchText.clear();
+        m_batchCount = 0;
+        m_grams.clear();
+        m_streamIsOpen = false;
+        m_postings.Clear();
+    }
+
+
     DocId Document::GetDocId() const
     {
         return m_docId;
@@ -59,7 +72,7 @@ namespace BitFunnel
 
     size_t Document::GetPostingCount() const
     {
-        return m_postings.size();
+        return m_postings.GetCount();
     }
 
 
@@ -80,8 +93,7 @@ namespace BitFunnel
 
     bool Document::Contains(Term & term) const
     {
-        auto it = m_postings.find(term);
-        return (it != m_postings.end());
+        return m_postings.Contains(term);
     }
 
 
@@ -97,8 +109,8 @@ namespace BitFunnel
 
             m_currentStreamId = id;
 
-            // Reset ring buffer just in case.
-            m_ringBuffer.Reset();
+            // Reset ngrams just in case.
+            m_grams.clear();
         }
     }
 
@@ -114,15 +126,16 @@ namespace BitFunnel
             // TODO: This is placeholder code that computes the term count.
             // TODO: Make it compute the unique posting count.
 
-            // TODO: should we use the dfThreshold parameter instead of the fixed value?
-            new(m_ringBuffer.PushBack()) Term(termText,
-                                              m_currentStreamId,
-                                              m_configuration);
+            const size_t length = strlen(termText);
+            m_batchOffsets[m_batchCount] = m_batchText.size();
+            m_batchLengths[m_batchCount] = length;
+            m_batchText.insert(m_batchText.end(),
+                               termText,
+                               termText + length + 1);
 
-            if (m_ringBuffer.GetCount() == m_maxGramSize)
+            if (++m_batchCount == c_termBatchSize)
             {
-                ProcessNGrams();
-                m_ringBuffer.PopFront();
+                FlushTerms();
             }
         }
     }
@@ -139,45 +152,71 @@ namespace BitFunnel
             m_streamIsOpen = false;
 
             // Process ngrams at end of document.
-            PurgeRingBuffer();
+            FlushTerms();
+            m_grams.clear();
         }
     }
 
 
     void Document::CloseDocument(size_t sourceByteSize)
     {
+        // Some callers never close their last stream, so post the terms
+        // that are still waiting to be hashed.
+        FlushTerms();
+
         m_sourceByteSize = sourceByteSize;
     }
 
 
-    void Document::ProcessNGrams()
+    void Document::FlushTerms()
     {
-        const size_t count = m_ringBuffer.GetCount();
-        LogAssertB(count > 0, "Count must be greater than 0.");
+        char const * texts[c_termBatchSize];
+        for (size_t i = 0; i < m_batchCount; ++i)
+        {
+            texts[i] = &m_batchText[m_batchOffsets[i]];
+        }
 
-        // Process each of the higher order n-grams.
-        Term term(m_ringBuffer[0]);
-        AddPosting(term);
-        for (size_t n = 1; n < count; ++n)
+        Term::Hash hashes[c_termBatchSize];
+        Term::ComputeRawHashes(texts, m_batchLengths, m_batchCount, hashes);
+
+        for (size_t i = 0; i < m_batchCount; ++i)
         {
-            term.AddTerm(m_ringBuffer[n], m_configuration);
-            AddPosting(term);
+            // TODO: should we use the dfThreshold parameter instead of the fixed value?
+            AddNGrams(Term(hashes[i],
+                           texts[i],
+                           m_currentStreamId,
+                           m_configuration));
         }
+
+        m_batchText.clear();
+        m_batchCount = 0;
     }
 
 
-    void Document::PurgeRingBuffer()
+    void Document::AddNGrams(Term const & term)
     {
-        while (!m_ringBuffer.IsEmpty())
+        if (m_grams.size() < m_maxGramSize)
+        {
+            m_grams.push_back(term);
+        }
+        LogAssertB(m_grams.size() > 0, "Max gram size must be greater than 0.");
+
+        // Extend the longest ngrams first, since each is derived from the
+        // next shorter one.
+        for (size_t n = m_grams.size() - 1; n > 0; --n)
         {
-            ProcessNGrams();
-            m_ringBuffer.PopFront();
+            m_grams[n] = m_grams[n - 1];
+            m_grams[n].AddTerm(term, m_configuration);
+            AddPosting(m_grams[n]);
         }
+
+        m_grams[0] = term;
+        AddPosting(term);
     }
 
 
     void Document::AddPosting(Term term)
     {
-        m_postings.insert(term);
+        m_postings.Add(term);
     }
 }
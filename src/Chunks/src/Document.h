@@ -22,12 +22,13 @@
 
 #pragma once
 
-#include <unordered_set>                    // TODO: Remove this temporary include.
+#include <stddef.h>                         // size_t member.
+#include <vector>                           // std::vector member.
 
 #include "BitFunnel/BitFunnelTypes.h"       // DocId parameter.
 #include "BitFunnel/Index/IDocument.h"      // Inherits from IDocument.
-#include "BitFunnel/Utilities/RingBuffer.h" // RingBuffer member.
 #include "BitFunnel/Term.h"                 // Term template parameter.
+#include "TermSet.h"                        // TermSet member.
 
 
 namespace BitFunnel
@@ -40,6 +41,12 @@ namespace BitFunnel
     public:
         Document(IConfiguration const & config, DocId id);
 
+        // Prepares the Document to hold the document with the given id,
+        // discarding its current contents. The storage for postings is kept,
+        // so that a Document reused across many documents stops allocating
+        // once it has held the largest of them.
+        void Reset(DocId id);
+
         // TODO: Should GetDocId() be part of IDocument?
         // Probably not. There is no requirement that the id be internal to the
         // document. The id could be supplied by another system.
@@ -79,14 +86,15 @@ namespace BitFunnel
         virtual void CloseDocument(size_t sourceByteSize) override;
 
     private:
-        // Invoke AddPosting() for each ngram starting at the front of
-        // m_ringBuffer. This includes ngrams with lengths 1 to
-        // IConfiguration::GetMaxGramSize.
-        void ProcessNGrams();
+        // Hashes the terms buffered by AddTerm() and invokes AddNGrams() for
+        // each of them in order.
+        void FlushTerms();
 
-        // Invoke AddPosting() for each ngram starting at each position in
-        // m_ringBuffer.
-        void PurgeRingBuffer();
+        // Invoke AddPosting() for each ngram ending with term, which follows
+        // the terms that were passed to the previous calls in the current
+        // stream. This includes ngrams with lengths 1 to
+        // IConfiguration::GetMaxGramSize.
+        void AddNGrams(Term const & term);
 
         // Add term to the set of terms used to create postings in a
         // call to Ingest().
@@ -98,7 +106,7 @@ namespace BitFunnel
 
         IConfiguration const & m_configuration;
 
-        const DocId m_docId;
+        DocId m_docId;
 
         // Maximum size of ngrams that will be indexed.
         const size_t m_maxGramSize;
@@ -110,9 +118,20 @@ namespace BitFunnel
 
         size_t m_sourceByteSize;
 
-        // Ring buffer used to generate ngram postings.
-        static const size_t c_ringBufferSize = Term::c_log2MaxGramSize + 1;
-        RingBuffer<Term, c_ringBufferSize> m_ringBuffer;
+        // AddTerm() buffers terms so that they can be hashed in batches of
+        // up to c_termBatchSize terms. m_batchText holds the text of each
+        // buffered term followed by a '\0'.
+        static const size_t c_termBatchSize = 16;
+        std::vector<char> m_batchText;
+        size_t m_batchOffsets[c_termBatchSize];
+        size_t m_batchLengths[c_termBatchSize];
+        size_t m_batchCount;
+
+        // The ngrams which end with the last term added to the current
+        // stream. m_grams[n] has n + 1 terms. Each call to AddNGrams()
+        // extends these ngrams by one term, so every ngram is computed from
+        // a shorter one in a single pass over the stream.
+        std::vector<Term> m_grams;
 
 
         //
@@ -127,7 +146,6 @@ namespace BitFunnel
         // Only valid when m_streamIsOpen is true.
         Term::StreamId m_currentStreamId;
 
-        // TODO: Replace unordered_set with alloc free version.
-        std::unordered_set<Term, Term::Hasher> m_postings;
+        TermSet m_postings;
     };
 }
@@ -20,8 +20,8 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
+#include "BitFunnel/Chunks/IChunkManifestIngestor.h"
 #include "BitFunnel/Index/IngestChunks.h"
-#include "ChunkEnumerator.h"
 
 
 namespace BitFunnel
@@ -29,8 +29,6 @@ namespace BitFunnel
     void IngestChunks(IChunkManifestIngestor const & manifest,
                       size_t threadCount)
     {
-        ChunkEnumerator chunkEnumerator(manifest, threadCount);
-
-        chunkEnumerator.WaitForCompletion();
+        manifest.IngestChunks(threadCount);
     }
 }
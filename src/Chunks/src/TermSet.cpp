@@ -0,0 +1,137 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "LoggerInterfaces/Logging.h"
+#include "TermSet.h"
+
+
+namespace BitFunnel
+{
+    // Initial number of slots. Must be a power of two.
+    static const size_t c_initialSlotCount = 256;
+
+
+    TermSet::TermSet()
+      : m_slots(c_initialSlotCount, Slot()),
+        m_mask(c_initialSlotCount - 1),
+        m_generation(1)
+    {
+        m_terms.reserve(c_initialSlotCount / 2);
+    }
+
+
+    void TermSet::Add(Term const & term)
+    {
+        // Keep the load factor at or below one half so that probe sequences
+        // stay short.
+        if (2 * (m_terms.size() + 1) > m_slots.size())
+        {
+            Grow();
+        }
+
+        Slot& slot = m_slots[FindSlot(term)];
+        if (slot.m_generation != m_generation)
+        {
+            slot.m_generation = m_generation;
+            slot.m_index = static_cast<uint32_t>(m_terms.size());
+            m_terms.push_back(term);
+        }
+    }
+
+
+    bool TermSet::Contains(Term const & term) const
+    {
+        return m_slots[FindSlot(term)].m_generation == m_generation;
+    }
+
+
+    size_t TermSet::GetCount() const
+    {
+        return m_terms.size();
+    }
+
+
+    void TermSet::Clear()
+    {
+        m_terms.clear();
+
+        ++m_generation;
+        if (m_generation == 0)
+        {
+            // The generation wrapped around, so slots filled four billion
+            // generations ago would appear to be full. Zero is reserved for
+            // slots that were never filled.
+            for (auto & slot : m_slots)
+            {
+                slot.m_generation = 0;
+            }
+            m_generation = 1;
+        }
+    }
+
+
+    TermSet::const_iterator TermSet::begin() const
+    {
+        return m_terms.begin();
+    }
+
+
+    TermSet::const_iterator TermSet::end() const
+    {
+        return m_terms.end();
+    }
+
+
+    size_t TermSet::FindSlot(Term const & term) const
+    {
+        size_t index = Term::Hasher()(term) & m_mask;
+        for (;;)
+        {
+            Slot const & slot = m_slots[index];
+            if (slot.m_generation != m_generation
+                || m_terms[slot.m_index] == term)
+            {
+                return index;
+            }
+            index = (index + 1) & m_mask;
+        }
+    }
+
+
+    void TermSet::Grow()
+    {
+        const size_t slotCount = 2 * m_slots.size();
+        LogAssertB(slotCount <= (static_cast<size_t>(1) << 32),
+                   "TermSet: too many terms.");
+
+        m_slots.assign(slotCount, Slot());
+        m_mask = slotCount - 1;
+        m_generation = 1;
+
+        for (size_t i = 0; i < m_terms.size(); ++i)
+        {
+            Slot& slot = m_slots[FindSlot(m_terms[i])];
+            slot.m_generation = m_generation;
+            slot.m_index = static_cast<uint32_t>(i);
+        }
+    }
+}
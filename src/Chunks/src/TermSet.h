@@ -0,0 +1,94 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <stddef.h>                 // size_t return value.
+#include <stdint.h>                 // uint32_t embedded.
+#include <vector>                   // std::vector embedded.
+
+#include "BitFunnel/NonCopyable.h"  // Base class.
+#include "BitFunnel/Term.h"         // Term template parameter.
+
+
+namespace BitFunnel
+{
+    //*************************************************************************
+    //
+    // TermSet
+    //
+    // A set of Terms with the same equality as std::unordered_set<Term,
+    // Term::Hasher>, intended to be cleared and refilled for each document.
+    // Terms are stored densely in insertion order, indexed by an open
+    // addressing hash table with linear probing. Each slot carries the
+    // generation in which it was filled, so Clear() only advances the
+    // generation and keeps all storage for the next document. Storage is
+    // allocated only when a document has more terms than any before it.
+    //
+    // This class is not thread-safe.
+    //
+    //*************************************************************************
+    class TermSet : NonCopyable
+    {
+    public:
+        typedef std::vector<Term>::const_iterator const_iterator;
+
+        TermSet();
+
+        // Adds term to the set if it is not already present.
+        void Add(Term const & term);
+
+        bool Contains(Term const & term) const;
+
+        size_t GetCount() const;
+
+        // Removes all terms in constant time.
+        void Clear();
+
+        // Iterates over the terms in the order in which they were added.
+        const_iterator begin() const;
+        const_iterator end() const;
+
+    private:
+        struct Slot
+        {
+            uint32_t m_generation;
+            uint32_t m_index;
+        };
+
+        // Returns the index of the slot holding term, or of the empty slot
+        // where it would be added.
+        size_t FindSlot(Term const & term) const;
+
+        // Doubles the number of slots and re-adds the terms.
+        void Grow();
+
+        std::vector<Term> m_terms;
+        std::vector<Slot> m_slots;
+
+        // The number of slots is a power of two. m_mask is one less.
+        size_t m_mask;
+
+        // Slots whose m_generation differs from m_generation are empty.
+        uint32_t m_generation;
+    };
+}
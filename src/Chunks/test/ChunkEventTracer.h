@@ -39,6 +39,13 @@ namespace BitFunnel
         class ChunkEventTracer : public IChunkProcessor
         {
         public:
+            // Constructs a tracer which records the events of a ChunkReader
+            // supplied by the caller.
+            ChunkEventTracer()
+            {
+            }
+
+
             ChunkEventTracer(std::vector<char> const & chunkData)
             {
                 ChunkReader(&chunkData[0],
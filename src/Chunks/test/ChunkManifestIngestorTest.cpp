@@ -0,0 +1,278 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "BitFunnel/Chunks/DocumentFilters.h"
+#include "BitFunnel/Chunks/Factories.h"
+#include "BitFunnel/Chunks/IChunkManifestIngestor.h"
+#include "BitFunnel/Configuration/Factories.h"
+#include "BitFunnel/Configuration/IFileSystem.h"
+#include "BitFunnel/Exceptions.h"
+#include "BitFunnel/Index/Factories.h"
+#include "BitFunnel/Index/IDocument.h"
+#include "BitFunnel/Index/IDocumentCache.h"
+#include "BitFunnel/Index/IIngestor.h"
+#include "BitFunnel/Index/ISimpleIndex.h"
+#include "ChunkPipeline.h"
+
+
+namespace BitFunnel
+{
+    namespace ChunkManifestIngestorTest
+    {
+        static const size_t c_chunkCount = 6;
+        static const size_t c_documentsPerChunk = 150;
+
+        // Number of distinct terms, and therefore unigram postings, in the
+        // document with the given id.
+        static size_t TermCount(DocId id)
+        {
+            return (id % 7) + 1;
+        }
+
+
+        // Writes c_chunkCount chunk files with c_documentsPerChunk documents
+        // each to fileSystem and returns their paths. DocIds start at 1.
+        static std::vector<std::string> WriteChunks(IFileSystem & fileSystem)
+        {
+            std::vector<std::string> paths;
+            DocId id = 1;
+            for (size_t chunk = 0; chunk < c_chunkCount; ++chunk)
+            {
+                std::stringstream path;
+                path << "chunk" << chunk;
+                paths.push_back(path.str());
+
+                auto output = fileSystem.OpenForWrite(paths.back().c_str());
+                for (size_t i = 0; i < c_documentsPerChunk; ++i, ++id)
+                {
+                    *output << std::hex << std::setw(16) << std::setfill('0')
+                            << id << std::dec << '\0';
+                    *output << "00" << '\0';
+                    for (size_t t = 0; t < TermCount(id); ++t)
+                    {
+                        *output << "term" << (id + t * 13) % 97 << '\0';
+                    }
+                    *output << '\0' << '\0';
+                }
+                *output << '\0';
+            }
+            return paths;
+        }
+
+
+        static std::unique_ptr<ISimpleIndex> CreateIndex(IFileSystem & fileSystem)
+        {
+            auto index = Factories::CreateSimpleIndex(fileSystem);
+            index->ConfigureAsMock(1, false);
+            index->StartIndex();
+            return index;
+        }
+
+
+        // Ingests the chunks at paths into a new index and returns the
+        // posting counts of the ingested documents by DocId, read from the
+        // document cache when cacheDocuments is true. Otherwise the posting
+        // counts are zero.
+        static std::map<DocId, size_t> Ingest(IFileSystem & fileSystem,
+                                              std::vector<std::string> const & paths,
+                                              IDocumentFilter & filter,
+                                              bool cacheDocuments,
+                                              size_t threadCount)
+        {
+            auto index = CreateIndex(fileSystem);
+            IIngestor & ingestor = index->GetIngestor();
+
+            auto manifest =
+                Factories::CreateChunkManifestIngestor(fileSystem,
+                                                       nullptr,
+                                                       paths,
+                                                       index->GetConfiguration(),
+                                                       ingestor,
+                                                       filter,
+                                                       cacheDocuments);
+            manifest->IngestChunks(threadCount);
+
+            std::map<DocId, size_t> documents;
+            const DocId maxId = c_chunkCount * c_documentsPerChunk;
+            for (DocId id = 0; id <= maxId + 1; ++id)
+            {
+                if (ingestor.Contains(id))
+                {
+                    documents[id] = 0;
+                }
+            }
+            EXPECT_EQ(documents.size(), ingestor.GetDocumentCount());
+
+            size_t cachedCount = 0;
+            for (auto entry : ingestor.GetDocumentCache())
+            {
+                ++cachedCount;
+                EXPECT_EQ(1u, documents.count(entry.second));
+                documents[entry.second] = entry.first.GetPostingCount();
+            }
+            EXPECT_EQ(cacheDocuments ? documents.size() : 0u, cachedCount);
+
+            return documents;
+        }
+
+
+        // The documents which WriteChunks() writes and filter would keep.
+        static std::map<DocId, size_t> Expected(size_t minPostingCount,
+                                                size_t maxPostingCount,
+                                                bool cacheDocuments)
+        {
+            std::map<DocId, size_t> documents;
+            const DocId maxId = c_chunkCount * c_documentsPerChunk;
+            for (DocId id = 1; id <= maxId; ++id)
+            {
+                const size_t count = TermCount(id);
+                if (count >= minPostingCount && count <= maxPostingCount)
+                {
+                    documents[id] = cacheDocuments ? count : 0;
+                }
+            }
+            return documents;
+        }
+
+
+        TEST(ChunkManifestIngestor, PipelineMatchesSequential)
+        {
+            auto fileSystem = Factories::CreateRAMFileSystem();
+            auto paths = WriteChunks(*fileSystem);
+
+            for (bool cacheDocuments : { false, true })
+            {
+                NopFilter filter;
+                auto sequential =
+                    Ingest(*fileSystem, paths, filter, cacheDocuments, 1);
+                EXPECT_EQ(Expected(0, 100, cacheDocuments), sequential);
+
+                for (size_t threadCount = 2; threadCount <= 8; threadCount *= 2)
+                {
+                    auto pipelined = Ingest(*fileSystem,
+                                            paths,
+                                            filter,
+                                            cacheDocuments,
+                                            threadCount);
+                    EXPECT_EQ(sequential, pipelined);
+                }
+            }
+        }
+
+
+        TEST(ChunkManifestIngestor, Filter)
+        {
+            auto fileSystem = Factories::CreateRAMFileSystem();
+            auto paths = WriteChunks(*fileSystem);
+
+            // PostingCountFilter has no state, so it may be shared by
+            // threads.
+            const size_t minCount = 2;
+            const size_t maxCount = 4;
+            PostingCountFilter filter(minCount, maxCount);
+            auto expected = Expected(minCount, maxCount, true);
+
+            EXPECT_EQ(expected, Ingest(*fileSystem, paths, filter, true, 1));
+            EXPECT_EQ(expected, Ingest(*fileSystem, paths, filter, true, 4));
+        }
+
+
+        TEST(ChunkManifestIngestor, Errors)
+        {
+            auto fileSystem = Factories::CreateRAMFileSystem();
+            auto paths = WriteChunks(*fileSystem);
+
+            // An empty chunk.
+            auto empty = paths;
+            fileSystem->OpenForWrite("empty");
+            empty.insert(empty.begin() + 2, "empty");
+
+            // A chunk which does not exist.
+            auto missing = paths;
+            missing.push_back("missing");
+
+            for (auto const & badPaths : { empty, missing })
+            {
+                for (size_t threadCount : { 1, 4 })
+                {
+                    auto index = CreateIndex(*fileSystem);
+                    NopFilter filter;
+                    auto manifest =
+                        Factories::CreateChunkManifestIngestor(*fileSystem,
+                                                               nullptr,
+                                                               badPaths,
+                                                               index->GetConfiguration(),
+                                                               index->GetIngestor(),
+                                                               filter,
+                                                               false);
+                    EXPECT_THROW(manifest->IngestChunks(threadCount),
+                                 FatalError);
+                }
+            }
+        }
+
+
+        // Small runs make every stage hand work to the next many times, so
+        // the queues fill up and the stages also run inline.
+        TEST(ChunkPipeline, SmallRanges)
+        {
+            auto fileSystem = Factories::CreateRAMFileSystem();
+            auto paths = WriteChunks(*fileSystem);
+
+            NopFilter filter;
+            auto expected = Ingest(*fileSystem, paths, filter, true, 1);
+
+            for (size_t rangeByteSize : { 1, 64, 1024 })
+            {
+                auto index = CreateIndex(*fileSystem);
+                ChunkPipeline pipeline(*fileSystem,
+                                       paths,
+                                       index->GetConfiguration(),
+                                       index->GetIngestor(),
+                                       filter,
+                                       true,
+                                       3,
+                                       rangeByteSize);
+                pipeline.Run();
+
+                std::map<DocId, size_t> observed;
+                for (auto entry : index->GetIngestor().GetDocumentCache())
+                {
+                    observed[entry.second] = entry.first.GetPostingCount();
+                }
+                EXPECT_EQ(expected, observed);
+                EXPECT_EQ(expected.size(),
+                          index->GetIngestor().GetDocumentCount());
+            }
+        }
+    }
+}
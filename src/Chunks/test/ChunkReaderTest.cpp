@@ -203,5 +203,67 @@ namespace BitFunnel
                 EXPECT_EQ(trace.str(), tracer.Trace());
             });
         }
+
+
+        // Split a chunk into runs of one document each and verify that
+        // parsing the runs generates the same document events as parsing the
+        // whole chunk.
+        TEST(ChunkReader, SplitDocuments)
+        {
+            std::vector<char> const chunk = ToCharVector(
+                // First document
+                "00000000000000f0\0"
+                "20\0Dogs\0\0"
+                "\0"
+
+                // Second document
+                "00000000000000f1\0"
+                "20\0Cat\0Facts\0\0"
+                "30\0The\0internet\0\0"
+                "\0"
+
+                // Third document
+                "00000000000000f2\0"
+                "20\0More\0\0"
+                "\0"
+
+                // End of corpus
+                "\0");
+
+            char const * start = &chunk[0];
+            char const * end = start + chunk.size();
+
+            std::vector<char const *> const boundaries =
+                ChunkReader::SplitDocuments(start, end, 1);
+            ASSERT_EQ(4u, boundaries.size());
+            EXPECT_EQ(start, boundaries.front());
+
+            // The last run ends before the end of corpus marker.
+            EXPECT_EQ(end - 1, boundaries.back());
+
+            Mocks::ChunkEventTracer runs;
+            for (size_t i = 0; i + 1 < boundaries.size(); ++i)
+            {
+                ChunkReader::ReadDocuments(boundaries[i],
+                                           boundaries[i + 1],
+                                           runs);
+            }
+
+            Mocks::ChunkEventTracer whole(chunk);
+            std::string expected = whole.Trace();
+            std::string const fileEnter = "OnFileEnter\n";
+            std::string const fileExit = "OnFileExit\n";
+            ASSERT_EQ(0u, expected.find(fileEnter));
+            expected = expected.substr(
+                fileEnter.size(),
+                expected.size() - fileEnter.size() - fileExit.size());
+            EXPECT_EQ(expected, runs.Trace());
+
+            // A large target keeps all of the documents in a single run.
+            std::vector<char const *> const single =
+                ChunkReader::SplitDocuments(start, end, chunk.size());
+            ASSERT_EQ(2u, single.size());
+            EXPECT_EQ(boundaries.back(), single.back());
+        }
     }
 }
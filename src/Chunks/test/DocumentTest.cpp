@@ -21,6 +21,8 @@
 // THE SOFTWARE.
 
 #include <array>
+#include <string>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -133,4 +135,103 @@ namespace BitFunnel
         Term unexpected("unexpected", streamId, *config);
         EXPECT_FALSE(d.Contains(unexpected));
     }
+
+
+    TEST(Document, Reset)
+    {
+        const Term::StreamId streamId = 0;
+        const size_t gramSize = 1;
+
+        auto idfTable = Factories::CreateIndexedIdfTable();
+        auto facts = Factories::CreateFactSet();
+        auto config =
+            Factories::CreateConfiguration(gramSize, false, *idfTable, *facts);
+        Document d(*config, 0);
+
+        d.OpenStream(streamId);
+        d.AddTerm("one");
+        d.AddTerm("two");
+        d.CloseStream();
+        d.CloseDocument(10);
+
+        // A stream left open by the previous document is discarded too.
+        d.Reset(1);
+        d.OpenStream(streamId);
+        d.AddTerm("three");
+        d.Reset(2);
+        EXPECT_EQ(2u, d.GetDocId());
+        EXPECT_EQ(0u, d.GetPostingCount());
+        EXPECT_EQ(0u, d.GetSourceByteSize());
+
+        d.OpenStream(streamId);
+        d.AddTerm("two");
+        d.CloseStream();
+        d.CloseDocument(3);
+
+        EXPECT_EQ(1u, d.GetPostingCount());
+        EXPECT_EQ(3u, d.GetSourceByteSize());
+        Term one("one", streamId, *config);
+        Term two("two", streamId, *config);
+        Term three("three", streamId, *config);
+        EXPECT_TRUE(d.Contains(two));
+        EXPECT_FALSE(d.Contains(one));
+        EXPECT_FALSE(d.Contains(three));
+    }
+
+
+    // Streams longer than the batch of terms hashed at once must produce
+    // exactly the ngrams of their terms, without ngrams that span streams.
+    TEST(Document, LongStreams)
+    {
+        const DocId docId = 0;
+        const size_t gramSize = 3;
+        const size_t termCount = 40;
+
+        auto idfTable = Factories::CreateIndexedIdfTable();
+        auto facts = Factories::CreateFactSet();
+        auto config =
+            Factories::CreateConfiguration(gramSize, false, *idfTable, *facts);
+        Document d(*config, docId);
+
+        std::vector<std::string> text;
+        for (size_t i = 0; i < termCount; ++i)
+        {
+            text.push_back("word" + std::to_string(i));
+        }
+
+        for (Term::StreamId streamId = 0; streamId < 2; ++streamId)
+        {
+            d.OpenStream(streamId);
+            for (auto const & word : text)
+            {
+                d.AddTerm(word.c_str());
+            }
+            d.CloseStream();
+        }
+        d.CloseDocument(0);
+
+        // Each stream has termCount unigrams, termCount - 1 bigrams and
+        // termCount - 2 trigrams. Terms from different streams differ only
+        // in their StreamId, which is not part of Term equality.
+        EXPECT_EQ(3 * termCount - 3, d.GetPostingCount());
+
+        for (size_t i = 0; i < termCount; ++i)
+        {
+            Term term(text[i].c_str(), 0, *config);
+            EXPECT_TRUE(d.Contains(term));
+            for (size_t j = i + 1; j < termCount && j < i + gramSize; ++j)
+            {
+                Term next(text[j].c_str(), 0, *config);
+                term.AddTerm(next, *config);
+                EXPECT_TRUE(d.Contains(term));
+            }
+        }
+
+        // No ngram spans the end of the first stream and the start of the
+        // second.
+        Term last(text[termCount - 1].c_str(), 0, *config);
+        Term first(text[0].c_str(), 0, *config);
+        last.AddTerm(first, *config);
+        EXPECT_FALSE(d.Contains(last));
+    }
 }
@@ -0,0 +1,104 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <unordered_set>
+
+#include "gtest/gtest.h"
+
+#include "BitFunnel/Term.h"
+#include "TermSet.h"
+
+
+namespace BitFunnel
+{
+    TEST(TermSet, Basic)
+    {
+        TermSet set;
+        EXPECT_EQ(0u, set.GetCount());
+
+        const Term a(1234, 0, 10);
+        const Term b(5678, 0, 10);
+
+        set.Add(a);
+        set.Add(a);
+        EXPECT_EQ(1u, set.GetCount());
+        EXPECT_TRUE(set.Contains(a));
+        EXPECT_FALSE(set.Contains(b));
+
+        // Terms with the same raw hash but different gram sizes collide.
+        const Term bigram(1234, 0, 10, 2);
+        set.Add(bigram);
+        EXPECT_EQ(2u, set.GetCount());
+        EXPECT_TRUE(set.Contains(bigram));
+
+        set.Clear();
+        EXPECT_EQ(0u, set.GetCount());
+        EXPECT_FALSE(set.Contains(a));
+        EXPECT_TRUE(set.begin() == set.end());
+    }
+
+
+    // Compares TermSet with std::unordered_set over several documents of
+    // increasing size, which forces TermSet to grow while it is reused.
+    TEST(TermSet, MatchesUnorderedSet)
+    {
+        TermSet set;
+
+        for (unsigned document = 0; document < 20; ++document)
+        {
+            set.Clear();
+            std::unordered_set<Term, Term::Hasher> expected;
+
+            const unsigned termCount = 50 * document;
+            for (unsigned i = 0; i < termCount; ++i)
+            {
+                // Low hash bits repeat so that probe sequences collide.
+                const Term term((static_cast<Term::Hash>(i % 97) << 8) + document,
+                                0,
+                                10,
+                                static_cast<Term::GramSize>(1 + i % 3));
+                set.Add(term);
+                expected.insert(term);
+            }
+
+            ASSERT_EQ(expected.size(), set.GetCount());
+
+            size_t count = 0;
+            for (auto const & term : set)
+            {
+                EXPECT_TRUE(expected.find(term) != expected.end());
+                ++count;
+            }
+            EXPECT_EQ(expected.size(), count);
+
+            for (auto const & term : expected)
+            {
+                EXPECT_TRUE(set.Contains(term));
+            }
+
+            // Terms from the previous document are gone.
+            const Term previous(document - 1, 0, 10);
+            EXPECT_EQ(expected.find(previous) != expected.end(),
+                      set.Contains(previous));
+        }
+    }
+}
@@ -82,6 +82,10 @@ namespace BitFunnel
                                                    indexDirectory,
                                                    "IndexedIdfTable",
                                                    ".bin")),
+          m_indexSlice(new ParameterizedFile2(fileSystem,
+                                              indexDirectory,
+                                              "IndexSlice",
+                                              ".bin")),
           m_manifest(new ParameterizedFile0(fileSystem,
                                             indexDirectory,
                                             "Manifest",
@@ -108,6 +112,10 @@ namespace BitFunnel
                                      statisticsDirectory,
                                      "ShardDefinition",
                                      ".csv")),
+          m_shardSnapshot(new ParameterizedFile1(fileSystem,
+                                                 indexDirectory,
+                                                 "ShardSnapshot",
+                                                 ".bin")),
           m_termTable(new ParameterizedFile1(fileSystem,
                                              indexDirectory,
                                              "TermTable",
@@ -232,6 +240,12 @@ namespace BitFunnel
     }
 
 
+    FileDescriptor1 FileManager::ShardSnapshot(size_t shard)
+    {
+        return FileDescriptor1(*m_shardSnapshot, shard);
+    }
+
+
     FileDescriptor1 FileManager::TermTable(size_t shard)
     {
         return FileDescriptor1(*m_termTable, shard);
@@ -255,8 +269,8 @@ namespace BitFunnel
     // FileDescriptor2 files.
     //
 
-    //FileDescriptor2 FileManager::IndexSlice(size_t shard, size_t slice)
-    //{
-    //    return FileDescriptor2(*m_indexSlice, shard, slice);
-    //}
+    FileDescriptor2 FileManager::IndexSlice(size_t shard, size_t slice)
+    {
+        return FileDescriptor2(*m_indexSlice, shard, slice);
+    }
 }
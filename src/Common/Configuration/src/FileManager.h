@@ -82,10 +82,11 @@ namespace BitFunnel
         //virtual FileDescriptor1 DocTable(size_t shard) override;
         //virtual FileDescriptor1 ScoreTable(size_t shard) override;
         virtual FileDescriptor1 RowDensities(size_t shard) override;
+        virtual FileDescriptor1 ShardSnapshot(size_t shard) override;
         virtual FileDescriptor1 TermTable(size_t shard) override;
         virtual FileDescriptor1 TermTableStatistics(size_t shard) override;
 
-        //virtual FileDescriptor2 IndexSlice(size_t shard, size_t slice) override;
+        virtual FileDescriptor2 IndexSlice(size_t shard, size_t slice) override;
 
     private:
         std::unique_ptr<IParameterizedFile1> m_chunk;
@@ -96,12 +97,14 @@ namespace BitFunnel
         std::unique_ptr<IParameterizedFile1> m_docFreqTable;
         std::unique_ptr<IParameterizedFile0> m_documentHistogram;
         std::unique_ptr<IParameterizedFile1> m_indexedIdfTable;
+        std::unique_ptr<IParameterizedFile2> m_indexSlice;
         std::unique_ptr<IParameterizedFile0> m_manifest;
         std::unique_ptr<IParameterizedFile0> m_queryLog;
         std::unique_ptr<IParameterizedFile0> m_queryPipelineStatistics;
         std::unique_ptr<IParameterizedFile0> m_querySummaryStatistics;
         std::unique_ptr<IParameterizedFile1> m_rowDensities;
         std::unique_ptr<IParameterizedFile0> m_shardDefinition;
+        std::unique_ptr<IParameterizedFile1> m_shardSnapshot;
         std::unique_ptr<IParameterizedFile1> m_termTable;
         std::unique_ptr<IParameterizedFile1> m_termTableStatistics;
         std::unique_ptr<IParameterizedFile0> m_termToText;
@@ -0,0 +1,241 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <cstring>
+#include <istream>
+#include <sstream>
+
+#include "BitFunnel/BitFunnelTypes.h"
+#include "BitFunnel/Exceptions.h"
+#include "FileMapping.h"
+#include "LoggerInterfaces/Logging.h"
+
+#ifdef BITFUNNEL_PLATFORM_WINDOWS
+#include <Windows.h>        // For CreateFileMapping/MapViewOfFile.
+#else
+#include <cerrno>
+#include <fcntl.h>          // For open.
+#include <sys/mman.h>       // For mmap/munmap.
+#include <sys/stat.h>       // For fstat.
+#include <unistd.h>         // For close.
+#endif
+
+
+namespace BitFunnel
+{
+    //*************************************************************************
+    //
+    // FileMapping
+    //
+    //*************************************************************************
+#ifdef BITFUNNEL_PLATFORM_WINDOWS
+    // Windows has no access pattern advice for views of a file, so
+    // isSequential is ignored.
+    FileMapping::FileMapping(char const * filename, bool /*isSequential*/)
+      : m_data(nullptr),
+        m_size(0)
+    {
+        HANDLE file = CreateFileA(filename,
+                                  GENERIC_READ,
+                                  FILE_SHARE_READ,
+                                  nullptr,
+                                  OPEN_EXISTING,
+                                  FILE_ATTRIBUTE_NORMAL,
+                                  nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            std::stringstream message;
+            message << "File " << filename << " failed to open for mapping.";
+            throw RecoverableError(message.str());
+        }
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size))
+        {
+            CloseHandle(file);
+            std::stringstream message;
+            message << "File " << filename << " failed to get size.";
+            throw RecoverableError(message.str());
+        }
+        m_size = static_cast<size_t>(size.QuadPart);
+
+        if (m_size > 0)
+        {
+            HANDLE mapping = CreateFileMappingA(file,
+                                                nullptr,
+                                                PAGE_WRITECOPY,
+                                                0,
+                                                0,
+                                                nullptr);
+            if (mapping != nullptr)
+            {
+                m_data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+                CloseHandle(mapping);
+            }
+        }
+        CloseHandle(file);
+
+        if (m_size > 0 && m_data == nullptr)
+        {
+            std::stringstream message;
+            message << "File " << filename << " failed to map.";
+            throw RecoverableError(message.str());
+        }
+    }
+
+
+    FileMapping::~FileMapping()
+    {
+        if (m_data != nullptr)
+        {
+            UnmapViewOfFile(m_data);
+        }
+    }
+#else
+    FileMapping::FileMapping(char const * filename, bool isSequential)
+      : m_data(nullptr),
+        m_size(0)
+    {
+        const int file = open(filename, O_RDONLY);
+        if (file == -1)
+        {
+            std::stringstream message;
+            message << "File " << filename << " failed to open for mapping: "
+                    << std::strerror(errno);
+            throw RecoverableError(message.str());
+        }
+
+        struct stat status;
+        if (fstat(file, &status) == -1)
+        {
+            std::stringstream message;
+            message << "File " << filename << " failed to get size: "
+                    << std::strerror(errno);
+            close(file);
+            throw RecoverableError(message.str());
+        }
+        m_size = static_cast<size_t>(status.st_size);
+
+        if (m_size > 0)
+        {
+            // MAP_PRIVATE makes writes copy-on-write. The mapping holds its
+            // own reference to the file, so the descriptor can be closed.
+            void* data = mmap(nullptr,
+                              m_size,
+                              PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE,
+                              file,
+                              0);
+
+            // See SimpleBuffer.cpp for the reason behind this pragma.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+            if (data == MAP_FAILED)
+#pragma GCC diagnostic pop
+            {
+                std::stringstream message;
+                message << "File " << filename << " failed to map: "
+                        << std::strerror(errno);
+                close(file);
+                throw RecoverableError(message.str());
+            }
+            m_data = data;
+
+            // The advice only affects paging, so failure is not an error.
+            if (isSequential)
+            {
+                madvise(m_data, m_size, MADV_SEQUENTIAL);
+            }
+        }
+        close(file);
+    }
+
+
+    FileMapping::~FileMapping()
+    {
+        if (m_data != nullptr)
+        {
+            if (munmap(m_data, m_size) == -1)
+            {
+                LogB(Logging::Error,
+                     "FileMapping",
+                     "munmap() failed in FileMapping::~FileMapping()",
+                     "");
+            }
+        }
+    }
+#endif
+
+
+    void* FileMapping::GetData() const
+    {
+        return m_data;
+    }
+
+
+    size_t FileMapping::GetSize() const
+    {
+        return m_size;
+    }
+
+
+    //*************************************************************************
+    //
+    // BufferedFileMapping
+    //
+    //*************************************************************************
+    BufferedFileMapping::BufferedFileMapping(std::istream& input)
+      : m_data(nullptr),
+        m_size(0)
+    {
+        const std::streampos start = input.tellg();
+        input.seekg(0, std::ios::end);
+        m_size = static_cast<size_t>(input.tellg() - start);
+        input.seekg(start);
+
+        // Over-allocate so that the data can start on a cache line boundary.
+        m_buffer.reset(new char[m_size + c_bytesPerCacheLine]);
+        const size_t misalignment =
+            reinterpret_cast<size_t>(m_buffer.get()) % c_bytesPerCacheLine;
+        m_data = m_buffer.get() +
+            ((misalignment == 0) ? 0 : c_bytesPerCacheLine - misalignment);
+
+        input.read(static_cast<char*>(m_data),
+                   static_cast<std::streamsize>(m_size));
+        if (static_cast<size_t>(input.gcount()) != m_size)
+        {
+            throw RecoverableError("BufferedFileMapping: unexpected end of stream.");
+        }
+    }
+
+
+    void* BufferedFileMapping::GetData() const
+    {
+        return m_data;
+    }
+
+
+    size_t BufferedFileMapping::GetSize() const
+    {
+        return m_size;
+    }
+}
@@ -0,0 +1,86 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <iosfwd>                                   // std::istream parameter.
+#include <memory>                                   // std::unique_ptr embedded.
+
+#include "BitFunnel/Configuration/IFileSystem.h"    // Base class.
+#include "BitFunnel/NonCopyable.h"                  // Base class.
+
+
+namespace BitFunnel
+{
+    //*************************************************************************
+    //
+    // FileMapping
+    //
+    // IFileMapping over an operating system memory mapped view of a file.
+    // The view is copy-on-write, so pages are read from the file when they
+    // are first touched and pages that are written become private copies.
+    //
+    //*************************************************************************
+    class FileMapping : public IFileMapping, NonCopyable
+    {
+    public:
+        // Maps the entire contents of the file. Throws if the file cannot be
+        // opened or mapped. When isSequential is true, the operating system
+        // is advised that the mapping will be read sequentially, so that it
+        // reads ahead aggressively and may free pages soon after they have
+        // been read.
+        FileMapping(char const * filename, bool isSequential);
+
+        virtual ~FileMapping();
+
+        virtual void* GetData() const override;
+        virtual size_t GetSize() const override;
+
+    private:
+        void* m_data;
+        size_t m_size;
+    };
+
+
+    //*************************************************************************
+    //
+    // BufferedFileMapping
+    //
+    // IFileMapping which reads the contents of a stream into a heap buffer.
+    // Used by IFileSystems that are not backed by operating system files.
+    //
+    //*************************************************************************
+    class BufferedFileMapping : public IFileMapping, NonCopyable
+    {
+    public:
+        // Reads the stream from its current position to the end.
+        BufferedFileMapping(std::istream& input);
+
+        virtual void* GetData() const override;
+        virtual size_t GetSize() const override;
+
+    private:
+        std::unique_ptr<char[]> m_buffer;
+        void* m_data;
+        size_t m_size;
+    };
+}
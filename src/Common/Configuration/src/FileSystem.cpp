@@ -25,6 +25,7 @@
 
 #include "BitFunnel/Configuration/Factories.h"
 #include "BitFunnel/Exceptions.h"
+#include "FileMapping.h"
 #include "FileSystem.h"
 
 
@@ -84,4 +85,29 @@ namespace BitFunnel
 
         return std::unique_ptr<std::istream>(stream.release());
     }
+
+
+    std::unique_ptr<IFileMapping>
+        FileSystem::OpenForMapping(char const * filename)
+    {
+        return std::unique_ptr<IFileMapping>(new FileMapping(filename, false));
+    }
+
+
+    std::unique_ptr<IFileMapping>
+        FileSystem::OpenForSequentialMapping(char const * filename)
+    {
+        try
+        {
+            return std::unique_ptr<IFileMapping>(new FileMapping(filename, true));
+        }
+        catch (RecoverableError const &)
+        {
+            // Some files, e.g. those on file systems without mmap support,
+            // can still be read. OpenForRead() throws if the file cannot be
+            // opened at all.
+            auto input = OpenForRead(filename, std::ios::binary);
+            return std::unique_ptr<IFileMapping>(new BufferedFileMapping(*input));
+        }
+    }
 }
@@ -41,5 +41,11 @@ namespace BitFunnel
         virtual std::unique_ptr<std::istream>
             OpenForRead(char const * filename,
                         std::ios_base::openmode mode = std::ios::in) override;
+
+        virtual std::unique_ptr<IFileMapping>
+            OpenForMapping(char const * filename) override;
+
+        virtual std::unique_ptr<IFileMapping>
+            OpenForSequentialMapping(char const * filename) override;
     };
 }
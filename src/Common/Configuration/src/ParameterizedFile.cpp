@@ -96,6 +96,12 @@ namespace BitFunnel
     }
 
 
+    std::unique_ptr<IFileMapping> ParameterizedFile::OpenForMapping(const std::string& filename)
+    {
+        return m_fileSystem.OpenForMapping(filename.c_str());
+    }
+
+
     // void ParameterizedFile::Commit(const std::string& filename)
     // {
     //     if (Exists(filename))
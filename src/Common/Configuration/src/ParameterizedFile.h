@@ -51,6 +51,7 @@ namespace BitFunnel
     protected:
         std::string GetTempName(const std::string& filename);
         std::unique_ptr<std::ostream> OpenForWrite(const std::string& filename);
+        std::unique_ptr<IFileMapping> OpenForMapping(const std::string& filename);
         // void Commit(const std::string& filename);
         // bool Exists(const std::string& filename);
         // void Delete(const std::string& filename);
@@ -183,6 +184,11 @@ namespace BitFunnel
             return ParameterizedFile::OpenForWrite(GetName(p1, p2));
         }
 
+        std::unique_ptr<IFileMapping> OpenForMapping(size_t p1, size_t p2)
+        {
+            return ParameterizedFile::OpenForMapping(GetName(p1, p2));
+        }
+
 
         // std::unique_ptr<std::ostream> OpenTempForWrite(size_t p1, size_t p2)
         // {
@@ -21,6 +21,7 @@
 // THE SOFTWARE.
 
 #include "BitFunnel/Configuration/Factories.h"
+#include "FileMapping.h"
 #include "RAMFileSystem.h"
 
 
@@ -56,6 +57,21 @@ namespace BitFunnel
     }
 
 
+    std::unique_ptr<IFileMapping>
+        RAMFileSystem::OpenForMapping(char const * filename)
+    {
+        auto input = OpenForRead(filename, std::ios::binary);
+        return std::unique_ptr<IFileMapping>(new BufferedFileMapping(*input));
+    }
+
+
+    std::unique_ptr<IFileMapping>
+        RAMFileSystem::OpenForSequentialMapping(char const * filename)
+    {
+        return OpenForMapping(filename);
+    }
+
+
     RAMFileSystem::Buffer
         RAMFileSystem::EnsureStream(const char * filename,
                                     bool forWrite)
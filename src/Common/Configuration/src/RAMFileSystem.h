@@ -45,6 +45,12 @@ namespace BitFunnel
             OpenForRead(char const * filename,
                         std::ios_base::openmode mode = std::ios::in) override;
 
+        virtual std::unique_ptr<IFileMapping>
+            OpenForMapping(char const * filename) override;
+
+        virtual std::unique_ptr<IFileMapping>
+            OpenForSequentialMapping(char const * filename) override;
+
     private:
         static std::stringstream& GetStringStream();
         typedef decltype (GetStringStream().rdbuf()) Buffer;
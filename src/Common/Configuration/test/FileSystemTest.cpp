@@ -0,0 +1,114 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "BitFunnel/Configuration/Factories.h"
+#include "BitFunnel/Configuration/IFileSystem.h"
+
+
+namespace BitFunnel
+{
+    TEST(FileSystem, OpenForMapping)
+    {
+        auto fileSystem = Factories::CreateFileSystem();
+
+        char const * name = "FileSystemTest_OpenForMapping.bin";
+        std::string expected;
+        for (unsigned i = 0; i < 10000; ++i)
+        {
+            expected.push_back(static_cast<char>(i * 7));
+        }
+
+        {
+            auto output = fileSystem->OpenForWrite(name, std::ios::binary);
+            output->write(expected.data(),
+                          static_cast<std::streamsize>(expected.size()));
+        }
+
+        {
+            auto mapping = fileSystem->OpenForMapping(name);
+            ASSERT_EQ(expected.size(), mapping->GetSize());
+            EXPECT_EQ(0, memcmp(expected.data(),
+                                mapping->GetData(),
+                                mapping->GetSize()));
+
+            // The mapping is private so writes must not reach the file.
+            memset(mapping->GetData(), 0, mapping->GetSize());
+        }
+
+        {
+            auto mapping = fileSystem->OpenForMapping(name);
+            ASSERT_EQ(expected.size(), mapping->GetSize());
+            EXPECT_EQ(0, memcmp(expected.data(),
+                                mapping->GetData(),
+                                mapping->GetSize()));
+        }
+
+        {
+            // Empty files have no data.
+            auto output = fileSystem->OpenForWrite(name, std::ios::binary);
+        }
+
+        {
+            auto mapping = fileSystem->OpenForMapping(name);
+            EXPECT_EQ(0u, mapping->GetSize());
+        }
+
+        std::remove(name);
+    }
+
+
+    TEST(FileSystem, OpenForSequentialMapping)
+    {
+        auto fileSystem = Factories::CreateFileSystem();
+
+        char const * name = "FileSystemTest_OpenForSequentialMapping.bin";
+        std::string expected;
+        for (unsigned i = 0; i < 100000; ++i)
+        {
+            expected.push_back(static_cast<char>(i * 13));
+        }
+
+        {
+            auto output = fileSystem->OpenForWrite(name, std::ios::binary);
+            output->write(expected.data(),
+                          static_cast<std::streamsize>(expected.size()));
+        }
+
+        {
+            auto mapping = fileSystem->OpenForSequentialMapping(name);
+            ASSERT_EQ(expected.size(), mapping->GetSize());
+            EXPECT_EQ(0, memcmp(expected.data(),
+                                mapping->GetData(),
+                                mapping->GetSize()));
+        }
+
+        std::remove(name);
+
+        EXPECT_ANY_THROW(fileSystem->OpenForSequentialMapping(name));
+    }
+}
@@ -20,11 +20,13 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
+#include <cstring>
 #include <iostream>
 #include <string>
 
 #include "gtest/gtest.h"
 
+#include "BitFunnel/BitFunnelTypes.h"
 #include "RAMFileSystem.h"
 
 
@@ -117,4 +119,30 @@ namespace BitFunnel
             EXPECT_STREQ(expected2, observed.c_str());
         }
     }
+
+
+    TEST(RAMFileSystem, OpenForMapping)
+    {
+        RAMFileSystem files;
+
+        char const * expected = "Contents of file 1.";
+        char const * name = "name1";
+        {
+            auto output = files.OpenForWrite(name);
+            *output << expected;
+        }
+
+        auto mapping = files.OpenForMapping(name);
+        ASSERT_EQ(strlen(expected), mapping->GetSize());
+        EXPECT_EQ(0, memcmp(expected, mapping->GetData(), mapping->GetSize()));
+        EXPECT_EQ(0u, reinterpret_cast<size_t>(mapping->GetData()) % c_bytesPerCacheLine);
+
+        // Writes to the mapping must not change the file.
+        static_cast<char*>(mapping->GetData())[0] = 'X';
+
+        auto input = files.OpenForRead(name);
+        std::string observed;
+        std::getline(*input, observed);
+        EXPECT_STREQ(expected, observed.c_str());
+    }
 }
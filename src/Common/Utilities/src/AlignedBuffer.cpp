@@ -26,6 +26,8 @@
 #include "AlignedBuffer.h"
 #include "BitFunnel/Exceptions.h"
 #include "LoggerInterfaces/Check.h"
+#include "LoggerInterfaces/Logging.h"
+#include "Rounding.h"
 
 #ifdef BITFUNNEL_PLATFORM_WINDOWS
 #include <Windows.h>   // For VirtualAlloc/VirtualFree.
@@ -33,6 +35,10 @@
 #include <cerrno>
 #include <sstream>
 #include <sys/mman.h>  // For mmap/munmap.
+#ifdef __linux__
+#include <sys/syscall.h>  // For SYS_mbind.
+#include <unistd.h>       // For syscall.
+#endif
 #endif
 
 
@@ -40,28 +46,90 @@ namespace BitFunnel
 {
 
     AlignedBuffer::AlignedBuffer(size_t size, int alignment)
+        : m_requestedSize(size),
+          m_actualSize(0),
+          m_rawBuffer(nullptr),
+          m_alignedBuffer(nullptr),
+          m_usesHugePages(false)
+    {
+        Initialize(alignment, 0, -1);
+    }
+
+
+    AlignedBuffer::AlignedBuffer(size_t size,
+                                 int alignment,
+                                 size_t hugePageSize,
+                                 int numaNode)
+        : m_requestedSize(size),
+          m_actualSize(0),
+          m_rawBuffer(nullptr),
+          m_alignedBuffer(nullptr),
+          m_usesHugePages(false)
     {
-        m_requestedSize = size;
+        CHECK_EQ(hugePageSize & (hugePageSize - 1), 0u)
+            << "hugePageSize must be a power of 2.";
+        Initialize(alignment, hugePageSize, numaNode);
+    }
+
 
 #ifdef BITFUNNEL_PLATFORM_WINDOWS
+    void AlignedBuffer::Initialize(int alignment,
+                                   size_t hugePageSize,
+                                   int numaNode)
+    {
+        const DWORD node = (numaNode < 0) ?
+            NUMA_NO_PREFERRED_NODE :
+            static_cast<DWORD>(numaNode);
+
+        if (hugePageSize > 0)
+        {
+            // Windows chooses the large page size. Requires the "Lock pages
+            // in memory" privilege.
+            const size_t largePageSize = GetLargePageMinimum();
+            if (largePageSize > 0)
+            {
+                m_actualSize = RoundUp(m_requestedSize, largePageSize);
+                m_rawBuffer = VirtualAllocExNuma(GetCurrentProcess(),
+                                                 nullptr,
+                                                 m_actualSize,
+                                                 MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+                                                 PAGE_READWRITE,
+                                                 node);
+            }
+
+            if (m_rawBuffer != nullptr)
+            {
+                m_usesHugePages = true;
+                m_alignedBuffer = m_rawBuffer;
+                return;
+            }
+
+            LogB(Logging::Warning,
+                 "AlignedBuffer",
+                 "Large pages unavailable. Falling back to regular pages.",
+                 "");
+        }
+
         size_t padding = 1ULL << alignment;
         m_actualSize = m_requestedSize + padding;
-        m_rawBuffer = VirtualAlloc(nullptr, m_actualSize, MEM_COMMIT, PAGE_READWRITE);
+        m_rawBuffer = VirtualAllocExNuma(GetCurrentProcess(),
+                                         nullptr,
+                                         m_actualSize,
+                                         MEM_RESERVE | MEM_COMMIT,
+                                         PAGE_READWRITE,
+                                         node);
         CHECK_NE(m_rawBuffer, nullptr) <<  "VirtualAlloc() failed.";
         m_alignedBuffer = (char *)(((size_t)m_rawBuffer + padding -1) & ~(padding -1));
+    }
 #else
-        // TODO: detect non-4k size?
-        const int c_pageSize = 4096;
-
-        // mmap will give us something page aligned and we assume that alignment
-        // is sufficient.
-        CHECK_LE(alignment, c_pageSize) << "Alignment > 4096.\n";
-        m_actualSize = m_requestedSize;
-        m_rawBuffer = mmap(nullptr, size,
-                           PROT_READ | PROT_WRITE,
-                           MAP_ANON | MAP_PRIVATE,
-                           -1,  // No file descriptor.
-                           0);
+    // Maps anonymous memory. Returns nullptr on failure.
+    static void* MapAnonymous(size_t size, int extraFlags)
+    {
+        void* buffer = mmap(nullptr, size,
+                            PROT_READ | PROT_WRITE,
+                            MAP_ANON | MAP_PRIVATE | extraFlags,
+                            -1,  // No file descriptor.
+                            0);
 
         // `MAP_FAILED` is implemented as an old-style cast on some old
         // Unix-derived platforms. Note that issuing a `#pragma GCC` here is
@@ -69,17 +137,147 @@ namespace BitFunnel
         // either toolchain. See #233.
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wold-style-cast"
-        if (m_rawBuffer == MAP_FAILED)
+        if (buffer == MAP_FAILED)
 #pragma GCC diagnostic pop
         {
-            CHECK_FAIL << "AlignedBuffer Failed to mmap: "
-		       << std::strerror(errno)
-		       << std::endl;
+            return nullptr;
+        }
+
+        return buffer;
+    }
+
+
+    // Sets an MPOL_BIND memory policy on the buffer so that its pages are
+    // allocated on numaNode when first touched. Uses the system call directly
+    // to avoid a dependency on libnuma.
+    static void BindToNumaNode(void* buffer, size_t size, int numaNode)
+    {
+#if defined(__linux__) && defined(SYS_mbind)
+        const int c_mpolBind = 2;
+        const size_t c_bitsPerLong = 8 * sizeof(unsigned long);
+        const size_t c_maskLongCount = 16;
+        const size_t c_maxNodeCount = c_bitsPerLong * c_maskLongCount;
+
+        const size_t node = static_cast<size_t>(numaNode);
+        if (node >= c_maxNodeCount)
+        {
+            LogB(Logging::Warning,
+                 "AlignedBuffer",
+                 "NUMA node out of range.",
+                 "");
+            return;
+        }
+
+        unsigned long nodeMask[c_maskLongCount] = { 0 };
+        nodeMask[node / c_bitsPerLong] = 1ul << (node % c_bitsPerLong);
+
+        if (syscall(SYS_mbind,
+                    buffer,
+                    size,
+                    c_mpolBind,
+                    nodeMask,
+                    c_maxNodeCount + 1,
+                    0) != 0)
+        {
+            LogB(Logging::Warning,
+                 "AlignedBuffer",
+                 "Failed to bind buffer to NUMA node.",
+                 "");
         }
-        m_alignedBuffer = m_rawBuffer;
+#else
+        (void)buffer;
+        (void)size;
+        (void)numaNode;
+        LogB(Logging::Warning,
+             "AlignedBuffer",
+             "NUMA binding is not supported on this platform.",
+             "");
 #endif
     }
 
+
+    void AlignedBuffer::Initialize(int alignment,
+                                   size_t hugePageSize,
+                                   int numaNode)
+    {
+        // TODO: detect non-4k size?
+        const int c_pageSize = 4096;
+
+        if (hugePageSize == 0)
+        {
+            // mmap will give us something page aligned and we assume that
+            // alignment is sufficient.
+            CHECK_LE(alignment, c_pageSize) << "Alignment > 4096.\n";
+            m_actualSize = m_requestedSize;
+            m_rawBuffer = MapAnonymous(m_actualSize, 0);
+            if (m_rawBuffer == nullptr)
+            {
+                CHECK_FAIL << "AlignedBuffer Failed to mmap: "
+                           << std::strerror(errno)
+                           << std::endl;
+            }
+            m_alignedBuffer = m_rawBuffer;
+        }
+        else
+        {
+            CHECK_LE(1ull << alignment, hugePageSize)
+                << "Alignment > hugePageSize.\n";
+
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+            // Explicit huge pages must be reserved by the administrator
+            // (e.g. through /proc/sys/vm/nr_hugepages).
+            int log2PageSize = 0;
+            while ((1ull << log2PageSize) < hugePageSize)
+            {
+                ++log2PageSize;
+            }
+            m_actualSize = RoundUp(m_requestedSize, hugePageSize);
+            m_rawBuffer = MapAnonymous(m_actualSize,
+                                       MAP_HUGETLB | (log2PageSize << MAP_HUGE_SHIFT));
+#endif
+
+            if (m_rawBuffer != nullptr)
+            {
+                m_usesHugePages = true;
+                m_alignedBuffer = m_rawBuffer;
+            }
+            else
+            {
+                // Fall back to regular pages. Over-allocate so that the
+                // buffer can be aligned to a huge page boundary, which lets
+                // the kernel back it with transparent huge pages.
+                m_actualSize = RoundUp(m_requestedSize, hugePageSize) + hugePageSize;
+                m_rawBuffer = MapAnonymous(m_actualSize, 0);
+                if (m_rawBuffer == nullptr)
+                {
+                    CHECK_FAIL << "AlignedBuffer Failed to mmap: "
+                               << std::strerror(errno)
+                               << std::endl;
+                }
+                m_alignedBuffer = reinterpret_cast<void*>(
+                    RoundUp(reinterpret_cast<size_t>(m_rawBuffer), hugePageSize));
+#ifdef MADV_HUGEPAGE
+                madvise(m_alignedBuffer,
+                        RoundUp(m_requestedSize, hugePageSize),
+                        MADV_HUGEPAGE);
+#endif
+            }
+        }
+
+        if (numaNode >= 0)
+        {
+            // A hugetlb mapping must be bound in whole huge pages, which is
+            // exactly the mapping's size. Otherwise bind the regular pages
+            // that hold the requested bytes.
+            const size_t bindSize = m_usesHugePages ?
+                m_actualSize :
+                RoundUp(m_requestedSize, static_cast<size_t>(c_pageSize));
+            BindToNumaNode(m_alignedBuffer, bindSize, numaNode);
+        }
+    }
+#endif
+
+
     AlignedBuffer::~AlignedBuffer()
     {
         if (m_rawBuffer != nullptr)
@@ -103,4 +301,19 @@ namespace BitFunnel
     {
         return m_requestedSize;
     }
+
+    bool AlignedBuffer::UsesHugePages() const
+    {
+        return m_usesHugePages;
+    }
+
+
+    void AlignedBuffer::Discard()
+    {
+#ifdef BITFUNNEL_PLATFORM_WINDOWS
+        VirtualAlloc(m_rawBuffer, m_actualSize, MEM_RESET, PAGE_READWRITE);
+#else
+        madvise(m_rawBuffer, m_actualSize, MADV_DONTNEED);
+#endif
+    }
 }
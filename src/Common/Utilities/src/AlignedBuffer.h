@@ -32,20 +32,43 @@ namespace BitFunnel
     // boundary. This is intended to be used for allocating "large" blocks of
     // memory, something like 10GB or 100GB at a time.
     //
+    // When hugePageSize is non-zero, the buffer is aligned to hugePageSize and
+    // backed by huge pages of that size (e.g. 2MB or 1GB) if the operating
+    // system has them available. Otherwise the buffer falls back to regular
+    // pages, marked as eligible for transparent huge pages where supported.
+    // When numaNode is non-negative, the buffer's memory is bound to that
+    // NUMA node. Failures to bind are logged and otherwise ignored.
+    //
     //*************************************************************************
     class AlignedBuffer
     {
     public:
         AlignedBuffer(size_t size, int alignment);
+        AlignedBuffer(size_t size,
+                      int alignment,
+                      size_t hugePageSize,
+                      int numaNode);
         ~AlignedBuffer();
 
         void *GetBuffer() const;
         size_t GetSize() const;
 
+        // Returns true if the buffer is backed by explicitly reserved huge
+        // pages.
+        bool UsesHugePages() const;
+
+        // Returns the buffer's physical pages to the operating system while
+        // keeping its address range reserved. The contents of the buffer are
+        // undefined afterwards. Pages are supplied again on the next touch.
+        void Discard();
+
     private:
+        void Initialize(int alignment, size_t hugePageSize, int numaNode);
+
         size_t m_requestedSize;
         size_t m_actualSize;
         void *m_rawBuffer;
         void *m_alignedBuffer;
+        bool m_usesHugePages;
     };
 }
@@ -21,7 +21,10 @@
 // THE SOFTWARE.
 
 
+#include <algorithm>
+#include <cstdint>
 #include <memory>
+#include <thread>
 
 #include "BitFunnel/Exceptions.h"
 #include "BitFunnel/Utilities/Factories.h"
@@ -39,15 +42,85 @@ namespace BitFunnel
         CreateBlockAllocator(size_t blockSize, size_t totalBlockCount)
     {
         return std::unique_ptr<IBlockAllocator>(
-            new BlockAllocator(blockSize, totalBlockCount));
+            new BlockAllocator(blockSize, totalBlockCount, 0, 0, -1));
     }
 
 
+    std::unique_ptr<IBlockAllocator>
+        Factories::
+        CreateBlockAllocator(size_t blockSize,
+                             size_t totalBlockCount,
+                             size_t magazineCapacity)
+    {
+        return std::unique_ptr<IBlockAllocator>(
+            new BlockAllocator(blockSize,
+                               totalBlockCount,
+                               magazineCapacity,
+                               0,
+                               -1));
+    }
+
+
+    std::unique_ptr<IBlockAllocator>
+        Factories::
+        CreateBlockAllocator(size_t blockSize,
+                             size_t totalBlockCount,
+                             size_t magazineCapacity,
+                             size_t hugePageSize,
+                             int numaNode)
+    {
+        return std::unique_ptr<IBlockAllocator>(
+            new BlockAllocator(blockSize,
+                               totalBlockCount,
+                               magazineCapacity,
+                               hugePageSize,
+                               numaNode));
+    }
+
+
+    static uint64_t PackHead(uint64_t counter, uint32_t index)
+    {
+        return (counter << 32) | index;
+    }
+
+
+    static uint32_t IndexFromHead(uint64_t head)
+    {
+        return static_cast<uint32_t>(head);
+    }
+
+
+    static uint64_t CounterFromHead(uint64_t head)
+    {
+        return head >> 32;
+    }
+
+
+    // Returns a small number that is unique to the calling thread. Threads
+    // are numbered in the order they first call this function.
+    static size_t GetThreadNumber()
+    {
+        static std::atomic<size_t> nextThreadNumber(0);
+        static thread_local size_t threadNumber = nextThreadNumber++;
+        return threadNumber;
+    }
 
-    BlockAllocator::BlockAllocator(size_t blockSize, size_t totalBlockCount)
+
+    BlockAllocator::BlockAllocator(size_t blockSize,
+                                   size_t totalBlockCount,
+                                   size_t magazineCapacity,
+                                   size_t hugePageSize,
+                                   int numaNode)
         : m_blockSize(RoundUp<size_t>(blockSize, c_byteAlignment)),
           m_totalPoolSize(m_blockSize * totalBlockCount),
-          m_pool(m_totalPoolSize, c_log2ByteAlignment)
+          m_pool(m_totalPoolSize, c_log2ByteAlignment, hugePageSize, numaNode),
+          m_next(new std::atomic<BlockIndex>[totalBlockCount]),
+          m_head(0),
+          m_magazineCapacity(magazineCapacity),
+          m_magazineCount(magazineCapacity == 0 ?
+                          0 :
+                          std::max(1u, std::thread::hardware_concurrency())),
+          m_magazines(new Magazine[m_magazineCount])
     {
         // DESIGN NOTE: technically, one can create an allocator with a size = 0
         // which would simply throw on the first allocation. This would allow
@@ -57,41 +130,77 @@ namespace BitFunnel
         // re-visit it in future if needed.
         LogAssertB(m_blockSize > 0, "m_blockSize of 0.");
         LogAssertB(totalBlockCount > 0, "totalBlockCount of 0.");
-
-        char * currentBlock = static_cast<char *>(m_pool.GetBuffer());
+        LogAssertB(totalBlockCount < UINT32_MAX, "totalBlockCount too large.");
 
         for (size_t block = 0; block < totalBlockCount; ++block)
         {
-            char** nextBlockPtr = reinterpret_cast<char**>(currentBlock);
-            currentBlock += m_blockSize;
-
-            if (block != totalBlockCount - 1)
-            {
-                *nextBlockPtr = currentBlock;
-            }
-            else
-            {
-                *nextBlockPtr = nullptr;
-            }
+            const BlockIndex next = (block == totalBlockCount - 1) ?
+                c_endOfList :
+                static_cast<BlockIndex>(block + 2);
+            m_next[block].store(next, std::memory_order_relaxed);
         }
+        m_head.store(PackHead(0, 1), std::memory_order_release);
 
-        m_freeListHead = static_cast<uint64_t*>(m_pool.GetBuffer());
+        for (size_t i = 0; i < m_magazineCount; ++i)
+        {
+            m_magazines[i].m_count = 0;
+            m_magazines[i].m_blocks.reset(new BlockIndex[m_magazineCapacity]);
+        }
     }
 
 
     uint64_t * BlockAllocator::AllocateBlock()
     {
-        std::lock_guard<std::mutex> lock(m_lock);
+        BlockIndex index = c_endOfList;
 
-        if (m_freeListHead == nullptr)
+        if (m_magazineCount > 0)
         {
-            throw FatalError("Out of memory");
+            Magazine& magazine = GetMagazine();
+            std::lock_guard<std::mutex> lock(magazine.m_lock);
+
+            if (magazine.m_count == 0)
+            {
+                // Refill half of the magazine so that alternating allocate
+                // and release calls don't go to the shared stack each time.
+                const size_t refillCount = (m_magazineCapacity + 1) / 2;
+                for (size_t i = 0; i < refillCount; ++i)
+                {
+                    const BlockIndex block = Pop();
+                    if (block == c_endOfList)
+                    {
+                        break;
+                    }
+                    magazine.m_blocks[magazine.m_count++] = block;
+                }
+            }
+
+            if (magazine.m_count > 0)
+            {
+                index = magazine.m_blocks[--magazine.m_count];
+            }
+        }
+        else
+        {
+            index = Pop();
         }
 
-        uint64_t * block = m_freeListHead;
-        m_freeListHead = reinterpret_cast<uint64_t*>(*m_freeListHead);
+        if (index == c_endOfList && m_magazineCount > 0)
+        {
+            // Another thread may have flushed its magazine to the shared
+            // stack while the magazines were being searched.
+            index = StealFromMagazines();
+            if (index == c_endOfList)
+            {
+                index = Pop();
+            }
+        }
+
+        if (index == c_endOfList)
+        {
+            throw FatalError("Out of memory");
+        }
 
-        return block;
+        return GetBlock(index);
     }
 
 
@@ -114,14 +223,39 @@ namespace BitFunnel
         LogAssertB(((blockReturned - bufferStart) % static_cast<long>(m_blockSize)) == 0,
                    "Block offset (relative to begining of pool not a multiple of blockSize");
 
-        // Add the block to the head of the free list
-        uint64_t** blockPtr = reinterpret_cast<uint64_t**>(block);
+        const BlockIndex index = GetIndex(block);
 
-        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_magazineCount > 0)
+        {
+            Magazine& magazine = GetMagazine();
+            std::lock_guard<std::mutex> lock(magazine.m_lock);
 
-        *blockPtr = m_freeListHead;
+            if (magazine.m_count == m_magazineCapacity)
+            {
+                // Flush the older half of the magazine to the shared stack
+                // with a single push.
+                const size_t flushCount = (m_magazineCapacity + 1) / 2;
+                for (size_t i = 0; i + 1 < flushCount; ++i)
+                {
+                    m_next[magazine.m_blocks[i] - 1].store(
+                        magazine.m_blocks[i + 1],
+                        std::memory_order_relaxed);
+                }
+                Push(magazine.m_blocks[0], magazine.m_blocks[flushCount - 1]);
+
+                for (size_t i = flushCount; i < magazine.m_count; ++i)
+                {
+                    magazine.m_blocks[i - flushCount] = magazine.m_blocks[i];
+                }
+                magazine.m_count -= flushCount;
+            }
 
-        m_freeListHead = block;
+            magazine.m_blocks[magazine.m_count++] = index;
+        }
+        else
+        {
+            Push(index, index);
+        }
     }
 
 
@@ -129,4 +263,91 @@ namespace BitFunnel
     {
         return m_blockSize;
     }
+
+
+    bool BlockAllocator::Contains(uint64_t const * block) const
+    {
+        char const * address = reinterpret_cast<char const *>(block);
+        char const * bufferStart = static_cast<char const *>(m_pool.GetBuffer());
+        return address >= bufferStart && address < bufferStart + m_totalPoolSize;
+    }
+
+
+    BlockAllocator::BlockIndex BlockAllocator::Pop()
+    {
+        uint64_t head = m_head.load(std::memory_order_acquire);
+        for (;;)
+        {
+            const BlockIndex index = IndexFromHead(head);
+            if (index == c_endOfList)
+            {
+                return c_endOfList;
+            }
+
+            // If another thread pops this block first, m_next may already
+            // have been changed, but then the counter in m_head has changed
+            // as well and the exchange below fails.
+            const BlockIndex next = m_next[index - 1].load(std::memory_order_relaxed);
+            if (m_head.compare_exchange_weak(head,
+                                             PackHead(CounterFromHead(head) + 1, next),
+                                             std::memory_order_acquire,
+                                             std::memory_order_acquire))
+            {
+                return index;
+            }
+        }
+    }
+
+
+    void BlockAllocator::Push(BlockIndex first, BlockIndex last)
+    {
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+        do
+        {
+            m_next[last - 1].store(IndexFromHead(head), std::memory_order_relaxed);
+        }
+        while (!m_head.compare_exchange_weak(head,
+                                             PackHead(CounterFromHead(head) + 1, first),
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed));
+    }
+
+
+    uint64_t* BlockAllocator::GetBlock(BlockIndex index) const
+    {
+        char* block = static_cast<char*>(m_pool.GetBuffer()) +
+            (index - 1) * m_blockSize;
+        return reinterpret_cast<uint64_t*>(block);
+    }
+
+
+    BlockAllocator::BlockIndex BlockAllocator::GetIndex(uint64_t const * block) const
+    {
+        char const * bufferStart = static_cast<char const *>(m_pool.GetBuffer());
+        const size_t offset =
+            static_cast<size_t>(reinterpret_cast<char const *>(block) - bufferStart);
+        return static_cast<BlockIndex>(offset / m_blockSize + 1);
+    }
+
+
+    BlockAllocator::Magazine& BlockAllocator::GetMagazine()
+    {
+        return m_magazines[GetThreadNumber() % m_magazineCount];
+    }
+
+
+    BlockAllocator::BlockIndex BlockAllocator::StealFromMagazines()
+    {
+        for (size_t i = 0; i < m_magazineCount; ++i)
+        {
+            Magazine& magazine = m_magazines[i];
+            std::lock_guard<std::mutex> lock(magazine.m_lock);
+            if (magazine.m_count > 0)
+            {
+                return magazine.m_blocks[--magazine.m_count];
+            }
+        }
+
+        return c_endOfList;
+    }
 }
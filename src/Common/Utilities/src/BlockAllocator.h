@@ -24,7 +24,9 @@
 #pragma once
 
 
-#include <mutex>  // For std::mutex.
+#include <atomic>   // For std::atomic.
+#include <memory>   // For std::unique_ptr.
+#include <mutex>    // For std::mutex.
 
 #include "BitFunnel/Utilities/IBlockAllocator.h"
 #include "AlignedBuffer.h"
@@ -36,12 +38,27 @@ namespace BitFunnel
     // BlockAllocator is an implementation of the IBlockAllocator that
     // allocates the entire pool of the requested number of blocks at
     // construction and never releases it until destruction. Internally the
-    // pool is aligned to c_byteAlignment. The list of available blocks is
-    // stored as a linked list where the pointer to the next item is stored in
-    // the beginning of the block itself. If this value is nullptr, this is the
-    // last block. m_freeListHead points to the first available block, or
-    // nullptr if there are no available blocks.
-    // Requesting a block when there are none available results in an exception.
+    // pool is aligned to c_byteAlignment. Requesting a block when there are
+    // none available results in an exception.
+    //
+    // The list of available blocks is a lock-free stack of block indexes.
+    // The link to the next block is kept in m_next, outside of the blocks,
+    // so that the allocator never reads or writes memory that has been handed
+    // out. The head of the stack packs the index of the first available block
+    // with a counter which is incremented on every push and pop. The counter
+    // makes a compare-and-swap fail if the head was popped and pushed back in
+    // between (the ABA problem).
+    //
+    // When constructed with a non-zero magazineCapacity, the allocator also
+    // keeps small caches of blocks ("magazines"). Each thread is assigned a
+    // magazine on first use. AllocateBlock() and ReleaseBlock() normally only
+    // touch the thread's magazine. A magazine is refilled from, or flushed
+    // to, the shared stack half a magazine at a time. The magazine mutex is
+    // uncontended unless there are more threads than magazines. Before
+    // throwing on an empty pool, AllocateBlock() takes blocks cached in other
+    // threads' magazines. Blocks that are being moved between a magazine and
+    // the shared stack may be missed, so a pool that is nearly exhausted can
+    // throw even though a block is about to be released.
     //
     // DESIGN NOTE: The main usage of this allocator is for the RowTable rows
     // which operate on quadwords. Therefore the allocator's pointers are
@@ -55,8 +72,15 @@ namespace BitFunnel
         // Constructs an allocator with given block size and the total number
         // of blocks in the pool.
         // Requested blockSize will be rounded up to the next multiple of
-        // c_byteAlignment.
-        BlockAllocator(size_t blockSize, size_t totalBlockCount);
+        // c_byteAlignment. Per-thread magazines are enabled when
+        // magazineCapacity is greater than zero. A non-zero hugePageSize
+        // and a non-negative numaNode are passed to the AlignedBuffer that
+        // holds the pool.
+        BlockAllocator(size_t blockSize,
+                       size_t totalBlockCount,
+                       size_t magazineCapacity,
+                       size_t hugePageSize,
+                       int numaNode);
 
         //
         // IBlockAllocator API.
@@ -64,8 +88,38 @@ namespace BitFunnel
         virtual uint64_t* AllocateBlock() override;
         virtual void ReleaseBlock(uint64_t*) override;
         virtual size_t GetBlockSize() const override;
+        virtual bool Contains(uint64_t const * block) const override;
 
     private:
+        // Indexes in m_next and in the head of the stack are one-based so
+        // that zero can mark the end of the stack.
+        typedef uint32_t BlockIndex;
+        static const BlockIndex c_endOfList = 0;
+
+        // Pops a block from the shared stack. Returns c_endOfList if the
+        // stack is empty.
+        BlockIndex Pop();
+
+        // Pushes the chain of blocks first..last, already linked through
+        // m_next, onto the shared stack.
+        void Push(BlockIndex first, BlockIndex last);
+
+        uint64_t* GetBlock(BlockIndex index) const;
+        BlockIndex GetIndex(uint64_t const * block) const;
+
+        struct Magazine
+        {
+            std::mutex m_lock;
+            size_t m_count;
+            std::unique_ptr<BlockIndex[]> m_blocks;
+        };
+
+        Magazine& GetMagazine();
+
+        // Takes one block from any magazine. Returns c_endOfList if all
+        // magazines are empty.
+        BlockIndex StealFromMagazines();
+
         // Byte alignment of the allocated blocks.
         static const unsigned c_log2ByteAlignment = 3;
         static const unsigned c_byteAlignment = 1U << c_log2ByteAlignment;
@@ -73,13 +127,19 @@ namespace BitFunnel
         const size_t m_blockSize;
         const size_t m_totalPoolSize;
 
-        // Lock protecting operations on the pool.
-        std::mutex m_lock;
-
         // Underlying pool of memory blocks.
         AlignedBuffer m_pool;
 
-        // A pointer to the first available block.
-        uint64_t * m_freeListHead;
+        // m_next[i - 1] is the index of the block after block i on the
+        // shared stack.
+        std::unique_ptr<std::atomic<BlockIndex>[]> m_next;
+
+        // Low 32 bits: index of the first available block. High 32 bits:
+        // ABA counter.
+        std::atomic<uint64_t> m_head;
+
+        const size_t m_magazineCapacity;
+        const size_t m_magazineCount;
+        std::unique_ptr<Magazine[]> m_magazines;
     };
 }
@@ -0,0 +1,222 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "BitFunnel/BitFunnelTypes.h"
+#include "BitFunnel/Utilities/Factories.h"
+#include "EpochTokenManager.h"
+#include "LoggerInterfaces/Logging.h"
+
+namespace BitFunnel
+{
+    std::unique_ptr<ITokenManager> Factories::CreateEpochTokenManager()
+    {
+        return std::unique_ptr<ITokenManager>(new EpochTokenManager());
+    }
+
+
+    static const size_t c_slotCount = 256;
+
+
+    //*************************************************************************
+    //
+    // EpochTokenManager::Slot
+    //
+    //*************************************************************************
+    struct EpochTokenManager::Slot
+    {
+        Slot()
+            : m_epoch(0)
+        {
+        }
+
+        std::atomic<int64_t> m_epoch;
+        char m_padding[c_bytesPerCacheLine - sizeof(std::atomic<int64_t>)];
+    };
+
+
+    //*************************************************************************
+    //
+    // EpochTokenManager::Tracker
+    //
+    // Holds the (slot, epoch) pairs which were pinned when the tracker was
+    // started. A slot is done once its epoch differs from the recorded one,
+    // either because the Token was returned or because the slot was pinned
+    // again by a later Token. Since a slot is never pinned twice at the same
+    // epoch after the epoch has advanced, this check is free of ABA issues.
+    //
+    //*************************************************************************
+    class EpochTokenManager::Tracker : public ITokenTracker
+    {
+    public:
+        Tracker(std::shared_ptr<Slot> const & slots, int64_t epoch)
+            : m_slots(slots)
+        {
+            for (size_t i = 0; i < c_slotCount; ++i)
+            {
+                const int64_t pinned = m_slots.get()[i].m_epoch;
+                if (pinned != 0 && pinned < epoch)
+                {
+                    m_pinned.push_back(std::make_pair(i, pinned));
+                }
+            }
+        }
+
+
+        virtual bool IsComplete() const override
+        {
+            for (auto const & pinned : m_pinned)
+            {
+                if (m_slots.get()[pinned.first].m_epoch == pinned.second)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+
+        virtual void WaitForCompletion() override
+        {
+            // Tokens are held for the duration of a query or a document
+            // ingestion, so polling is cheaper than having every returned
+            // Token signal a condition variable.
+            while (!IsComplete())
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+    private:
+        std::shared_ptr<Slot> m_slots;
+        std::vector<std::pair<size_t, int64_t>> m_pinned;
+    };
+
+
+    //*************************************************************************
+    //
+    // EpochTokenManager
+    //
+    //*************************************************************************
+    EpochTokenManager::EpochTokenManager()
+        : m_slots(new Slot[c_slotCount], std::default_delete<Slot[]>()),
+          m_epoch(1),
+          m_isShuttingDown(false)
+    {
+    }
+
+
+    EpochTokenManager::~EpochTokenManager()
+    {
+        Shutdown();
+    }
+
+
+    Token EpochTokenManager::RequestToken()
+    {
+        LogAssertB(!m_isShuttingDown, "Requested Token while shutting down");
+
+        // A stale epoch is harmless here. A tracker started after the epoch
+        // was read either sees this slot pinned, or its slot scan precedes
+        // the pin, in which case every subsequent read observes the state
+        // the tracker was started for.
+        const int64_t epoch = m_epoch;
+        Slot* slots = m_slots.get();
+
+        size_t slot =
+            std::hash<std::thread::id>()(std::this_thread::get_id()) % c_slotCount;
+        for (;;)
+        {
+            for (size_t i = 0; i < c_slotCount; ++i)
+            {
+                int64_t expected = 0;
+                if (slots[slot].m_epoch.compare_exchange_strong(expected, epoch))
+                {
+                    return Token(*this, static_cast<SerialNumber>(slot));
+                }
+                slot = (slot + 1) % c_slotCount;
+            }
+
+            // All slots are pinned. Wait for a Token to be returned.
+            std::this_thread::yield();
+        }
+    }
+
+
+    const std::shared_ptr<ITokenTracker> EpochTokenManager::StartTracker()
+    {
+        // Every slot pinned below the new epoch holds a Token which may have
+        // observed the state from before the call.
+        const int64_t epoch = ++m_epoch;
+        return std::shared_ptr<ITokenTracker>(new Tracker(m_slots, epoch));
+    }
+
+
+    void EpochTokenManager::Shutdown()
+    {
+        m_isShuttingDown = true;
+
+        // Wait for existing tokens to be returned. The timeout covers a
+        // Token which is returned between the check and the wait.
+        std::unique_lock<std::mutex> lock(m_shutdownLock);
+        while (!AreAllSlotsFree())
+        {
+            m_shutdownCondition.wait_for(lock, std::chrono::milliseconds(1));
+        }
+    }
+
+
+    void EpochTokenManager::OnTokenComplete(SerialNumber serialNumber)
+    {
+        LogAssertB(serialNumber >= 0
+                   && static_cast<size_t>(serialNumber) < c_slotCount,
+                   "Token completed with an invalid slot.");
+
+        std::atomic<int64_t>& slot = m_slots.get()[serialNumber].m_epoch;
+        LogAssertB(slot != 0, "Token completed for a free slot.");
+        slot = 0;
+
+        if (m_isShuttingDown)
+        {
+            m_shutdownCondition.notify_all();
+        }
+    }
+
+
+    bool EpochTokenManager::AreAllSlotsFree() const
+    {
+        Slot const * slots = m_slots.get();
+        for (size_t i = 0; i < c_slotCount; ++i)
+        {
+            if (slots[i].m_epoch != 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
@@ -0,0 +1,102 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <atomic>                   // std::atomic embedded.
+#include <condition_variable>       // std::condition_variable embedded.
+#include <memory>                   // std::shared_ptr embedded.
+#include <mutex>                    // std::mutex embedded.
+
+#include "BitFunnel/Index/Token.h"  // ITokenManager, ITokenListener bases.
+
+namespace BitFunnel
+{
+    //*************************************************************************
+    //
+    // EpochTokenManager is an implementation of ITokenManager which issues
+    // and returns Tokens without taking a lock. It is intended for query
+    // threads, which request a Token per query and should not contend with
+    // each other or with ingestion while doing so.
+    //
+    // Each Token pins the current epoch in one of a fixed number of slots,
+    // each of which lives on its own cache line. A thread starts probing at
+    // a slot derived from its thread id, so threads rarely touch the same
+    // slot. StartTracker() advances the epoch and records the slots which
+    // were pinned at the time. The tracker is complete once each of those
+    // slots has been released or re-pinned at a later epoch.
+    //
+    // The SerialNumber of a Token is the index of its slot. Unlike
+    // TokenManager, serial numbers are therefore not monotonic.
+    //
+    // This class is thread-safe.
+    //
+    //*************************************************************************
+    class EpochTokenManager : public ITokenManager,
+                              private ITokenListener
+    {
+    public:
+        EpochTokenManager();
+
+        ~EpochTokenManager();
+
+        //
+        // ITokenManager API.
+        //
+
+        virtual Token RequestToken() override;
+        virtual const std::shared_ptr<ITokenTracker> StartTracker() override;
+        virtual void Shutdown() override;
+
+    private:
+        // A slot holds the epoch pinned by a Token, or zero when it is free.
+        // Defined in EpochTokenManager.cpp.
+        struct Slot;
+
+        // ITokenTracker returned by StartTracker().
+        class Tracker;
+
+        //
+        // ITokenListener API.
+        //
+        virtual void OnTokenComplete(SerialNumber serialNumber) override;
+
+        // Returns true if no slot is pinned.
+        bool AreAllSlotsFree() const;
+
+        // Array of slots. It is shared with the trackers, which may outlive
+        // the EpochTokenManager.
+        std::shared_ptr<Slot> m_slots;
+
+        // Epoch pinned by newly issued Tokens. Starts at 1 since zero marks
+        // a free slot.
+        std::atomic<int64_t> m_epoch;
+
+        // Flag indicating that EpochTokenManager is shutting down.
+        std::atomic<bool> m_isShuttingDown;
+
+        // Shutdown() waits on m_shutdownCondition for the pinned slots to be
+        // released.
+        std::mutex m_shutdownLock;
+        std::condition_variable m_shutdownCondition;
+    };
+}
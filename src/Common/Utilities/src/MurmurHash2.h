@@ -12,4 +12,13 @@ namespace BitFunnel
 {
     // 64-bit hash for 64-bit platforms
     uint64_t MurmurHash64A(const void *key, size_t len, unsigned seed);
+
+    // Sets hashes[i] to MurmurHash64A(keys[i], lengths[i], seed) for each of
+    // the count keys. Hashes groups of keys in lockstep so that their
+    // multiply chains overlap.
+    void MurmurHash64A(const void * const * keys,
+                       const size_t * lengths,
+                       size_t count,
+                       unsigned seed,
+                       uint64_t * hashes);
 }
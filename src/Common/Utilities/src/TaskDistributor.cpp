@@ -20,55 +20,421 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
 #include "BitFunnel/Utilities/Factories.h"
 #include "BitFunnel/Utilities/ITaskProcessor.h"
 #include "TaskDistributor.h"
 #include "TaskDistributorThread.h"
 #include "ThreadManager.h"
 
+#ifdef BITFUNNEL_PLATFORM_WINDOWS
+#include <Windows.h>    // For SetThreadAffinityMask.
+#elif defined(__linux__)
+#include <pthread.h>    // For pthread_setaffinity_np.
+#include <sched.h>      // For cpu_set_t.
+#endif
+
 
 namespace BitFunnel
 {
+    // The TaskDistributor that started the calling thread and the index of
+    // the thread within that TaskDistributor.
+    static thread_local TaskDistributor* t_distributor = nullptr;
+    static thread_local size_t t_threadIndex = 0;
+
+
     std::unique_ptr<ITaskDistributor>
     Factories::CreateTaskDistributor(std::vector<std::unique_ptr<ITaskProcessor>> const & processors,
-                                     size_t taskCount)
+                                     size_t taskCount,
+                                     bool pinThreads)
+    {
+        return std::unique_ptr<ITaskDistributor>(new TaskDistributor(processors, taskCount, pinThreads));
+    }
+
+
+    ITaskDistributor* ITaskDistributor::GetCurrent()
     {
-        return std::unique_ptr<ITaskDistributor>(new TaskDistributor(processors, taskCount));
+        return t_distributor;
     }
 
 
+    //*************************************************************************
+    //
+    // TaskDistributor::SubtaskGroup
+    //
+    // Tracks the subtasks started by a single call to RunSubtasks(). Lives
+    // on the stack of the calling thread, which does not return until
+    // m_remainingCount has dropped to zero.
+    //
+    //*************************************************************************
+    class TaskDistributor::SubtaskGroup : NonCopyable
+    {
+    public:
+        SubtaskGroup(std::function<void(size_t)> const & subtask,
+                     size_t subtaskCount)
+          : m_subtask(subtask),
+            m_remainingCount(subtaskCount)
+        {
+        }
+
+
+        // Runs the given subtask. Decrementing m_remainingCount is the last
+        // access to the group, since the group may be destroyed as soon as
+        // the count reaches zero.
+        void Run(size_t subtaskId)
+        {
+            try
+            {
+                m_subtask(subtaskId);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(m_lock);
+                if (m_exception == nullptr)
+                {
+                    m_exception = std::current_exception();
+                }
+            }
+            m_remainingCount.fetch_sub(1, std::memory_order_release);
+        }
+
+
+        bool IsComplete() const
+        {
+            return m_remainingCount.load(std::memory_order_acquire) == 0;
+        }
+
+
+        // Rethrows the first exception thrown by a subtask, if any.
+        void RethrowException()
+        {
+            if (m_exception != nullptr)
+            {
+                std::rethrow_exception(m_exception);
+            }
+        }
+
+    private:
+        std::function<void(size_t)> const & m_subtask;
+        std::atomic<size_t> m_remainingCount;
+
+        std::mutex m_lock;
+        std::exception_ptr m_exception;
+    };
+
+
+    //*************************************************************************
+    //
+    // TaskDistributor::WorkQueue
+    //
+    // Deque of task id ranges owned by a single thread. The owner pushes and
+    // pops at the back, other threads steal from the front.
+    //
+    //*************************************************************************
+    class TaskDistributor::WorkQueue : NonCopyable
+    {
+    public:
+        WorkQueue(size_t threadIndex)
+          : m_nextVictim(threadIndex + 1)
+        {
+        }
+
+        std::mutex m_lock;
+        std::deque<Range> m_ranges;
+
+        // Index of the first thread to try to steal from. Only accessed by
+        // the owner.
+        size_t m_nextVictim;
+    };
+
+
+    //*************************************************************************
+    //
+    // TaskDistributor
+    //
+    //*************************************************************************
     TaskDistributor::TaskDistributor(std::vector<std::unique_ptr<ITaskProcessor>> const & processors,
-                                     size_t taskCount)
+                                     size_t taskCount,
+                                     bool pinThreads)
         : m_processors(processors),
-          m_taskCount(taskCount),
-          m_nextTaskId(0)
+          m_pinThreads(pinThreads),
+          m_remainingTaskCount(taskCount)
     {
-        for (size_t i = 0 ; i < m_processors.size(); ++i)
+        // Give each thread a contiguous share of the task ids. The shares are
+        // rebalanced by stealing as threads finish.
+        const size_t threadCount = m_processors.size();
+        for (size_t i = 0 ; i < threadCount; ++i)
+        {
+            m_queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue(i)));
+
+            const Range range = { taskCount * i / threadCount,
+                                  taskCount * (i + 1) / threadCount,
+                                  nullptr };
+            if (range.m_begin < range.m_end)
+            {
+                m_queues.back()->m_ranges.push_back(range);
+            }
+        }
+
+        for (size_t i = 0 ; i < threadCount; ++i)
         {
-            m_threads.push_back(std::unique_ptr<IThreadBase>(new TaskDistributorThread(*this, *m_processors[i])));
+            m_threads.push_back(std::unique_ptr<IThreadBase>(new TaskDistributorThread(*this, i)));
         }
         m_threadManager = std::unique_ptr<ThreadManager>((new ThreadManager(m_threads)));
     }
 
 
-    bool TaskDistributor::TryAllocateTask(size_t& taskId)
+    TaskDistributor::~TaskDistributor()
     {
-        std::lock_guard<std::mutex> lock(m_lock);
+    }
+
+
+    void TaskDistributor::RunSubtasks(size_t subtaskCount,
+                                      std::function<void(size_t)> const & subtask)
+    {
+        if (subtaskCount == 0)
+        {
+            return;
+        }
+
+        SubtaskGroup group(subtask, subtaskCount);
 
-        if (m_nextTaskId < m_taskCount)
+        if (t_distributor != this)
         {
-            taskId = m_nextTaskId++;
-            return true;
+            // Not one of our threads, so there is no deque to share the
+            // subtasks through.
+            for (size_t i = 0; i < subtaskCount; ++i)
+            {
+                group.Run(i);
+            }
         }
         else
         {
-            return false;
+            const size_t threadIndex = t_threadIndex;
+            const Range subtasks = { 0, subtaskCount, &group };
+            Push(threadIndex, subtasks);
+
+            Range range;
+            unsigned idleCount = 0;
+            while (!group.IsComplete())
+            {
+                if (TryPop(threadIndex, true, range) ||
+                    TrySteal(threadIndex, true, range))
+                {
+                    Execute(threadIndex, range);
+                    idleCount = 0;
+                }
+                else
+                {
+                    Backoff(++idleCount);
+                }
+            }
         }
+
+        group.RethrowException();
     }
 
 
     void TaskDistributor::WaitForCompletion()
     {
         m_threadManager->WaitForThreads();
+
+        if (m_exception != nullptr)
+        {
+            std::rethrow_exception(m_exception);
+        }
+    }
+
+
+    void TaskDistributor::ProcessTasks(size_t threadIndex)
+    {
+        if (m_pinThreads)
+        {
+            PinCurrentThread(threadIndex);
+        }
+
+        t_distributor = this;
+        t_threadIndex = threadIndex;
+
+        Range range;
+        unsigned idleCount = 0;
+        while (m_remainingTaskCount.load(std::memory_order_acquire) > 0)
+        {
+            if (TryPop(threadIndex, false, range) ||
+                TrySteal(threadIndex, false, range))
+            {
+                Execute(threadIndex, range);
+                idleCount = 0;
+            }
+            else
+            {
+                Backoff(++idleCount);
+            }
+        }
+
+        m_processors[threadIndex]->Finished();
+
+        t_distributor = nullptr;
+    }
+
+
+    bool TaskDistributor::TryPop(size_t threadIndex,
+                                 bool subtasksOnly,
+                                 Range& range)
+    {
+        WorkQueue& queue = *m_queues[threadIndex];
+        std::lock_guard<std::mutex> lock(queue.m_lock);
+
+        if (queue.m_ranges.empty() ||
+            (subtasksOnly && queue.m_ranges.back().m_group == nullptr))
+        {
+            return false;
+        }
+
+        range = queue.m_ranges.back();
+        queue.m_ranges.pop_back();
+        return true;
+    }
+
+
+    bool TaskDistributor::TrySteal(size_t threadIndex,
+                                   bool subtasksOnly,
+                                   Range& range)
+    {
+        const size_t threadCount = m_queues.size();
+        WorkQueue& thief = *m_queues[threadIndex];
+
+        for (size_t i = 0; i < threadCount; ++i)
+        {
+            const size_t victimIndex = (thief.m_nextVictim + i) % threadCount;
+            if (victimIndex == threadIndex)
+            {
+                continue;
+            }
+
+            WorkQueue& victim = *m_queues[victimIndex];
+            std::lock_guard<std::mutex> lock(victim.m_lock);
+
+            for (auto it = victim.m_ranges.begin();
+                 it != victim.m_ranges.end();
+                 ++it)
+            {
+                if (subtasksOnly && it->m_group == nullptr)
+                {
+                    continue;
+                }
+
+                // The owner works from the bottom of its range, so take the
+                // upper half.
+                range = *it;
+                const size_t count = it->m_end - it->m_begin;
+                if (count > 1)
+                {
+                    range.m_begin = it->m_begin + count / 2;
+                    it->m_end = range.m_begin;
+                }
+                else
+                {
+                    victim.m_ranges.erase(it);
+                }
+
+                // Start with the same victim next time, since it had more
+                // work than it could handle.
+                thief.m_nextVictim = victimIndex;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+
+    void TaskDistributor::Execute(size_t threadIndex, Range const & range)
+    {
+        if (range.m_begin + 1 < range.m_end)
+        {
+            const Range remaining = { range.m_begin + 1,
+                                      range.m_end,
+                                      range.m_group };
+            Push(threadIndex, remaining);
+        }
+
+        if (range.m_group != nullptr)
+        {
+            range.m_group->Run(range.m_begin);
+        }
+        else
+        {
+            try
+            {
+                m_processors[threadIndex]->ProcessTask(range.m_begin);
+            }
+            catch (...)
+            {
+                // Keep going, so that the other threads do not wait forever
+                // for this task. WaitForCompletion() rethrows the exception.
+                std::lock_guard<std::mutex> lock(m_exceptionLock);
+                if (m_exception == nullptr)
+                {
+                    m_exception = std::current_exception();
+                }
+            }
+            m_remainingTaskCount.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+
+    void TaskDistributor::Push(size_t threadIndex, Range const & range)
+    {
+        WorkQueue& queue = *m_queues[threadIndex];
+        std::lock_guard<std::mutex> lock(queue.m_lock);
+        queue.m_ranges.push_back(range);
+    }
+
+
+    void TaskDistributor::Backoff(unsigned idleCount)
+    {
+        // Yield while work is likely to show up soon, then sleep so that
+        // idle threads do not compete with busy ones for the cores.
+        if (idleCount < 64)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+
+    void TaskDistributor::PinCurrentThread(size_t threadIndex)
+    {
+        // Pinning is a performance hint, so failures are ignored.
+        const unsigned coreCount = std::thread::hardware_concurrency();
+        if (coreCount == 0)
+        {
+            return;
+        }
+        const size_t core = threadIndex % coreCount;
+
+#ifdef BITFUNNEL_PLATFORM_WINDOWS
+        if (core < 64)
+        {
+            SetThreadAffinityMask(GetCurrentThread(),
+                                  static_cast<DWORD_PTR>(1) << core);
+        }
+#elif defined(__linux__)
+        cpu_set_t cores;
+        CPU_ZERO(&cores);
+        CPU_SET(core, &cores);
+        pthread_setaffinity_np(pthread_self(), sizeof(cores), &cores);
+#else
+        static_cast<void>(core);
+#endif
     }
 }
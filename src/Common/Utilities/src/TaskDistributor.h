@@ -22,6 +22,8 @@
 
 #pragma once
 
+#include <atomic>                                   // std::atomic member.
+#include <exception>                                // std::exception_ptr member.
 #include <memory>                                   // For std::unique_ptr.
 #include <mutex>                                    // std::mutex member.
 #include <vector>                                   // std::vector member.
@@ -34,7 +36,6 @@ namespace BitFunnel
 {
     class ITaskProcessor;
     class IThreadBase;
-    class TaskCoordinatorThread;
     class ThreadManager;
 
     //*************************************************************************
@@ -44,11 +45,21 @@ namespace BitFunnel
     // Uses multiple threads to dispatch numbered tasks to a vector of objects
     // that derive from ITaskProcessor.
     //
-    // One thread is started for each ITaskProcessor. The ITaskProcessors are
-    // assigned task ids via ITaskProcessor::ProcessTask(). Task ids are handed
-    // out starting from 0 and increasing until all ITaskProcessors are busy.
-    // Each time a thread returns from ProcessTask(), a new task id will be
-    // assigned until all tasks have been processed.
+    // One thread is started for each ITaskProcessor. Each thread owns a
+    // deque of task id ranges, and the ids from 0 to taskCount - 1 are
+    // initially split into one contiguous range per thread. A thread takes
+    // its next task from the back of its own deque. A thread whose deque is
+    // empty steals half of a range from the front of another thread's deque,
+    // so the threads only contend when one of them runs out of work.
+    //
+    // Subtasks started with RunSubtasks() are pushed as a range onto the
+    // calling thread's deque, where they are processed by the calling thread
+    // and stolen by idle threads. While waiting for its subtasks to complete,
+    // the calling thread only processes subtasks, so that a task never waits
+    // on an unrelated top-level task.
+    //
+    // When pinThreads is true, thread i is pinned to logical core i modulo
+    // the number of cores.
     //
     // Task coordinator only knows about task ids. The interpretation of the
     // work associated with a particular task id is up to the ITaskProcessor.
@@ -59,25 +70,73 @@ namespace BitFunnel
     public:
         TaskDistributor(
             const std::vector<std::unique_ptr<ITaskProcessor>>& processors,
-            size_t taskCount);
+            size_t taskCount,
+            bool pinThreads);
+
+        ~TaskDistributor();
+
+        //
+        // ITaskDistributor methods.
+        //
+
+        void RunSubtasks(size_t subtaskCount,
+                         std::function<void(size_t)> const & subtask) override;
 
-        // TaskDistributorThreads call TryAllocateTask() to get their next task
-        // assignment. If there is work remaining, taskId will be set to the id
-        // of the assigned task and the method will return true. If there are
-        // no tasks remaining, the method will return false.
-        bool TryAllocateTask(size_t& taskId);
+        // Wait for all tasks to complete. Rethrows the first exception
+        // thrown by ITaskProcessor::ProcessTask(), if any.
+        void WaitForCompletion() override;
 
-        // Wait for all tasks to complete.
-        void WaitForCompletion();
+        // Runs the tasks of the thread with the given index. Returns once all
+        // tasks have been processed.
+        void ProcessTasks(size_t threadIndex);
 
     private:
+        class SubtaskGroup;
+        class WorkQueue;
+
+        // A range [m_begin, m_end) of task ids. m_group is nullptr for
+        // top-level tasks and otherwise the SubtaskGroup the ids belong to.
+        class Range
+        {
+        public:
+            size_t m_begin;
+            size_t m_end;
+            SubtaskGroup* m_group;
+        };
+
+        // Pops the range at the back of the deque of the given thread. If
+        // subtasksOnly is true, top-level ranges are left in place.
+        bool TryPop(size_t threadIndex, bool subtasksOnly, Range& range);
+
+        // Steals the upper half of the first eligible range in another
+        // thread's deque.
+        bool TrySteal(size_t threadIndex, bool subtasksOnly, Range& range);
+
+        // Processes the first id in range, after pushing the remaining ids
+        // back onto the deque of the given thread.
+        void Execute(size_t threadIndex, Range const & range);
+
+        void Push(size_t threadIndex, Range const & range);
+
+        // Waits briefly after a thread failed to find work idleCount times
+        // in a row.
+        static void Backoff(unsigned idleCount);
+
+        static void PinCurrentThread(size_t threadIndex);
+
         std::vector<std::unique_ptr<ITaskProcessor>> const & m_processors;
-        size_t m_taskCount;
-        size_t m_nextTaskId;
+        const bool m_pinThreads;
+
+        // Number of top-level tasks that have not completed yet.
+        std::atomic<size_t> m_remainingTaskCount;
+
+        // First exception thrown by ITaskProcessor::ProcessTask().
+        std::mutex m_exceptionLock;
+        std::exception_ptr m_exception;
+
+        std::vector<std::unique_ptr<WorkQueue>> m_queues;
 
         std::vector<std::unique_ptr<IThreadBase>> m_threads;
         std::unique_ptr<ThreadManager> m_threadManager;
-
-        std::mutex m_lock;
     };
 }
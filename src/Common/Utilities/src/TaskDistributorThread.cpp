@@ -20,26 +20,20 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
-#include "BitFunnel/Utilities/ITaskProcessor.h"
 #include "TaskDistributor.h"
 #include "TaskDistributorThread.h"
 
 
 namespace BitFunnel
 {
-    TaskDistributorThread::TaskDistributorThread(TaskDistributor& distributor, ITaskProcessor& processor)
+    TaskDistributorThread::TaskDistributorThread(TaskDistributor& distributor, size_t threadIndex)
         : m_distributor(distributor),
-          m_processor(processor)
+          m_threadIndex(threadIndex)
     {
     }
 
     void TaskDistributorThread::EntryPoint()
     {
-        size_t taskId = 0;
-        while (m_distributor.TryAllocateTask(taskId))
-        {
-            m_processor.ProcessTask(taskId);
-        }
-        m_processor.Finished();
+        m_distributor.ProcessTasks(m_threadIndex);
     }
 }
@@ -22,21 +22,22 @@
 
 #pragma once
 
+#include <stddef.h>
+
 #include "ThreadManager.h"
 
 namespace BitFunnel
 {
     class TaskDistributor;
-    class ITaskProcessor;
 
     class TaskDistributorThread : public IThreadBase
     {
     public:
-        TaskDistributorThread(TaskDistributor& distributor, ITaskProcessor& processor);
+        TaskDistributorThread(TaskDistributor& distributor, size_t threadIndex);
         void EntryPoint();
 
     private:
         TaskDistributor& m_distributor;
-        ITaskProcessor& m_processor;
+        const size_t m_threadIndex;
     };
 }
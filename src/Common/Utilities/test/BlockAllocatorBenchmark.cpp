@@ -0,0 +1,177 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// BlockAllocatorBenchmark measures the cost of AllocateBlock() and
+// ReleaseBlock() when several threads churn blocks at the same time, the
+// pattern produced by slice buffer allocation during high-rate ingestion with
+// deletion. It compares
+//
+//   mutex:      every call serialized on one std::mutex, as the allocator
+//               used to be.
+//   lock-free:  the shared lock-free free list.
+//   magazines:  per-thread magazines in front of the shared free list.
+//
+// Usage: BlockAllocatorBenchmark [maxThreads] [operationsPerThread]
+
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BitFunnel/Utilities/Factories.h"
+#include "BitFunnel/Utilities/IBlockAllocator.h"
+#include "BitFunnel/Utilities/Stopwatch.h"
+
+
+namespace BitFunnel
+{
+    // Serializes all calls on one mutex to reproduce the single lock
+    // BlockAllocator used to have.
+    class MutexBlockAllocator : public IBlockAllocator
+    {
+    public:
+        MutexBlockAllocator(std::unique_ptr<IBlockAllocator> allocator)
+          : m_allocator(std::move(allocator))
+        {
+        }
+
+        virtual uint64_t* AllocateBlock() override
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            return m_allocator->AllocateBlock();
+        }
+
+        virtual void ReleaseBlock(uint64_t* block) override
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_allocator->ReleaseBlock(block);
+        }
+
+        virtual size_t GetBlockSize() const override
+        {
+            return m_allocator->GetBlockSize();
+        }
+
+        virtual bool Contains(uint64_t const * block) const override
+        {
+            return m_allocator->Contains(block);
+        }
+
+    private:
+        std::mutex m_lock;
+        std::unique_ptr<IBlockAllocator> m_allocator;
+    };
+
+
+    static const size_t c_blockSize = 64;
+    static const size_t c_blocksHeldPerThread = 16;
+    static const size_t c_magazineCapacity = 32;
+
+
+    // Returns the average time per AllocateBlock() or ReleaseBlock() call in
+    // nanoseconds.
+    static double Run(IBlockAllocator& allocator,
+                      size_t threadCount,
+                      size_t operationsPerThread)
+    {
+        const size_t rounds =
+            operationsPerThread / (2 * c_blocksHeldPerThread);
+
+        Stopwatch stopwatch;
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < threadCount; ++t)
+        {
+            threads.emplace_back([&]()
+            {
+                uint64_t* blocks[c_blocksHeldPerThread];
+                for (size_t round = 0; round < rounds; ++round)
+                {
+                    for (size_t i = 0; i < c_blocksHeldPerThread; ++i)
+                    {
+                        blocks[i] = allocator.AllocateBlock();
+                        blocks[i][0] = round;
+                    }
+                    for (size_t i = 0; i < c_blocksHeldPerThread; ++i)
+                    {
+                        allocator.ReleaseBlock(blocks[i]);
+                    }
+                }
+            });
+        }
+
+        for (auto & thread : threads)
+        {
+            thread.join();
+        }
+
+        const double operations =
+            static_cast<double>(threadCount * rounds * 2 * c_blocksHeldPerThread);
+        return stopwatch.ElapsedTime() * 1e9 / operations;
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    using namespace BitFunnel;
+
+    const size_t maxThreads =
+        (argc > 1) ? std::stoul(argv[1]) : 2 * std::thread::hardware_concurrency();
+    const size_t operationsPerThread =
+        (argc > 2) ? std::stoul(argv[2]) : 2000000;
+
+    std::cout << "ns per operation, " << operationsPerThread
+              << " operations per thread" << std::endl;
+    std::cout << std::setw(8) << "threads"
+              << std::setw(12) << "mutex"
+              << std::setw(12) << "lock-free"
+              << std::setw(12) << "magazines" << std::endl;
+
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        // Leave room for every thread's held blocks plus full magazines.
+        const size_t blockCount =
+            threads * (c_blocksHeldPerThread + c_magazineCapacity) +
+            std::thread::hardware_concurrency() * c_magazineCapacity;
+
+        MutexBlockAllocator mutex(
+            Factories::CreateBlockAllocator(c_blockSize, blockCount));
+        auto lockFree =
+            Factories::CreateBlockAllocator(c_blockSize, blockCount);
+        auto magazines =
+            Factories::CreateBlockAllocator(c_blockSize,
+                                            blockCount,
+                                            c_magazineCapacity);
+
+        std::cout << std::setw(8) << threads
+                  << std::fixed << std::setprecision(1)
+                  << std::setw(12) << Run(mutex, threads, operationsPerThread)
+                  << std::setw(12) << Run(*lockFree, threads, operationsPerThread)
+                  << std::setw(12) << Run(*magazines, threads, operationsPerThread)
+                  << std::endl;
+    }
+
+    return 0;
+}
@@ -22,6 +22,9 @@
 
 
 #include <memory>
+#include <set>
+#include <thread>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -143,5 +146,178 @@ namespace BitFunnel
             allocator->ReleaseBlock(block + 2);
             allocator->ReleaseBlock(block + 4);
         }
+    
+
+        // Huge pages may or may not be reserved on the test machine, so this
+        // test only checks that the pool works either way.
+        TEST(BlockAllocator, HugePages)
+        {
+            static const size_t c_blockSize = 4096;
+            static const size_t c_totalBlockCount = 8;
+            static const size_t c_hugePageSize = 2 * 1024 * 1024;
+
+            std::unique_ptr<IBlockAllocator> allocator(
+                Factories::CreateBlockAllocator(c_blockSize,
+                                                c_totalBlockCount,
+                                                0,
+                                                c_hugePageSize,
+                                                0));
+
+            std::vector<uint64_t*> blocks;
+            for (size_t i = 0; i < c_totalBlockCount; ++i)
+            {
+                uint64_t* block = allocator->AllocateBlock();
+                EXPECT_TRUE(allocator->Contains(block));
+
+                // The pool is aligned to the huge page size.
+                if (i == 0)
+                {
+                    EXPECT_EQ(0u, reinterpret_cast<size_t>(block) % c_hugePageSize);
+                }
+
+                block[0] = i;
+                block[c_blockSize / sizeof(uint64_t) - 1] = i;
+                blocks.push_back(block);
+            }
+
+            EXPECT_ANY_THROW(allocator->AllocateBlock());
+
+            uint64_t outside = 0;
+            EXPECT_FALSE(allocator->Contains(&outside));
+
+            for (size_t i = 0; i < c_totalBlockCount; ++i)
+            {
+                EXPECT_EQ(i, blocks[i][0]);
+                allocator->ReleaseBlock(blocks[i]);
+            }
+        }
+
+
+        TEST(BlockAllocator, Magazines)
+        {
+            static const size_t c_blockSize = 64;
+            static const size_t c_totalBlockCount = 20;
+            static const size_t c_magazineCapacity = 4;
+
+            std::unique_ptr<IBlockAllocator> allocator(
+                Factories::CreateBlockAllocator(c_blockSize,
+                                                c_totalBlockCount,
+                                                c_magazineCapacity));
+
+            // Every block in the pool can be allocated exactly once.
+            std::set<uint64_t*> blocks;
+            for (size_t i = 0; i < c_totalBlockCount; ++i)
+            {
+                blocks.insert(allocator->AllocateBlock());
+            }
+            EXPECT_EQ(c_totalBlockCount, blocks.size());
+            EXPECT_ANY_THROW(allocator->AllocateBlock());
+
+            // Releasing more blocks than fit in a magazine flushes them to
+            // the shared free list.
+            for (auto block : blocks)
+            {
+                allocator->ReleaseBlock(block);
+            }
+
+            std::set<uint64_t*> reallocated;
+            for (size_t i = 0; i < c_totalBlockCount; ++i)
+            {
+                reallocated.insert(allocator->AllocateBlock());
+            }
+            EXPECT_EQ(blocks, reallocated);
+            EXPECT_ANY_THROW(allocator->AllocateBlock());
+
+            // Blocks cached in another thread's magazine are still available
+            // once the shared free list is empty.
+            std::thread releaser([&]()
+            {
+                for (auto block : reallocated)
+                {
+                    allocator->ReleaseBlock(block);
+                }
+            });
+            releaser.join();
+
+            std::set<uint64_t*> stolen;
+            for (size_t i = 0; i < c_totalBlockCount; ++i)
+            {
+                stolen.insert(allocator->AllocateBlock());
+            }
+            EXPECT_EQ(blocks, stolen);
+            EXPECT_ANY_THROW(allocator->AllocateBlock());
+        }
+
+
+        // Threads repeatedly allocate blocks, tag them, and verify that no
+        // other thread wrote to them before releasing them.
+        static void VerifyExclusiveOwnership(IBlockAllocator& allocator,
+                                             size_t threadCount,
+                                             size_t blocksPerThread)
+        {
+            std::vector<bool> failed(threadCount, false);
+            std::vector<std::thread> threads;
+            for (size_t t = 0; t < threadCount; ++t)
+            {
+                threads.emplace_back([&, t]()
+                {
+                    std::vector<uint64_t*> blocks;
+                    for (unsigned round = 0; round < 2000; ++round)
+                    {
+                        for (size_t i = 0; i < blocksPerThread; ++i)
+                        {
+                            uint64_t* block = allocator.AllocateBlock();
+                            block[0] = t;
+                            block[1] = round;
+                            blocks.push_back(block);
+                        }
+                        std::this_thread::yield();
+                        for (auto block : blocks)
+                        {
+                            if (block[0] != t || block[1] != round)
+                            {
+                                failed[t] = true;
+                            }
+                            allocator.ReleaseBlock(block);
+                        }
+                        blocks.clear();
+                    }
+                });
+            }
+
+            for (auto & thread : threads)
+            {
+                thread.join();
+            }
+
+            for (size_t t = 0; t < threadCount; ++t)
+            {
+                EXPECT_FALSE(failed[t]);
+            }
+        }
+
+
+        TEST(BlockAllocator, Concurrent)
+        {
+            static const size_t c_blockSize = 16;
+            static const size_t c_threadCount = 4;
+            static const size_t c_blocksPerThread = 8;
+
+            std::unique_ptr<IBlockAllocator> allocator(
+                Factories::CreateBlockAllocator(c_blockSize,
+                                                c_threadCount * c_blocksPerThread));
+            VerifyExclusiveOwnership(*allocator, c_threadCount, c_blocksPerThread);
+
+            // Blocks in transit between a magazine and the shared free list
+            // are briefly invisible to other threads, so leave some headroom
+            // in the pool when using magazines.
+            std::unique_ptr<IBlockAllocator> magazineAllocator(
+                Factories::CreateBlockAllocator(c_blockSize,
+                                                2 * c_threadCount * c_blocksPerThread,
+                                                c_blocksPerThread));
+            VerifyExclusiveOwnership(*magazineAllocator,
+                                     c_threadCount,
+                                     c_blocksPerThread);
+        }
     }
 }
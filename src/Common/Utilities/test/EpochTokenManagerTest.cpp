@@ -0,0 +1,156 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "BitFunnel/Utilities/Factories.h"
+#include "EpochTokenManager.h"
+
+namespace BitFunnel
+{
+    namespace EpochTokenManagerTest
+    {
+        TEST(EpochTokenManager, Basic)
+        {
+            EpochTokenManager tokenManager;
+
+            {
+                // Tokens held at the same time get different slots.
+                const Token token1 = tokenManager.RequestToken();
+                const Token token2 = tokenManager.RequestToken();
+                ASSERT_NE(token1.GetSerialNumber(), token2.GetSerialNumber());
+            }
+
+            // The slots were returned, so Shutdown() does not block.
+            tokenManager.Shutdown();
+        }
+
+
+        TEST(EpochTokenManager, StartTracker)
+        {
+            std::unique_ptr<ITokenManager> tokenManager =
+                Factories::CreateEpochTokenManager();
+
+            // Starting a tracker when there are no tokens in flight.
+            const std::shared_ptr<ITokenTracker> noTokensTracker
+                = tokenManager->StartTracker();
+            ASSERT_TRUE(noTokensTracker->IsComplete());
+
+            std::shared_ptr<ITokenTracker> token0Tracker;
+            std::shared_ptr<ITokenTracker> token1Tracker;
+            {
+                const Token token0 = tokenManager->RequestToken();
+                token0Tracker = tokenManager->StartTracker();
+                ASSERT_FALSE(token0Tracker->IsComplete());
+
+                {
+                    const Token token1 = tokenManager->RequestToken();
+                    token1Tracker = tokenManager->StartTracker();
+                    ASSERT_FALSE(token1Tracker->IsComplete());
+
+                    // A token requested after the tracker was started is not
+                    // tracked.
+                    const Token token2 = tokenManager->RequestToken();
+                    std::shared_ptr<ITokenTracker> token2Tracker
+                        = tokenManager->StartTracker();
+                    ASSERT_FALSE(token2Tracker->IsComplete());
+                }
+
+                // token0 is still in flight.
+                ASSERT_FALSE(token0Tracker->IsComplete());
+                ASSERT_FALSE(token1Tracker->IsComplete());
+            }
+
+            ASSERT_TRUE(token0Tracker->IsComplete());
+            ASSERT_TRUE(token1Tracker->IsComplete());
+            ASSERT_TRUE(noTokensTracker->IsComplete());
+
+            // A token which reuses a tracked slot at a later epoch does not
+            // hold back a tracker.
+            std::shared_ptr<ITokenTracker> reuseTracker;
+            {
+                const Token token = tokenManager->RequestToken();
+                reuseTracker = tokenManager->StartTracker();
+            }
+            const Token token = tokenManager->RequestToken();
+            ASSERT_TRUE(reuseTracker->IsComplete());
+        }
+
+
+        TEST(EpochTokenManager, ConcurrentTrackers)
+        {
+            EpochTokenManager tokenManager;
+
+            // Each thread repeatedly publishes a value while holding a
+            // token. After the tracker completes, no thread may still be
+            // using the value which was current when it was started.
+            const unsigned c_threadCount = 8;
+            const unsigned c_iterationCount = 20000;
+            std::atomic<unsigned> current(0);
+            std::vector<std::atomic<unsigned>> inUse(c_threadCount);
+            std::atomic<bool> failed(false);
+            std::atomic<unsigned> running(c_threadCount);
+
+            std::vector<std::thread> threads;
+            for (unsigned t = 0; t < c_threadCount; ++t)
+            {
+                inUse[t] = 0;
+                threads.emplace_back([&, t]()
+                {
+                    for (unsigned i = 0; i < c_iterationCount; ++i)
+                    {
+                        const Token token = tokenManager.RequestToken();
+                        inUse[t] = current.load() + 1;
+                        std::this_thread::yield();
+                        inUse[t] = 0;
+                    }
+                    --running;
+                });
+            }
+
+            while (running > 0)
+            {
+                const unsigned old = current++;
+                tokenManager.StartTracker()->WaitForCompletion();
+                for (unsigned t = 0; t < c_threadCount; ++t)
+                {
+                    if (inUse[t] == old + 1)
+                    {
+                        failed = true;
+                    }
+                }
+            }
+
+            for (auto & thread : threads)
+            {
+                thread.join();
+            }
+
+            ASSERT_FALSE(failed);
+        }
+    }
+}
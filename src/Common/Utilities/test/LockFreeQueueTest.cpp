@@ -0,0 +1,162 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "BitFunnel/Utilities/LockFreeQueue.h"
+
+
+namespace BitFunnel
+{
+    namespace LockFreeQueueTest
+    {
+        TEST(LockFreeQueue, Basic)
+        {
+            LockFreeQueue<unsigned> queue(3);
+            ASSERT_EQ(4u, queue.GetCapacity());
+
+            unsigned value;
+            EXPECT_FALSE(queue.TryDequeue(value));
+
+            // Fill and drain the queue several times so that positions wrap
+            // around the ring.
+            for (unsigned lap = 0; lap < 3; ++lap)
+            {
+                for (unsigned i = 0; i < 4; ++i)
+                {
+                    EXPECT_TRUE(queue.TryEnqueue(lap * 10 + i));
+                }
+                EXPECT_FALSE(queue.TryEnqueue(100));
+
+                for (unsigned i = 0; i < 4; ++i)
+                {
+                    ASSERT_TRUE(queue.TryDequeue(value));
+                    EXPECT_EQ(lap * 10 + i, value);
+                }
+                EXPECT_FALSE(queue.TryDequeue(value));
+            }
+        }
+
+
+        TEST(LockFreeQueue, MinimumCapacity)
+        {
+            for (size_t capacity = 0; capacity <= 2; ++capacity)
+            {
+                LockFreeQueue<unsigned> queue(capacity);
+                ASSERT_EQ(2u, queue.GetCapacity());
+
+                EXPECT_TRUE(queue.TryEnqueue(1));
+                EXPECT_TRUE(queue.TryEnqueue(2));
+                EXPECT_FALSE(queue.TryEnqueue(3));
+
+                unsigned value;
+                ASSERT_TRUE(queue.TryDequeue(value));
+                EXPECT_EQ(1u, value);
+                ASSERT_TRUE(queue.TryDequeue(value));
+                EXPECT_EQ(2u, value);
+                EXPECT_FALSE(queue.TryDequeue(value));
+            }
+        }
+
+
+        TEST(LockFreeQueue, ProducersAndConsumers)
+        {
+            const unsigned c_producerCount = 4;
+            const unsigned c_consumerCount = 4;
+            const uint64_t c_itemsPerProducer = 100000;
+
+            LockFreeQueue<uint64_t> queue(16);
+            std::atomic<unsigned> producersRunning(c_producerCount);
+            std::vector<uint64_t> sums(c_consumerCount, 0);
+            std::vector<uint64_t> counts(c_consumerCount, 0);
+
+            std::vector<std::thread> threads;
+            for (unsigned p = 0; p < c_producerCount; ++p)
+            {
+                threads.emplace_back([&, p]()
+                {
+                    for (uint64_t i = 0; i < c_itemsPerProducer; ++i)
+                    {
+                        while (!queue.TryEnqueue(p * c_itemsPerProducer + i))
+                        {
+                            std::this_thread::yield();
+                        }
+                    }
+                    --producersRunning;
+                });
+            }
+
+            for (unsigned c = 0; c < c_consumerCount; ++c)
+            {
+                threads.emplace_back([&, c]()
+                {
+                    uint64_t value;
+                    for (;;)
+                    {
+                        if (queue.TryDequeue(value))
+                        {
+                            sums[c] += value;
+                            ++counts[c];
+                        }
+                        else if (producersRunning == 0)
+                        {
+                            // Producers are done, so an empty queue stays
+                            // empty. Drain anything enqueued before the
+                            // check.
+                            while (queue.TryDequeue(value))
+                            {
+                                sums[c] += value;
+                                ++counts[c];
+                            }
+                            break;
+                        }
+                        else
+                        {
+                            std::this_thread::yield();
+                        }
+                    }
+                });
+            }
+
+            for (auto & thread : threads)
+            {
+                thread.join();
+            }
+
+            // Every item was dequeued exactly once.
+            const uint64_t itemCount = c_producerCount * c_itemsPerProducer;
+            uint64_t sum = 0;
+            uint64_t count = 0;
+            for (unsigned c = 0; c < c_consumerCount; ++c)
+            {
+                sum += sums[c];
+                count += counts[c];
+            }
+            EXPECT_EQ(itemCount, count);
+            EXPECT_EQ(itemCount * (itemCount - 1) / 2, sum);
+        }
+    }
+}
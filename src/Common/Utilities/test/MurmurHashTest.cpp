@@ -20,6 +20,9 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
+#include <string>
+#include <vector>
+
 #include "MurmurHash2.h"
 #include "gtest/gtest.h"
 
@@ -37,5 +40,46 @@ namespace BitFunnel
             // like FarmHash or SipHash.
 
         }
+
+
+        //*********************************************************************
+        // The batched MurmurHash64A must match the single key version for
+        // keys of every length class and for counts that are not a multiple
+        // of the batch width.
+        TEST(MurmurHashTest, Batch)
+        {
+            const unsigned seed = 123456789;
+
+            std::string text;
+            for (size_t i = 0; i < 64; ++i)
+            {
+                text.push_back(static_cast<char>('a' + (i * 7) % 26));
+            }
+
+            std::vector<void const *> keys;
+            std::vector<size_t> lengths;
+            for (size_t length = 0; length <= 41; ++length)
+            {
+                // Vary the alignment of the keys.
+                keys.push_back(text.data() + length % 8);
+                lengths.push_back(length);
+            }
+
+            for (size_t count = 0; count <= keys.size(); ++count)
+            {
+                std::vector<uint64_t> hashes(count);
+                MurmurHash64A(keys.data(),
+                              lengths.data(),
+                              count,
+                              seed,
+                              hashes.data());
+
+                for (size_t i = 0; i < count; ++i)
+                {
+                    EXPECT_EQ(MurmurHash64A(keys[i], lengths[i], seed),
+                              hashes[i]);
+                }
+            }
+        }
     }
 }
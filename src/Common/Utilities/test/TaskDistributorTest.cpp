@@ -23,6 +23,7 @@
 #include <array>
 #include <atomic>
 #include <chrono>
+#include <stdexcept>
 #include <thread>
 #include <ostream>
 #include <vector>
@@ -159,5 +160,256 @@ namespace BitFunnel
         {
             out << "call count = " << m_callCount << std::endl;
         }
+
+
+        //*************************************************************************
+        //
+        // Subtasks
+        //
+        //*************************************************************************
+
+        // Each task runs c_subtaskCount subtasks, each of which runs
+        // c_nestedCount nested subtasks. Counts how many times each nested
+        // subtask ran.
+        class SubtaskProcessor : public ITaskProcessor, NonCopyable
+        {
+        public:
+            static const size_t c_subtaskCount = 20;
+            static const size_t c_nestedCount = 5;
+
+            SubtaskProcessor(std::vector<std::atomic<uint64_t>>& counts)
+              : m_counts(counts)
+            {
+            }
+
+            void ProcessTask(size_t taskId) override
+            {
+                ITaskDistributor* distributor = ITaskDistributor::GetCurrent();
+                ASSERT_NE(nullptr, distributor);
+
+                const size_t subtaskCount = c_subtaskCount;
+                const size_t nestedCount = c_nestedCount;
+                distributor->RunSubtasks(
+                    subtaskCount,
+                    [&](size_t subtaskId)
+                    {
+                        distributor->RunSubtasks(
+                            nestedCount,
+                            [&](size_t nestedId)
+                            {
+                                ++m_counts[(taskId * subtaskCount + subtaskId) *
+                                           nestedCount + nestedId];
+                            });
+                    });
+            }
+
+            void Finished() override
+            {
+            }
+
+        private:
+            std::vector<std::atomic<uint64_t>>& m_counts;
+        };
+
+
+        TEST(TaskDistributor, NestedSubtasks)
+        {
+            const size_t threadCount = 8;
+            const size_t taskCount = 30;
+
+            std::vector<std::atomic<uint64_t>> counts(
+                taskCount *
+                SubtaskProcessor::c_subtaskCount *
+                SubtaskProcessor::c_nestedCount);
+
+            std::vector<std::unique_ptr<ITaskProcessor>> processors;
+            for (size_t i = 0; i < threadCount; ++i)
+            {
+                processors.push_back(std::unique_ptr<ITaskProcessor>(
+                    new SubtaskProcessor(counts)));
+            }
+
+            std::unique_ptr<ITaskDistributor> distributor(
+                Factories::CreateTaskDistributor(processors, taskCount));
+            distributor->WaitForCompletion();
+
+            for (size_t i = 0; i < counts.size(); ++i)
+            {
+                ASSERT_EQ(1u, counts[i].load());
+            }
+        }
+
+
+        TEST(TaskDistributor, PinnedThreads)
+        {
+            const size_t threadCount = 4;
+            const size_t taskCount = 7;
+
+            std::vector<std::atomic<uint64_t>> counts(
+                taskCount *
+                SubtaskProcessor::c_subtaskCount *
+                SubtaskProcessor::c_nestedCount);
+
+            std::vector<std::unique_ptr<ITaskProcessor>> processors;
+            for (size_t i = 0; i < threadCount; ++i)
+            {
+                processors.push_back(std::unique_ptr<ITaskProcessor>(
+                    new SubtaskProcessor(counts)));
+            }
+
+            std::unique_ptr<ITaskDistributor> distributor(
+                Factories::CreateTaskDistributor(processors, taskCount, true));
+            distributor->WaitForCompletion();
+
+            for (size_t i = 0; i < counts.size(); ++i)
+            {
+                ASSERT_EQ(1u, counts[i].load());
+            }
+        }
+
+
+        // Throws from one subtask of each task and records whether
+        // RunSubtasks() rethrew the exception after running the others.
+        class ThrowingProcessor : public ITaskProcessor, NonCopyable
+        {
+        public:
+            ThrowingProcessor(std::atomic<uint64_t>& subtaskCount,
+                              std::atomic<uint64_t>& exceptionCount)
+              : m_subtaskCount(subtaskCount),
+                m_exceptionCount(exceptionCount)
+            {
+            }
+
+            void ProcessTask(size_t /*taskId*/) override
+            {
+                try
+                {
+                    ITaskDistributor::GetCurrent()->RunSubtasks(
+                        10,
+                        [this](size_t subtaskId)
+                        {
+                            ++m_subtaskCount;
+                            if (subtaskId == 3)
+                            {
+                                throw std::runtime_error("subtask");
+                            }
+                        });
+                }
+                catch (std::runtime_error const &)
+                {
+                    ++m_exceptionCount;
+                }
+            }
+
+            void Finished() override
+            {
+            }
+
+        private:
+            std::atomic<uint64_t>& m_subtaskCount;
+            std::atomic<uint64_t>& m_exceptionCount;
+        };
+
+
+        TEST(TaskDistributor, SubtaskException)
+        {
+            const size_t threadCount = 4;
+            const size_t taskCount = 10;
+
+            std::atomic<uint64_t> subtaskCount(0);
+            std::atomic<uint64_t> exceptionCount(0);
+
+            std::vector<std::unique_ptr<ITaskProcessor>> processors;
+            for (size_t i = 0; i < threadCount; ++i)
+            {
+                processors.push_back(std::unique_ptr<ITaskProcessor>(
+                    new ThrowingProcessor(subtaskCount, exceptionCount)));
+            }
+
+            std::unique_ptr<ITaskDistributor> distributor(
+                Factories::CreateTaskDistributor(processors, taskCount));
+            distributor->WaitForCompletion();
+
+            EXPECT_EQ(taskCount * 10, subtaskCount.load());
+            EXPECT_EQ(taskCount, exceptionCount.load());
+        }
+
+
+        // Throws from one task and counts the tasks it processed.
+        class ThrowingTaskProcessor : public ITaskProcessor, NonCopyable
+        {
+        public:
+            ThrowingTaskProcessor(std::atomic<uint64_t>& taskCount,
+                                  std::atomic<uint64_t>& finishedCount)
+              : m_taskCount(taskCount),
+                m_finishedCount(finishedCount)
+            {
+            }
+
+            void ProcessTask(size_t taskId) override
+            {
+                ++m_taskCount;
+                if (taskId == 5)
+                {
+                    throw std::runtime_error("task");
+                }
+            }
+
+            void Finished() override
+            {
+                ++m_finishedCount;
+            }
+
+        private:
+            std::atomic<uint64_t>& m_taskCount;
+            std::atomic<uint64_t>& m_finishedCount;
+        };
+
+
+        TEST(TaskDistributor, TaskException)
+        {
+            const size_t threadCount = 4;
+            const size_t taskCount = 50;
+
+            std::atomic<uint64_t> processedCount(0);
+            std::atomic<uint64_t> finishedCount(0);
+
+            std::vector<std::unique_ptr<ITaskProcessor>> processors;
+            for (size_t i = 0; i < threadCount; ++i)
+            {
+                processors.push_back(std::unique_ptr<ITaskProcessor>(
+                    new ThrowingTaskProcessor(processedCount, finishedCount)));
+            }
+
+            std::unique_ptr<ITaskDistributor> distributor(
+                Factories::CreateTaskDistributor(processors, taskCount));
+            EXPECT_THROW(distributor->WaitForCompletion(), std::runtime_error);
+
+            // The other tasks still ran and every thread finished.
+            EXPECT_EQ(taskCount, processedCount.load());
+            EXPECT_EQ(threadCount, finishedCount.load());
+        }
+
+
+        // Subtasks started from a thread that does not belong to the
+        // distributor run in order on that thread.
+        TEST(TaskDistributor, SubtasksOnOtherThread)
+        {
+            EXPECT_EQ(nullptr, ITaskDistributor::GetCurrent());
+
+            std::vector<std::unique_ptr<ITaskProcessor>> processors;
+            std::unique_ptr<ITaskDistributor> distributor(
+                Factories::CreateTaskDistributor(processors, 0));
+
+            std::vector<size_t> order;
+            distributor->RunSubtasks(5, [&](size_t subtaskId)
+            {
+                order.push_back(subtaskId);
+            });
+            distributor->WaitForCompletion();
+
+            std::vector<size_t> expected = { 0, 1, 2, 3, 4 };
+            EXPECT_EQ(expected, order);
+        }
     }
 }
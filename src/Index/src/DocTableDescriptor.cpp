@@ -149,6 +149,20 @@ namespace BitFunnel
     {
         if (m_variableSizeBlobCount > 0)
         {
+            // The blob pointers in sliceBuffer may be stale (e.g. when the
+            // buffer was mapped from a file). Clear them first so that
+            // Cleanup() is safe if reading fails part way through.
+            for (DocIndex i = 0; i < m_capacity; ++i)
+            {
+                for (unsigned blob = 0; blob < m_variableSizeBlobCount; ++blob)
+                {
+                    VariableSizeBlob& blobData =
+                        GetVariableBlobRef(sliceBuffer, i, blob);
+                    blobData.m_data = nullptr;
+                    blobData.m_size = 0;
+                }
+            }
+
             for (DocIndex i = 0; i < m_capacity; ++i)
             {
                 for (unsigned blob = 0; blob < m_variableSizeBlobCount; ++blob)
@@ -202,6 +216,31 @@ namespace BitFunnel
     }
 
 
+    void DocTableDescriptor::CopyItem(void* fromBuffer,
+                                      DocIndex fromIndex,
+                                      void* toBuffer,
+                                      DocIndex toIndex) const
+    {
+        memcpy(GetItem(toBuffer, toIndex),
+               GetItem(fromBuffer, fromIndex),
+               m_bytesPerItem);
+
+        for (unsigned blob = 0; blob < m_variableSizeBlobCount; ++blob)
+        {
+            VariableSizeBlob const & from =
+                GetVariableBlobRef(fromBuffer, fromIndex, blob);
+            VariableSizeBlob& to =
+                GetVariableBlobRef(toBuffer, toIndex, blob);
+
+            if (from.m_data != nullptr)
+            {
+                to.m_data = malloc(from.m_size);
+                memcpy(to.m_data, from.m_data, from.m_size);
+            }
+        }
+    }
+
+
     void DocTableDescriptor::Cleanup(void* sliceBuffer) const
     {
         if (m_variableSizeBlobCount > 0)
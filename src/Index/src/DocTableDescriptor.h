@@ -104,6 +104,15 @@ namespace BitFunnel
         // written out along with the whole slice buffer.
         void WriteVariableSizeBlobs(void* sliceBuffer, std::ostream& output) const;
 
+        // Copies the item at fromIndex in fromBuffer to the item at toIndex in
+        // toBuffer, which must not have any variable size blobs allocated.
+        // Variable size blobs are copied to new allocations so that the two
+        // items can be cleaned up independently.
+        void CopyItem(void* fromBuffer,
+                      DocIndex fromIndex,
+                      void* toBuffer,
+                      DocIndex toIndex) const;
+
         // Releases memory held by the variable sized blobs.
         void Cleanup(void* sliceBuffer) const;
 
@@ -60,7 +60,8 @@ namespace BitFunnel
     //*************************************************************************
     DocumentHandle::DocumentHandle(Slice* slice, DocIndex index)
       : m_slice(slice),
-        m_index(index)
+        m_index(index),
+        m_postingBuffer(nullptr)
     {
     }
 
@@ -104,7 +105,14 @@ namespace BitFunnel
 
     void DocumentHandle::AddPosting(Term const & term)
     {
-        m_slice->GetShard().AddPosting(term, m_index, m_slice->GetSliceBuffer());
+        if (m_postingBuffer != nullptr)
+        {
+            m_slice->GetShard().StagePosting(term, m_index, *m_slice, *m_postingBuffer);
+        }
+        else
+        {
+            m_slice->GetShard().AddPosting(term, m_index, m_slice->GetSliceBuffer());
+        }
     }
 
 
@@ -207,7 +215,21 @@ namespace BitFunnel
     }
 
 
+    void DocumentHandleInternal::SetPostingBuffer(PostingBuffer* buffer)
+    {
+        m_postingBuffer = buffer;
+    }
+
+
     void DocumentHandleInternal::Activate()
+    {
+        ActivateCopy();
+
+        m_slice->GetShard().TemporaryRecordDocument();
+    }
+
+
+    void DocumentHandleInternal::ActivateCopy()
     {
         const RowId documentActiveRow =
             m_slice->GetShard().GetDocumentActiveRowId();
@@ -216,7 +238,5 @@ namespace BitFunnel
         rowTable.SetBit(m_slice->GetSliceBuffer(),
                         documentActiveRow.GetIndex(),
                         m_index);
-
-        m_slice->GetShard().TemporaryRecordDocument();
     }
 }
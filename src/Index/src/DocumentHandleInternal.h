@@ -69,10 +69,20 @@ namespace BitFunnel
         // Returns the column in the slice where the document resides.
         DocIndex GetIndex() const;
 
+        // Makes AddPosting() stage postings in buffer, which must be flushed
+        // before the document is activated. Passing nullptr restores direct
+        // writes to the slice.
+        void SetPostingBuffer(PostingBuffer* buffer);
+
         // Make the document visible to matcher. Must be called after the
         // document's content is fully ingested.
         void Activate();
 
+        // Makes a document copied by Shard::CopyDocuments() visible to the
+        // matcher. Unlike Activate(), does not count the document in the
+        // Shard's statistics again.
+        void ActivateCopy();
+
         // Represent the value that the default constructor assigns to the instances
         // of DocumentHandle.
         static const DocIndex c_invalidDocIndex =
@@ -20,76 +20,570 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
+#include <algorithm>
 #include <sstream>
+#include <thread>
 
 #include "BitFunnel/Exceptions.h"
+#include "BitFunnel/Index/IRecycler.h"
+#include "BitFunnel/Index/Token.h"
 #include "DocumentMap.h"
+#include "LoggerInterfaces/Logging.h"
+#include "Recycler.h"
+#include "Slice.h"
 
 
 namespace BitFunnel
 {
-    void DocumentMap::Add(DocumentHandleInternal handle)
+    //*************************************************************************
+    //
+    // DocumentMap
+    //
+    //*************************************************************************
+    DocumentMap::DocumentMap(IRecycler& recycler, ITokenManager& tokenManager)
+      : m_recycler(recycler),
+        m_tokenManager(tokenManager),
+        m_expiredGroups(new std::vector<GroupId>()),
+        m_expiredCount(0)
+    {
+    }
+
+
+    DocumentMap::~DocumentMap()
     {
-        std::lock_guard<std::mutex> lock(m_lock);
+        delete m_expiredGroups.load(std::memory_order_relaxed);
+    }
 
-        DocId id = handle.GetDocId();
 
-        // Verify that this DocId hasn't been added previously.
-        auto it = m_docIdToDocHandle.find(id);
-        if (it != m_docIdToDocHandle.end())
+    void DocumentMap::Add(DocumentHandleInternal handle)
+    {
+        const DocId id = handle.GetDocId();
+        const uint64_t hash = Hash(id);
+        Stripe& stripe = GetStripe(hash);
+
+        RetiredList retired;
         {
-            std::stringstream message;
-            message << "Ingestor::Add(): DocId " << id << " has already been added.";
+            const Token token = m_tokenManager.RequestToken();
+            std::lock_guard<std::mutex> lock(stripe.m_lock);
+
+            Table* table = stripe.m_table.load(std::memory_order_relaxed);
+            const GroupId group = handle.GetSlice().GetGroupId();
 
-            RecoverableError error(message.str());
+            // Verify that this DocId hasn't been added previously.
+            const size_t existing = FindSlot(*table, id, hash);
+            const GroupId existingGroup = (existing != table->GetCapacity()) ?
+                (*table)[existing].m_group.load(std::memory_order_relaxed) :
+                c_noGroupId;
+            if (existing != table->GetCapacity() && !IsExpired(existingGroup))
+            {
+                std::stringstream message;
+                message << "Ingestor::Add(): DocId " << id << " has already been added.";
+
+                RecoverableError error(message.str());
+                throw error;
+            }
+
+            const size_t count = stripe.m_count.load(std::memory_order_relaxed);
+            const uint64_t version = stripe.m_version.load(std::memory_order_relaxed);
+
+            stripe.m_version.store(version + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            if (existing != table->GetCapacity())
+            {
+                // Reuse the slot of the DocId's expired entry.
+                Slot& entry = (*table)[existing];
+                entry.m_index.store(handle.GetIndex(), std::memory_order_relaxed);
+                entry.m_group.store(group, std::memory_order_relaxed);
+                entry.m_slice.store(&handle.GetSlice(), std::memory_order_relaxed);
+                ReleaseExpiredEntries(existingGroup, 1, retired);
+            }
+            else
+            {
+                if ((count + 1) * 2 > table->GetCapacity())
+                {
+                    Rehash(stripe, retired);
+                    table = stripe.m_table.load(std::memory_order_relaxed);
+                }
+
+                Insert(*table, id, hash, &handle.GetSlice(), handle.GetIndex(), group);
+                stripe.m_count.store(stripe.m_count.load(std::memory_order_relaxed) + 1,
+                                     std::memory_order_relaxed);
+            }
+
+            stripe.m_version.store(version + 2, std::memory_order_release);
         }
 
-        m_docIdToDocHandle.insert(std::make_pair(id, handle));
+        Recycle(retired);
     }
 
 
     DocumentHandleInternal DocumentMap::Find(DocId id, bool& isFound) const
     {
-        std::lock_guard<std::mutex> lock(m_lock);
-
-        DocumentHandleInternal handle;
+        const uint64_t hash = Hash(id);
+        Stripe const & stripe = GetStripe(hash);
 
-        auto it = m_docIdToDocHandle.find(id);
-        if (it == m_docIdToDocHandle.end())
+        const Token token = m_tokenManager.RequestToken();
+        for (;;)
         {
-            isFound = false;
+            const uint64_t version = stripe.m_version.load(std::memory_order_acquire);
+            if ((version & 1) != 0)
+            {
+                // A writer is modifying the stripe.
+                std::this_thread::yield();
+                continue;
+            }
+
+            // The Token keeps a table which a writer has just replaced from
+            // being freed while it is probed.
+            Table const & table = *stripe.m_table.load(std::memory_order_acquire);
+            const size_t mask = table.GetCapacity() - 1;
+
+            Slice* slice = nullptr;
+            DocIndex index = 0;
+            bool found = false;
+
+            // The probe count is bounded because a concurrent writer may
+            // present a torn view of the table.
+            size_t slot = hash & mask;
+            for (size_t probe = 0; probe < table.GetCapacity(); ++probe)
+            {
+                Slot const & entry = table[slot];
+                slice = entry.m_slice.load(std::memory_order_relaxed);
+                if (slice == nullptr)
+                {
+                    break;
+                }
+                if (entry.m_id.load(std::memory_order_relaxed) == id)
+                {
+                    index = entry.m_index.load(std::memory_order_relaxed);
+                    found = !IsExpired(entry.m_group.load(std::memory_order_relaxed));
+                    break;
+                }
+                slot = (slot + 1) & mask;
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (stripe.m_version.load(std::memory_order_relaxed) == version)
+            {
+                isFound = found;
+                return found ?
+                    DocumentHandleInternal(slice, index) :
+                    DocumentHandleInternal();
+            }
         }
-        else
+    }
+
+
+    bool DocumentMap::Update(DocumentHandleInternal handle)
+    {
+        const DocId id = handle.GetDocId();
+        const uint64_t hash = Hash(id);
+        Stripe& stripe = GetStripe(hash);
+
+        // The Token keeps the expired group list alive in IsExpired().
+        const Token token = m_tokenManager.RequestToken();
+        std::lock_guard<std::mutex> lock(stripe.m_lock);
+
+        Table& table = *stripe.m_table.load(std::memory_order_relaxed);
+        const size_t slot = FindSlot(table, id, hash);
+        if (slot == table.GetCapacity() ||
+            IsExpired(table[slot].m_group.load(std::memory_order_relaxed)))
         {
-            isFound = true;
-            handle = (*it).second;
+            return false;
         }
 
-        return handle;
+        const uint64_t version = stripe.m_version.load(std::memory_order_relaxed);
+        stripe.m_version.store(version + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        table[slot].m_slice.store(&handle.GetSlice(), std::memory_order_relaxed);
+        table[slot].m_index.store(handle.GetIndex(), std::memory_order_relaxed);
+        table[slot].m_group.store(handle.GetSlice().GetGroupId(),
+                                  std::memory_order_relaxed);
+
+        stripe.m_version.store(version + 2, std::memory_order_release);
+
+        return true;
     }
 
 
     bool DocumentMap::Delete(DocId id)
     {
-        std::lock_guard<std::mutex> lock(m_lock);
+        const uint64_t hash = Hash(id);
+        Stripe& stripe = GetStripe(hash);
+
+        const Token token = m_tokenManager.RequestToken();
+        std::lock_guard<std::mutex> lock(stripe.m_lock);
+
+        Table& table = *stripe.m_table.load(std::memory_order_relaxed);
+        const size_t mask = table.GetCapacity() - 1;
+
+        size_t hole = FindSlot(table, id, hash);
+        if (hole == table.GetCapacity() ||
+            IsExpired(table[hole].m_group.load(std::memory_order_relaxed)))
+        {
+            return false;
+        }
+
+        const uint64_t version = stripe.m_version.load(std::memory_order_relaxed);
+        stripe.m_version.store(version + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        // Backward shift deletion. Move each following entry of the cluster
+        // into the hole unless its home slot lies cyclically in
+        // (hole, slot], in which case moving it would break its probe
+        // sequence.
+        for (size_t slot = (hole + 1) & mask; ; slot = (slot + 1) & mask)
+        {
+            Slot& entry = table[slot];
+            Slice* slice = entry.m_slice.load(std::memory_order_relaxed);
+            if (slice == nullptr)
+            {
+                break;
+            }
+
+            const DocId entryId = entry.m_id.load(std::memory_order_relaxed);
+            const size_t home = Hash(entryId) & mask;
+            const size_t distanceToHome = (slot - home) & mask;
+            const size_t distanceToHole = (slot - hole) & mask;
+            if (distanceToHome >= distanceToHole)
+            {
+                Slot& target = table[hole];
+                target.m_id.store(entryId, std::memory_order_relaxed);
+                target.m_index.store(entry.m_index.load(std::memory_order_relaxed),
+                                     std::memory_order_relaxed);
+                target.m_group.store(entry.m_group.load(std::memory_order_relaxed),
+                                     std::memory_order_relaxed);
+                target.m_slice.store(slice, std::memory_order_relaxed);
+                hole = slot;
+            }
+        }
+
+        table[hole].m_slice.store(nullptr, std::memory_order_relaxed);
+        stripe.m_count.store(stripe.m_count.load(std::memory_order_relaxed) - 1,
+                             std::memory_order_relaxed);
+
+        stripe.m_version.store(version + 2, std::memory_order_release);
+
+        return true;
+    }
 
-        DocumentHandleInternal handle;
 
-        auto it = m_docIdToDocHandle.find(id);
-        bool found = (it != m_docIdToDocHandle.end());
-        if (found)
+    void DocumentMap::ExpireGroup(GroupId groupId, size_t documentCount)
+    {
+        if (documentCount == 0)
         {
-            m_docIdToDocHandle.erase(it);
+            // No entry refers to the group.
+            return;
+        }
+
+        RetiredList retired;
+        {
+            std::lock_guard<std::mutex> lock(m_expiredGroupsLock);
+
+            std::vector<GroupId> const * groups =
+                m_expiredGroups.load(std::memory_order_relaxed);
+            auto position =
+                std::lower_bound(groups->begin(), groups->end(), groupId);
+            if (position != groups->end() && *position == groupId)
+            {
+                return;
+            }
+
+            std::unique_ptr<std::vector<GroupId>> expired(new std::vector<GroupId>());
+            expired->reserve(groups->size() + 1);
+            expired->insert(expired->end(), groups->begin(), position);
+            expired->push_back(groupId);
+            expired->insert(expired->end(), position, groups->end());
+
+            m_expiredGroupCounts[groupId] = documentCount;
+            m_expiredCount += documentCount;
+
+            m_expiredGroups.store(expired.release(), std::memory_order_release);
+            retired.emplace_back(
+                new DeferredDelete<std::vector<GroupId>>(groups, m_tokenManager));
         }
 
-        return found;
+        Recycle(retired);
     }
 
 
     size_t DocumentMap::size() const
     {
-        std::lock_guard<std::mutex> lock(m_lock);
+        size_t count = 0;
+        for (auto const & stripe : m_stripes)
+        {
+            count += stripe.m_count.load(std::memory_order_relaxed);
+        }
+
+        // Rehash() retires expired entries from m_expiredCount before
+        // removing them from m_count, so a concurrent Rehash() never makes the
+        // difference negative. ExpireGroup() may still race with the loop
+        // above.
+        const size_t expired = m_expiredCount.load(std::memory_order_relaxed);
+        return (count > expired) ? count - expired : 0;
+    }
+
+
+    size_t DocumentMap::GetCapacity() const
+    {
+        const Token token = m_tokenManager.RequestToken();
 
-        return m_docIdToDocHandle.size();
+        size_t capacity = 0;
+        for (auto const & stripe : m_stripes)
+        {
+            capacity += stripe.m_table.load(std::memory_order_acquire)->GetCapacity();
+        }
+        return capacity;
+    }
+
+
+    bool DocumentMap::IsExpired(GroupId group) const
+    {
+        if (group == c_noGroupId)
+        {
+            return false;
+        }
+
+        std::vector<GroupId> const & groups =
+            *m_expiredGroups.load(std::memory_order_acquire);
+        return std::binary_search(groups.begin(), groups.end(), group);
+    }
+
+
+    void DocumentMap::ReleaseExpiredEntries(GroupId group,
+                                            size_t count,
+                                            RetiredList& retired)
+    {
+        std::lock_guard<std::mutex> lock(m_expiredGroupsLock);
+
+        m_expiredCount -= count;
+
+        auto it = m_expiredGroupCounts.find(group);
+        LogAssertB(it != m_expiredGroupCounts.end() && it->second >= count,
+                   "DocumentMap dropped more entries than its group held.");
+        it->second -= count;
+        if (it->second > 0)
+        {
+            return;
+        }
+        m_expiredGroupCounts.erase(it);
+
+        // No entry refers to the group any more, so it can be forgotten.
+        std::vector<GroupId> const * groups =
+            m_expiredGroups.load(std::memory_order_relaxed);
+        std::unique_ptr<std::vector<GroupId>> expired(new std::vector<GroupId>());
+        expired->reserve(groups->size() - 1);
+        for (GroupId g : *groups)
+        {
+            if (g != group)
+            {
+                expired->push_back(g);
+            }
+        }
+
+        m_expiredGroups.store(expired.release(), std::memory_order_release);
+        retired.emplace_back(
+            new DeferredDelete<std::vector<GroupId>>(groups, m_tokenManager));
+    }
+
+
+    void DocumentMap::Recycle(RetiredList& retired)
+    {
+        for (auto & item : retired)
+        {
+            m_recycler.ScheduleRecyling(item);
+        }
+    }
+
+
+    // Uses the MurmurHash3 64-bit finalizer. DocIds are often sequential, so
+    // they need to be mixed before selecting a stripe and a home slot.
+    uint64_t DocumentMap::Hash(DocId id)
+    {
+        uint64_t h = id;
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+        return h;
+    }
+
+
+    DocumentMap::Stripe& DocumentMap::GetStripe(uint64_t hash)
+    {
+        return m_stripes[hash >> c_stripeShift];
+    }
+
+
+    DocumentMap::Stripe const & DocumentMap::GetStripe(uint64_t hash) const
+    {
+        return m_stripes[hash >> c_stripeShift];
+    }
+
+
+    size_t DocumentMap::FindSlot(Table const & table, DocId id, uint64_t hash)
+    {
+        const size_t mask = table.GetCapacity() - 1;
+        for (size_t slot = hash & mask; ; slot = (slot + 1) & mask)
+        {
+            Slot const & entry = table[slot];
+            if (entry.m_slice.load(std::memory_order_relaxed) == nullptr)
+            {
+                return table.GetCapacity();
+            }
+            if (entry.m_id.load(std::memory_order_relaxed) == id)
+            {
+                return slot;
+            }
+        }
+    }
+
+
+    void DocumentMap::Rehash(Stripe& stripe, RetiredList& retired)
+    {
+        Table const * oldTable = stripe.m_table.load(std::memory_order_relaxed);
+
+        // Count the entries of each expired group, so that the new table can
+        // be sized for the live entries.
+        std::unordered_map<GroupId, size_t> dropped;
+        size_t droppedCount = 0;
+        for (size_t slot = 0; slot < oldTable->GetCapacity(); ++slot)
+        {
+            Slot const & entry = (*oldTable)[slot];
+            if (entry.m_slice.load(std::memory_order_relaxed) != nullptr)
+            {
+                const GroupId group = entry.m_group.load(std::memory_order_relaxed);
+                if (IsExpired(group))
+                {
+                    ++dropped[group];
+                    ++droppedCount;
+                }
+            }
+        }
+
+        // Leave the table at most a quarter full, so that the stripe doubles
+        // when nothing has expired.
+        const size_t liveCount =
+            stripe.m_count.load(std::memory_order_relaxed) - droppedCount;
+        size_t capacity = c_initialCapacity;
+        while (capacity < liveCount * 4)
+        {
+            capacity *= 2;
+        }
+
+        std::unique_ptr<Table> newTable(new Table(capacity));
+        for (size_t slot = 0; slot < oldTable->GetCapacity(); ++slot)
+        {
+            Slot const & entry = (*oldTable)[slot];
+            Slice* slice = entry.m_slice.load(std::memory_order_relaxed);
+            if (slice != nullptr)
+            {
+                const GroupId group = entry.m_group.load(std::memory_order_relaxed);
+                if (dropped.find(group) != dropped.end())
+                {
+                    continue;
+                }
+
+                const DocId id = entry.m_id.load(std::memory_order_relaxed);
+                Insert(*newTable,
+                       id,
+                       Hash(id),
+                       slice,
+                       entry.m_index.load(std::memory_order_relaxed),
+                       group);
+            }
+        }
+
+        // Publish the new table. Readers may still be probing the old one,
+        // so it is deleted once their Tokens have been returned.
+        stripe.m_table.store(newTable.release(), std::memory_order_release);
+        retired.emplace_back(new DeferredDelete<Table>(oldTable, m_tokenManager));
+
+        for (auto const & group : dropped)
+        {
+            ReleaseExpiredEntries(group.first, group.second, retired);
+        }
+        stripe.m_count.store(liveCount, std::memory_order_relaxed);
+    }
+
+
+    void DocumentMap::Insert(Table& table,
+                             DocId id,
+                             uint64_t hash,
+                             Slice* slice,
+                             DocIndex index,
+                             GroupId group)
+    {
+        const size_t mask = table.GetCapacity() - 1;
+        size_t slot = hash & mask;
+        while (table[slot].m_slice.load(std::memory_order_relaxed) != nullptr)
+        {
+            slot = (slot + 1) & mask;
+        }
+
+        Slot& entry = table[slot];
+        entry.m_id.store(id, std::memory_order_relaxed);
+        entry.m_index.store(index, std::memory_order_relaxed);
+        entry.m_group.store(group, std::memory_order_relaxed);
+        entry.m_slice.store(slice, std::memory_order_relaxed);
+    }
+
+
+    //*************************************************************************
+    //
+    // DocumentMap::Table
+    //
+    //*************************************************************************
+    DocumentMap::Table::Table(size_t capacity)
+        : m_capacity(capacity),
+          m_slots(new Slot[capacity])
+    {
+        for (size_t slot = 0; slot < m_capacity; ++slot)
+        {
+            m_slots[slot].m_id.store(0, std::memory_order_relaxed);
+            m_slots[slot].m_slice.store(nullptr, std::memory_order_relaxed);
+            m_slots[slot].m_index.store(0, std::memory_order_relaxed);
+            m_slots[slot].m_group.store(c_noGroupId, std::memory_order_relaxed);
+        }
+    }
+
+
+    size_t DocumentMap::Table::GetCapacity() const
+    {
+        return m_capacity;
+    }
+
+
+    DocumentMap::Slot& DocumentMap::Table::operator[](size_t slot)
+    {
+        return m_slots[slot];
+    }
+
+
+    DocumentMap::Slot const & DocumentMap::Table::operator[](size_t slot) const
+    {
+        return m_slots[slot];
+    }
+
+
+    //*************************************************************************
+    //
+    // DocumentMap::Stripe
+    //
+    //*************************************************************************
+    DocumentMap::Stripe::Stripe()
+        : m_version(0),
+          m_table(new Table(c_initialCapacity)),
+          m_count(0)
+    {
+    }
+
+
+    DocumentMap::Stripe::~Stripe()
+    {
+        delete m_table.load(std::memory_order_relaxed);
     }
 }
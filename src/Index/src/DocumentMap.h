@@ -22,19 +22,65 @@
 
 #pragma once
 
+#include <atomic>                       // std::atomic member.
+#include <memory>                       // std::unique_ptr member.
 #include <mutex>                        // std::mutex member.
 #include <unordered_map>                // std::unordered_map member.
+#include <vector>                       // std::vector member.
 
-#include "BitFunnel/BitFunnelTypes.h"   // For DocId parameter.
+#include "BitFunnel/BitFunnelTypes.h"   // For DocId and GroupId parameters.
 #include "BitFunnel/NonCopyable.h"      // Base class.
-#include "DocumentHandleInternal.h"     // DocHandleInternal template parameter.
+#include "DocumentHandleInternal.h"     // DocHandleInternal return value.
+#include "IRecyclable.h"                // IRecyclable template parameter.
 
 
 namespace BitFunnel
 {
+    class IRecycler;
+    class ITokenManager;
+
+    //*************************************************************************
+    //
+    // DocumentMap
+    //
+    // Maps DocIds to DocumentHandleInternals for Ingestor.
+    //
+    // The map is split into c_stripeCount stripes, selected by a hash of the
+    // DocId. Each stripe is an open addressing hash table with linear probing
+    // and backward shift deletion, so there are no tombstones.
+    //
+    // THREAD SAFETY: all methods are thread safe. Find() does not take a lock.
+    // It reads the stripe under a sequence lock and retries if a writer
+    // modified the stripe while it was reading. Add() and Delete() serialize
+    // on a per-stripe mutex, so writers only contend when they hash to the
+    // same stripe.
+    //
+    // A stripe is rehashed when it becomes half full. The new table is sized
+    // from the entries which are still live, so a stripe which is mostly
+    // expired keeps its size or shrinks. The table it replaces may still be
+    // in use by readers, so it is handed to the Recycler, which deletes it
+    // once the Tokens held during the swap have been returned. Each method
+    // holds a Token from the ITokenManager passed to the constructor while
+    // it reads the map.
+    //
+    // Each entry records the GroupId of its document's Slice. ExpireGroup()
+    // removes every entry of a group in one step by adding the group to a
+    // sorted list of expired groups, which readers check on each lookup.
+    // The expired entries stay in their tables, where they are invisible to
+    // Find(), Update() and Delete(). They are dropped when their stripe is
+    // rehashed, or overwritten if their DocId is added again. A group is
+    // removed from the list once none of its entries remain.
+    //
+    //*************************************************************************
     class DocumentMap : NonCopyable
     {
     public:
+        // Tables and expired group lists which are replaced are recycled
+        // with recycler after the Tokens issued by tokenManager drain.
+        DocumentMap(IRecycler& recycler, ITokenManager& tokenManager);
+
+        ~DocumentMap();
+
         // Adds a new (DocId, DocumentHandleInternal) pair to the map. DocId is
         // obtained from DocumentHandleInternal::GetDocId(). Throws if the map
         // already contains an entry for a given DocId.
@@ -56,14 +102,143 @@ namespace BitFunnel
         // Returns true otherwise.
         bool Delete(DocId id);
 
+        // Replaces the DocumentHandleInternal stored for value's DocId with
+        // value, e.g. after the document has been moved to another Slice.
+        // Find() never observes the DocId as missing during the update.
+        // Returns false if the map has no entry for the DocId.
+        bool Update(DocumentHandleInternal value);
+
+        // Removes the entries of every document in groupId without visiting
+        // them. documentCount is the number of entries in the group, which
+        // the caller knows from the group's Slices. The group's Slices must
+        // not be recycled before this call returns, and no documents may be
+        // added to the group afterwards. documentCount must be exact, since
+        // the group is forgotten once that many entries have been dropped.
+        void ExpireGroup(GroupId groupId, size_t documentCount);
+
         // Returns the number of DocIds in the map.
         size_t size() const;
 
+        // Returns the total number of slots in the stripes' tables.
+        size_t GetCapacity() const;
+
     private:
-        // Lock protecting operations on m_docIdToHandle.
-        // Made mutable to allow using it from const functions.
-        mutable std::mutex m_lock;
+        // A (DocId, DocumentHandleInternal) entry. The slot is empty when
+        // m_slice is nullptr. Fields are atomic because Find() may read a
+        // slot while a writer is modifying it. Such reads are discarded by
+        // the sequence lock.
+        struct Slot
+        {
+            std::atomic<DocId> m_id;
+            std::atomic<Slice*> m_slice;
+            std::atomic<DocIndex> m_index;
+            std::atomic<GroupId> m_group;
+        };
+
+        class Table : NonCopyable
+        {
+        public:
+            // Capacity must be a power of two.
+            Table(size_t capacity);
+
+            size_t GetCapacity() const;
+
+            Slot& operator[](size_t slot);
+            Slot const & operator[](size_t slot) const;
+
+        private:
+            const size_t m_capacity;
+            std::unique_ptr<Slot[]> m_slots;
+        };
+
+        struct Stripe
+        {
+            Stripe();
+            ~Stripe();
+
+            // Odd while a writer is modifying the stripe.
+            std::atomic<uint64_t> m_version;
+
+            // Owned by the stripe. Replaced tables are owned by the
+            // Recycler.
+            std::atomic<Table*> m_table;
+
+            std::atomic<size_t> m_count;
+
+            // Serializes Add(), Update() and Delete().
+            std::mutex m_lock;
+
+            // Keeps writers to one stripe from evicting the cache line read
+            // by Find() in the next stripe.
+            char m_padding[c_bytesPerCacheLine];
+        };
+
+        static uint64_t Hash(DocId id);
+
+        Stripe& GetStripe(uint64_t hash);
+        Stripe const & GetStripe(uint64_t hash) const;
+
+        // Returns the slot holding id in table, or table.GetCapacity() if id
+        // is not in the table. Must be called with the stripe's lock held.
+        static size_t FindSlot(Table const & table, DocId id, uint64_t hash);
+
+        // Stores an entry in the first empty slot in its probe sequence.
+        static void Insert(Table& table,
+                           DocId id,
+                           uint64_t hash,
+                           Slice* slice,
+                           DocIndex index,
+                           GroupId group);
+
+        // Objects which have been replaced and must be handed to the
+        // Recycler. Scheduling may block until the Recycler catches up, so
+        // it happens after the caller has released its locks and Token.
+        typedef std::vector<std::unique_ptr<IRecyclable>> RetiredList;
+
+        // Returns true if entries in group have been removed by
+        // ExpireGroup().
+        bool IsExpired(GroupId group) const;
+
+        // Records that count entries of the expired group have been dropped
+        // from the tables. The group is removed from the expired list once
+        // all of its entries are gone, and the old list is added to retired.
+        void ReleaseExpiredEntries(GroupId group,
+                                   size_t count,
+                                   RetiredList& retired);
+
+        // Replaces the stripe's table with one sized for its live entries,
+        // dropping the entries of expired groups. The old table is added to
+        // retired. Must be called with the stripe's lock held and the
+        // stripe's version odd.
+        void Rehash(Stripe& stripe, RetiredList& retired);
+
+        void Recycle(RetiredList& retired);
+
+        // The number of stripes must be a power of two.
+        static const size_t c_stripeCount = 64;
+        static const unsigned c_stripeShift = 58;
+
+        static const size_t c_initialCapacity = 16;
+
+        IRecycler& m_recycler;
+        ITokenManager& m_tokenManager;
+
+        Stripe m_stripes[c_stripeCount];
+
+        // Sorted list of expired groups. Replaced rather than modified so
+        // that Find() can read it without a lock. Replaced lists are
+        // recycled, like replaced tables.
+        std::atomic<std::vector<GroupId> const *> m_expiredGroups;
+
+        // Number of entries of each expired group still held in the tables.
+        // Protected by m_expiredGroupsLock.
+        std::unordered_map<GroupId, size_t> m_expiredGroupCounts;
+
+        // Serializes changes to the expired groups. Taken after a stripe's
+        // lock when both are held.
+        std::mutex m_expiredGroupsLock;
 
-        std::unordered_map<DocId, DocumentHandleInternal> m_docIdToDocHandle;
+        // Number of entries of expired groups still held in the tables.
+        std::atomic<size_t> m_expiredCount;
     };
 }
@@ -0,0 +1,261 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <algorithm>
+
+#include "AlignedBuffer.h"
+#include "BitFunnel/BitFunnelTypes.h"
+#include "BitFunnel/Exceptions.h"
+#include "BitFunnel/Index/Factories.h"
+#include "ElasticSliceBufferAllocator.h"
+#include "LoggerInterfaces/Check.h"
+#include "LoggerInterfaces/Logging.h"
+#include "Rounding.h"
+
+
+namespace BitFunnel
+{
+    // Arenas are aligned to a cache line. Blocks are a multiple of the cache
+    // line size, so every block is as well.
+    static const int c_log2ArenaAlignment = 6;
+
+
+    std::unique_ptr<ISliceBufferAllocator>
+        Factories::CreateElasticSliceBufferAllocator(size_t blockSize,
+                                                     size_t arenaBlockCount,
+                                                     size_t maxBlockCount)
+    {
+        return std::unique_ptr<ISliceBufferAllocator>(
+            new ElasticSliceBufferAllocator(blockSize,
+                                            arenaBlockCount,
+                                            maxBlockCount));
+    }
+
+
+    //*************************************************************************
+    //
+    // ElasticSliceBufferAllocator::Arena
+    //
+    //*************************************************************************
+    ElasticSliceBufferAllocator::Arena::Arena(size_t blockSize,
+                                              size_t blockCount)
+        : m_buffer(new AlignedBuffer(blockSize * blockCount,
+                                     c_log2ArenaAlignment)),
+          m_blockCount(blockCount)
+    {
+        // Push in reverse so that blocks are handed out in address order.
+        m_freeBlocks.reserve(blockCount);
+        for (size_t i = blockCount; i > 0; --i)
+        {
+            m_freeBlocks.push_back(GetStart() + (i - 1) * blockSize);
+        }
+    }
+
+
+    ElasticSliceBufferAllocator::Arena::~Arena()
+    {
+    }
+
+
+    char* ElasticSliceBufferAllocator::Arena::GetStart() const
+    {
+        return static_cast<char*>(m_buffer->GetBuffer());
+    }
+
+
+    size_t ElasticSliceBufferAllocator::Arena::GetBlockCount() const
+    {
+        return m_blockCount;
+    }
+
+
+    std::vector<char*>& ElasticSliceBufferAllocator::Arena::GetFreeBlocks()
+    {
+        return m_freeBlocks;
+    }
+
+
+    void ElasticSliceBufferAllocator::Arena::Discard()
+    {
+        m_buffer->Discard();
+    }
+
+
+    //*************************************************************************
+    //
+    // ElasticSliceBufferAllocator
+    //
+    //*************************************************************************
+    ElasticSliceBufferAllocator::ElasticSliceBufferAllocator(size_t blockSize,
+                                                             size_t arenaBlockCount,
+                                                             size_t maxBlockCount)
+        : m_blockSize(RoundUp<size_t>(blockSize, c_bytesPerCacheLine)),
+          m_arenaBlockCount(arenaBlockCount),
+          m_maxBlockCount(maxBlockCount),
+          m_reservedBlockCount(0),
+          m_usedBlockCount(0),
+          m_peakUsedBlockCount(0)
+    {
+        CHECK_GT(arenaBlockCount, 0u)
+            << "arenaBlockCount must be positive.";
+    }
+
+
+    ElasticSliceBufferAllocator::~ElasticSliceBufferAllocator()
+    {
+    }
+
+
+    void* ElasticSliceBufferAllocator::Allocate(size_t byteSize)
+    {
+        LogAssertB(m_blockSize == byteSize,
+                   "Allocate byteSize != block size.");
+
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        Arena* arena = nullptr;
+        for (auto & entry : m_arenas)
+        {
+            const size_t freeCount = entry.second->GetFreeBlocks().size();
+            if (freeCount > 0 &&
+                (arena == nullptr || freeCount < arena->GetFreeBlocks().size()))
+            {
+                arena = entry.second.get();
+            }
+        }
+
+        if (arena == nullptr)
+        {
+            size_t blockCount = m_arenaBlockCount;
+            if (m_maxBlockCount != 0)
+            {
+                if (m_reservedBlockCount >= m_maxBlockCount)
+                {
+                    FatalError error("ElasticSliceBufferAllocator: high-water mark reached.");
+                    throw error;
+                }
+                blockCount = (std::min)(blockCount,
+                                        m_maxBlockCount - m_reservedBlockCount);
+            }
+
+            std::unique_ptr<Arena> newArena(new Arena(m_blockSize, blockCount));
+            arena = newArena.get();
+            m_arenas[arena->GetStart()] = std::move(newArena);
+            m_reservedBlockCount += blockCount;
+        }
+
+        char* block = arena->GetFreeBlocks().back();
+        arena->GetFreeBlocks().pop_back();
+
+        ++m_usedBlockCount;
+        m_peakUsedBlockCount = (std::max)(m_peakUsedBlockCount, m_usedBlockCount);
+
+        return block;
+    }
+
+
+    void* ElasticSliceBufferAllocator::Allocate(size_t byteSize,
+                                                ShardId /*shard*/)
+    {
+        return Allocate(byteSize);
+    }
+
+
+    void ElasticSliceBufferAllocator::Release(void* buffer)
+    {
+        char* block = static_cast<char*>(buffer);
+
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        // Find the last arena that starts at or before the block.
+        auto it = m_arenas.upper_bound(block);
+        if (it == m_arenas.begin())
+        {
+            RecoverableError
+                error("ElasticSliceBufferAllocator::Release: buffer not from this allocator.");
+            throw error;
+        }
+        --it;
+
+        Arena& arena = *it->second;
+        const size_t offset = static_cast<size_t>(block - arena.GetStart());
+        if (offset >= arena.GetBlockCount() * m_blockSize ||
+            offset % m_blockSize != 0)
+        {
+            RecoverableError
+                error("ElasticSliceBufferAllocator::Release: buffer not from this allocator.");
+            throw error;
+        }
+
+        arena.GetFreeBlocks().push_back(block);
+        --m_usedBlockCount;
+
+        if (arena.GetFreeBlocks().size() == arena.GetBlockCount())
+        {
+            const size_t otherFreeBlocks =
+                m_reservedBlockCount - m_usedBlockCount - arena.GetBlockCount();
+            if (otherFreeBlocks > 0)
+            {
+                m_reservedBlockCount -= arena.GetBlockCount();
+                m_arenas.erase(it);
+            }
+            else
+            {
+                arena.Discard();
+            }
+        }
+    }
+
+
+    size_t ElasticSliceBufferAllocator::GetSliceBufferSize() const
+    {
+        return m_blockSize;
+    }
+
+
+    size_t ElasticSliceBufferAllocator::GetUsedCapacityInBytes() const
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_usedBlockCount * m_blockSize;
+    }
+
+
+    size_t ElasticSliceBufferAllocator::GetReservedCapacityInBytes() const
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_reservedBlockCount * m_blockSize;
+    }
+
+
+    size_t ElasticSliceBufferAllocator::GetPeakUsedCapacityInBytes() const
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_peakUsedBlockCount * m_blockSize;
+    }
+
+
+    size_t ElasticSliceBufferAllocator::GetArenaCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_arenas.size();
+    }
+}
@@ -0,0 +1,129 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+#include <vector>
+
+#include "BitFunnel/Index/ISliceBufferAllocator.h"
+#include "BitFunnel/NonCopyable.h"
+
+
+namespace BitFunnel
+{
+    class AlignedBuffer;
+
+    //*************************************************************************
+    //
+    // Implementation of the ISliceBufferAllocator which grows on demand. Blocks
+    // are carved out of arenas of arenaBlockCount blocks. A new arena is
+    // mapped when all existing arenas are full, up to a high-water mark of
+    // maxBlockCount blocks. Allocate throws once the high-water mark is
+    // reached.
+    //
+    // When every block in an arena has been released, the arena is unmapped
+    // if other arenas still have free blocks. Otherwise it is kept as a
+    // spare, but its pages are handed back to the operating system, so that
+    // a workload which hovers around an arena boundary doesn't map and unmap
+    // arenas over and over.
+    //
+    // Allocate prefers the fullest arena with a free block, so that lightly
+    // used arenas drain and can be released.
+    //
+    // Allocate method expects only a well-known value of the buffer size,
+    // otherwise it throws.
+    //
+    // This class is thread safe. Slice buffers are allocated and released
+    // rarely, so a single lock protects all arenas.
+    //
+    //*************************************************************************
+    class ElasticSliceBufferAllocator : public ISliceBufferAllocator, NonCopyable
+    {
+    public:
+        // Creates an allocator for blocks of blockSize bytes. Requested
+        // blockSize is rounded up to the next multiple of the cache line
+        // size. A maxBlockCount of zero means there is no high-water mark.
+        ElasticSliceBufferAllocator(size_t blockSize,
+                                    size_t arenaBlockCount,
+                                    size_t maxBlockCount);
+
+        ~ElasticSliceBufferAllocator();
+
+        //
+        // ISliceBufferAllocator API.
+        //
+        virtual void* Allocate(size_t byteSize) override;
+        virtual void* Allocate(size_t byteSize, ShardId shard) override;
+        virtual void Release(void* buffer) override;
+        virtual size_t GetSliceBufferSize() const override;
+
+        // Returns the number of bytes in blocks that are currently allocated.
+        size_t GetUsedCapacityInBytes() const;
+
+        // Returns the number of bytes in all arenas that are currently mapped,
+        // including free blocks.
+        size_t GetReservedCapacityInBytes() const;
+
+        // Returns the largest value GetUsedCapacityInBytes() has reached.
+        size_t GetPeakUsedCapacityInBytes() const;
+
+        size_t GetArenaCount() const;
+
+    private:
+        class Arena : NonCopyable
+        {
+        public:
+            Arena(size_t blockSize, size_t blockCount);
+            ~Arena();
+
+            char* GetStart() const;
+            size_t GetBlockCount() const;
+
+            std::vector<char*>& GetFreeBlocks();
+
+            void Discard();
+
+        private:
+            std::unique_ptr<AlignedBuffer> m_buffer;
+            const size_t m_blockCount;
+            std::vector<char*> m_freeBlocks;
+        };
+
+        const size_t m_blockSize;
+        const size_t m_arenaBlockCount;
+        const size_t m_maxBlockCount;
+
+        mutable std::mutex m_lock;
+
+        // Arenas, keyed by the address of their first block so that Release
+        // can find the arena that owns a buffer.
+        std::map<char const *, std::unique_ptr<Arena>> m_arenas;
+
+        size_t m_reservedBlockCount;
+        size_t m_usedBlockCount;
+        size_t m_peakUsedBlockCount;
+    };
+}
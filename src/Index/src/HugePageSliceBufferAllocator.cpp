@@ -0,0 +1,140 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <stdint.h>
+
+#include "BitFunnel/BitFunnelTypes.h"
+#include "BitFunnel/Exceptions.h"
+#include "BitFunnel/Index/Factories.h"
+#include "BitFunnel/Utilities/Factories.h"
+#include "HugePageSliceBufferAllocator.h"
+#include "LoggerInterfaces/Logging.h"
+#include "Rounding.h"
+
+namespace BitFunnel
+{
+    std::unique_ptr<ISliceBufferAllocator>
+        Factories::CreateSliceBufferAllocator(size_t blockSize,
+                                              size_t blockCount,
+                                              size_t hugePageSize,
+                                              std::vector<int> const & shardNumaNodes)
+    {
+        return std::unique_ptr<ISliceBufferAllocator>(
+            new HugePageSliceBufferAllocator(blockSize,
+                                             blockCount,
+                                             hugePageSize,
+                                             shardNumaNodes));
+    }
+
+
+    HugePageSliceBufferAllocator::HugePageSliceBufferAllocator(
+        size_t blockSize,
+        size_t blockCount,
+        size_t hugePageSize,
+        std::vector<int> const & shardNumaNodes)
+    {
+        // The pools are page aligned, so rounding the block size keeps every
+        // block, and the rows within it, aligned to cache lines.
+        blockSize = RoundUp<size_t>(blockSize, c_bytesPerCacheLine);
+
+        if (shardNumaNodes.empty())
+        {
+            m_pools.push_back(Factories::CreateBlockAllocator(blockSize,
+                                                              blockCount,
+                                                              0,
+                                                              hugePageSize,
+                                                              -1));
+            return;
+        }
+
+        std::vector<int> poolNodes;
+        for (int node : shardNumaNodes)
+        {
+            size_t pool = 0;
+            while (pool < poolNodes.size() && poolNodes[pool] != node)
+            {
+                ++pool;
+            }
+
+            if (pool == poolNodes.size())
+            {
+                poolNodes.push_back(node);
+                m_pools.push_back(Factories::CreateBlockAllocator(blockSize,
+                                                                  blockCount,
+                                                                  0,
+                                                                  hugePageSize,
+                                                                  node));
+            }
+
+            m_shardPools.push_back(pool);
+        }
+    }
+
+
+    void* HugePageSliceBufferAllocator::Allocate(size_t byteSize)
+    {
+        return Allocate(byteSize, 0);
+    }
+
+
+    void* HugePageSliceBufferAllocator::Allocate(size_t byteSize, ShardId shard)
+    {
+        size_t pool = 0;
+        if (!m_shardPools.empty())
+        {
+            LogAssertB(shard < m_shardPools.size(),
+                       "Allocate shard has no NUMA node.");
+            pool = m_shardPools[shard];
+        }
+
+        IBlockAllocator& blocks = *m_pools[pool];
+
+        LogAssertB(blocks.GetBlockSize() == byteSize,
+                   "Allocate byteSize != block size.");
+
+        return blocks.AllocateBlock();
+    }
+
+
+    void HugePageSliceBufferAllocator::Release(void* buffer)
+    {
+        uint64_t* block = reinterpret_cast<uint64_t*>(buffer);
+        for (auto & pool : m_pools)
+        {
+            if (pool->Contains(block))
+            {
+                pool->ReleaseBlock(block);
+                return;
+            }
+        }
+
+        RecoverableError
+            error("HugePageSliceBufferAllocator::Release: buffer not from this allocator.");
+        throw error;
+    }
+
+
+    size_t HugePageSliceBufferAllocator::GetSliceBufferSize() const
+    {
+        return m_pools.front()->GetBlockSize();
+    }
+}
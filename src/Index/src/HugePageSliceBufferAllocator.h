@@ -0,0 +1,86 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <memory>
+#include <stddef.h>
+#include <vector>
+
+#include "BitFunnel/Index/ISliceBufferAllocator.h"
+#include "BitFunnel/NonCopyable.h"
+#include "BitFunnel/Utilities/IBlockAllocator.h"
+
+
+namespace BitFunnel
+{
+    //*************************************************************************
+    //
+    // Implementation of the ISliceBufferAllocator which keeps one pool of
+    // fixed size blocks per NUMA node. Each pool is backed by huge pages when
+    // the operating system has them available, which reduces the TLB misses
+    // incurred by the matcher when it scans rows spread across many slices.
+    //
+    // Shards are assigned to NUMA nodes by the shardNumaNodes vector passed
+    // to the constructor, which has one entry per shard. Shard i uses the
+    // pool for node shardNumaNodes[i], and allocating for a shard without an
+    // entry throws. A node of -1 uses the default memory policy.
+    // Allocate(byteSize), which doesn't name a shard, uses the pool of
+    // shard 0.
+    //
+    // Allocate method expects only a well-known value of the buffer size,
+    // otherwise it throws.
+    //
+    // This class is thread safe.
+    //
+    //*************************************************************************
+    class HugePageSliceBufferAllocator : public ISliceBufferAllocator, NonCopyable
+    {
+    public:
+        // Creates an allocator with blockCount blocks of blockSize bytes for
+        // each distinct NUMA node in shardNumaNodes. hugePageSize is the size
+        // of the huge pages to request, e.g. 2MB. Requested blockSize is
+        // rounded up to the next multiple of the cache line size. An empty
+        // shardNumaNodes creates a single pool with the default memory
+        // policy which is shared by every shard.
+        HugePageSliceBufferAllocator(size_t blockSize,
+                                     size_t blockCount,
+                                     size_t hugePageSize,
+                                     std::vector<int> const & shardNumaNodes);
+
+        //
+        // ISliceBufferAllocator API.
+        //
+        virtual void* Allocate(size_t byteSize) override;
+        virtual void* Allocate(size_t byteSize, ShardId shard) override;
+        virtual void Release(void* buffer) override;
+        virtual size_t GetSliceBufferSize() const override;
+
+    private:
+        // One block allocator per distinct NUMA node.
+        std::vector<std::unique_ptr<IBlockAllocator>> m_pools;
+
+        // Index into m_pools for each entry of shardNumaNodes. Empty if all
+        // shards share m_pools[0].
+        std::vector<size_t> m_shardPools;
+    };
+}
@@ -0,0 +1,93 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <thread>
+
+#include "IndexSnapshot.h"
+#include "Shard.h"
+
+
+namespace BitFunnel
+{
+    IndexSnapshot::IndexSnapshot(std::vector<std::unique_ptr<Shard>> const & shards)
+      : m_versions(shards.size()),
+        m_sliceBuffers(shards.size())
+    {
+        for (;;)
+        {
+            bool isStable = true;
+            for (size_t i = 0; i < shards.size(); ++i)
+            {
+                m_versions[i] = shards[i]->GetSliceListVersion();
+
+                // An odd version means the list is being replaced.
+                if ((m_versions[i] & 1) != 0)
+                {
+                    isStable = false;
+                    break;
+                }
+            }
+
+            if (isStable)
+            {
+                for (size_t i = 0; i < shards.size(); ++i)
+                {
+                    m_sliceBuffers[i] = &shards[i]->GetSliceBuffers();
+                }
+
+                if (IsCurrent(shards))
+                {
+                    return;
+                }
+            }
+
+            // A Shard is adding or removing a Slice. This is rare and quick,
+            // so wait for it instead of blocking it.
+            std::this_thread::yield();
+        }
+    }
+
+
+    bool IndexSnapshot::IsCurrent(std::vector<std::unique_ptr<Shard>> const & shards) const
+    {
+        for (size_t i = 0; i < shards.size(); ++i)
+        {
+            if (shards[i]->GetSliceListVersion() != m_versions[i])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+
+    size_t IndexSnapshot::GetShardCount() const
+    {
+        return m_sliceBuffers.size();
+    }
+
+
+    std::vector<void*> const & IndexSnapshot::GetSliceBuffers(ShardId shard) const
+    {
+        return *m_sliceBuffers.at(shard);
+    }
+}
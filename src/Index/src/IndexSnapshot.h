@@ -0,0 +1,75 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <memory>                           // std::unique_ptr parameter.
+#include <stdint.h>                         // uint64_t embedded.
+#include <vector>                           // std::vector embedded.
+
+#include "BitFunnel/Index/IIndexSnapshot.h" // Base class.
+#include "BitFunnel/NonCopyable.h"          // Base class.
+
+
+namespace BitFunnel
+{
+    class Shard;
+
+    //*************************************************************************
+    //
+    // IndexSnapshot implements IIndexSnapshot over the lists of slice buffers
+    // which the Shards swap in whenever they add or remove a Slice. It holds
+    // pointers to those lists rather than copies, so building a snapshot
+    // costs a few atomic loads per Shard.
+    //
+    // The lists are read between two readings of each Shard's slice list
+    // version. If no version changed in between, all of the lists were
+    // current at the moment the last of them was read. The lists are owned
+    // by the Shards, which recycle them once the Tokens held while they were
+    // current have been released.
+    //
+    //*************************************************************************
+    class IndexSnapshot : public IIndexSnapshot, NonCopyable
+    {
+    public:
+        // Reads a consistent snapshot of the shards' slice buffer lists.
+        // Must be called while holding a Token.
+        IndexSnapshot(std::vector<std::unique_ptr<Shard>> const & shards);
+
+        // Returns true if none of the shards has replaced its list since the
+        // snapshot was taken. A snapshot which is current when checked while
+        // holding a Token is valid for the lifetime of that Token.
+        bool IsCurrent(
+            std::vector<std::unique_ptr<Shard>> const & shards) const;
+
+        //
+        // IIndexSnapshot API.
+        //
+        virtual size_t GetShardCount() const override;
+        virtual std::vector<void*> const &
+            GetSliceBuffers(ShardId shard) const override;
+
+    private:
+        std::vector<uint64_t> m_versions;
+        std::vector<std::vector<void*> const *> m_sliceBuffers;
+    };
+}
@@ -20,6 +20,8 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
+#include <chrono>
+#include <exception>
 #include <iostream>     // TODO: Remove this temporary header.
 #include <memory>
 
@@ -36,6 +38,8 @@
 #include "DocumentHandleInternal.h"
 #include "Ingestor.h"
 #include "LoggerInterfaces/Logging.h"
+#include "PostingBuffer.h"
+#include "Recycler.h"
 #include "TermToText.h"
 
 
@@ -65,9 +69,13 @@ namespace BitFunnel
           m_shardDefinition(shardDefinition),
           m_documentCount(0),   // TODO: This member is now redundant (with m_documentMap).
           m_totalSourceByteSize(0),
-          m_documentMap(new DocumentMap()),
+          m_tokenManager(Factories::CreateEpochTokenManager()),
+          m_documentMap(new DocumentMap(recycler, *m_tokenManager)),
           m_documentCache(new DocumentCache()),
-          m_tokenManager(Factories::CreateTokenManager()),
+          m_snapshot(nullptr),
+          m_isShutdown(false),
+          m_groupId(c_noGroupId),
+          m_nextGroupId(0),
           m_sliceBufferAllocator(sliceBufferAllocator)
     {
         // Create shards based on shard definition in m_shardDefinition..
@@ -83,12 +91,16 @@ namespace BitFunnel
                               m_sliceBufferAllocator,
                               m_sliceBufferAllocator.GetSliceBufferSize())));
         }
+        m_postingBuffers.resize(m_shards.size());
+
+        m_snapshot = new IndexSnapshot(m_shards);
     }
 
 
     Ingestor::~Ingestor()
     {
         Shutdown();
+        delete m_snapshot.load();
     }
 
 
@@ -146,6 +158,33 @@ namespace BitFunnel
     }
 
 
+    void Ingestor::WriteSnapshot(IFileManager & fileManager) const
+    {
+        const Token token = m_tokenManager->RequestToken();
+
+        for (auto const & shard : m_shards)
+        {
+            shard->WriteSnapshot(fileManager);
+        }
+    }
+
+
+    void Ingestor::LoadSnapshot(IFileManager & fileManager)
+    {
+        std::vector<DocumentHandleInternal> documents;
+        for (auto const & shard : m_shards)
+        {
+            shard->LoadSnapshot(fileManager, documents);
+        }
+
+        for (auto const & handle : documents)
+        {
+            m_documentMap->Add(handle);
+            ++m_documentCount;
+        }
+    }
+
+
     IDocumentCache & Ingestor::GetDocumentCache() const
     {
         return *m_documentCache;
@@ -205,6 +244,141 @@ namespace BitFunnel
     }
 
 
+    void Ingestor::AddBatch(
+        std::vector<std::pair<DocId, IDocument const *>> const & documents)
+    {
+        // Group the documents by Shard.
+        std::vector<std::vector<size_t>> positions(m_shards.size());
+        for (size_t i = 0; i < documents.size(); ++i)
+        {
+            IDocument const & document = *documents[i].second;
+
+            ++m_documentCount;
+            m_totalSourceByteSize += document.GetSourceByteSize();
+            m_histogram.AddDocument(document.GetPostingCount());
+
+            positions[m_shardDefinition.GetShard(document.GetPostingCount())].push_back(i);
+        }
+
+        // Ingest every document before any of them is published.
+        std::vector<std::vector<DocumentHandleInternal>> handles(m_shards.size());
+        try
+        {
+            for (ShardId shard = 0; shard < m_shards.size(); ++shard)
+            {
+                std::vector<DocId> ids;
+                ids.reserve(positions[shard].size());
+                for (size_t position : positions[shard])
+                {
+                    ids.push_back(documents[position].first);
+                }
+
+                if (ids.empty())
+                {
+                    continue;
+                }
+
+                handles[shard] = m_shards[shard]->AllocateDocuments(ids);
+
+                // Postings are staged a block of columns at a time and
+                // written to each row with one operation per block. If a
+                // document throws, the buffer is discarded along with its
+                // unflushed postings rather than returned to the pool.
+                std::unique_ptr<PostingBuffer> postings =
+                    AcquirePostingBuffer(shard);
+                for (size_t i = 0; i < ids.size(); ++i)
+                {
+                    DocumentHandleInternal handle(handles[shard][i]);
+                    handle.SetPostingBuffer(postings.get());
+                    documents[positions[shard][i]].second->Ingest(handle);
+                }
+                postings->Flush();
+                ReleasePostingBuffer(shard, std::move(postings));
+            }
+        }
+        catch (...)
+        {
+            for (ShardId shard = 0; shard < m_shards.size(); ++shard)
+            {
+                m_shards[shard]->AbandonDocuments(handles[shard]);
+            }
+            throw;
+        }
+
+        for (ShardId shard = 0; shard < m_shards.size(); ++shard)
+        {
+            m_shards[shard]->PublishDocuments(handles[shard]);
+        }
+
+        // As in Add(), a document which cannot be added to the DocumentMap
+        // is expired. The first such error is rethrown once the rest of the
+        // batch has been added.
+        std::exception_ptr error;
+        for (auto const & shardHandles : handles)
+        {
+            for (auto handle : shardHandles)
+            {
+                try
+                {
+                    m_documentMap->Add(handle);
+                }
+                catch (...)
+                {
+                    if (!error)
+                    {
+                        error = std::current_exception();
+                    }
+
+                    try
+                    {
+                        handle.Expire();
+                    }
+                    catch (...)
+                    {
+                        LogB(Logging::Error,
+                             "Ingestor::AddBatch",
+                             "Error while cleaning up after AddDocument operation failed.",
+                             "");
+                    }
+                }
+            }
+        }
+
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+
+    std::unique_ptr<PostingBuffer> Ingestor::AcquirePostingBuffer(ShardId shard)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_postingBufferLock);
+            auto & buffers = m_postingBuffers[shard];
+            if (!buffers.empty())
+            {
+                std::unique_ptr<PostingBuffer> buffer = std::move(buffers.back());
+                buffers.pop_back();
+                return buffer;
+            }
+        }
+
+        // Construct outside of the lock since the buffer is sized by the
+        // Shard's row counts.
+        return std::unique_ptr<PostingBuffer>(
+            new PostingBuffer(*m_shards[shard]));
+    }
+
+
+    void Ingestor::ReleasePostingBuffer(ShardId shard,
+                                        std::unique_ptr<PostingBuffer> buffer)
+    {
+        std::lock_guard<std::mutex> lock(m_postingBufferLock);
+        m_postingBuffers[shard].push_back(std::move(buffer));
+    }
+
+
     IRecycler& Ingestor::GetRecycler() const
     {
         return m_recycler;
@@ -229,6 +403,36 @@ namespace BitFunnel
     }
 
 
+    IIndexSnapshot const & Ingestor::GetSnapshot() const
+    {
+        for (;;)
+        {
+            IndexSnapshot* snapshot = m_snapshot;
+            if (snapshot->IsCurrent(m_shards))
+            {
+                return *snapshot;
+            }
+
+            std::unique_ptr<IndexSnapshot> newSnapshot(new IndexSnapshot(m_shards));
+            if (m_snapshot.compare_exchange_strong(snapshot, newSnapshot.get()))
+            {
+                // Queries which loaded the old snapshot hold Tokens issued
+                // before the exchange.
+                std::unique_ptr<IRecyclable>
+                    recyclableSnapshot(new DeferredIndexSnapshotDelete(snapshot,
+                                                                       *m_tokenManager));
+                m_recycler.ScheduleRecyling(recyclableSnapshot);
+
+                return *newSnapshot.release();
+            }
+
+            // Another thread published a snapshot first. It may have been
+            // taken before this thread's Token was issued, so it is only
+            // used if it is still current.
+        }
+    }
+
+
     bool Ingestor::Delete(DocId id)
     {
         const Token token = m_tokenManager->RequestToken();
@@ -257,6 +461,87 @@ namespace BitFunnel
     }
 
 
+    size_t Ingestor::Compact(double minExpiredRatio)
+    {
+        // The Token keeps the Slices returned by GetSlicesToCompact() alive,
+        // even if they are recycled during compaction.
+        const Token token = m_tokenManager->RequestToken();
+
+        size_t compactedCount = 0;
+        for (auto const & shard : m_shards)
+        {
+            for (Slice* slice : shard->GetSlicesToCompact(minExpiredRatio))
+            {
+                CompactSlice(*shard, *slice);
+                ++compactedCount;
+            }
+        }
+
+        return compactedCount;
+    }
+
+
+    void Ingestor::CompactSlice(Shard& shard, Slice& slice)
+    {
+        // Copy the active documents into new columns without holding the
+        // delete lock. The new columns are not active, so the matcher
+        // ignores them until they are published below.
+        std::vector<DocumentHandleInternal> from;
+        std::vector<DocumentHandleInternal> to;
+        for (DocIndex i = 0; i < shard.GetSliceCapacity(); ++i)
+        {
+            DocumentHandleInternal handle(&slice, i);
+            if (handle.IsActive())
+            {
+                from.push_back(handle);
+                to.push_back(shard.AllocateDocument(handle.GetDocId()));
+            }
+        }
+
+        shard.CopyDocuments(from, to);
+
+        // Publish the copies of documents which were not deleted while they
+        // were being copied. Expiring the last active document in slice
+        // schedules it for recycling.
+        std::lock_guard<std::mutex> lock(m_deleteDocumentLock);
+        for (size_t i = 0; i < from.size(); ++i)
+        {
+            to[i].GetSlice().CommitDocument();
+
+            if (from[i].IsActive())
+            {
+                to[i].ActivateCopy();
+                m_documentMap->Update(to[i]);
+                from[i].Expire();
+            }
+            else
+            {
+                to[i].Expire();
+            }
+        }
+    }
+
+
+    void Ingestor::RunCompactor(double minExpiredRatio, unsigned intervalInMs)
+    {
+        std::unique_lock<std::mutex> lock(m_compactorLock);
+        for (;;)
+        {
+            m_compactorCondition.wait_for(lock,
+                                          std::chrono::milliseconds(intervalInMs),
+                                          [this] { return m_isShutdown; });
+            if (m_isShutdown)
+            {
+                break;
+            }
+
+            // Holding m_compactorLock makes Shutdown() wait for the pass to
+            // finish before it shuts down the TokenManager.
+            Compact(minExpiredRatio);
+        }
+    }
+
+
     void Ingestor::AssertFact(DocId /*id*/, FactHandle /*fact*/, bool /*value*/)
     {
         throw NotImplemented();
@@ -295,7 +580,12 @@ namespace BitFunnel
 
     size_t Ingestor::GetUsedCapacityInBytes() const
     {
-        throw NotImplemented();
+        size_t bytes = 0;
+        for (auto & shard : m_shards)
+        {
+            bytes += shard->GetUsedCapacityInBytes();
+        }
+        return bytes;
     }
 
 
@@ -307,24 +597,119 @@ namespace BitFunnel
 
     void Ingestor::Shutdown()
     {
+        {
+            std::lock_guard<std::mutex> lock(m_compactorLock);
+            m_isShutdown = true;
+        }
+        m_compactorCondition.notify_all();
+
         m_tokenManager->Shutdown();
     }
 
 
-    void Ingestor::OpenGroup(GroupId /*groupId*/)
+    void Ingestor::OpenGroup(GroupId groupId)
     {
-        throw NotImplemented();
+        std::lock_guard<std::mutex> lock(m_groupLock);
+
+        if (groupId == c_noGroupId || groupId < m_nextGroupId)
+        {
+            RecoverableError error("Ingestor::OpenGroup: group id is not available.");
+            throw error;
+        }
+
+        m_groupIds.insert(groupId);
+        m_nextGroupId = groupId + 1;
+        m_groupId = groupId;
+        for (auto const & shard : m_shards)
+        {
+            shard->SetGroup(groupId);
+        }
     }
 
 
     void Ingestor::CloseGroup()
     {
-        throw NotImplemented();
+        std::lock_guard<std::mutex> lock(m_groupLock);
+
+        m_groupId = c_noGroupId;
+        for (auto const & shard : m_shards)
+        {
+            shard->SetGroup(c_noGroupId);
+        }
     }
 
 
-    void Ingestor::ExpireGroup(GroupId /*groupId*/)
+    void Ingestor::ExpireGroup(GroupId groupId)
     {
-        throw NotImplemented();
+        std::lock_guard<std::mutex> lock(m_groupLock);
+
+        if (groupId >= m_nextGroupId)
+        {
+            RecoverableError error("Ingestor::ExpireGroup: unknown group.");
+            throw error;
+        }
+
+        if (m_groupIds.find(groupId) == m_groupIds.end())
+        {
+            // The group was expired before, or its id was skipped.
+            return;
+        }
+
+        if (groupId == m_groupId)
+        {
+            RecoverableError error("Ingestor::ExpireGroup: group is still open.");
+            throw error;
+        }
+
+        // The Token keeps the Slices alive while they are being expired.
+        const Token token = m_tokenManager->RequestToken();
+
+        // The group is closed, so its Slices are sealed and cannot receive
+        // new documents. Check that every document has been committed before
+        // changing anything.
+        std::vector<std::vector<Slice*>> slices;
+        for (auto const & shard : m_shards)
+        {
+            slices.push_back(shard->GetGroupSlices(groupId));
+            for (Slice* slice : slices.back())
+            {
+                if (!slice->IsFull())
+                {
+                    RecoverableError error("Ingestor::ExpireGroup: group has documents which are still being added.");
+                    throw error;
+                }
+            }
+        }
+
+        // Holding the delete lock keeps Delete() and compaction from
+        // expiring columns in these Slices concurrently. Under the lock,
+        // every column which is not expired holds a document in the
+        // DocumentMap.
+        std::lock_guard<std::mutex> deleteLock(m_deleteDocumentLock);
+        size_t documentCount = 0;
+        for (size_t shard = 0; shard < m_shards.size(); ++shard)
+        {
+            for (Slice* slice : slices[shard])
+            {
+                documentCount +=
+                    m_shards[shard]->GetSliceCapacity() - slice->GetExpiredCount();
+            }
+        }
+
+        // Remove the group's documents from the DocumentMap before their
+        // Slices can be recycled.
+        m_documentMap->ExpireGroup(groupId, documentCount);
+
+        for (size_t shard = 0; shard < m_shards.size(); ++shard)
+        {
+            for (Slice* slice : slices[shard])
+            {
+                // Expires the whole Slice in one step and hands it to the
+                // Recycler.
+                m_shards[shard]->ExpireSlice(*slice);
+            }
+        }
+
+        m_groupIds.erase(groupId);
     }
 }
@@ -23,9 +23,12 @@
 #pragma once
 
 #include <atomic>                           // std::atomic member.
+#include <condition_variable>               // std::condition_variable member.
 #include <memory>                           // std::unique_ptr embedded.
 #include <mutex>                            // std::mutex member.
 #include <stddef.h>                         // size_t template parameter.
+#include <unordered_set>                    // std::unordered_set member.
+#include <utility>                          // std::pair parameter.
 #include <vector>                           // std::vector embedded.
 
 #include "BitFunnel/BitFunnelTypes.h"       // DocId parameter.
@@ -35,6 +38,8 @@
 #include "DocumentCache.h"                  // DocumentCache embedded.
 #include "DocumentHistogramBuilder.h"       // Embeds DocumentHistogramBuilder.
 #include "DocumentMap.h"                    // DocumentMap template parameter.
+#include "IndexSnapshot.h"                  // std::atomic template parameter.
+#include "PostingBuffer.h"                  // std::unique_ptr template parameter.
 #include "Shard.h"                          // std::unique_ptr template parameter.
 
 
@@ -74,6 +79,21 @@ namespace BitFunnel
                                      ITermToText const * termToText) const override;
 
 
+        // Writes a snapshot of each Shard's full Slices to locations defined
+        // by the FileManager. Slices which are still being filled are not
+        // written, and their documents must be re-ingested after
+        // LoadSnapshot(). Statistics are not included; use WriteStatistics()
+        // for those.
+        virtual void WriteSnapshot(IFileManager & fileManager) const override;
+
+        // Loads the Slices written by WriteSnapshot() into each Shard and
+        // adds their active documents to the index. The slice buffers are
+        // memory mapped from the files written by WriteSnapshot(). Intended
+        // to be called on an empty index, before any documents are added.
+        // Throws if the snapshot is incompatible with the index's layout.
+        virtual void LoadSnapshot(IFileManager & fileManager) override;
+
+
         // Returns a reference to the IDocument cache. This cache holds ingested
         // IDocuments for use in query verification diagnostics.
         virtual IDocumentCache & GetDocumentCache() const override;
@@ -87,6 +107,17 @@ namespace BitFunnel
         // value.
         virtual void Add(DocId id, IDocument const & document) override;
 
+        // Adds a batch of documents to the index. Equivalent to calling Add()
+        // for each (DocId, IDocument) pair, but allocates columns in runs,
+        // stages postings so that each row is written once per block of 64
+        // documents, avoids interlocked operations in Slices filled by the
+        // batch and makes the documents visible together once all of them
+        // have been ingested. Throws if there is no space for the
+        // documents. If a DocId is already in the index, the rest of the
+        // batch is still added and the error is thrown afterwards.
+        virtual void AddBatch(
+            std::vector<std::pair<DocId, IDocument const *>> const & documents) override;
+
         // Removes a document from serving. The document with the specified id
         // will no longer be returned from the queries. Returns true if the
         // document was successfully removed and false otherwise. False means
@@ -98,6 +129,11 @@ namespace BitFunnel
         // some of which may already have been deleted for other reasons.
         virtual bool Delete(DocId id) override;
 
+        virtual size_t Compact(double minExpiredRatio) override;
+
+        virtual void RunCompactor(double minExpiredRatio,
+                                  unsigned intervalInMs) override;
+
         // Sets or clears a fact about a document with the given DocId. The
         // FactHandle must have been previously registered in the IFactSet,
         // otherwise the function throws.
@@ -132,6 +168,13 @@ namespace BitFunnel
 
         virtual ITokenManager& GetTokenManager() const override;
 
+        // Returns a consistent view of the slice buffers of all Shards. The
+        // caller must hold a Token. The previous snapshot is reused while no
+        // Shard has added or removed a Slice, so that the common case costs
+        // one version check per Shard. Superseded snapshots are deleted by
+        // the Recycler once the Tokens which may refer to them are released.
+        virtual IIndexSnapshot const & GetSnapshot() const override;
+
         // Shuts down the index and releases resources allocated to it.
         virtual void Shutdown() override;
 
@@ -148,15 +191,32 @@ namespace BitFunnel
         //    - All future addition operations are done in this new group.
         //    - The previous group is closed. A closed group cannot be reopened or
         //      modified.
+        // Throws if groupId is c_noGroupId or is not greater than every group
+        // id opened before.
         virtual void OpenGroup(GroupId groupId) override;
 
         // Closes the current group, if any.
         virtual void CloseGroup() override;
 
-        // Expires the group with the given id.
+        // Expires the group with the given id. Its documents are removed from
+        // serving and the Slices which hold them are recycled. Expiring a
+        // group again, or an id which was skipped, has no effect. Throws if
+        // no group with this or a greater id was opened, if the group is
+        // still open, or if it still has documents being added.
         virtual void ExpireGroup(GroupId groupId) override;
 
     private:
+        // Moves the active documents in slice to the Shard's active Slice.
+        // Must be called while holding a Token.
+        void CompactSlice(Shard& shard, Slice& slice);
+
+        // Returns an idle PostingBuffer for the given Shard, creating one if
+        // every buffer is in use by another AddBatch() call. The buffer is
+        // handed back with ReleasePostingBuffer() once it has been flushed.
+        std::unique_ptr<PostingBuffer> AcquirePostingBuffer(ShardId shard);
+        void ReleasePostingBuffer(ShardId shard,
+                                  std::unique_ptr<PostingBuffer> buffer);
+
         IRecycler& m_recycler;
         IShardDefinition const & m_shardDefinition;
 
@@ -169,18 +229,51 @@ namespace BitFunnel
         std::atomic<size_t> m_documentCount;
         std::atomic<size_t> m_totalSourceByteSize;
 
+        // TokenManager which distributes tokens for thread synchronization.
+        // Declared before m_documentMap, which uses it.
+        std::unique_ptr<ITokenManager> m_tokenManager;
+
         std::unique_ptr<DocumentMap> m_documentMap;
 
         std::unique_ptr<DocumentCache> m_documentCache;
 
         std::vector<std::unique_ptr<Shard>> m_shards;
 
-        // TokenManager which distributes tokens for thread synchronization.
-        std::unique_ptr<ITokenManager> m_tokenManager;
+        // Idle PostingBuffers for each Shard. A PostingBuffer holds a
+        // quadword for every row in the Shard, so buffers are reused by
+        // subsequent AddBatch() calls instead of being allocated per batch.
+        // Protected by m_postingBufferLock.
+        std::mutex m_postingBufferLock;
+        std::vector<std::vector<std::unique_ptr<PostingBuffer>>> m_postingBuffers;
+
+        // Most recently published snapshot. Replaced with an interlocked
+        // compare-exchange by GetSnapshot().
+        mutable std::atomic<IndexSnapshot*> m_snapshot;
 
-        // Lock protecting concurrent DeleteDocument operations.
+        // Lock protecting concurrent DeleteDocument operations. Compaction
+        // takes this lock while it moves documents, so that a document is
+        // either deleted before it is moved or after.
         std::mutex m_deleteDocumentLock;
 
+        // Wakes RunCompactor() when Shutdown() is called.
+        std::mutex m_compactorLock;
+        std::condition_variable m_compactorCondition;
+        bool m_isShutdown;
+
+        // Protects the group members below. OpenGroup(), CloseGroup() and
+        // ExpireGroup() are serialized by this lock.
+        std::mutex m_groupLock;
+
+        // Group which is currently open or c_noGroupId.
+        GroupId m_groupId;
+
+        // Groups which have been opened and not yet expired.
+        std::unordered_set<GroupId> m_groupIds;
+
+        // Smallest GroupId which may be opened. GroupIds increase, so that
+        // expired groups can be forgotten while still rejecting their reuse.
+        GroupId m_nextGroupId;
+
 
         DocumentHistogramBuilder m_histogram;
 
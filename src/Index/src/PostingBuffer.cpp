@@ -0,0 +1,98 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "PostingBuffer.h"
+#include "RowTableDescriptor.h"
+#include "Shard.h"
+#include "Slice.h"
+
+
+namespace BitFunnel
+{
+    // The number of columns in a block. All columns in a block share a
+    // quadword in every rank.
+    static const DocIndex c_blockSize = 64;
+
+
+    PostingBuffer::PostingBuffer(Shard const & shard)
+        : m_slice(nullptr),
+          m_block(0),
+          m_bits(c_maxRankValue + 1),
+          m_touchedRows(c_maxRankValue + 1)
+    {
+        for (Rank rank = 0; rank <= c_maxRankValue; ++rank)
+        {
+            m_bits[rank].resize(shard.GetRowTable(rank).GetRowCount(), 0);
+        }
+    }
+
+
+    void PostingBuffer::Add(Slice& slice, DocIndex index, RowId row)
+    {
+        const DocIndex block = index - index % c_blockSize;
+        if (m_slice != &slice || m_block != block)
+        {
+            Flush();
+            m_slice = &slice;
+            m_block = block;
+        }
+
+        uint64_t & bits = m_bits[row.GetRank()][row.GetIndex()];
+        if (bits == 0)
+        {
+            m_touchedRows[row.GetRank()].push_back(row.GetIndex());
+        }
+        bits |= 1ull << (index % c_blockSize);
+    }
+
+
+    void PostingBuffer::Flush()
+    {
+        if (m_slice == nullptr)
+        {
+            return;
+        }
+
+        void* sliceBuffer = m_slice->GetSliceBuffer();
+        const bool isExclusive = m_slice->IsStaged();
+        for (Rank rank = 0; rank <= c_maxRankValue; ++rank)
+        {
+            RowTableDescriptor const & rowTable = m_slice->GetRowTable(rank);
+            for (RowIndex row : m_touchedRows[rank])
+            {
+                uint64_t & bits = m_bits[rank][row];
+                if (isExclusive)
+                {
+                    rowTable.OrBitsExclusive(sliceBuffer, row, m_block, bits);
+                }
+                else
+                {
+                    rowTable.OrBits(sliceBuffer, row, m_block, bits);
+                }
+                bits = 0;
+            }
+            m_touchedRows[rank].clear();
+        }
+
+        m_slice = nullptr;
+    }
+}
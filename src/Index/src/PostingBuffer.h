@@ -0,0 +1,85 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <stdint.h>                     // uint64_t template parameter.
+#include <vector>                       // std::vector member.
+
+#include "BitFunnel/BitFunnelTypes.h"   // DocIndex, Rank, RowIndex parameters.
+#include "BitFunnel/Index/RowId.h"      // RowId parameter.
+#include "BitFunnel/NonCopyable.h"      // Base class.
+
+
+namespace BitFunnel
+{
+    class Shard;
+    class Slice;
+
+    //*************************************************************************
+    //
+    // PostingBuffer stages the postings of a block of documents which are
+    // being ingested by one thread, so that they can be written to the
+    // Slice's rows a quadword at a time instead of one bit at a time.
+    //
+    // A block consists of the columns of one Slice which share a rank 0
+    // quadword, i.e. up to 64 consecutive documents. Since a quadword at rank
+    // r covers 64 << r columns, the columns of a block also share a quadword
+    // in every other rank. For each rank, the buffer keeps one accumulator
+    // per row, along with the list of rows which have been touched, so
+    // staging a posting is a plain OR into thread local memory. When a
+    // posting arrives for another block, or when Flush() is called, each
+    // touched row's accumulator is ORed into the Slice with a single
+    // interlocked operation, or a plain store if the Slice is staged.
+    //
+    // The accumulators hold one quadword per row in the Shard, so a
+    // PostingBuffer is intended to be reused for many documents.
+    //
+    // This class is not thread safe.
+    //
+    //*************************************************************************
+    class PostingBuffer : NonCopyable
+    {
+    public:
+        // Creates a PostingBuffer for documents in Slices of the given Shard.
+        PostingBuffer(Shard const & shard);
+
+        // Stages a posting to the given row for the document in column index
+        // of slice.
+        void Add(Slice& slice, DocIndex index, RowId row);
+
+        // Writes all staged postings to their Slice. Postings which have not
+        // been flushed when the PostingBuffer is destroyed are discarded.
+        void Flush();
+
+    private:
+        // Slice and the first column of the block being staged, or nullptr
+        // if nothing is staged.
+        Slice* m_slice;
+        DocIndex m_block;
+
+        // Per rank accumulators, indexed by RowIndex, and the rows which have
+        // non-zero accumulators.
+        std::vector<std::vector<uint64_t>> m_bits;
+        std::vector<std::vector<RowIndex>> m_touchedRows;
+    };
+}
@@ -23,6 +23,7 @@
 
 #include "BitFunnel/Index/Factories.h"
 #include "BitFunnel/Index/Token.h"
+#include "IndexSnapshot.h"
 #include "LoggerInterfaces/Logging.h"
 #include "Recycler.h"
 #include "Slice.h"
@@ -115,4 +116,24 @@ namespace BitFunnel
 
         delete m_sliceBuffers;
     }
+
+
+    //*************************************************************************
+    //
+    // DeferredIndexSnapshotDelete.
+    //
+    //*************************************************************************
+    DeferredIndexSnapshotDelete::DeferredIndexSnapshotDelete(IndexSnapshot const * snapshot,
+                                                             ITokenManager& tokenManager)
+        : m_snapshot(snapshot),
+          m_tokenTracker(tokenManager.StartTracker())
+    {
+    }
+
+
+    void DeferredIndexSnapshotDelete::Recycle()
+    {
+        m_tokenTracker->WaitForCompletion();
+        delete m_snapshot;
+    }
 }
@@ -28,14 +28,14 @@
 
 #include "BitFunnel/NonCopyable.h"
 #include "BitFunnel/Index/IRecycler.h"
+#include "BitFunnel/Index/Token.h"
 #include "BitFunnel/Utilities/BlockingQueue.h"
 #include "IRecyclable.h"
 
 
 namespace BitFunnel
 {
-    class ITokenManager;
-    class ITokenTracker;
+    class IndexSnapshot;
     class Slice;
 
     // Class which represents a recycling logic which happens after a list of
@@ -81,6 +81,54 @@ namespace BitFunnel
     };
 
 
+    // Deletes an IndexSnapshot which was replaced by a newer one, after the
+    // queries which might still be using it have drained. Started after the
+    // old snapshot has been swapped out by Ingestor::GetSnapshot().
+    class DeferredIndexSnapshotDelete : public IRecyclable
+    {
+    public:
+        DeferredIndexSnapshotDelete(IndexSnapshot const * snapshot,
+                                    ITokenManager& tokenManager);
+
+        //
+        // IRecyclable API.
+        //
+        virtual void Recycle() override;
+
+    private:
+        IndexSnapshot const * m_snapshot;
+        std::shared_ptr<ITokenTracker> m_tokenTracker;
+    };
+
+
+    // Deletes an object which has been swapped out for a replacement, after
+    // the threads which might still be reading it have drained. Used by
+    // DocumentMap for its hash tables and expired group lists.
+    template <typename T>
+    class DeferredDelete : public IRecyclable
+    {
+    public:
+        DeferredDelete(T const * object, ITokenManager& tokenManager)
+          : m_object(object),
+            m_tokenTracker(tokenManager.StartTracker())
+        {
+        }
+
+        //
+        // IRecyclable API.
+        //
+        virtual void Recycle() override
+        {
+            m_tokenTracker->WaitForCompletion();
+            delete m_object;
+        }
+
+    private:
+        T const * m_object;
+        std::shared_ptr<ITokenTracker> m_tokenTracker;
+    };
+
+
     //*************************************************************************
     //
     // Class which implements a list of IRecyclable instances which have been
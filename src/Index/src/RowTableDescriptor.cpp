@@ -20,6 +20,7 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
+#include <algorithm>
 #include <cstring>
 
 #include "BitFunnel/Index/ITermTable.h"
@@ -105,6 +106,9 @@ namespace BitFunnel
             // Fill up the match-all row with all ones.
             uint64_t * rowData = GetRowData(sliceBuffer, row.GetIndex());
             memset(rowData, 0xFF, m_bytesPerRow);
+
+            uint64_t * summary = GetSummaryData(sliceBuffer);
+            summary[row.GetIndex() >> 6] |= 1ull << (row.GetIndex() & 0x3F);
         }
     }
 
@@ -154,6 +158,123 @@ namespace BitFunnel
         // uint64_t newVal = *(row + offset) | bitMask;
         // *(row + offset) = newVal;
 #endif
+
+        // Mark the row as non-empty. The summary bit is almost always set
+        // already, so test it first to avoid a locked write to a shared
+        // cache line on every posting.
+        uint64_t* const summary = GetSummaryData(sliceBuffer) + (rowIndex >> 6);
+        uint64_t summaryPos = rowIndex & 0x3F;
+        if ((*summary & (1ull << summaryPos)) == 0)
+        {
+#ifdef _MSC_VER
+            _interlockedbittestandset64(reinterpret_cast<long long *>(summary), summaryPos);
+#else
+            asm("lock btsq %1, %0" : "+m" (*summary) : "r" (summaryPos));
+#endif
+        }
+    }
+
+
+    void RowTableDescriptor::SetBitExclusive(void* sliceBuffer,
+                                             RowIndex rowIndex,
+                                             DocIndex docIndex) const
+    {
+        CHECK_LT(rowIndex, m_rowCount)
+            << "rowIndex out of range.";
+        uint64_t* const row = GetRowData(sliceBuffer, rowIndex);
+        row[QwordPositionFromDocIndex(docIndex)] |= 1ull << (docIndex & 0x3F);
+
+        GetSummaryData(sliceBuffer)[rowIndex >> 6] |= 1ull << (rowIndex & 0x3F);
+    }
+
+
+    void RowTableDescriptor::SetBits(void* sliceBuffer,
+                                     RowIndex rowIndex,
+                                     DocIndex first,
+                                     DocIndex count) const
+    {
+        CHECK_LT(rowIndex, m_rowCount)
+            << "rowIndex out of range.";
+        if (count == 0)
+        {
+            return;
+        }
+
+        uint64_t* const row = GetRowData(sliceBuffer, rowIndex);
+        const DocIndex end = first + count;
+        DocIndex docIndex = first;
+        while (docIndex < end)
+        {
+            // Gather the bits of all columns in [docIndex, end) which map to
+            // the same quadword.
+            const size_t offset = QwordPositionFromDocIndex(docIndex);
+            const DocIndex qwordEnd =
+                std::min(end, static_cast<DocIndex>((offset + 1) << (6 + m_rank)));
+            uint64_t bits = 0;
+            for (; docIndex < qwordEnd; ++docIndex)
+            {
+                bits |= 1ull << (docIndex & 0x3F);
+            }
+
+#ifdef _MSC_VER
+            _InterlockedOr64(reinterpret_cast<long long *>(row + offset),
+                             static_cast<long long>(bits));
+#else
+            asm("lock orq %1, %0" : "+m" (*(row + offset)) : "r" (bits));
+#endif
+        }
+
+        uint64_t* const summary = GetSummaryData(sliceBuffer) + (rowIndex >> 6);
+        uint64_t summaryPos = rowIndex & 0x3F;
+#ifdef _MSC_VER
+        _interlockedbittestandset64(reinterpret_cast<long long *>(summary), summaryPos);
+#else
+        asm("lock btsq %1, %0" : "+m" (*summary) : "r" (summaryPos));
+#endif
+    }
+
+
+    void RowTableDescriptor::OrBits(void* sliceBuffer,
+                                    RowIndex rowIndex,
+                                    DocIndex docIndex,
+                                    uint64_t bits) const
+    {
+        CHECK_LT(rowIndex, m_rowCount)
+            << "rowIndex out of range.";
+        uint64_t* const row = GetRowData(sliceBuffer, rowIndex);
+        const size_t offset = QwordPositionFromDocIndex(docIndex);
+
+#ifdef _MSC_VER
+        _InterlockedOr64(reinterpret_cast<long long *>(row + offset),
+                         static_cast<long long>(bits));
+#else
+        asm("lock orq %1, %0" : "+m" (*(row + offset)) : "r" (bits));
+#endif
+
+        uint64_t* const summary = GetSummaryData(sliceBuffer) + (rowIndex >> 6);
+        uint64_t summaryPos = rowIndex & 0x3F;
+        if ((*summary & (1ull << summaryPos)) == 0)
+        {
+#ifdef _MSC_VER
+            _interlockedbittestandset64(reinterpret_cast<long long *>(summary), summaryPos);
+#else
+            asm("lock btsq %1, %0" : "+m" (*summary) : "r" (summaryPos));
+#endif
+        }
+    }
+
+
+    void RowTableDescriptor::OrBitsExclusive(void* sliceBuffer,
+                                             RowIndex rowIndex,
+                                             DocIndex docIndex,
+                                             uint64_t bits) const
+    {
+        CHECK_LT(rowIndex, m_rowCount)
+            << "rowIndex out of range.";
+        uint64_t* const row = GetRowData(sliceBuffer, rowIndex);
+        row[QwordPositionFromDocIndex(docIndex)] |= bits;
+
+        GetSummaryData(sliceBuffer)[rowIndex >> 6] |= 1ull << (rowIndex & 0x3F);
     }
 
 
@@ -177,6 +298,23 @@ namespace BitFunnel
     }
 
 
+    void RowTableDescriptor::ClearRow(void* sliceBuffer,
+                                      RowIndex rowIndex) const
+    {
+        memset(GetRowData(sliceBuffer, rowIndex), 0, m_bytesPerRow);
+    }
+
+
+    bool RowTableDescriptor::IsRowEmpty(void const * sliceBuffer,
+                                        RowIndex rowIndex) const
+    {
+        CHECK_LT(rowIndex, m_rowCount)
+            << "rowIndex out of range.";
+        uint64_t const * summary = GetSummaryData(sliceBuffer);
+        return (summary[rowIndex >> 6] & (1ull << (rowIndex & 0x3F))) == 0;
+    }
+
+
     ptrdiff_t RowTableDescriptor::GetRowOffset(RowIndex rowIndex) const
     {
         // TODO: consider checking for overflow.
@@ -184,6 +322,25 @@ namespace BitFunnel
     }
 
 
+    bool RowTableDescriptor::TryGetRowIndex(ptrdiff_t rowOffset,
+                                            RowIndex & rowIndex) const
+    {
+        if (rowOffset < m_bufferOffset || m_bytesPerRow == 0)
+        {
+            return false;
+        }
+
+        const size_t delta = static_cast<size_t>(rowOffset - m_bufferOffset);
+        if (delta % m_bytesPerRow != 0 || delta / m_bytesPerRow >= m_rowCount)
+        {
+            return false;
+        }
+
+        rowIndex = static_cast<RowIndex>(delta / m_bytesPerRow);
+        return true;
+    }
+
+
     /* static */
     size_t RowTableDescriptor::GetBufferSize(DocIndex capacity,
                                              RowIndex rowCount,
@@ -195,8 +352,12 @@ namespace BitFunnel
         // LogAssertB(capacity == Row::DocumentsInRank0Row(capacity),
         //            "capacity not evenly rounded.");
 
+        // The rows are followed by the summary bit vector, one bit per row,
+        // padded out to a whole number of quadwords.
+        const size_t summaryBytes = ((rowCount + 63) >> 6) * sizeof(uint64_t);
+
         return static_cast<unsigned>(
-            Row::BytesInRow(capacity, rank, maxRank) * rowCount);
+            Row::BytesInRow(capacity, rank, maxRank) * rowCount + summaryBytes);
     }
 
 
@@ -221,6 +382,19 @@ namespace BitFunnel
     }
 
 
+    uint64_t* RowTableDescriptor::GetSummaryData(void* sliceBuffer) const
+    {
+        return GetRowData(sliceBuffer, m_rowCount);
+    }
+
+
+    uint64_t const *
+        RowTableDescriptor::GetSummaryData(void const * sliceBuffer) const
+    {
+        return GetRowData(sliceBuffer, m_rowCount);
+    }
+
+
     size_t RowTableDescriptor::QwordPositionFromDocIndex(DocIndex docIndex) const
     {
         LogAssertB(docIndex < m_capacity, "docIndex out of range");
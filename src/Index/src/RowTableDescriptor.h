@@ -40,10 +40,18 @@ namespace BitFunnel
     // for other RowTable buffers and the DocTable buffer. RowTableDescriptor
     // knows where in the buffer its RowTable starts and what dimensions it has
     // and is able to perform bit operations over that data.
+    //
+    // Following the rows, each RowTable holds a summary bit vector with one
+    // bit per row. SetBit() sets a row's summary bit along with the row bit,
+    // so a clear summary bit guarantees that the row is empty in this slice.
+    // ClearBit() does not update the summary, which therefore may report a
+    // row as non-empty after all of its bits have been cleared.
     // See Slice.h for more info about the layout of the data buffer.
     //
-    // All methods except Initialize are thread safe. Initialize method is not
-    // thread-safe with respect to calling *Bit methods at the same time.
+    // All methods except Initialize and the *Exclusive methods are thread
+    // safe.
+    // Initialize method is not thread-safe with respect to calling *Bit
+    // methods at the same time.
     //
     //*************************************************************************
     class RowTableDescriptor
@@ -85,15 +93,55 @@ namespace BitFunnel
                     RowIndex rowIndex,
                     DocIndex docIndex) const;
 
+        // Sets a bit in the given row and column with plain stores. May only
+        // be used when no other thread writes to the slice buffer, e.g.
+        // while its Slice is staged by a batch.
+        void SetBitExclusive(void* sliceBuffer,
+                             RowIndex rowIndex,
+                             DocIndex docIndex) const;
+
+        // Sets the bits in the given row for the count columns starting at
+        // first. The bits which fall into the same quadword are combined and
+        // set with a single interlocked operation.
+        void SetBits(void* sliceBuffer,
+                     RowIndex rowIndex,
+                     DocIndex first,
+                     DocIndex count) const;
+
+        // ORs bits into the quadword of the given row which holds the column
+        // docIndex. Bit i of bits corresponds to the same bit position as
+        // column i of an aligned block of 64 columns. OrBitsExclusive() uses
+        // plain stores, with the same restrictions as SetBitExclusive().
+        void OrBits(void* sliceBuffer,
+                    RowIndex rowIndex,
+                    DocIndex docIndex,
+                    uint64_t bits) const;
+        void OrBitsExclusive(void* sliceBuffer,
+                             RowIndex rowIndex,
+                             DocIndex docIndex,
+                             uint64_t bits) const;
+
+        // Clears every bit in the given row with plain stores. Other threads
+        // may read the row, but must not write to it.
+        void ClearRow(void* sliceBuffer, RowIndex rowIndex) const;
+
         // Clears a bit in the given row and column.
         void ClearBit(void* sliceBuffer,
                       RowIndex rowIndex,
                       DocIndex docIndex) const;
 
+        // Returns true if no bit has been set in the given row since the
+        // sliceBuffer was initialized.
+        bool IsRowEmpty(void const * sliceBuffer, RowIndex rowIndex) const;
+
         // Returns the offset of a row with the given index, relative to the
         // start of the sliceBuffer.
         ptrdiff_t GetRowOffset(RowIndex rowIndex) const;
 
+        // Returns true if the given sliceBuffer offset is the start of a row
+        // in this RowTable. If so, rowIndex is set to the index of that row.
+        bool TryGetRowIndex(ptrdiff_t rowOffset, RowIndex & rowIndex) const;
+
         // Returns true if the given RowTableDescriptor is data-compatible with
         // this instance. Used when loading Slices from the stream.
         bool IsCompatibleWith(RowTableDescriptor const & other) const;
@@ -123,6 +171,11 @@ namespace BitFunnel
         uint64_t const * GetRowData(void const * sliceBuffer,
                                     RowIndex rowIndex) const;
 
+        // Helper methods to seek to the summary bit vector which follows the
+        // rows.
+        uint64_t* GetSummaryData(void* sliceBuffer) const;
+        uint64_t const * GetSummaryData(void const * sliceBuffer) const;
+
         // Returns the QWORD number for the given DocIndex.
         size_t QwordPositionFromDocIndex(DocIndex docIndex) const;
 
@@ -20,7 +20,12 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
+#include <istream>
+#include <ostream>
+
+#include "BitFunnel/Configuration/IFileSystem.h"
 #include "BitFunnel/Exceptions.h"
+#include "BitFunnel/IFileManager.h"
 #include "BitFunnel/Index/IRecycler.h"
 #include "BitFunnel/Index/ISliceBufferAllocator.h"
 #include "BitFunnel/Index/ITermTable.h"
@@ -28,9 +33,11 @@
 #include "BitFunnel/Index/RowIdSequence.h"
 #include "BitFunnel/Index/Token.h"
 #include "BitFunnel/Term.h"
+#include "BitFunnel/Utilities/StreamUtilities.h"
 #include "IRecyclable.h"
 #include "LoggerInterfaces/Check.h"
 #include "LoggerInterfaces/Logging.h"
+#include "PostingBuffer.h"
 #include "Recycler.h"
 #include "Rounding.h"
 #include "Shard.h"
@@ -38,6 +45,11 @@
 
 namespace BitFunnel
 {
+    // Version of the ShardSnapshot file format. Must be incremented whenever
+    // the format or the slice buffer layout changes.
+    static const uint32_t c_snapshotVersion = 1;
+
+
     // Extracts a RowId used to mark documents as active/soft-deleted.
     static RowId RowIdForActiveDocument(ITermTable const & termTable)
     {
@@ -83,7 +95,9 @@ namespace BitFunnel
           m_sliceBufferAllocator(sliceBufferAllocator),
           m_documentActiveRowId(RowIdForActiveDocument(termTable)),
           m_activeSlice(nullptr),
+          m_groupId(c_noGroupId),
           m_sliceBuffers(new std::vector<void*>()),
+          m_sliceListVersion(0),
           m_sliceCapacity(GetCapacityForByteSize(sliceBufferSize,
                                                  docDataSchema,
                                                  termTable)),
@@ -123,22 +137,205 @@ namespace BitFunnel
     }
 
 
+    // A run of consecutive columns in a Slice, allocated by a batch.
+    struct ColumnRun
+    {
+        Slice* m_slice;
+        DocIndex m_first;
+        size_t m_count;
+        bool m_isStaged;
+    };
+
+
+    static std::vector<ColumnRun>
+        GetColumnRuns(std::vector<DocumentHandleInternal> const & handles)
+    {
+        std::vector<ColumnRun> runs;
+        for (auto const & handle : handles)
+        {
+            Slice* slice = &handle.GetSlice();
+            if (runs.empty() ||
+                runs.back().m_slice != slice ||
+                runs.back().m_first + runs.back().m_count != handle.GetIndex())
+            {
+                runs.push_back({ slice, handle.GetIndex(), 0, slice->IsStaged() });
+            }
+            ++runs.back().m_count;
+        }
+
+        return runs;
+    }
+
+
+    std::vector<DocumentHandleInternal>
+        Shard::AllocateDocuments(std::vector<DocId> const & ids)
+    {
+        std::vector<DocumentHandleInternal> handles;
+        handles.reserve(ids.size());
+
+        try
+        {
+            GroupId groupId;
+            {
+                std::lock_guard<std::mutex> lock(m_slicesLock);
+                groupId = m_groupId;
+            }
+
+            // Whole Slices' worth of documents go to staged Slices, which are
+            // created outside of the lock.
+            const size_t stagedCount = ids.size() - ids.size() % m_sliceCapacity;
+            while (handles.size() < stagedCount)
+            {
+                Slice* slice = new Slice(*this, groupId);
+                slice->SetStaged(true);
+
+                DocIndex first;
+                const size_t count =
+                    slice->TryAllocateDocuments(m_sliceCapacity, first);
+                for (size_t i = 0; i < count; ++i)
+                {
+                    handles.push_back(
+                        DocumentHandleInternal(slice, first + i, ids[handles.size()]));
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(m_slicesLock);
+            while (handles.size() < ids.size())
+            {
+                DocIndex first = 0;
+                const size_t count = (m_activeSlice == nullptr) ? 0 :
+                    m_activeSlice->TryAllocateDocuments(ids.size() - handles.size(),
+                                                        first);
+                if (count == 0)
+                {
+                    CreateNewActiveSlice();
+                }
+
+                for (size_t i = 0; i < count; ++i)
+                {
+                    handles.push_back(
+                        DocumentHandleInternal(m_activeSlice, first + i, ids[handles.size()]));
+                }
+            }
+        }
+        catch (...)
+        {
+            AbandonDocuments(handles);
+            throw;
+        }
+
+        return handles;
+    }
+
+
+    void Shard::PublishDocuments(std::vector<DocumentHandleInternal> const & handles)
+    {
+        RowTableDescriptor const & rowTable =
+            m_rowTables[m_documentActiveRowId.GetRank()];
+        const std::vector<ColumnRun> runs = GetColumnRuns(handles);
+
+        // Staged Slices are activated before they become visible.
+        std::vector<Slice*> stagedSlices;
+        for (auto const & run : runs)
+        {
+            if (run.m_isStaged)
+            {
+                rowTable.SetBits(run.m_slice->GetSliceBuffer(),
+                                 m_documentActiveRowId.GetIndex(),
+                                 run.m_first,
+                                 run.m_count);
+                run.m_slice->CommitDocuments(run.m_count);
+                stagedSlices.push_back(run.m_slice);
+            }
+        }
+
+        for (size_t i = 0; i < handles.size(); ++i)
+        {
+            TemporaryRecordDocument();
+        }
+
+        if (!stagedSlices.empty())
+        {
+            std::lock_guard<std::mutex> lock(m_slicesLock);
+            for (Slice* slice : stagedSlices)
+            {
+                slice->SetStaged(false);
+            }
+            AddSlices(stagedSlices);
+        }
+
+        for (auto const & run : runs)
+        {
+            if (!run.m_isStaged)
+            {
+                rowTable.SetBits(run.m_slice->GetSliceBuffer(),
+                                 m_documentActiveRowId.GetIndex(),
+                                 run.m_first,
+                                 run.m_count);
+                run.m_slice->CommitDocuments(run.m_count);
+            }
+        }
+    }
+
+
+    void Shard::AbandonDocuments(std::vector<DocumentHandleInternal> const & handles)
+    {
+        for (auto const & run : GetColumnRuns(handles))
+        {
+            if (run.m_isStaged)
+            {
+                // Staged Slices were never visible to other threads.
+                delete run.m_slice;
+            }
+            else
+            {
+                run.m_slice->CommitDocuments(run.m_count);
+                for (size_t i = 0; i < run.m_count; ++i)
+                {
+                    if (run.m_slice->ExpireDocument())
+                    {
+                        Slice::DecrementRefCount(run.m_slice);
+                    }
+                }
+            }
+        }
+    }
+
+
     void* Shard::AllocateSliceBuffer()
     {
-        return m_sliceBufferAllocator.Allocate(m_sliceBufferSize);
+        return m_sliceBufferAllocator.Allocate(m_sliceBufferSize, m_shardId);
     }
 
     // Must be called with m_slicesLock held.
     void Shard::CreateNewActiveSlice()
     {
-        Slice* newSlice = new Slice(*this);
+        Slice* newSlice = new Slice(*this, m_groupId);
+        AddSlice(newSlice);
+        m_activeSlice = newSlice;
+    }
+
+
+    // Must be called with m_slicesLock held.
+    void Shard::AddSlice(Slice* slice)
+    {
+        AddSlices(std::vector<Slice*>(1, slice));
+    }
+
 
+    // Must be called with m_slicesLock held.
+    void Shard::AddSlices(std::vector<Slice*> const & slices)
+    {
         std::vector<void*>* oldSlices = m_sliceBuffers;
         std::vector<void*>* const newSlices = new std::vector<void*>(*m_sliceBuffers);
-        newSlices->push_back(newSlice->GetSliceBuffer());
+        for (Slice* slice : slices)
+        {
+            newSlices->push_back(slice->GetSliceBuffer());
+        }
 
+        ++m_sliceListVersion;
         m_sliceBuffers = newSlices;
-        m_activeSlice = newSlice;
+        ++m_sliceListVersion;
 
         // TODO: think if this can be done outside of the lock.
         std::unique_ptr<IRecyclable>
@@ -193,6 +390,22 @@ namespace BitFunnel
     }
 
 
+    bool Shard::IsRowEmpty(void const * sliceBuffer, ptrdiff_t rowOffset) const
+    {
+        for (auto const & rowTable : m_rowTables)
+        {
+            RowIndex rowIndex;
+            if (rowTable.TryGetRowIndex(rowOffset, rowIndex))
+            {
+                return rowTable.IsRowEmpty(sliceBuffer, rowIndex);
+            }
+        }
+
+        RecoverableError error("Shard::IsRowEmpty: rowOffset does not start a row.");
+        throw error;
+    }
+
+
     RowTableDescriptor const & Shard::GetRowTable(Rank rank) const
     {
         return m_rowTables.at(rank);
@@ -205,6 +418,12 @@ namespace BitFunnel
     }
 
 
+    uint64_t Shard::GetSliceListVersion() const
+    {
+        return m_sliceListVersion;
+    }
+
+
     ShardId Shard::GetId() const
     {
         return m_shardId;
@@ -325,7 +544,9 @@ namespace BitFunnel
             }
 
             oldSlices = m_sliceBuffers.load();
+            ++m_sliceListVersion;
             m_sliceBuffers = newSlices;
+            ++m_sliceListVersion;
 
             if (m_activeSlice == &slice)
             {
@@ -346,12 +567,278 @@ namespace BitFunnel
     }
 
 
+    void Shard::SetGroup(GroupId groupId)
+    {
+        Slice* sealedSlice = nullptr;
+
+        {
+            std::lock_guard<std::mutex> lock(m_slicesLock);
+
+            m_groupId = groupId;
+            if (m_activeSlice != nullptr && m_activeSlice->GetGroupId() != groupId)
+            {
+                if (m_activeSlice->Seal())
+                {
+                    // No documents were committed to the Slice.
+                    sealedSlice = m_activeSlice;
+                }
+                m_activeSlice = nullptr;
+            }
+        }
+
+        // Recycling takes m_slicesLock, so it is done outside of the lock.
+        if (sealedSlice != nullptr)
+        {
+            Slice::DecrementRefCount(sealedSlice);
+        }
+    }
+
+
+    std::vector<Slice*> Shard::GetGroupSlices(GroupId groupId) const
+    {
+        std::lock_guard<std::mutex> lock(m_slicesLock);
+
+        std::vector<Slice*> slices;
+        for (auto buffer : *m_sliceBuffers)
+        {
+            Slice* slice = Slice::GetSliceFromBuffer(buffer, GetSlicePtrOffset());
+            if (slice->GetGroupId() == groupId)
+            {
+                slices.push_back(slice);
+            }
+        }
+
+        return slices;
+    }
+
+
+    void Shard::ExpireSlice(Slice& slice)
+    {
+        m_rowTables[m_documentActiveRowId.GetRank()].ClearRow(
+            slice.GetSliceBuffer(),
+            m_documentActiveRowId.GetIndex());
+
+        if (slice.ExpireAllDocuments())
+        {
+            Slice::DecrementRefCount(&slice);
+        }
+    }
+
+
+    std::vector<Slice*> Shard::GetSlicesToCompact(double minExpiredRatio) const
+    {
+        std::lock_guard<std::mutex> lock(m_slicesLock);
+
+        std::vector<Slice*> slices;
+        for (auto buffer : *m_sliceBuffers)
+        {
+            Slice* slice = Slice::GetSliceFromBuffer(buffer, GetSlicePtrOffset());
+            const DocIndex expiredCount = slice->GetExpiredCount();
+            if (slice != m_activeSlice &&
+                slice->GetGroupId() == m_groupId &&
+                slice->IsFull() &&
+                expiredCount > 0 &&
+                expiredCount < m_sliceCapacity &&
+                expiredCount >= minExpiredRatio * m_sliceCapacity)
+            {
+                slices.push_back(slice);
+            }
+        }
+
+        return slices;
+    }
+
+
+    void Shard::CopyDocuments(std::vector<DocumentHandleInternal> const & from,
+                              std::vector<DocumentHandleInternal> const & to) const
+    {
+        LogAssertB(from.size() == to.size(),
+                   "CopyDocuments: from and to sizes differ.");
+        if (from.empty())
+        {
+            return;
+        }
+
+        void* fromBuffer = from.front().GetSlice().GetSliceBuffer();
+        for (size_t i = 0; i < from.size(); ++i)
+        {
+            m_docTable->CopyItem(fromBuffer,
+                                 from[i].GetIndex(),
+                                 to[i].GetSlice().GetSliceBuffer(),
+                                 to[i].GetIndex());
+        }
+
+        // Copy row by row so that each source row is scanned once, and rows
+        // whose summary bit is clear are skipped entirely.
+        for (auto const & rowTable : m_rowTables)
+        {
+            for (RowIndex row = 0; row < rowTable.GetRowCount(); ++row)
+            {
+                if (rowTable.IsRowEmpty(fromBuffer, row) ||
+                    (&rowTable == &m_rowTables[m_documentActiveRowId.GetRank()] &&
+                     row == m_documentActiveRowId.GetIndex()))
+                {
+                    continue;
+                }
+
+                for (size_t i = 0; i < from.size(); ++i)
+                {
+                    if (rowTable.GetBit(fromBuffer, row, from[i].GetIndex()) != 0)
+                    {
+                        rowTable.SetBit(to[i].GetSlice().GetSliceBuffer(),
+                                        row,
+                                        to[i].GetIndex());
+                    }
+                }
+            }
+        }
+    }
+
+
     void Shard::ReleaseSliceBuffer(void* sliceBuffer)
     {
         m_sliceBufferAllocator.Release(sliceBuffer);
     }
 
 
+    void Shard::WriteSnapshot(IFileManager & fileManager) const
+    {
+        // The caller's Token guarantees that neither the list of slice
+        // buffers nor the Slices on it will be recycled while they are
+        // being written.
+        std::vector<void*> const & buffers = *m_sliceBuffers;
+
+        std::vector<void*> fullBuffers;
+        for (auto buffer : buffers)
+        {
+            Slice const * slice =
+                Slice::GetSliceFromBuffer(buffer, GetSlicePtrOffset());
+            if (slice->IsFull() && !slice->IsExpired())
+            {
+                fullBuffers.push_back(buffer);
+            }
+        }
+
+        auto output = fileManager.ShardSnapshot(m_shardId).OpenForWrite();
+        WriteLayout(*output);
+        StreamUtilities::WriteField<uint64_t>(*output, fullBuffers.size());
+
+        for (size_t i = 0; i < fullBuffers.size(); ++i)
+        {
+            Slice const * slice =
+                Slice::GetSliceFromBuffer(fullBuffers[i], GetSlicePtrOffset());
+
+            auto sliceOutput =
+                fileManager.IndexSlice(m_shardId, i).OpenForWrite();
+            slice->Write(*sliceOutput);
+
+            m_docTable->WriteVariableSizeBlobs(fullBuffers[i], *output);
+        }
+    }
+
+
+    void Shard::LoadSnapshot(IFileManager & fileManager,
+                             std::vector<DocumentHandleInternal> & documents)
+    {
+        auto input = fileManager.ShardSnapshot(m_shardId).OpenForRead();
+        ReadLayout(*input);
+
+        const size_t sliceCount =
+            static_cast<size_t>(StreamUtilities::ReadField<uint64_t>(*input));
+
+        for (size_t i = 0; i < sliceCount; ++i)
+        {
+            LoadSlice(fileManager.IndexSlice(m_shardId, i).OpenForMapping(),
+                      *input,
+                      documents);
+        }
+    }
+
+
+    void Shard::LoadSlice(std::unique_ptr<IFileMapping> sliceBuffer,
+                          std::istream& input,
+                          std::vector<DocumentHandleInternal> & documents)
+    {
+        if (sliceBuffer->GetSize() != m_sliceBufferSize)
+        {
+            RecoverableError error("Shard::LoadSlice: slice buffer has the wrong size.");
+            throw error;
+        }
+
+        std::unique_ptr<Slice> slice(new Slice(*this, std::move(sliceBuffer)));
+        m_docTable->LoadVariableSizeBlobs(slice->GetSliceBuffer(), input);
+
+        // Columns which were expired when the snapshot was taken are expired
+        // again so that the Slice is recycled once its remaining documents
+        // are expired.
+        const size_t firstDocument = documents.size();
+        bool isExpired = false;
+        for (DocIndex i = 0; i < m_sliceCapacity; ++i)
+        {
+            DocumentHandleInternal handle(slice.get(), i);
+            if (handle.IsActive())
+            {
+                documents.push_back(handle);
+            }
+            else
+            {
+                isExpired = slice->ExpireDocument();
+            }
+        }
+
+        if (isExpired)
+        {
+            documents.resize(firstDocument);
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(m_slicesLock);
+            AddSlice(slice.release());
+        }
+    }
+
+
+    void Shard::WriteLayout(std::ostream& output) const
+    {
+        StreamUtilities::WriteField<uint32_t>(output, c_snapshotVersion);
+        StreamUtilities::WriteField<uint64_t>(output, m_sliceBufferSize);
+        StreamUtilities::WriteField<uint64_t>(output, m_sliceCapacity);
+
+        for (auto const & rowTable : m_rowTables)
+        {
+            StreamUtilities::WriteField<uint64_t>(output,
+                                                  rowTable.GetRowCount());
+            StreamUtilities::WriteField<int64_t>(output,
+                                                 rowTable.GetRowOffset(0));
+        }
+    }
+
+
+    void Shard::ReadLayout(std::istream& input) const
+    {
+        bool isCompatible =
+            StreamUtilities::ReadField<uint32_t>(input) == c_snapshotVersion;
+        isCompatible &=
+            StreamUtilities::ReadField<uint64_t>(input) == m_sliceBufferSize;
+        isCompatible &=
+            StreamUtilities::ReadField<uint64_t>(input) == m_sliceCapacity;
+
+        for (auto const & rowTable : m_rowTables)
+        {
+            isCompatible &=
+                StreamUtilities::ReadField<uint64_t>(input) == rowTable.GetRowCount();
+            isCompatible &=
+                StreamUtilities::ReadField<int64_t>(input) == rowTable.GetRowOffset(0);
+        }
+
+        if (!isCompatible)
+        {
+            RecoverableError error("Shard::LoadSnapshot: snapshot is not compatible with this shard.");
+            throw error;
+        }
+    }
+
+
     void Shard::AddPosting(Term const & term,
                            DocIndex index,
                            void* sliceBuffer)
@@ -362,13 +849,45 @@ namespace BitFunnel
         }
 
 
+        RowIdSequence rows(term, m_termTable);
+
+        // Only the thread ingesting a batch writes to its staged Slices.
+        if (Slice::GetSliceFromBuffer(sliceBuffer, GetSlicePtrOffset())->IsStaged())
+        {
+            for (auto const row : rows)
+            {
+                m_rowTables[row.GetRank()].SetBitExclusive(sliceBuffer,
+                                                           row.GetIndex(),
+                                                           index);
+            }
+        }
+        else
+        {
+            for (auto const row : rows)
+            {
+                m_rowTables[row.GetRank()].SetBit(sliceBuffer,
+                                                  row.GetIndex(),
+                                                  index);
+            }
+        }
+    }
+
+
+    void Shard::StagePosting(Term const & term,
+                             DocIndex index,
+                             Slice& slice,
+                             PostingBuffer& buffer)
+    {
+        if (m_docFrequencyTableBuilder.get() != nullptr)
+        {
+            m_docFrequencyTableBuilder->OnTerm(term);
+        }
+
         RowIdSequence rows(term, m_termTable);
 
         for (auto const row : rows)
         {
-            m_rowTables[row.GetRank()].SetBit(sliceBuffer,
-                                              row.GetIndex(),
-                                              index);
+            buffer.Add(slice, index, row);
         }
     }
 
@@ -41,11 +41,14 @@
 namespace BitFunnel
 {
     //class IDocumentDataSchema;
+    class IFileManager;
+    class IFileMapping;
     class ISliceBufferAllocator;
     class ITermTable;
     class ITermToText;
     class ITokenManager;
     class IRecycler;
+    class PostingBuffer;
     class Slice;
     class Term;     // TODO: Remove this temporary declaration.
 
@@ -79,6 +82,13 @@ namespace BitFunnel
         virtual ~Shard();
 
         void AddPosting(Term const & term, DocIndex index, void* sliceBuffer);
+
+        // Stages the rows of a posting in buffer rather than setting them in
+        // the slice buffer. See PostingBuffer for details.
+        void StagePosting(Term const & term,
+                          DocIndex index,
+                          Slice& slice,
+                          PostingBuffer& buffer);
         void AssertFact(FactHandle fact, bool value, DocIndex index, void* sliceBuffer);
 
         void TemporaryRecordDocument();
@@ -105,9 +115,23 @@ namespace BitFunnel
         // list of slice buffers, as well as the buffers themselves.
         virtual std::vector<void*> const & GetSliceBuffers() const override;
 
+        // Returns a version number of the list of slice buffers. The version
+        // is odd while the list is being replaced and increases by two with
+        // each replacement, so a list returned by GetSliceBuffers() between
+        // two equal, even readings of the version is the list of that
+        // version.
+        uint64_t GetSliceListVersion() const;
+
         // Returns the offset of the row in the slice buffer in a shard.
         virtual ptrdiff_t GetRowOffset(RowId rowId) const override;
 
+        // Returns true if no bit has been set since the slice was created in
+        // the row that starts at rowOffset in the given slice buffer. A false
+        // return does not guarantee that the row has any bits set, since
+        // clearing bits does not update the summary consulted here.
+        virtual bool IsRowEmpty(void const * sliceBuffer,
+                                ptrdiff_t rowOffset) const override;
+
         virtual void TemporaryWriteDocumentFrequencyTable(
             std::ostream& out,
             ITermToText const * termToText) const override;
@@ -139,20 +163,49 @@ namespace BitFunnel
         //   return DocumentHandleInternal(m_activeSlice, docIndex);
         DocumentHandleInternal AllocateDocument(DocId id);
 
-        // Loads a Slice from a previously serialized state and adds it to the
-        // list of Slices. As part of deserialization, LoadSlice loads
-        // RowTable/DocTable descriptors from the stream and verifies that it is
-        // compatible with the current descriptors. Uses descriptor's
-        // IsCompatibleWith methods for verification, and if not passed, this
-        // function throws.
+        // Allocates storage for a batch of documents and returns a handle for
+        // each of the ids, in order. Whole Slices' worth of documents are
+        // placed in new staged Slices which are not visible until
+        // PublishDocuments() is called. The remaining documents are placed in
+        // contiguous runs of columns in the active Slice, taking the lock
+        // once. Throws if there is no memory available in the
+        // SliceBufferAllocator.
+        std::vector<DocumentHandleInternal>
+            AllocateDocuments(std::vector<DocId> const & ids);
+
+        // Makes a batch of documents returned by AllocateDocuments() visible
+        // to the matcher. The document active bits are set a quadword at a
+        // time, and all staged Slices are added to the list of slices with a
+        // single swap.
+        void PublishDocuments(std::vector<DocumentHandleInternal> const & handles);
+
+        // Releases the storage for a batch of documents returned by
+        // AllocateDocuments() which will not be published. Staged Slices are
+        // destroyed and the columns in the active Slice are expired.
+        void AbandonDocuments(std::vector<DocumentHandleInternal> const & handles);
+
+        // Writes a snapshot of the Shard's full Slices to the locations
+        // defined by the FileManager. The ShardSnapshot file holds the slice
+        // buffer layout, the number of Slices and the DocTable's variable size
+        // blobs. Each slice buffer is written verbatim to its own IndexSlice
+        // file so that LoadSnapshot() can map it back into memory. Slices
+        // which are still being ingested are not written. The caller must
+        // hold a Token.
+        void WriteSnapshot(IFileManager & fileManager) const;
+
+        // Loads the Slices written by WriteSnapshot() and adds them to the
+        // list of Slices. The slice buffers are mapped from their IndexSlice
+        // files rather than allocated from the ISliceBufferAllocator. Appends
+        // a handle for each active document in the loaded Slices to
+        // documents. Throws if the snapshot was written by a Shard with a
+        // different slice buffer layout.
         //
         // Design intent is that the serialized files act as a cache, and it is
         // expected that the index may not be able to restore some or all slices
         // from the cache, and the host will re-ingest the documents which were
         // not restored.
-        //void LoadSlice(std::istream& input);
-
-        // TODO: WriteSlice here or in Slice?
+        void LoadSnapshot(IFileManager & fileManager,
+                          std::vector<DocumentHandleInternal> & documents);
 
         // Remove slice buffer and its Slice from the list of slices. Throws if
         // slice buffer wasn't found in the list of active slice buffers.
@@ -161,6 +214,39 @@ namespace BitFunnel
         // copy of the vector of slices, is scheduled for recycling.
         void RecycleSlice(Slice& slice);
 
+        // Makes the documents allocated from now on belong to the given group,
+        // which may be c_noGroupId. If the active Slice belongs to another
+        // group, it is sealed so that each Slice holds documents from a
+        // single group, and a new Slice is created by the next call to
+        // AllocateDocument(). Space that was left in the sealed Slice is
+        // not reused.
+        void SetGroup(GroupId groupId);
+
+        // Returns the Slices which belong to the given group. The caller must
+        // hold a Token.
+        std::vector<Slice*> GetGroupSlices(GroupId groupId) const;
+
+        // Removes all documents in the given Slice from serving by zeroing
+        // its document active row, and schedules the Slice for recycling.
+        // The Slice must be full. The caller must hold a Token and is
+        // responsible for removing the documents from the DocumentMap.
+        void ExpireSlice(Slice& slice);
+
+        // Returns the full Slices, other than the active Slice, in which at
+        // least minExpiredRatio of the columns have been expired but which
+        // still have active documents. Only Slices in the current group are
+        // returned, since compaction moves documents to the active Slice.
+        // The caller must hold a Token.
+        std::vector<Slice*> GetSlicesToCompact(double minExpiredRatio) const;
+
+        // Copies the DocTable entries and row bits of the documents in from,
+        // which must all be in the same Slice, to the columns in to. The
+        // document active bit is not copied, so the copies are not visible to
+        // the matcher until they are activated. Rows which are empty in the
+        // source Slice are skipped.
+        void CopyDocuments(std::vector<DocumentHandleInternal> const & from,
+                           std::vector<DocumentHandleInternal> const & to) const;
+
         // Returns term table associated with this shard.
         ITermTable const & GetTermTable() const;
 
@@ -176,17 +262,6 @@ namespace BitFunnel
         // m_sliceBufferSize.
         void* AllocateSliceBuffer();
 
-        // Allocates and loads the contents of the slice buffer from the
-        // stream. The stream has the size of the buffer embedded as the first
-        // element, and the function verifies that it matches the value stored
-        // in buffer m_sliceBufferSize.
-        //void* LoadSliceBuffer(std::istream& input);
-
-        // Writes the contents of the slice buffer to the output stream. The
-        // size of the stream is stored in m_sliceBufferSize and is written
-        // before the buffer's data for compatibility checks.
-        //void WriteSliceBuffer(void* buffer, std::ostream& output);
-
         // Releases the slice buffer and returns it to the
         // ISliceBufferAllocator.
         void ReleaseSliceBuffer(void* sliceBuffer);
@@ -222,11 +297,31 @@ namespace BitFunnel
         // Tries to add a new slice. Throws if no memory in the allocator.
         // Implementation:
         //   std::vector<void*>* newSlices = new std::vector<void*>(m_sliceBuffers);
-        //   Slice* newSlice = new Slice(*this);
+        //   Slice* newSlice = new Slice(*this, m_groupId);
         //   newSlices.push_back(newSlice->GetBuffer());
         //   swap newSlices and m_sliceBuffers, schedule newSlices for recycling.
         void CreateNewActiveSlice();
 
+        // Adds Slices to the list of slice buffers. Must be called with
+        // m_slicesLock held.
+        void AddSlice(Slice* slice);
+        void AddSlices(std::vector<Slice*> const & slices);
+
+        // Creates a Slice over a slice buffer written by WriteSnapshot(),
+        // loads its variable size blobs from input, expires the columns
+        // which were not active when the snapshot was taken, and adds the
+        // Slice to the list of slice buffers. Appends handles for the active
+        // documents to documents.
+        void LoadSlice(std::unique_ptr<IFileMapping> sliceBuffer,
+                       std::istream& input,
+                       std::vector<DocumentHandleInternal> & documents);
+
+        // Writes or reads and verifies the values that determine the slice
+        // buffer layout. ReadLayout() throws if they differ from this
+        // Shard's layout.
+        void WriteLayout(std::ostream& output) const;
+        void ReadLayout(std::istream& input) const;
+
         //
         // Constructor parameters.
         //
@@ -262,6 +357,10 @@ namespace BitFunnel
         // allocate a new Slice via CreateNewActiveSlice().
         Slice* m_activeSlice;
 
+        // Group of the documents which are being allocated. Protected by
+        // m_slicesLock.
+        GroupId m_groupId;
+
         // Vector of pointers to slice buffers.
         //
         // DESIGN NOTE: We store a pointer to an std::vector here instead of
@@ -300,6 +399,9 @@ namespace BitFunnel
         // of vectors is implemented.
         std::atomic<std::vector<void*>*> m_sliceBuffers;
 
+        // See GetSliceListVersion(). Updated with m_slicesLock held.
+        std::atomic<uint64_t> m_sliceListVersion;
+
        // Capacity of a Slice. All Slices in the shard have the same capacity.
         const DocIndex m_sliceCapacity;
 
@@ -362,10 +362,14 @@ namespace BitFunnel
                 32 * GetReasonableBlockSize(*m_schema, m_termTables->GetTermTable(tempId));
             //        std::cout << "Blocksize: " << blockSize << std::endl;
 
-            const size_t initialBlockCount = 512;
+            // Map slice buffers in arenas as the index grows, rather than
+            // reserving memory for a worst-case corpus up front.
+            const size_t arenaBlockCount = 16;
+            const size_t maxBlockCount = 0;
             m_sliceAllocator =
-                Factories::CreateSliceBufferAllocator(blockSize,
-                                                      initialBlockCount);
+                Factories::CreateElasticSliceBufferAllocator(blockSize,
+                                                             arenaBlockCount,
+                                                             maxBlockCount);
         }
 
         if (m_recycler.get() == nullptr)
@@ -408,6 +412,13 @@ namespace BitFunnel
     }
 
 
+    IDocumentDataSchema const & SimpleIndex::GetDocumentDataSchema() const
+    {
+        EnsureStarted(true);
+        return *m_schema;
+    }
+
+
     IFileManager & SimpleIndex::GetFileManager() const
     {
         EnsureStarted(true);
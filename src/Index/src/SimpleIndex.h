@@ -91,6 +91,7 @@ namespace BitFunnel
         virtual void StopIndex() override;
 
         virtual IConfiguration const & GetConfiguration() const override;
+        virtual IDocumentDataSchema const & GetDocumentDataSchema() const override;
         virtual IFileManager & GetFileManager() const override;
         virtual IFileSystem & GetFileSystem() const override;
         virtual IIngestor & GetIngestor() const override;
@@ -21,6 +21,11 @@
 // THE SOFTWARE.
 
 
+#include <ostream>
+
+#include "BitFunnel/Configuration/IFileSystem.h"
+#include "BitFunnel/Exceptions.h"
+#include "BitFunnel/Utilities/StreamUtilities.h"
 #include "LoggerInterfaces/Logging.h"
 #include "Shard.h"
 #include "Slice.h"
@@ -28,9 +33,11 @@
 
 namespace BitFunnel
 {
-    Slice::Slice(Shard& shard)
+    Slice::Slice(Shard& shard, GroupId groupId)
         : m_shard(shard),
           m_temporaryNextDocIndex(0U),
+          m_groupId(groupId),
+          m_isStaged(false),
           m_capacity(shard.GetSliceCapacity()),
           m_refCount(1),
           m_buffer(shard.AllocateSliceBuffer()),
@@ -50,12 +57,34 @@ namespace BitFunnel
     }
 
 
+    Slice::Slice(Shard& shard, std::unique_ptr<IFileMapping> sliceBuffer)
+        : m_shard(shard),
+          m_temporaryNextDocIndex(0U),
+          m_groupId(c_noGroupId),
+          m_isStaged(false),
+          m_capacity(shard.GetSliceCapacity()),
+          m_refCount(1),
+          m_buffer(sliceBuffer->GetData()),
+          m_unallocatedCount(0),
+          m_commitPendingCount(0),
+          m_expiredCount(0),
+          m_mapping(std::move(sliceBuffer))
+    {
+        // The DocTable and RowTables already hold the slice's data. Only the
+        // pointer to the Slice needs to be updated.
+        Initialize();
+    }
+
+
     Slice::~Slice()
     {
         try
         {
             GetDocTable().Cleanup(m_buffer);
-            m_shard.ReleaseSliceBuffer(m_buffer);
+            if (m_mapping == nullptr)
+            {
+                m_shard.ReleaseSliceBuffer(m_buffer);
+            }
         }
         catch (...)
         {
@@ -64,6 +93,12 @@ namespace BitFunnel
     }
 
 
+    GroupId Slice::GetGroupId() const
+    {
+        return m_groupId;
+    }
+
+
     Shard& Slice::GetShard() const
     {
         return m_shard;
@@ -83,6 +118,19 @@ namespace BitFunnel
     }
 
 
+    bool Slice::CommitDocuments(size_t count)
+    {
+        std::lock_guard<std::mutex> lock(m_docIndexLock);
+
+        LogAssertB(m_commitPendingCount >= count,
+                   "CommitDocuments with too few pending documents.");
+
+        m_commitPendingCount -= count;
+
+        return (m_unallocatedCount + m_commitPendingCount) == 0;
+    }
+
+
     /* static */
     void Slice::DecrementRefCount(Slice* slice)
     {
@@ -110,6 +158,23 @@ namespace BitFunnel
     }
 
 
+    bool Slice::ExpireAllDocuments()
+    {
+        std::lock_guard<std::mutex> lock(m_docIndexLock);
+
+        LogAssertB((m_unallocatedCount + m_commitPendingCount) == 0,
+                   "ExpireAllDocuments on a Slice which is not full.");
+
+        if (m_expiredCount == m_capacity)
+        {
+            return false;
+        }
+
+        m_expiredCount = m_capacity;
+        return true;
+    }
+
+
     DocTableDescriptor const & Slice::GetDocTable() const
     {
         return m_shard.GetDocTable();
@@ -166,6 +231,48 @@ namespace BitFunnel
     }
 
 
+    DocIndex Slice::GetExpiredCount() const
+    {
+        return m_expiredCount;
+    }
+
+
+    bool Slice::IsStaged() const
+    {
+        return m_isStaged;
+    }
+
+
+    void Slice::SetStaged(bool isStaged)
+    {
+        m_isStaged = isStaged;
+    }
+
+
+    bool Slice::IsFull() const
+    {
+        std::lock_guard<std::mutex> lock(m_docIndexLock);
+        return (m_unallocatedCount + m_commitPendingCount) == 0;
+    }
+
+
+    bool Slice::Seal()
+    {
+        std::lock_guard<std::mutex> lock(m_docIndexLock);
+
+        if (m_unallocatedCount == 0)
+        {
+            // A full Slice is recycled by ExpireDocument().
+            return false;
+        }
+
+        m_expiredCount += m_unallocatedCount;
+        m_unallocatedCount = 0;
+
+        return m_expiredCount == m_capacity;
+    }
+
+
     bool Slice::TryAllocateDocument(size_t& index)
     {
         std::lock_guard<std::mutex> lock(m_docIndexLock);
@@ -181,4 +288,33 @@ namespace BitFunnel
 
         return true;
     }
+
+
+    size_t Slice::TryAllocateDocuments(size_t count, DocIndex& first)
+    {
+        std::lock_guard<std::mutex> lock(m_docIndexLock);
+
+        const size_t allocated =
+            (count < m_unallocatedCount) ? count : m_unallocatedCount;
+
+        first = m_capacity - m_unallocatedCount;
+        m_unallocatedCount -= allocated;
+        m_commitPendingCount += allocated;
+
+        return allocated;
+    }
+
+
+    void Slice::Write(std::ostream& output) const
+    {
+        if (!IsFull())
+        {
+            RecoverableError error("Slice::Write: slice is not fully ingested.");
+            throw error;
+        }
+
+        StreamUtilities::WriteBytes(output,
+                                    static_cast<char const *>(m_buffer),
+                                    m_shard.GetSliceBufferSize());
+    }
 }
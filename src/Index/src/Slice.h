@@ -23,6 +23,8 @@
 #pragma once
 
 #include <atomic>
+#include <iosfwd>
+#include <memory>
 #include <stddef.h>
 #include <stdint.h>
 #include <mutex>
@@ -35,6 +37,7 @@ namespace BitFunnel
 {
     class DocumentFrequencyTableBuilder;
     class DocTableDescriptor;
+    class IFileMapping;
     class RowTableDescriptor;
     class Shard;
 
@@ -75,6 +78,18 @@ namespace BitFunnel
     // Expire() method and the thread that gets it is responsible of
     // decrementing the reference count on the Slice.
     //
+    // Each Slice belongs to the group that was open in its Shard when the
+    // Slice was created. When the Shard switches to another group, it seals
+    // its active Slice so that no more documents are allocated in it. Sealed
+    // columns count as expired, so a Slice which holds only documents from
+    // one group can be expired as a whole when its group is expired.
+    //
+    // A Slice may also be staged by a batch of documents being added. A staged
+    // Slice is not in its Shard's list of slices until the batch is
+    // published, so it is invisible to the matcher and only the thread
+    // ingesting the batch writes to it. Postings to a staged Slice are set
+    // with plain stores instead of interlocked operations.
+    //
     // DESIGN NOTE: To prevent destroying a Slice by recycler, the following
     // synchronization mechanisms are used
     // 1. Query threads use Token mechanism that guarantees availability of
@@ -107,7 +122,7 @@ namespace BitFunnel
     //
     // DocTable data
     // <padding>
-    // RowTable0 data
+    // RowTable0 data (rows followed by one summary bit per row)
     // <padding>
     // ... (RowTables for other ranks which have rows)
     // RowTable6 data
@@ -126,17 +141,19 @@ namespace BitFunnel
         // is dictated by the DocTable alignment.
         //static const size_t c_bufferByteAlignment = c_docTableByteAlignment;
 
-        // Creates a slice that belogs to a given Shard.
+        // Creates a slice that belogs to a given Shard and group.
         // Allocates a slice buffer using the allocator from the Shard.
         // Stores pointer to the buffer in m_sliceBuffer.
-        Slice(Shard& shard);
+        Slice(Shard& shard, GroupId groupId);
 
-        // Creates a slice from its serialized representation from an input
-        // stream. Verifies that the Slice is compatible with the one in the
-        // stream by comparing Shard's RowTableDescriptor and
-        // DocTableDescriptor with copies read from the stream. Throws if the
-        // descriptors are not compatible.
-        //Slice(Shard& shard, std::istream& input);
+        // Creates a fully ingested slice from a slice buffer previously
+        // written by Write(). The Slice takes ownership of the mapping and
+        // uses its data as the slice buffer in place, without copying or
+        // reinitializing it. The caller is responsible for verifying that the
+        // buffer was written by a Shard with the same layout and for loading
+        // the DocTable's variable size blobs. The Slice does not belong to a
+        // group.
+        Slice(Shard& shard, std::unique_ptr<IFileMapping> sliceBuffer);
 
         // Releases all heap-allocated data blobs, returns the slice buffer
         // back to its allocator and destroys the Slice.
@@ -147,6 +164,15 @@ namespace BitFunnel
         // parent Shard.
         void* GetSliceBuffer() const;
 
+        // Returns the group which was open when the Slice was created.
+        GroupId GetGroupId() const;
+
+        // Returns true while the Slice is staged by a batch. Not thread safe
+        // with respect to SetStaged(), which may only be called by the thread
+        // that owns the batch.
+        bool IsStaged() const;
+        void SetStaged(bool isStaged);
+
         // Returns the shard which owns this slice.
         // DESIGN NOTE: Shard is required to get access to shared objects at either
         // a Shard level or Index level (e.g. Recycler, backup system etc.)
@@ -156,10 +182,13 @@ namespace BitFunnel
         DocTableDescriptor const & GetDocTable() const;
         RowTableDescriptor const & GetRowTable(Rank rank) const;
 
-        // Serializes the slice to a given output stream. Only slices that are
-        // full (all columns are allocated and committed) may be serialized.
+        // Serializes the slice buffer to a given output stream. Only slices
+        // that are full (all columns are allocated and committed) may be
+        // serialized. Throws if the slice is not full. The DocTable's variable
+        // size blobs are not part of the slice buffer and must be written
+        // separately.
         // Thread safe with respect to concurrent calls to const methods.
-        //void Write(std::ostream& output) const;
+        void Write(std::ostream& output) const;
 
         //
         // Document allocation methods.
@@ -178,6 +207,12 @@ namespace BitFunnel
         //   return true
         bool TryAllocateDocument(DocIndex& index);
 
+        // Attempts to allocate a contiguous run of up to count DocIndexes.
+        // Returns the number of DocIndexes allocated, which is 0 if the Slice
+        // is full, and sets first to the first DocIndex in the run.
+        // Thread safe.
+        size_t TryAllocateDocuments(size_t count, DocIndex& first);
+
         // Makes document visible to the matcher. May only be called once per
         // DocIndex value. Returns true if this was the last document in this
         // slice to commit, in which case the caller is responsible of
@@ -191,6 +226,11 @@ namespace BitFunnel
         //   return (m_unallocated + m_commitPending) == 0;
         bool CommitDocument();
 
+        // Commits count documents at once. Equivalent to calling
+        // CommitDocument() count times, but takes the lock only once.
+        // Thread safe.
+        bool CommitDocuments(size_t count);
+
         // Hides document from future matching operations. May only be called
         // once per DocIndex value.  DocIndex value must have been successfully
         // allocated by TryAllocateDocument().  Returns true if the entire
@@ -205,6 +245,24 @@ namespace BitFunnel
         //   return m_expiredCount == m_capacity.
         bool ExpireDocument();
 
+        // Prevents further allocations from the Slice by expiring its
+        // unallocated columns. Returns true if the entire capacity of the
+        // Slice is now expired, in which case the caller is responsible of
+        // recycling the Slice. Returns false otherwise.
+        // Thread safe.
+        bool Seal();
+
+        // Expires all of the Slice's columns at once. The Slice must be full.
+        // Returns true if the Slice was not already fully expired, in which
+        // case the caller is responsible of recycling the Slice. The caller is
+        // responsible for clearing the document active bits.
+        // Thread safe.
+        bool ExpireAllDocuments();
+
+        // Returns true if all of the Slice's columns have been allocated and
+        // committed.
+        bool IsFull() const;
+
         // Returns true if the Slice is fully expired, meaning that all of its
         // documents are expired. In this case the Slice can be removed from
         // the index.
@@ -212,6 +270,9 @@ namespace BitFunnel
         // Slices are scheduled for recycling. Think if this is needed at all.
         bool IsExpired() const;
 
+        // Returns the number of expired documents in the Slice.
+        DocIndex GetExpiredCount() const;
+
         // Extracts Slice information from the buffer where its data is stored.
         // Slice places a pointer to itself at the offset which is controlled
         // by Shard.
@@ -243,6 +304,12 @@ namespace BitFunnel
 
         std::atomic<DocIndex> m_temporaryNextDocIndex;
 
+        // Group which was open when the Slice was created.
+        const GroupId m_groupId;
+
+        // True while the Slice is staged by a batch.
+        bool m_isStaged;
+
         // Capacity of the slice.
         const size_t m_capacity;
 
@@ -282,5 +349,10 @@ namespace BitFunnel
         // The number of DocIndex'es that have been expired from the slice.
         // When this value reaches m_capacity, the slice can be recycled.
         std::atomic<size_t> m_expiredCount;
+
+        // Owns m_buffer when the Slice was loaded from a file mapping. In this
+        // case the buffer is released by destroying the mapping instead of
+        // returning it to the ISliceBufferAllocator.
+        std::unique_ptr<IFileMapping> m_mapping;
     };
 }
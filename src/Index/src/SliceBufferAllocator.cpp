@@ -58,6 +58,13 @@ namespace BitFunnel
     }
 
 
+    void* SliceBufferAllocator::Allocate(size_t byteSize, ShardId /*shard*/)
+    {
+        // All shards share a single pool.
+        return Allocate(byteSize);
+    }
+
+
     void SliceBufferAllocator::Release(void* buffer)
     {
         m_blockAllocator->ReleaseBlock(reinterpret_cast<uint64_t*>(buffer));
@@ -56,6 +56,7 @@ namespace BitFunnel
         // ISliceBufferAllocator API.
         //
         virtual void* Allocate(size_t byteSize) override;
+        virtual void* Allocate(size_t byteSize, ShardId shard) override;
         virtual void Release(void* buffer) override;
         virtual size_t GetSliceBufferSize() const override;
 
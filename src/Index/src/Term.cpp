@@ -37,6 +37,11 @@
 
 namespace BitFunnel
 {
+    // TODO: Need some means to ensure that a term never gets the same hash
+    // as a system row or a fact.
+    static const unsigned c_murmurHashSeedForText = 123456789;
+
+
     static uint64_t rotl64By1(uint64_t x)
     {
         // TODO: Investigate `_rotl64` intrinsics; this exists on Windows, but
@@ -53,7 +58,16 @@ namespace BitFunnel
     Term::Term(char const * text,
                StreamId stream,
                IConfiguration const & configuration)
-        : m_rawHash(ComputeRawHash(text)),
+        : Term(ComputeRawHash(text), text, stream, configuration)
+    {
+    }
+
+
+    Term::Term(Hash rawHash,
+               char const * text,
+               StreamId stream,
+               IConfiguration const & configuration)
+        : m_rawHash(rawHash),
           m_stream(stream),
           m_gramSize(1)
     {
@@ -362,12 +376,21 @@ namespace BitFunnel
 
     Term::Hash Term::ComputeRawHash(char const * text)
     {
-        // TODO: Need some means to ensure that a term never gets the same hash
-        // as a system row or a fact.
-        const int c_murmurHashSeedForText = 123456789;
-
         Hash hash = MurmurHash64A(text, strlen(text), c_murmurHashSeedForText);
 
         return hash;
     }
+
+
+    void Term::ComputeRawHashes(char const * const * texts,
+                                size_t const * lengths,
+                                size_t count,
+                                Hash* hashes)
+    {
+        MurmurHash64A(reinterpret_cast<void const * const *>(texts),
+                      lengths,
+                      count,
+                      c_murmurHashSeedForText,
+                      hashes);
+    }
 }
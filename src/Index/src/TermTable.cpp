@@ -20,6 +20,7 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
+#include <atomic>
 #include <math.h>
 #include <sstream>
 
@@ -59,6 +60,7 @@ namespace BitFunnel
     TermTable::TermTable()
       : m_sealed(false),
         m_termOpen(false),
+        m_version(GetNextVersion()),
         m_ranksInUse({}),
         m_explicitRowCounts(c_maxRankValue + 1, 0),
         m_adhocRowCounts(c_maxRankValue + 1, 0),
@@ -152,6 +154,7 @@ namespace BitFunnel
 
     TermTable::TermTable(std::istream& input)
       : m_sealed(true),
+        m_version(GetNextVersion()),
         m_start(0),
         m_randomHashes({
                     0xac0a7f8c2faac497,
@@ -264,11 +267,19 @@ namespace BitFunnel
         StreamUtilities::WriteField<RowIndex>(output, m_factRowCount);
     }
 
+
+    uint64_t TermTable::GetVersion() const
+    {
+        return m_version;
+    }
+
+
     static_assert(std::is_trivially_copyable<std::array<std::array<PackedRowIdSequence, 10>, 10>>::value, "foo");
 
     void TermTable::OpenTerm()
     {
         EnsureSealed(false);
+        m_version = GetNextVersion();
         EnsureTermOpen(false);
         m_termOpen = true;
         m_start = static_cast<RowIndex>(m_rowIds.size());
@@ -278,6 +289,7 @@ namespace BitFunnel
     void TermTable::AddRowId(RowId row)
     {
         EnsureSealed(false);
+        m_version = GetNextVersion();
         // NOTE: we don't EnsureTermOpen because we could add system rows via
         // AddRowId.
         m_ranksInUse[row.GetRank()] = true;
@@ -289,6 +301,7 @@ namespace BitFunnel
     void TermTable::CloseTerm(Term::Hash hash)
     {
         EnsureSealed(false);
+        m_version = GetNextVersion();
         EnsureTermOpen(true);
         m_termOpen = false;
 
@@ -316,6 +329,7 @@ namespace BitFunnel
     void TermTable::CloseAdhocTerm(Term::IdfX10 idf, Term::GramSize gramSize)
     {
         EnsureSealed(false);
+        m_version = GetNextVersion();
         EnsureTermOpen(true);
         m_termOpen = false;
 
@@ -337,6 +351,7 @@ namespace BitFunnel
                                  size_t adhocCount)
     {
         EnsureSealed(false);
+        m_version = GetNextVersion();
 
         size_t totalRowCount = explicitCount + adhocCount;
         CHECK_EQ(totalRowCount != 0, m_ranksInUse[rank])
@@ -351,6 +366,7 @@ namespace BitFunnel
     void TermTable::SetFactCount(size_t factCount)
     {
         EnsureSealed(false);
+        m_version = GetNextVersion();
 
         // Fact rows include the SystemTerm rows and one row for each user
         // defined fact.
@@ -361,6 +377,7 @@ namespace BitFunnel
     void TermTable::Seal()
     {
         EnsureSealed(false);
+        m_version = GetNextVersion();
         m_sealed = true;
         EnsureTermOpen(false);
 
@@ -587,6 +604,13 @@ namespace BitFunnel
     }
 
 
+    uint64_t TermTable::GetNextVersion()
+    {
+        static std::atomic<uint64_t> nextVersion(0);
+        return nextVersion++;
+    }
+
+
     void TermTable::EnsureSealed(bool value) const
     {
         if (m_sealed != value)
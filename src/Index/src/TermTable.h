@@ -24,6 +24,7 @@
 
 #include <unordered_map>                // std::unordered_map member.
 #include <array>                        // std::array member.
+#include <stdint.h>                     // uint64_t member.
 #include <vector>                       // std::vector member.
 
 #include "BitFunnel/Index/ITermTable.h" // Base class.
@@ -45,6 +46,10 @@ namespace BitFunnel
         // Writes the contents of the ITermTable to a stream.
         virtual void Write(std::ostream& output) const override;
 
+        // Returns a version number which changes each time the TermTable is
+        // modified.
+        virtual uint64_t GetVersion() const override;
+
         // Instructs the TermTable to start recording RowIds added by AddRowId.
         virtual void OpenTerm() override;
 
@@ -144,9 +149,15 @@ namespace BitFunnel
 
         static Term CreateSystemTerm(SystemTerm term);
 
+        // Returns a version number that has not been used by any TermTable.
+        static uint64_t GetNextVersion();
+
         bool m_sealed;
         bool m_termOpen;
 
+        // Updated by each of the build methods.
+        uint64_t m_version;
+
         RowIndex m_start;
 
         typedef std::array<bool, c_maxRankValue + 1> RanksInUse;
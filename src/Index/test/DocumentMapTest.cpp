@@ -0,0 +1,429 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <atomic>
+#include <deque>
+#include <future>
+#include <memory>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "BitFunnel/Index/Factories.h"
+#include "BitFunnel/Index/Helpers.h"
+#include "BitFunnel/Index/IRecycler.h"
+#include "BitFunnel/Index/ITermTable.h"
+#include "BitFunnel/Index/Token.h"
+#include "BitFunnel/Utilities/Factories.h"
+#include "DocumentDataSchema.h"
+#include "DocumentMap.h"
+#include "Shard.h"
+#include "TrackingSliceBufferAllocator.h"
+
+
+namespace BitFunnel
+{
+    namespace DocumentMapTest
+    {
+        // Allocates DocumentHandleInternals with DocIds firstId and up from
+        // a Shard, in Slices which belong to groupId.
+        class Documents
+        {
+        public:
+            Documents(size_t documentCount,
+                      GroupId groupId = c_noGroupId,
+                      DocId firstId = 0)
+              : m_firstId(firstId),
+                m_recycler(Factories::CreateRecycler()),
+                m_tokenManager(Factories::CreateTokenManager()),
+                m_termTable(Factories::CreateTermTable())
+            {
+                m_background = std::async(std::launch::async,
+                                          &IRecycler::Run,
+                                          m_recycler.get());
+
+                m_termTable->Seal();
+
+                const size_t blockSize =
+                    GetMinimumBlockSize(m_docDataSchema, *m_termTable);
+                m_allocator.reset(new TrackingSliceBufferAllocator(blockSize));
+                m_shard.reset(new Shard(0,
+                                        *m_recycler,
+                                        *m_tokenManager,
+                                        *m_termTable,
+                                        m_docDataSchema,
+                                        *m_allocator,
+                                        blockSize));
+
+                m_shard->SetGroup(groupId);
+                for (DocId id = firstId; id < firstId + documentCount; ++id)
+                {
+                    m_handles.push_back(m_shard->AllocateDocument(id));
+                }
+            }
+
+
+            ~Documents()
+            {
+                m_tokenManager->Shutdown();
+                m_recycler->Shutdown();
+                m_background.wait();
+            }
+
+
+            DocumentHandleInternal const & operator[](DocId id) const
+            {
+                return m_handles[id - m_firstId];
+            }
+
+
+            IRecycler& GetRecycler() const
+            {
+                return *m_recycler;
+            }
+
+
+            ITokenManager& GetTokenManager() const
+            {
+                return *m_tokenManager;
+            }
+
+
+        private:
+            const DocId m_firstId;
+            std::unique_ptr<IRecycler> m_recycler;
+            std::future<void> m_background;
+            std::unique_ptr<ITokenManager> m_tokenManager;
+            std::unique_ptr<ITermTable> m_termTable;
+            DocumentDataSchema m_docDataSchema;
+            std::unique_ptr<TrackingSliceBufferAllocator> m_allocator;
+            std::unique_ptr<Shard> m_shard;
+            std::vector<DocumentHandleInternal> m_handles;
+        };
+
+
+        static void VerifyFound(DocumentMap const & map,
+                                DocumentHandleInternal const & expected)
+        {
+            bool isFound = false;
+            DocumentHandleInternal observed =
+                map.Find(expected.GetDocId(), isFound);
+            ASSERT_TRUE(isFound);
+            EXPECT_EQ(&expected.GetSlice(), &observed.GetSlice());
+            EXPECT_EQ(expected.GetIndex(), observed.GetIndex());
+        }
+
+
+        TEST(DocumentMap, AddFindDelete)
+        {
+            const size_t c_documentCount = 5000;
+            Documents documents(c_documentCount);
+            DocumentMap map(documents.GetRecycler(), documents.GetTokenManager());
+
+            for (DocId id = 0; id < c_documentCount; ++id)
+            {
+                map.Add(documents[id]);
+            }
+            EXPECT_EQ(c_documentCount, map.size());
+
+            for (DocId id = 0; id < c_documentCount; ++id)
+            {
+                VerifyFound(map, documents[id]);
+            }
+
+            EXPECT_ANY_THROW(map.Add(documents[17]));
+            EXPECT_EQ(c_documentCount, map.size());
+
+            bool isFound = true;
+            map.Find(c_documentCount, isFound);
+            EXPECT_FALSE(isFound);
+            EXPECT_FALSE(map.Delete(c_documentCount));
+
+            // Randomly delete and re-add entries, checking against
+            // std::unordered_map. This exercises backward shift deletion
+            // across clusters and table wrap-around.
+            std::unordered_map<DocId, bool> expected;
+            for (DocId id = 0; id < c_documentCount; ++id)
+            {
+                expected[id] = true;
+            }
+
+            std::mt19937 random(1234);
+            for (unsigned i = 0; i < 20000; ++i)
+            {
+                const DocId id = random() % c_documentCount;
+                if (expected[id])
+                {
+                    EXPECT_TRUE(map.Delete(id));
+                    expected[id] = false;
+                }
+                else
+                {
+                    EXPECT_FALSE(map.Delete(id));
+                    map.Add(documents[id]);
+                    expected[id] = true;
+                }
+            }
+
+            size_t expectedCount = 0;
+            for (DocId id = 0; id < c_documentCount; ++id)
+            {
+                if (expected[id])
+                {
+                    ++expectedCount;
+                    VerifyFound(map, documents[id]);
+                }
+                else
+                {
+                    map.Find(id, isFound);
+                    EXPECT_FALSE(isFound);
+                }
+            }
+            EXPECT_EQ(expectedCount, map.size());
+        }
+
+
+        TEST(DocumentMap, Update)
+        {
+            Documents documents(3);
+            DocumentMap map(documents.GetRecycler(), documents.GetTokenManager());
+            map.Add(documents[0]);
+
+            // Move DocId 0 to the column allocated for DocId 1.
+            DocumentHandleInternal moved(&documents[1].GetSlice(),
+                                         documents[1].GetIndex(),
+                                         0);
+            EXPECT_TRUE(map.Update(moved));
+            VerifyFound(map, moved);
+            EXPECT_EQ(1u, map.size());
+
+            DocumentHandleInternal missing(&documents[2].GetSlice(),
+                                           documents[2].GetIndex(),
+                                           99);
+            EXPECT_FALSE(map.Update(missing));
+            EXPECT_EQ(1u, map.size());
+        }
+
+
+        TEST(DocumentMap, ExpireGroup)
+        {
+            const size_t c_ungroupedCount = 1000;
+            const size_t c_groupedCount = 2000;
+            const GroupId c_groupId = 7;
+
+            Documents ungrouped(c_ungroupedCount);
+            Documents grouped(c_groupedCount, c_groupId, c_ungroupedCount);
+            DocumentMap map(ungrouped.GetRecycler(), ungrouped.GetTokenManager());
+
+            for (DocId id = 0; id < c_ungroupedCount; ++id)
+            {
+                map.Add(ungrouped[id]);
+            }
+            for (DocId id = c_ungroupedCount; id < c_ungroupedCount + c_groupedCount; ++id)
+            {
+                map.Add(grouped[id]);
+            }
+            EXPECT_EQ(c_ungroupedCount + c_groupedCount, map.size());
+
+            map.ExpireGroup(c_groupId, c_groupedCount);
+            EXPECT_EQ(c_ungroupedCount, map.size());
+
+            // Expiring the group again has no effect.
+            map.ExpireGroup(c_groupId, c_groupedCount);
+            EXPECT_EQ(c_ungroupedCount, map.size());
+
+            for (DocId id = 0; id < c_ungroupedCount; ++id)
+            {
+                VerifyFound(map, ungrouped[id]);
+            }
+
+            bool isFound = true;
+            for (DocId id = c_ungroupedCount; id < c_ungroupedCount + c_groupedCount; ++id)
+            {
+                map.Find(id, isFound);
+                EXPECT_FALSE(isFound);
+            }
+            EXPECT_FALSE(map.Delete(c_ungroupedCount));
+            EXPECT_FALSE(map.Update(grouped[c_ungroupedCount]));
+            EXPECT_EQ(c_ungroupedCount, map.size());
+
+            // Expired DocIds can be added again.
+            Documents readded(c_groupedCount, c_noGroupId, c_ungroupedCount);
+            for (DocId id = c_ungroupedCount; id < c_ungroupedCount + c_groupedCount; ++id)
+            {
+                map.Add(readded[id]);
+            }
+            EXPECT_EQ(c_ungroupedCount + c_groupedCount, map.size());
+
+            // Growing the stripes drops any expired entries which remain.
+            const DocId firstNewId = c_ungroupedCount + c_groupedCount;
+            const size_t c_newCount = 5000;
+            Documents added(c_newCount, c_noGroupId, firstNewId);
+            for (DocId id = firstNewId; id < firstNewId + c_newCount; ++id)
+            {
+                map.Add(added[id]);
+            }
+            EXPECT_EQ(firstNewId + c_newCount, map.size());
+
+            for (DocId id = c_ungroupedCount; id < firstNewId; ++id)
+            {
+                VerifyFound(map, readded[id]);
+            }
+            for (DocId id = firstNewId; id < firstNewId + c_newCount; ++id)
+            {
+                VerifyFound(map, added[id]);
+            }
+        }
+
+
+        // Expires groups under a rolling window. Rehashing sizes the tables
+        // for the live entries, so the map does not grow with the number of
+        // groups which have passed through it.
+        TEST(DocumentMap, RollingGroupWindow)
+        {
+            const size_t c_groupSize = 1000;
+            const size_t c_windowSize = 2;
+            const GroupId c_groupCount = 80;
+            const GroupId c_warmupGroupCount = 10;
+
+            Documents ungrouped(0);
+            DocumentMap map(ungrouped.GetRecycler(), ungrouped.GetTokenManager());
+
+            std::deque<std::unique_ptr<Documents>> window;
+            size_t warmupCapacity = 0;
+            for (GroupId group = 0; group < c_groupCount; ++group)
+            {
+                const DocId firstId = group * c_groupSize;
+                window.emplace_back(new Documents(c_groupSize, group, firstId));
+                for (DocId id = firstId; id < firstId + c_groupSize; ++id)
+                {
+                    map.Add((*window.back())[id]);
+                }
+
+                if (window.size() > c_windowSize)
+                {
+                    map.ExpireGroup(group - c_windowSize, c_groupSize);
+                    window.pop_front();
+                }
+                EXPECT_EQ(window.size() * c_groupSize, map.size());
+
+                if (group == c_warmupGroupCount)
+                {
+                    warmupCapacity = map.GetCapacity();
+                }
+            }
+
+            EXPECT_LE(map.GetCapacity(), 2 * warmupCapacity);
+
+            const DocId firstLiveId = (c_groupCount - c_windowSize) * c_groupSize;
+            for (DocId id = 0; id < c_groupCount * c_groupSize; ++id)
+            {
+                bool isFound = false;
+                map.Find(id, isFound);
+                EXPECT_EQ(id >= firstLiveId, isFound);
+            }
+        }
+
+
+        // Readers look up entries which are never deleted while writers
+        // add and delete other entries. Deletes move the stable entries
+        // within their clusters and adds grow the tables, so readers
+        // observe both while probing.
+        TEST(DocumentMap, ConcurrentReadersAndWriters)
+        {
+            const size_t c_stableCount = 2000;
+            const size_t c_writerCount = 4;
+            const size_t c_documentsPerWriter = 4000;
+            const size_t c_documentCount =
+                c_stableCount + c_writerCount * c_documentsPerWriter;
+
+            Documents documents(c_documentCount);
+            DocumentMap map(documents.GetRecycler(), documents.GetTokenManager());
+
+            for (DocId id = 0; id < c_stableCount; ++id)
+            {
+                map.Add(documents[id]);
+            }
+
+            std::atomic<bool> done(false);
+            std::atomic<size_t> misses(0);
+
+            std::vector<std::thread> readers;
+            for (unsigned r = 0; r < 2; ++r)
+            {
+                readers.emplace_back([&]()
+                {
+                    while (!done)
+                    {
+                        for (DocId id = 0; id < c_stableCount; ++id)
+                        {
+                            bool isFound = false;
+                            auto handle = map.Find(id, isFound);
+                            if (!isFound
+                                || &handle.GetSlice() != &documents[id].GetSlice()
+                                || handle.GetIndex() != documents[id].GetIndex())
+                            {
+                                ++misses;
+                            }
+                        }
+                    }
+                });
+            }
+
+            std::vector<std::thread> writers;
+            for (size_t w = 0; w < c_writerCount; ++w)
+            {
+                writers.emplace_back([&, w]()
+                {
+                    const DocId first = c_stableCount + w * c_documentsPerWriter;
+                    for (unsigned round = 0; round < 4; ++round)
+                    {
+                        for (DocId id = first; id < first + c_documentsPerWriter; ++id)
+                        {
+                            map.Add(documents[id]);
+                        }
+                        for (DocId id = first; id < first + c_documentsPerWriter; ++id)
+                        {
+                            map.Delete(id);
+                        }
+                    }
+                });
+            }
+
+            for (auto & writer : writers)
+            {
+                writer.join();
+            }
+            done = true;
+            for (auto & reader : readers)
+            {
+                reader.join();
+            }
+
+            EXPECT_EQ(0u, misses.load());
+            EXPECT_EQ(c_stableCount, map.size());
+        }
+    }
+}
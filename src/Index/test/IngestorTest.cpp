@@ -21,9 +21,13 @@
 // THE SOFTWARE.
 
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <future>
 #include <limits>
 #include <memory>
+#include <thread>
 #include <vector>
 #include <unordered_map>
 
@@ -32,13 +36,22 @@
 #include "BitFunnel/BitFunnelTypes.h"
 #include "BitFunnel/Configuration/IFileSystem.h"
 #include "BitFunnel/Configuration/Factories.h"
+#include "BitFunnel/IFileManager.h"
+#include "BitFunnel/Index/Factories.h"
+#include "BitFunnel/Index/IDocument.h"
+#include "BitFunnel/Index/IIndexSnapshot.h"
 #include "BitFunnel/Index/IIngestor.h"
 #include "BitFunnel/Index/IShard.h"
 #include "BitFunnel/Index/ISimpleIndex.h"
+#include "BitFunnel/Index/ISliceBufferAllocator.h"
+#include "BitFunnel/Index/ITermTable.h"
+#include "BitFunnel/Index/ITermTableCollection.h"
 #include "BitFunnel/Index/RowIdSequence.h"
+#include "BitFunnel/Index/Token.h"
 #include "BitFunnel/Mocks/Factories.h"
 #include "BitFunnel/Term.h"
 #include "DocumentFrequencyTable.h"
+#include "DocumentHandleInternal.h"
 #include "Primes.h"
 
 
@@ -186,6 +199,17 @@ namespace BitFunnel
         {
             index.VerifyQuery(i);
         }
+
+        IIngestor & ingestor = index.GetIngestor();
+        size_t expectedBytes = 0;
+        for (size_t i = 0; i < ingestor.GetShardCount(); ++i)
+        {
+            IShard & shard = ingestor.GetShard(i);
+            expectedBytes +=
+                shard.GetSliceBuffers().size() * shard.GetSliceBufferSize();
+        }
+        EXPECT_GT(expectedBytes, 0u);
+        EXPECT_EQ(expectedBytes, ingestor.GetUsedCapacityInBytes());
     }
 
 
@@ -257,4 +281,488 @@ namespace BitFunnel
         EXPECT_EQ(docFreqHistogram[21], 1u);
         EXPECT_EQ(docFreqHistogram[31], 1u);
     }
+
+
+    // Creates an empty index with the same configuration as the one created
+    // by Factories::CreatePrimeFactorsIndex().
+    static std::unique_ptr<ISimpleIndex>
+        CreateEmptyPrimeFactorsIndex(IFileSystem & fileSystem, DocId maxDocId)
+    {
+        auto termTableCollection = Factories::CreateTermTableCollection();
+        termTableCollection->AddTermTable(
+            Factories::CreatePrimeFactorsTermTable(maxDocId, c_streamId));
+
+        auto index = Factories::CreateSimpleIndex(fileSystem);
+        index->SetTermTableCollection(std::move(termTableCollection));
+        index->SetSliceBufferAllocator(
+            Factories::CreateSliceBufferAllocator(20000, 512));
+        index->ConfigureAsMock(1, false);
+        index->StartIndex();
+
+        return index;
+    }
+
+
+    // Verifies that two documents have the same bits in every row.
+    static void VerifySameBits(DocumentHandle expected,
+                               DocumentHandle observed,
+                               ITermTable const & termTable)
+    {
+        for (Rank rank = 0; rank <= c_maxRankValue; ++rank)
+        {
+            for (RowIndex row = 0; row < termTable.GetTotalRowCount(rank); ++row)
+            {
+                ASSERT_EQ(expected.GetBit(RowId(rank, row)),
+                          observed.GetBit(RowId(rank, row)));
+            }
+        }
+    }
+
+
+    TEST(Ingestor, Snapshot)
+    {
+        const DocId c_maxDocId = 1000;
+        const DocId c_deletedDocId = 7;
+
+        auto fileSystem = Factories::CreateRAMFileSystem();
+        auto fileManager =
+            Factories::CreateFileManager(".", ".", ".", *fileSystem);
+
+        auto original = Factories::CreatePrimeFactorsIndex(*fileSystem,
+                                                           c_maxDocId,
+                                                           c_streamId);
+        IIngestor & originalIngestor = original->GetIngestor();
+        originalIngestor.Delete(c_deletedDocId);
+        originalIngestor.WriteSnapshot(*fileManager);
+
+        auto loaded = CreateEmptyPrimeFactorsIndex(*fileSystem, c_maxDocId);
+        IIngestor & loadedIngestor = loaded->GetIngestor();
+        loadedIngestor.LoadSnapshot(*fileManager);
+
+        // Documents in the partially filled active slice are not part of the
+        // snapshot.
+        const size_t loadedCount = loadedIngestor.GetDocumentCount();
+        EXPECT_GT(loadedCount, 0u);
+        EXPECT_LT(loadedCount, originalIngestor.GetDocumentCount());
+        EXPECT_FALSE(loadedIngestor.Contains(c_deletedDocId));
+        EXPECT_FALSE(loadedIngestor.Contains(c_maxDocId));
+
+        for (DocId id = 0; id < loadedCount + 1; ++id)
+        {
+            EXPECT_EQ(id != c_deletedDocId, loadedIngestor.Contains(id));
+        }
+
+        // Re-ingest the documents which were not restored. The index must
+        // then hold the same documents as the original.
+        for (DocId id = 0; id <= c_maxDocId; ++id)
+        {
+            if (id != c_deletedDocId && !loadedIngestor.Contains(id))
+            {
+                auto document =
+                    Factories::CreatePrimeFactorsDocument(
+                        loaded->GetConfiguration(),
+                        id,
+                        c_maxDocId,
+                        c_streamId);
+                loadedIngestor.Add(id, *document);
+            }
+        }
+
+        ASSERT_EQ(originalIngestor.GetDocumentCount(),
+                  loadedIngestor.GetDocumentCount());
+
+        for (DocId id = 0; id <= c_maxDocId; ++id)
+        {
+            if (id != c_deletedDocId)
+            {
+                VerifySameBits(originalIngestor.GetHandle(id),
+                               loadedIngestor.GetHandle(id),
+                               loaded->GetTermTable0());
+            }
+        }
+
+        // Documents in loaded slices can be deleted.
+        EXPECT_TRUE(loadedIngestor.Delete(1));
+        EXPECT_FALSE(loadedIngestor.Contains(1));
+
+        // An index with a different slice layout cannot load the snapshot.
+        auto incompatible = CreateEmptyPrimeFactorsIndex(*fileSystem,
+                                                         c_maxDocId * 2);
+        EXPECT_ANY_THROW(incompatible->GetIngestor().LoadSnapshot(*fileManager));
+    }
+
+
+    // Returns the slice buffer which holds the document with the given id.
+    static void* GetSliceBuffer(IIngestor const & ingestor, DocId id)
+    {
+        DocumentHandleInternal handle(ingestor.GetHandle(id));
+        return Factories::GetSliceBuffer(&handle.GetSlice());
+    }
+
+
+    // Deletes three quarters of the documents in the shard's first slice
+    // buffer. Returns the ids of the remaining documents in that buffer.
+    static std::vector<DocId> DeleteMostOfFirstSlice(IIngestor & ingestor,
+                                                     DocId maxDocId)
+    {
+        void* buffer = ingestor.GetShard(0).GetSliceBuffers()[0];
+
+        std::vector<DocId> remaining;
+        unsigned count = 0;
+        for (DocId id = 0; id <= maxDocId; ++id)
+        {
+            if (ingestor.Contains(id) && GetSliceBuffer(ingestor, id) == buffer)
+            {
+                if (count++ % 4 == 0)
+                {
+                    remaining.push_back(id);
+                }
+                else
+                {
+                    ingestor.Delete(id);
+                }
+            }
+        }
+
+        return remaining;
+    }
+
+
+    TEST(Ingestor, Compact)
+    {
+        const DocId c_maxDocId = 1000;
+
+        auto fileSystem = Factories::CreateRAMFileSystem();
+        auto reference = Factories::CreatePrimeFactorsIndex(*fileSystem,
+                                                            c_maxDocId,
+                                                            c_streamId);
+        auto index = Factories::CreatePrimeFactorsIndex(*fileSystem,
+                                                        c_maxDocId,
+                                                        c_streamId);
+        IIngestor & ingestor = index->GetIngestor();
+        IShard & shard = ingestor.GetShard(0);
+
+        const size_t sliceCount = shard.GetSliceBuffers().size();
+        ASSERT_GT(sliceCount, 2u);
+
+        // No slice has enough expired documents.
+        EXPECT_EQ(0u, ingestor.Compact(0.5));
+
+        void* victim = shard.GetSliceBuffers()[0];
+        const std::vector<DocId> remaining =
+            DeleteMostOfFirstSlice(ingestor, c_maxDocId);
+        ASSERT_FALSE(remaining.empty());
+        const size_t documentCount = ingestor.GetDocumentCount();
+
+        EXPECT_EQ(0u, ingestor.Compact(0.9));
+        EXPECT_EQ(1u, ingestor.Compact(0.5));
+        EXPECT_EQ(0u, ingestor.Compact(0.5));
+
+        // The compacted slice has been removed from the shard, and its
+        // documents were packed into the active slice.
+        auto const & buffers = shard.GetSliceBuffers();
+        EXPECT_TRUE(std::find(buffers.begin(), buffers.end(), victim) ==
+                    buffers.end());
+        EXPECT_LE(buffers.size(), sliceCount);
+        EXPECT_EQ(documentCount, ingestor.GetDocumentCount());
+
+        // Moved documents keep their rank 0 bits. Higher rank bits are
+        // shared with neighbouring columns, so they may gain bits but never
+        // lose them.
+        ITermTable const & termTable = index->GetTermTable0();
+        for (DocId id : remaining)
+        {
+            ASSERT_TRUE(ingestor.Contains(id));
+            EXPECT_NE(victim, GetSliceBuffer(ingestor, id));
+
+            DocumentHandle expected = reference->GetIngestor().GetHandle(id);
+            DocumentHandle observed = ingestor.GetHandle(id);
+            EXPECT_EQ(id, observed.GetDocId());
+            for (Rank rank = 0; rank <= c_maxRankValue; ++rank)
+            {
+                for (RowIndex row = 0; row < termTable.GetTotalRowCount(rank); ++row)
+                {
+                    if (rank == 0)
+                    {
+                        ASSERT_EQ(expected.GetBit(RowId(rank, row)),
+                                  observed.GetBit(RowId(rank, row)));
+                    }
+                    else if (expected.GetBit(RowId(rank, row)))
+                    {
+                        ASSERT_TRUE(observed.GetBit(RowId(rank, row)));
+                    }
+                }
+            }
+        }
+
+        // Moved documents can be deleted.
+        EXPECT_TRUE(ingestor.Delete(remaining.front()));
+        EXPECT_FALSE(ingestor.Contains(remaining.front()));
+
+        // The background compactor picks up the next slice.
+        auto compactor = std::async(std::launch::async,
+                                    &IIngestor::RunCompactor,
+                                    &ingestor,
+                                    0.5,
+                                    1u);
+
+        void* nextVictim = shard.GetSliceBuffers()[0];
+        DeleteMostOfFirstSlice(ingestor, c_maxDocId);
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            const Token token = ingestor.GetTokenManager().RequestToken();
+            auto const & current = shard.GetSliceBuffers();
+            if (std::find(current.begin(), current.end(), nextVictim) == current.end())
+            {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        ingestor.Shutdown();
+        compactor.wait();
+
+        auto const & finalBuffers = shard.GetSliceBuffers();
+        EXPECT_TRUE(std::find(finalBuffers.begin(), finalBuffers.end(), nextVictim) ==
+                    finalBuffers.end());
+    }
+
+
+    // Adds the documents with ids in [first, last) to the index.
+    static void AddDocuments(ISimpleIndex & index,
+                             DocId first,
+                             DocId last,
+                             DocId maxDocId)
+    {
+        for (DocId id = first; id < last; ++id)
+        {
+            auto document =
+                Factories::CreatePrimeFactorsDocument(index.GetConfiguration(),
+                                                      id,
+                                                      maxDocId,
+                                                      c_streamId);
+            index.GetIngestor().Add(id, *document);
+        }
+    }
+
+
+    TEST(Ingestor, Groups)
+    {
+        const DocId c_maxDocId = 1000;
+
+        auto fileSystem = Factories::CreateRAMFileSystem();
+        auto index = CreateEmptyPrimeFactorsIndex(*fileSystem, c_maxDocId);
+        IIngestor & ingestor = index->GetIngestor();
+        IShard & shard = ingestor.GetShard(0);
+
+        // Documents 0-99 are not in a group, 100-399 are in group 1, 400-499
+        // in group 2 and 500-549 are not in a group.
+        AddDocuments(*index, 0, 100, c_maxDocId);
+        ingestor.OpenGroup(1);
+        AddDocuments(*index, 100, 400, c_maxDocId);
+        ingestor.OpenGroup(2);
+        AddDocuments(*index, 400, 500, c_maxDocId);
+        ingestor.CloseGroup();
+        AddDocuments(*index, 500, 550, c_maxDocId);
+
+        EXPECT_ANY_THROW(ingestor.OpenGroup(1));
+        EXPECT_ANY_THROW(ingestor.OpenGroup(c_noGroupId));
+        EXPECT_ANY_THROW(ingestor.ExpireGroup(3));
+
+        // Each slice holds documents from a single group.
+        std::unordered_map<void*, bool> isGroup1Buffer;
+        for (DocId id = 0; id < 550; ++id)
+        {
+            const bool isGroup1 = (id >= 100 && id < 400);
+            auto it = isGroup1Buffer.insert(
+                std::make_pair(GetSliceBuffer(ingestor, id), isGroup1));
+            ASSERT_EQ(isGroup1, it.first->second);
+        }
+
+        size_t group1BufferCount = 0;
+        for (auto const & entry : isGroup1Buffer)
+        {
+            group1BufferCount += entry.second ? 1 : 0;
+        }
+        ASSERT_GT(group1BufferCount, 0u);
+
+        const size_t sliceCount = shard.GetSliceBuffers().size();
+        const size_t usedBytes = ingestor.GetUsedCapacityInBytes();
+
+        ingestor.ExpireGroup(1);
+
+        EXPECT_EQ(250u, ingestor.GetDocumentCount());
+        EXPECT_EQ(sliceCount - group1BufferCount, shard.GetSliceBuffers().size());
+        EXPECT_EQ(usedBytes - group1BufferCount * shard.GetSliceBufferSize(),
+                  ingestor.GetUsedCapacityInBytes());
+        for (DocId id = 0; id < 550; ++id)
+        {
+            const bool isGroup1 = (id >= 100 && id < 400);
+            EXPECT_EQ(!isGroup1, ingestor.Contains(id));
+        }
+        EXPECT_FALSE(ingestor.Delete(100));
+
+        // Expiring a group again has no effect.
+        ingestor.ExpireGroup(1);
+        EXPECT_EQ(250u, ingestor.GetDocumentCount());
+
+        // An open group cannot be expired.
+        ingestor.OpenGroup(4);
+        AddDocuments(*index, 550, 560, c_maxDocId);
+        EXPECT_ANY_THROW(ingestor.ExpireGroup(4));
+        ingestor.CloseGroup();
+
+        // Group ids increase, so a skipped id cannot be opened later.
+        EXPECT_ANY_THROW(ingestor.OpenGroup(3));
+
+        // Documents deleted individually are skipped when their group is
+        // expired.
+        EXPECT_TRUE(ingestor.Delete(400));
+        ingestor.ExpireGroup(2);
+        ingestor.ExpireGroup(4);
+        EXPECT_EQ(150u, ingestor.GetDocumentCount());
+        for (DocId id = 0; id < 560; ++id)
+        {
+            EXPECT_EQ(id < 100 || (id >= 500 && id < 550),
+                      ingestor.Contains(id));
+        }
+
+        // Documents which are not in a group are still served and can be
+        // added after groups were expired.
+        AddDocuments(*index, 560, 600, c_maxDocId);
+        EXPECT_EQ(190u, ingestor.GetDocumentCount());
+        EXPECT_TRUE(ingestor.Delete(0));
+        EXPECT_FALSE(ingestor.Contains(0));
+    }
+
+
+    TEST(Ingestor, AddBatch)
+    {
+        const DocId c_maxDocId = 1000;
+
+        auto fileSystem = Factories::CreateRAMFileSystem();
+        auto reference = Factories::CreatePrimeFactorsIndex(*fileSystem,
+                                                            c_maxDocId,
+                                                            c_streamId);
+
+        // Adds the documents with ids in [first, last) with AddBatch().
+        auto addBatch = [&](ISimpleIndex & index, DocId first, DocId last)
+        {
+            std::vector<std::unique_ptr<IDocument>> owners;
+            std::vector<std::pair<DocId, IDocument const *>> documents;
+            for (DocId id = first; id < last; ++id)
+            {
+                owners.push_back(
+                    Factories::CreatePrimeFactorsDocument(index.GetConfiguration(),
+                                                          id,
+                                                          c_maxDocId,
+                                                          c_streamId));
+                documents.push_back(std::make_pair(id, owners.back().get()));
+            }
+            index.GetIngestor().AddBatch(documents);
+        };
+
+        // A batch added to an empty index fills whole staged slices and then
+        // the active slice, so each document ends up in the same column as
+        // with Add().
+        auto index = CreateEmptyPrimeFactorsIndex(*fileSystem, c_maxDocId);
+        IIngestor & ingestor = index->GetIngestor();
+        ASSERT_LT(2 * ingestor.GetShard(0).GetSliceCapacity(), c_maxDocId);
+
+        addBatch(*index, 0, c_maxDocId + 1);
+
+        ASSERT_EQ(c_maxDocId + 1, ingestor.GetDocumentCount());
+        EXPECT_EQ(reference->GetIngestor().GetUsedCapacityInBytes(),
+                  ingestor.GetUsedCapacityInBytes());
+        for (DocId id = 0; id <= c_maxDocId; ++id)
+        {
+            ASSERT_TRUE(ingestor.Contains(id));
+            DocumentHandle handle = ingestor.GetHandle(id);
+            EXPECT_TRUE(handle.IsActive());
+            VerifySameBits(reference->GetIngestor().GetHandle(id),
+                           handle,
+                           index->GetTermTable0());
+        }
+
+        // Documents added by a batch can be deleted.
+        EXPECT_TRUE(ingestor.Delete(3));
+        EXPECT_FALSE(ingestor.Contains(3));
+
+        // A batch which follows individual additions continues in the
+        // partially filled active slice.
+        auto mixed = CreateEmptyPrimeFactorsIndex(*fileSystem, c_maxDocId);
+        AddDocuments(*mixed, 0, 10, c_maxDocId);
+        addBatch(*mixed, 10, c_maxDocId + 1);
+        EXPECT_EQ(c_maxDocId + 1, mixed->GetIngestor().GetDocumentCount());
+        for (DocId id = 0; id <= c_maxDocId; ++id)
+        {
+            ASSERT_TRUE(mixed->GetIngestor().Contains(id));
+            EXPECT_EQ(reference->GetIngestor().GetHandle(id).GetBit(RowId(0, 10)),
+                      mixed->GetIngestor().GetHandle(id).GetBit(RowId(0, 10)));
+        }
+
+        // A duplicate DocId is reported after the rest of the batch has been
+        // added.
+        auto duplicates = CreateEmptyPrimeFactorsIndex(*fileSystem, c_maxDocId);
+        AddDocuments(*duplicates, 5, 6, c_maxDocId);
+        EXPECT_ANY_THROW(addBatch(*duplicates, 0, 10));
+        EXPECT_EQ(10u, duplicates->GetIngestor().GetDocumentCount());
+    }
+
+
+    TEST(Ingestor, IndexSnapshot)
+    {
+        const DocId c_maxDocId = 1000;
+
+        auto fileSystem = Factories::CreateRAMFileSystem();
+        auto index = CreateEmptyPrimeFactorsIndex(*fileSystem, c_maxDocId);
+        IIngestor & ingestor = index->GetIngestor();
+
+        AddDocuments(*index, 0, 100, c_maxDocId);
+
+        IIndexSnapshot const * first = nullptr;
+        {
+            const Token token = ingestor.GetTokenManager().RequestToken();
+            IIndexSnapshot const & snapshot = ingestor.GetSnapshot();
+            ASSERT_EQ(ingestor.GetShardCount(), snapshot.GetShardCount());
+            for (ShardId shard = 0; shard < snapshot.GetShardCount(); ++shard)
+            {
+                EXPECT_EQ(&ingestor.GetShard(shard).GetSliceBuffers(),
+                          &snapshot.GetSliceBuffers(shard));
+            }
+
+            // The snapshot is reused while no Slice is added or removed.
+            EXPECT_EQ(&snapshot, &ingestor.GetSnapshot());
+            first = &snapshot;
+        }
+
+        // Adding enough documents for new Slices replaces the snapshot.
+        AddDocuments(*index, 100, 500, c_maxDocId);
+        {
+            const Token token = ingestor.GetTokenManager().RequestToken();
+            IIndexSnapshot const & snapshot = ingestor.GetSnapshot();
+            EXPECT_NE(first, &snapshot);
+            EXPECT_EQ(&ingestor.GetShard(0).GetSliceBuffers(),
+                      &snapshot.GetSliceBuffers(0));
+        }
+
+        // Slices are only added while documents are ingested, so the Slice
+        // count seen by successive snapshots never decreases.
+        std::thread writer(AddDocuments,
+                           std::ref(*index),
+                           500,
+                           c_maxDocId,
+                           c_maxDocId);
+        size_t sliceCount = 0;
+        for (unsigned i = 0; i < 1000; ++i)
+        {
+            const Token token = ingestor.GetTokenManager().RequestToken();
+            const size_t count = ingestor.GetSnapshot().GetSliceBuffers(0).size();
+            EXPECT_LE(sliceCount, count);
+            sliceCount = count;
+        }
+        writer.join();
+    }
 }
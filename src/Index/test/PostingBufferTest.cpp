@@ -0,0 +1,376 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "BitFunnel/Index/Factories.h"
+#include "BitFunnel/Index/Helpers.h"
+#include "BitFunnel/Index/IRecycler.h"
+#include "BitFunnel/Index/ITermTable.h"
+#include "BitFunnel/Index/Token.h"
+#include "BitFunnel/Utilities/Factories.h"
+#include "DocumentDataSchema.h"
+#include "DocumentHandleInternal.h"
+#include "PostingBuffer.h"
+#include "Shard.h"
+#include "Slice.h"
+#include "TrackingSliceBufferAllocator.h"
+
+
+namespace BitFunnel
+{
+    namespace PostingBufferTest
+    {
+        // Rank 3 rows share each bit between 8 columns, so postings at rank 3
+        // exercise the mapping of a block onto a higher rank quadword.
+        static const Rank c_higherRank = 3;
+
+
+        //*********************************************************************
+        //
+        // Ingests the same postings into two Shards with identical
+        // configurations, through a PostingBuffer in one of them and with
+        // direct calls to RowTableDescriptor::SetBit() in the other, and
+        // then checks that both Shards have the same bits in every row.
+        //
+        //*********************************************************************
+        class PostingBufferComparison
+        {
+        public:
+            PostingBufferComparison()
+              : m_recycler(Factories::CreateRecycler()),
+                m_tokenManager(Factories::CreateTokenManager()),
+                m_termTable(Factories::CreateTermTable())
+            {
+                m_background = std::async(std::launch::async,
+                                          &IRecycler::Run,
+                                          m_recycler.get());
+
+                // The row counts of a rank may only be set if some term has
+                // rows at that rank.
+                m_termTable->OpenTerm();
+                m_termTable->AddRowId(RowId(0, 0));
+                m_termTable->AddRowId(RowId(c_higherRank, 0));
+                m_termTable->CloseTerm(1000ull);
+
+                m_termTable->SetRowCounts(0, 100, 0);
+                m_termTable->SetRowCounts(c_higherRank, 10, 0);
+                m_termTable->SetFactCount(0);
+                m_termTable->Seal();
+
+                const size_t blockSize =
+                    GetMinimumBlockSize(m_schema, *m_termTable);
+                m_allocator.reset(new TrackingSliceBufferAllocator(blockSize));
+
+                m_buffered.reset(new Shard(0,
+                                           *m_recycler,
+                                           *m_tokenManager,
+                                           *m_termTable,
+                                           m_schema,
+                                           *m_allocator,
+                                           blockSize));
+                m_direct.reset(new Shard(1,
+                                         *m_recycler,
+                                         *m_tokenManager,
+                                         *m_termTable,
+                                         m_schema,
+                                         *m_allocator,
+                                         blockSize));
+            }
+
+
+            ~PostingBufferComparison()
+            {
+                m_buffered.reset();
+                m_direct.reset();
+
+                m_tokenManager->Shutdown();
+                m_recycler->Shutdown();
+                m_background.wait();
+            }
+
+
+            // Allocates documentCount documents in each Shard. If staged is
+            // true, the documents in the buffered Shard are allocated as a
+            // batch, so whole Slices are staged and flushed with plain
+            // stores.
+            void Allocate(size_t documentCount, bool staged)
+            {
+                std::vector<DocId> ids;
+                for (DocId id = 0; id < documentCount; ++id)
+                {
+                    ids.push_back(id);
+                    m_directHandles.push_back(m_direct->AllocateDocument(id));
+                }
+
+                if (staged)
+                {
+                    m_bufferedHandles = m_buffered->AllocateDocuments(ids);
+                }
+                else
+                {
+                    for (auto id : ids)
+                    {
+                        m_bufferedHandles.push_back(
+                            m_buffered->AllocateDocument(id));
+                    }
+                }
+                m_staged = staged;
+
+                for (size_t i = 0; i < documentCount; ++i)
+                {
+                    ASSERT_EQ(m_bufferedHandles[i].GetIndex(),
+                              m_directHandles[i].GetIndex());
+                }
+            }
+
+
+            // Adds the postings of the document at position i in the
+            // allocation order.
+            void AddPostings(size_t i, PostingBuffer& buffer)
+            {
+                std::vector<RowId> rows;
+                GetRows(i, rows);
+
+                DocumentHandleInternal const & buffered = m_bufferedHandles[i];
+                DocumentHandleInternal const & direct = m_directHandles[i];
+                for (auto row : rows)
+                {
+                    buffer.Add(buffered.GetSlice(), buffered.GetIndex(), row);
+
+                    Slice& slice = direct.GetSlice();
+                    slice.GetRowTable(row.GetRank()).SetBit(
+                        slice.GetSliceBuffer(),
+                        row.GetIndex(),
+                        direct.GetIndex());
+                }
+            }
+
+
+            // Checks that every row of every document has the same bit in
+            // both Shards.
+            void Verify() const
+            {
+                for (size_t i = 0; i < m_directHandles.size(); ++i)
+                {
+                    DocumentHandleInternal const & buffered = m_bufferedHandles[i];
+                    DocumentHandleInternal const & direct = m_directHandles[i];
+                    for (Rank rank = 0; rank <= c_maxRankValue; ++rank)
+                    {
+                        RowTableDescriptor const & rowTable =
+                            m_direct->GetRowTable(rank);
+                        for (RowIndex row = 0; row < rowTable.GetRowCount(); ++row)
+                        {
+                            ASSERT_EQ(
+                                rowTable.GetBit(buffered.GetSlice().GetSliceBuffer(),
+                                                row,
+                                                buffered.GetIndex()),
+                                rowTable.GetBit(direct.GetSlice().GetSliceBuffer(),
+                                                row,
+                                                direct.GetIndex()))
+                                << "document " << i
+                                << ", rank " << rank
+                                << ", row " << row;
+                        }
+                    }
+                }
+            }
+
+
+            // Releases the documents so that their Slices are recycled.
+            void Release()
+            {
+                ReleaseDirect(*m_direct, m_directHandles);
+                if (m_staged)
+                {
+                    m_buffered->AbandonDocuments(m_bufferedHandles);
+                }
+                else
+                {
+                    ReleaseDirect(*m_buffered, m_bufferedHandles);
+                }
+                m_directHandles.clear();
+                m_bufferedHandles.clear();
+
+                while (m_allocator->GetInUseBuffersCount() != 0u) {}
+            }
+
+
+            Shard const & GetBufferedShard() const
+            {
+                return *m_buffered;
+            }
+
+
+            DocIndex GetSliceCapacity() const
+            {
+                return m_direct->GetSliceCapacity();
+            }
+
+        private:
+            // Postings for the document at position i. Documents have between
+            // one and four rank 0 rows, possibly repeated, and two rows at the
+            // higher rank.
+            void GetRows(size_t i, std::vector<RowId>& rows) const
+            {
+                const RowIndex rowCount = m_direct->GetRowTable(0).GetRowCount();
+                for (size_t k = 0; k <= i % 4; ++k)
+                {
+                    rows.push_back(RowId(0, (i * 7 + k * 13) % rowCount));
+                }
+
+                const RowIndex higherCount =
+                    m_direct->GetRowTable(c_higherRank).GetRowCount();
+                rows.push_back(RowId(c_higherRank, (i / 8) % higherCount));
+                rows.push_back(RowId(c_higherRank, (i % 5) % higherCount));
+            }
+
+
+            static void ReleaseDirect(Shard const & shard,
+                                      std::vector<DocumentHandleInternal>& handles)
+            {
+                const DocIndex sliceCapacity = shard.GetSliceCapacity();
+                for (size_t i = 0; i < handles.size(); i += sliceCapacity)
+                {
+                    for (DocIndex j = 0; j < sliceCapacity; ++j)
+                    {
+                        handles[i].GetSlice().CommitDocument();
+                    }
+                }
+                for (auto & handle : handles)
+                {
+                    handle.Expire();
+                }
+            }
+
+            std::unique_ptr<IRecycler> m_recycler;
+            std::future<void> m_background;
+            std::unique_ptr<ITokenManager> m_tokenManager;
+            std::unique_ptr<ITermTable> m_termTable;
+            DocumentDataSchema m_schema;
+            std::unique_ptr<TrackingSliceBufferAllocator> m_allocator;
+            std::unique_ptr<Shard> m_buffered;
+            std::unique_ptr<Shard> m_direct;
+
+            bool m_staged;
+            std::vector<DocumentHandleInternal> m_bufferedHandles;
+            std::vector<DocumentHandleInternal> m_directHandles;
+        };
+
+
+        // Postings are added in column order, so the buffer flushes at each
+        // 64 column block boundary and once when moving to the second Slice.
+        TEST(PostingBuffer, BlockBoundaries)
+        {
+            PostingBufferComparison comparison;
+            const DocIndex sliceCapacity = comparison.GetSliceCapacity();
+            comparison.Allocate(sliceCapacity * 2, false);
+
+            PostingBuffer buffer(comparison.GetBufferedShard());
+            for (size_t i = 0; i < sliceCapacity * 2; ++i)
+            {
+                comparison.AddPostings(i, buffer);
+            }
+            buffer.Flush();
+
+            comparison.Verify();
+            comparison.Release();
+        }
+
+
+        // Postings alternate between two Slices and revisit blocks which
+        // have already been flushed, so each flushed quadword must be ORed
+        // with the bits already in the Slice.
+        TEST(PostingBuffer, SliceSwitches)
+        {
+            PostingBufferComparison comparison;
+            const DocIndex sliceCapacity = comparison.GetSliceCapacity();
+            comparison.Allocate(sliceCapacity * 2, false);
+
+            PostingBuffer buffer(comparison.GetBufferedShard());
+            for (size_t i = 0; i < sliceCapacity; ++i)
+            {
+                comparison.AddPostings(i, buffer);
+                comparison.AddPostings(sliceCapacity + i, buffer);
+            }
+            for (size_t i = 0; i < sliceCapacity * 2; i += 3)
+            {
+                comparison.AddPostings(i, buffer);
+            }
+            buffer.Flush();
+
+            comparison.Verify();
+            comparison.Release();
+        }
+
+
+        // Flushing into staged Slices uses plain stores rather than
+        // interlocked operations.
+        TEST(PostingBuffer, StagedSlices)
+        {
+            PostingBufferComparison comparison;
+            const DocIndex sliceCapacity = comparison.GetSliceCapacity();
+            comparison.Allocate(sliceCapacity * 2, true);
+
+            PostingBuffer buffer(comparison.GetBufferedShard());
+            for (size_t i = 0; i < sliceCapacity; ++i)
+            {
+                comparison.AddPostings(i, buffer);
+                comparison.AddPostings(sliceCapacity + i, buffer);
+            }
+            buffer.Flush();
+
+            comparison.Verify();
+            comparison.Release();
+        }
+
+
+        // A PostingBuffer which is reused after Flush() must not carry bits
+        // from the previous block into the next one, even when the next
+        // block is at the same position in another Slice.
+        TEST(PostingBuffer, Reuse)
+        {
+            PostingBufferComparison comparison;
+            const DocIndex sliceCapacity = comparison.GetSliceCapacity();
+            comparison.Allocate(sliceCapacity * 2, false);
+
+            PostingBuffer buffer(comparison.GetBufferedShard());
+            for (size_t i = 0; i < sliceCapacity; ++i)
+            {
+                comparison.AddPostings(i, buffer);
+                buffer.Flush();
+                comparison.AddPostings(sliceCapacity + i, buffer);
+                buffer.Flush();
+            }
+
+            // Flushing an empty buffer has no effect.
+            buffer.Flush();
+
+            comparison.Verify();
+            comparison.Release();
+        }
+    }
+}
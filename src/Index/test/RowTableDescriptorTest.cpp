@@ -20,13 +20,125 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
+#include <utility>
+#include <vector>
 
 #include "gtest/gtest.h"
 
+#include "BitFunnel/Index/Factories.h"
+#include "BitFunnel/Index/ITermTable.h"
+#include "BitFunnel/Index/RowIdSequence.h"
+#include "RowTableDescriptor.h"
+
 
 namespace BitFunnel
 {
     TEST(RowTableDescriptor, Placeholder)
     {
     }
+
+
+    TEST(RowTableDescriptor, RowSummary)
+    {
+        auto termTable = Factories::CreateTermTable();
+        const size_t c_explicitRowCount = 130;
+        termTable->SetRowCounts(0,
+                                ITermTable::SystemTerm::Count + c_explicitRowCount,
+                                0);
+        termTable->Seal();
+
+        const DocIndex c_capacity = 4096;
+        const RowIndex rowCount = termTable->GetTotalRowCount(0);
+        RowTableDescriptor rowTable(c_capacity, rowCount, 0, 0, 0);
+
+        std::vector<uint64_t>
+            buffer(RowTableDescriptor::GetBufferSize(c_capacity, rowCount, 0, 0) /
+                   sizeof(uint64_t));
+        void* sliceBuffer = buffer.data();
+        rowTable.Initialize(sliceBuffer, *termTable);
+
+        const RowIndex matchAll =
+            (*RowIdSequence(termTable->GetMatchAllTerm(), *termTable).begin()).GetIndex();
+
+        for (RowIndex row = 0; row < rowCount; ++row)
+        {
+            EXPECT_EQ(rowTable.IsRowEmpty(sliceBuffer, row), row != matchAll);
+        }
+
+        // Setting a bit marks only its own row as non-empty.
+        const RowIndex c_row = rowCount - 1;
+        rowTable.SetBit(sliceBuffer, c_row, 1000);
+        EXPECT_FALSE(rowTable.IsRowEmpty(sliceBuffer, c_row));
+        EXPECT_TRUE(rowTable.IsRowEmpty(sliceBuffer, c_row - 1));
+        EXPECT_NE(rowTable.GetBit(sliceBuffer, c_row, 1000), 0u);
+
+        // The summary is conservative. Clearing the only bit in a row does
+        // not mark the row as empty.
+        rowTable.ClearBit(sliceBuffer, c_row, 1000);
+        EXPECT_EQ(rowTable.GetBit(sliceBuffer, c_row, 1000), 0u);
+        EXPECT_FALSE(rowTable.IsRowEmpty(sliceBuffer, c_row));
+
+        // Row offsets map back to their row indexes.
+        for (RowIndex row = 0; row < rowCount; ++row)
+        {
+            RowIndex index = 0;
+            EXPECT_TRUE(rowTable.TryGetRowIndex(rowTable.GetRowOffset(row), index));
+            EXPECT_EQ(index, row);
+        }
+
+        RowIndex index = 0;
+        EXPECT_FALSE(rowTable.TryGetRowIndex(rowTable.GetRowOffset(1) + 8, index));
+        EXPECT_FALSE(rowTable.TryGetRowIndex(rowTable.GetRowOffset(rowCount), index));
+        EXPECT_FALSE(rowTable.TryGetRowIndex(-64, index));
+    }
+
+
+    TEST(RowTableDescriptor, SetBits)
+    {
+        const DocIndex c_capacity = 4096;
+        const RowIndex rowCount = 8;
+        for (Rank rank : { Rank(0), Rank(3) })
+        {
+            const size_t bufferSize =
+                RowTableDescriptor::GetBufferSize(c_capacity, rowCount, rank, 3);
+            RowTableDescriptor rowTable(c_capacity, rowCount, rank, 3, 0);
+
+            // SetBits() and SetBitExclusive() must set the same bits as
+            // SetBit() does for each column.
+            const std::vector<std::pair<DocIndex, DocIndex>> runs =
+                { { 0, 1 }, { 3, 61 }, { 60, 70 }, { 100, 1000 }, { 0, c_capacity } };
+            for (auto const & run : runs)
+            {
+                std::vector<uint64_t> expected(bufferSize / sizeof(uint64_t));
+                std::vector<uint64_t> combined(bufferSize / sizeof(uint64_t));
+                std::vector<uint64_t> exclusive(bufferSize / sizeof(uint64_t));
+
+                const RowIndex c_row = rowCount - 1;
+                for (DocIndex i = run.first; i < run.first + run.second; ++i)
+                {
+                    rowTable.SetBit(expected.data(), c_row, i);
+                    rowTable.SetBitExclusive(exclusive.data(), c_row, i);
+                }
+                rowTable.SetBits(combined.data(), c_row, run.first, run.second);
+
+                EXPECT_EQ(expected, combined);
+                EXPECT_EQ(expected, exclusive);
+                EXPECT_FALSE(rowTable.IsRowEmpty(combined.data(), c_row));
+            }
+
+            // OrBits() and OrBitsExclusive() take the bits of an aligned
+            // block of 64 columns.
+            std::vector<uint64_t> expected(bufferSize / sizeof(uint64_t));
+            std::vector<uint64_t> combined(bufferSize / sizeof(uint64_t));
+            std::vector<uint64_t> exclusive(bufferSize / sizeof(uint64_t));
+            rowTable.SetBit(expected.data(), 1, 128);
+            rowTable.SetBit(expected.data(), 1, 130);
+            rowTable.SetBit(expected.data(), 1, 191);
+            const uint64_t bits = (1ull << 0) | (1ull << 2) | (1ull << 63);
+            rowTable.OrBits(combined.data(), 1, 128, bits);
+            rowTable.OrBitsExclusive(exclusive.data(), 1, 128, bits);
+            EXPECT_EQ(expected, combined);
+            EXPECT_EQ(expected, exclusive);
+        }
+    }
 }
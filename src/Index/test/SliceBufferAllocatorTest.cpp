@@ -0,0 +1,208 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "BitFunnel/BitFunnelTypes.h"
+#include "BitFunnel/Index/Factories.h"
+#include "BitFunnel/Index/ISliceBufferAllocator.h"
+#include "ElasticSliceBufferAllocator.h"
+
+
+namespace BitFunnel
+{
+    namespace SliceBufferAllocatorTest
+    {
+        static const size_t c_blockSize = 4096;
+        static const size_t c_blockCount = 4;
+        static const size_t c_hugePageSize = 2 * 1024 * 1024;
+
+
+        TEST(SliceBufferAllocator, Basic)
+        {
+            auto allocator =
+                Factories::CreateSliceBufferAllocator(c_blockSize, c_blockCount);
+
+            EXPECT_EQ(c_blockSize, allocator->GetSliceBufferSize());
+
+            void* buffer1 = allocator->Allocate(c_blockSize);
+            void* buffer2 = allocator->Allocate(c_blockSize, 3);
+            EXPECT_NE(buffer1, buffer2);
+
+            allocator->Release(buffer1);
+            allocator->Release(buffer2);
+        }
+
+
+        // Shards 0 and 2 share node 0. Shard 1 is on node -1, which uses the
+        // default memory policy. Works whether or not huge pages are
+        // available.
+        TEST(SliceBufferAllocator, HugePagePerNode)
+        {
+            std::vector<int> shardNumaNodes = { 0, -1, 0 };
+            auto allocator =
+                Factories::CreateSliceBufferAllocator(c_blockSize,
+                                                      c_blockCount,
+                                                      c_hugePageSize,
+                                                      shardNumaNodes);
+
+            EXPECT_EQ(c_blockSize, allocator->GetSliceBufferSize());
+
+            // Each node has its own pool of c_blockCount blocks. Shards 0 and
+            // 2 draw from the same pool.
+            std::vector<void*> node0;
+            for (size_t i = 0; i < c_blockCount; ++i)
+            {
+                node0.push_back(allocator->Allocate(c_blockSize, i % 2 == 0 ? 0 : 2));
+            }
+            EXPECT_ANY_THROW(allocator->Allocate(c_blockSize, 0));
+            EXPECT_ANY_THROW(allocator->Allocate(c_blockSize, 2));
+
+            std::vector<void*> defaultNode;
+            for (size_t i = 0; i < c_blockCount; ++i)
+            {
+                defaultNode.push_back(allocator->Allocate(c_blockSize, 1));
+            }
+            EXPECT_ANY_THROW(allocator->Allocate(c_blockSize, 1));
+
+            // Shard 3 has no entry in shardNumaNodes.
+            EXPECT_ANY_THROW(allocator->Allocate(c_blockSize, 3));
+
+            // Buffers go back to the pool they came from.
+            allocator->Release(node0.back());
+            EXPECT_ANY_THROW(allocator->Allocate(c_blockSize, 1));
+            EXPECT_EQ(node0.back(), allocator->Allocate(c_blockSize, 2));
+
+            uint64_t notFromAllocator = 0;
+            EXPECT_ANY_THROW(allocator->Release(&notFromAllocator));
+
+            for (void* buffer : node0)
+            {
+                allocator->Release(buffer);
+            }
+            for (void* buffer : defaultNode)
+            {
+                allocator->Release(buffer);
+            }
+        }
+
+
+        // Block sizes which are not a multiple of the cache line size are
+        // rounded up so that every block starts on a cache line.
+        TEST(SliceBufferAllocator, HugePageCacheLineAlignment)
+        {
+            const size_t blockSize = c_blockSize + 8;
+            std::vector<int> shardNumaNodes;
+            auto allocator =
+                Factories::CreateSliceBufferAllocator(blockSize,
+                                                      c_blockCount,
+                                                      c_hugePageSize,
+                                                      shardNumaNodes);
+
+            const size_t sliceBufferSize = allocator->GetSliceBufferSize();
+            EXPECT_EQ(c_blockSize + c_bytesPerCacheLine, sliceBufferSize);
+
+            std::vector<void*> buffers;
+            for (size_t i = 0; i < c_blockCount; ++i)
+            {
+                buffers.push_back(allocator->Allocate(sliceBufferSize, i));
+                EXPECT_EQ(0u,
+                          reinterpret_cast<size_t>(buffers.back()) % c_bytesPerCacheLine);
+            }
+
+            for (void* buffer : buffers)
+            {
+                allocator->Release(buffer);
+            }
+        }
+
+
+        TEST(SliceBufferAllocator, ElasticGrowAndShrink)
+        {
+            const size_t c_arenaBlockCount = 2;
+            const size_t c_maxBlockCount = 6;
+            ElasticSliceBufferAllocator allocator(c_blockSize,
+                                                  c_arenaBlockCount,
+                                                  c_maxBlockCount);
+
+            EXPECT_EQ(c_blockSize, allocator.GetSliceBufferSize());
+            EXPECT_EQ(0u, allocator.GetArenaCount());
+            EXPECT_EQ(0u, allocator.GetReservedCapacityInBytes());
+
+            // Arenas are mapped on demand, up to the high-water mark.
+            std::vector<void*> buffers;
+            for (size_t i = 0; i < c_maxBlockCount; ++i)
+            {
+                void* buffer = allocator.Allocate(c_blockSize, i);
+                memset(buffer, 0xFF, c_blockSize);
+                buffers.push_back(buffer);
+                EXPECT_EQ((i + 1) * c_blockSize,
+                          allocator.GetUsedCapacityInBytes());
+                EXPECT_EQ(i / c_arenaBlockCount + 1, allocator.GetArenaCount());
+            }
+            EXPECT_EQ(c_maxBlockCount * c_blockSize,
+                      allocator.GetReservedCapacityInBytes());
+            EXPECT_ANY_THROW(allocator.Allocate(c_blockSize));
+
+            uint64_t notFromAllocator = 0;
+            EXPECT_ANY_THROW(allocator.Release(&notFromAllocator));
+            EXPECT_ANY_THROW(allocator.Release(static_cast<char*>(buffers[0]) + 1));
+
+            // The third arena empties while no other arena has a free block,
+            // so it is kept as a spare.
+            allocator.Release(buffers[4]);
+            allocator.Release(buffers[5]);
+            EXPECT_EQ(3u, allocator.GetArenaCount());
+
+            // The first arena empties while the spare is available, so it is
+            // unmapped.
+            allocator.Release(buffers[0]);
+            allocator.Release(buffers[1]);
+            EXPECT_EQ(2u, allocator.GetArenaCount());
+            EXPECT_EQ(2 * c_blockSize, allocator.GetUsedCapacityInBytes());
+            EXPECT_EQ(4 * c_blockSize, allocator.GetReservedCapacityInBytes());
+
+            // Allocation prefers the fuller of the two remaining arenas.
+            allocator.Release(buffers[3]);
+            EXPECT_EQ(buffers[3], allocator.Allocate(c_blockSize));
+            EXPECT_EQ(2u, allocator.GetArenaCount());
+
+            allocator.Release(buffers[2]);
+            allocator.Release(buffers[3]);
+            EXPECT_EQ(1u, allocator.GetArenaCount());
+            EXPECT_EQ(0u, allocator.GetUsedCapacityInBytes());
+            EXPECT_EQ(c_maxBlockCount * c_blockSize,
+                      allocator.GetPeakUsedCapacityInBytes());
+
+            // The spare's pages were returned to the system, but it is still
+            // usable.
+            void* buffer = allocator.Allocate(c_blockSize);
+            memset(buffer, 0, c_blockSize);
+            allocator.Release(buffer);
+            EXPECT_EQ(1u, allocator.GetArenaCount());
+        }
+    }
+}
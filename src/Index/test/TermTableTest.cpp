@@ -411,6 +411,47 @@ namespace BitFunnel
         }
 
 
+        //*********************************************************************
+        //
+        // Test version numbers.
+        //
+        //*********************************************************************
+
+        TEST(TermTable, Version)
+        {
+            TermTable termTable;
+            uint64_t version = termTable.GetVersion();
+
+            // Each build method changes the version.
+            termTable.OpenTerm();
+            EXPECT_NE(termTable.GetVersion(), version);
+            version = termTable.GetVersion();
+
+            termTable.AddRowId(RowId(0, 0));
+            EXPECT_NE(termTable.GetVersion(), version);
+            version = termTable.GetVersion();
+
+            termTable.CloseTerm(0ull);
+            EXPECT_NE(termTable.GetVersion(), version);
+            version = termTable.GetVersion();
+
+            termTable.Seal();
+            EXPECT_NE(termTable.GetVersion(), version);
+            version = termTable.GetVersion();
+
+            // Readers don't.
+            termTable.GetMaxRankUsed();
+            EXPECT_EQ(termTable.GetVersion(), version);
+
+            // A reloaded TermTable has a different version than the original.
+            std::stringstream stream;
+            termTable.Write(stream);
+            TermTable reloaded(stream);
+            EXPECT_TRUE(reloaded == termTable);
+            EXPECT_NE(reloaded.GetVersion(), version);
+        }
+
+
         //*********************************************************************
         //
         // Test fact rows.
@@ -58,6 +58,13 @@ namespace BitFunnel
     }
 
 
+    void* TrackingSliceBufferAllocator::Allocate(size_t byteSize,
+                                                 ShardId /*shard*/)
+    {
+        return Allocate(byteSize);
+    }
+
+
     void TrackingSliceBufferAllocator::Release(void* buffer)
     {
         std::lock_guard<std::mutex> lock(m_lock);
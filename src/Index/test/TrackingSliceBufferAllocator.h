@@ -41,6 +41,7 @@ namespace BitFunnel
         size_t GetInUseBuffersCount() const;
 
         virtual void* Allocate(size_t byteSize) override;
+        virtual void* Allocate(size_t byteSize, ShardId shard) override;
         virtual void Release(void* buffer) override;
         virtual size_t GetSliceBufferSize() const override;
 
@@ -20,6 +20,8 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
+#include <algorithm>
+#include <emmintrin.h>
 #include <iostream>
 #include <limits>
 
@@ -31,9 +33,17 @@
 #include "ByteCodeInterpreter.h"
 #include "CacheLineRecorder.h"
 #include "LoggerInterfaces/Check.h"
+#include "MatchQuota.h"
 #include "ResultsBuffer.h"
 
 
+// Direct-threaded dispatch relies on the labels-as-values extension which
+// is supported by gcc and clang.
+#ifdef __GNUC__
+#define BITFUNNEL_THREADED_DISPATCH
+#endif
+
+
 namespace BitFunnel
 {
 /*
@@ -55,6 +65,9 @@ Decide on type of Slices
     // ByteCodeInterpreter
     //
     //*************************************************************************
+    const size_t ByteCodeInterpreter::c_maxBlockSize;
+
+
     ByteCodeInterpreter::ByteCodeInterpreter(
         ByteCodeGenerator const & code,
         ResultsBuffer & resultsBuffer,
@@ -65,7 +78,11 @@ Decide on type of Slices
         ptrdiff_t const * rowOffsets,
         IDiagnosticStream * diagnosticStream,
         QueryInstrumentation & instrumentation,
-        CacheLineRecorder * cacheLineRecorder)
+        CacheLineRecorder * cacheLineRecorder,
+        MatchQuota * quota,
+        size_t blockSize,
+        bool threaded,
+        size_t prefetchDistance)
       : m_code(code.GetCode()),
         m_jumpTable(code.GetJumpTable()),
         m_resultsBuffer(resultsBuffer),
@@ -74,11 +91,20 @@ Decide on type of Slices
         m_iterationsPerSlice(iterationsPerSlice),
         m_initialRank(initialRank),
         m_rowOffsets(rowOffsets),
+        m_blockSize(IsBlockCompatible(m_code, initialRank) ?
+                    std::min(blockSize, c_maxBlockSize) : 0),
+        m_prefetchDistance(prefetchDistance),
         m_dedupe(),
         m_diagnosticStream(diagnosticStream),
         m_instrumentation(instrumentation),
-        m_cacheLineRecorder(cacheLineRecorder)
+        m_cacheLineRecorder(cacheLineRecorder),
+        m_quota(quota)
     {
+        if (threaded && m_blockSize == 0)
+        {
+            // Translate m_code into m_threadedCode.
+            RunOneIterationThreaded(nullptr, 0);
+        }
     }
 
 
@@ -89,6 +115,10 @@ Decide on type of Slices
             bool terminate = ProcessOneSlice(i);
             if (terminate)
             {
+                if (i + 1 < m_sliceCount)
+                {
+                    m_quota->MarkTruncated();
+                }
                 return true;
             }
         }
@@ -98,6 +128,48 @@ Decide on type of Slices
     }
 
 
+    bool ByteCodeInterpreter::IsBlockMode() const
+    {
+        return m_blockSize != 0;
+    }
+
+
+    bool ByteCodeInterpreter::IsThreaded() const
+    {
+        return !m_threadedCode.empty();
+    }
+
+
+    bool ByteCodeInterpreter::IsBlockCompatible(
+        std::vector<Instruction> const & code,
+        Rank initialRank)
+    {
+        if (initialRank != 0)
+        {
+            return false;
+        }
+
+        for (auto const & instruction : code)
+        {
+            switch (instruction.GetOpcode())
+            {
+            case Opcode::LeftShiftOffset:
+            case Opcode::RightShiftOffset:
+            case Opcode::IncrementOffset:
+            case Opcode::Constant:
+            case Opcode::Call:
+            case Opcode::Return:
+            case Opcode::Jnz:
+                return false;
+            default:
+                break;
+            }
+        }
+
+        return true;
+    }
+
+
     bool ByteCodeInterpreter::ProcessOneSlice(size_t slice)
     {
         auto sliceBuffer = m_sliceBuffers[slice];
@@ -108,14 +180,52 @@ Decide on type of Slices
             m_cacheLineRecorder->SetBase(sliceBuffer);
         }
 
+        const size_t initialMatchCount = m_resultsBuffer.size();
         bool terminate = false;
 
-        for (size_t i = 0; i < m_iterationsPerSlice; ++i)
+        if (m_blockSize != 0)
         {
-            terminate = RunOneIteration(sliceBuffer, i);
-            if (terminate)
+            for (size_t i = 0; i < m_iterationsPerSlice; i += m_blockSize)
             {
-                break;
+                terminate = RunOneBlock(sliceBuffer,
+                                        i,
+                                        std::min(m_blockSize,
+                                                 m_iterationsPerSlice - i));
+                if (terminate)
+                {
+                    break;
+                }
+            }
+        }
+        else if (!m_threadedCode.empty())
+        {
+            // Decode row pointers for this slice.
+            for (auto & instruction : m_threadedCode)
+            {
+                instruction.m_row =
+                    reinterpret_cast<uint64_t const *>(
+                        reinterpret_cast<char const *>(sliceBuffer) +
+                        instruction.m_rowOffset);
+            }
+
+            for (size_t i = 0; i < m_iterationsPerSlice; ++i)
+            {
+                terminate = RunOneIterationThreaded(sliceBuffer, i);
+                if (terminate)
+                {
+                    break;
+                }
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < m_iterationsPerSlice; ++i)
+            {
+                terminate = RunOneIteration(sliceBuffer, i);
+                if (terminate)
+                {
+                    break;
+                }
             }
         }
 
@@ -123,10 +233,16 @@ Decide on type of Slices
         {
             m_instrumentation.IncrementCacheLineCount(
                 m_cacheLineRecorder->GetCacheLinesAccessed());
+            m_instrumentation.IncrementPrefetchedCacheLineCount(
+                m_cacheLineRecorder->GetCacheLinesPrefetched());
         }
 
-        // false ==> ran to completion.
-        return false;
+        if (m_quota != nullptr)
+        {
+            terminate = m_quota->Add(m_resultsBuffer.size() - initialMatchCount);
+        }
+
+        return terminate;
     }
 
 
@@ -142,6 +258,10 @@ Decide on type of Slices
         auto ip = m_code.data();
         size_t offset = iteration;
 
+        // The prefetch distance scales with the offset as the plan ranks
+        // down and back up.
+        size_t prefetch = m_prefetchDistance;
+
         if (m_diagnosticStream != nullptr &&
             m_diagnosticStream->IsEnabled("bytecode/opcode"))
         {
@@ -182,6 +302,10 @@ Decide on type of Slices
                     {
                         m_cacheLineRecorder->RecordAccess(ptr);
                     }
+                    if (prefetch != 0)
+                    {
+                        Prefetch(rowPtr + ((offset + prefetch) >> delta));
+                    }
 
                     uint64_t value = *ptr;
                     accumulator &= (inverted ? ~value : value);
@@ -209,6 +333,10 @@ Decide on type of Slices
                     {
                         m_cacheLineRecorder->RecordAccess(ptr);
                     }
+                    if (prefetch != 0)
+                    {
+                        Prefetch(rowPtr + ((offset + prefetch) >> delta));
+                    }
 
                     auto value = *ptr;
                     accumulator = (inverted ? ~value : value);
@@ -226,10 +354,12 @@ Decide on type of Slices
                 break;
             case Opcode::LeftShiftOffset:
                 offset <<= row;
+                prefetch <<= row;
                 ip++;
                 break;
             case Opcode::RightShiftOffset:
                 offset >>= row;
+                prefetch >>= row;
                 ip++;
                 break;
             case Opcode::IncrementOffset:
@@ -255,7 +385,7 @@ Decide on type of Slices
             case Opcode::Constant:
                 throw NotImplemented("Constant opcode not implemented.");
             case Opcode::Not:
-                accumulator = !accumulator;
+                accumulator = ~accumulator;
                 ip++;
                 break;
             case Opcode::OrStack:
@@ -320,6 +450,547 @@ Decide on type of Slices
         return terminate;
     }
 
+
+#ifdef BITFUNNEL_THREADED_DISPATCH
+    bool ByteCodeInterpreter::RunOneIterationThreaded(
+        void const * sliceBuffer,
+        size_t iteration)
+    {
+        // Handler addresses, indexed by Opcode. AndRow and LoadRow of
+        // inverted rows have their own handlers which follow Opcode::Last.
+        static void * const c_handlers[] = {
+            &&AndRow,
+            &&LoadRow,
+            &&LeftShiftOffset,
+            &&RightShiftOffset,
+            &&IncrementOffset,
+            &&Push,
+            &&Pop,
+            &&AndStack,
+            &&Constant,
+            &&Not,
+            &&OrStack,
+            &&UpdateFlags,
+            &&Report,
+            &&Call,
+            &&Jmp,
+            &&Jnz,
+            &&Jz,
+            &&Return,
+            &&End,
+            &&Constant,         // Opcode::Last is never generated.
+            &&AndRowInverted,
+            &&LoadRowInverted
+        };
+        static const size_t c_andRowInverted =
+            static_cast<size_t>(Opcode::Last) + 1;
+        static const size_t c_loadRowInverted =
+            static_cast<size_t>(Opcode::Last) + 2;
+
+        if (sliceBuffer == nullptr)
+        {
+            m_threadedCode.resize(m_code.size());
+            for (size_t i = 0; i < m_code.size(); ++i)
+            {
+                Instruction const & instruction = m_code[i];
+                ThreadedInstruction & threaded = m_threadedCode[i];
+
+                size_t handler = static_cast<size_t>(instruction.GetOpcode());
+                if (instruction.IsInverted())
+                {
+                    if (instruction.GetOpcode() == Opcode::AndRow)
+                    {
+                        handler = c_andRowInverted;
+                    }
+                    else if (instruction.GetOpcode() == Opcode::LoadRow)
+                    {
+                        handler = c_loadRowInverted;
+                    }
+                }
+                threaded.m_handler = c_handlers[handler];
+
+                threaded.m_rowOffset = 0;
+                threaded.m_row = nullptr;
+                threaded.m_delta = instruction.GetDelta();
+                threaded.m_shift = 0;
+                threaded.m_target = nullptr;
+
+                switch (instruction.GetOpcode())
+                {
+                case Opcode::AndRow:
+                case Opcode::LoadRow:
+                    threaded.m_rowOffset = m_rowOffsets[instruction.GetRow()];
+                    break;
+                case Opcode::LeftShiftOffset:
+                case Opcode::RightShiftOffset:
+                    threaded.m_shift = instruction.GetRow();
+                    break;
+                case Opcode::Call:
+                case Opcode::Jmp:
+                case Opcode::Jnz:
+                case Opcode::Jz:
+                    threaded.m_target =
+                        m_threadedCode.data() +
+                        (m_jumpTable[instruction.GetRow()] - m_code.data());
+                    break;
+                default:
+                    break;
+                }
+            }
+
+            return false;
+        }
+
+        const size_t base = iteration << m_initialRank;
+
+        uint64_t accumulator = 0ull;
+        ThreadedInstruction const * ip = m_threadedCode.data();
+        size_t offset = iteration;
+        size_t prefetch = m_prefetchDistance;
+
+        goto *ip->m_handler;
+
+    AndRow:
+        {
+            m_instrumentation.IncrementQuadwordCount();
+            auto ptr = ip->m_row + (offset >> ip->m_delta);
+            if (m_cacheLineRecorder != nullptr)
+            {
+                m_cacheLineRecorder->RecordAccess(ptr);
+            }
+            if (prefetch != 0)
+            {
+                Prefetch(ip->m_row + ((offset + prefetch) >> ip->m_delta));
+            }
+            accumulator &= *ptr;
+            ++ip;
+            goto *ip->m_handler;
+        }
+
+    AndRowInverted:
+        {
+            m_instrumentation.IncrementQuadwordCount();
+            auto ptr = ip->m_row + (offset >> ip->m_delta);
+            if (m_cacheLineRecorder != nullptr)
+            {
+                m_cacheLineRecorder->RecordAccess(ptr);
+            }
+            if (prefetch != 0)
+            {
+                Prefetch(ip->m_row + ((offset + prefetch) >> ip->m_delta));
+            }
+            accumulator &= ~*ptr;
+            ++ip;
+            goto *ip->m_handler;
+        }
+
+    LoadRow:
+        {
+            m_instrumentation.IncrementQuadwordCount();
+            auto ptr = ip->m_row + (offset >> ip->m_delta);
+            if (m_cacheLineRecorder != nullptr)
+            {
+                m_cacheLineRecorder->RecordAccess(ptr);
+            }
+            if (prefetch != 0)
+            {
+                Prefetch(ip->m_row + ((offset + prefetch) >> ip->m_delta));
+            }
+            accumulator = *ptr;
+            ++ip;
+            goto *ip->m_handler;
+        }
+
+    LoadRowInverted:
+        {
+            m_instrumentation.IncrementQuadwordCount();
+            auto ptr = ip->m_row + (offset >> ip->m_delta);
+            if (m_cacheLineRecorder != nullptr)
+            {
+                m_cacheLineRecorder->RecordAccess(ptr);
+            }
+            if (prefetch != 0)
+            {
+                Prefetch(ip->m_row + ((offset + prefetch) >> ip->m_delta));
+            }
+            accumulator = ~*ptr;
+            ++ip;
+            goto *ip->m_handler;
+        }
+
+    LeftShiftOffset:
+        offset <<= ip->m_shift;
+        prefetch <<= ip->m_shift;
+        ++ip;
+        goto *ip->m_handler;
+
+    RightShiftOffset:
+        offset >>= ip->m_shift;
+        prefetch >>= ip->m_shift;
+        ++ip;
+        goto *ip->m_handler;
+
+    IncrementOffset:
+        offset++;
+        ++ip;
+        goto *ip->m_handler;
+
+    Push:
+        m_valueStack.push_back(accumulator);
+        ++ip;
+        goto *ip->m_handler;
+
+    Pop:
+        accumulator = m_valueStack.back();
+        m_valueStack.pop_back();
+        ++ip;
+        goto *ip->m_handler;
+
+    AndStack:
+        accumulator &= m_valueStack.back();
+        m_valueStack.pop_back();
+        ++ip;
+        goto *ip->m_handler;
+
+    Constant:
+        throw NotImplemented("Constant opcode not implemented.");
+
+    Not:
+        accumulator = ~accumulator;
+        ++ip;
+        goto *ip->m_handler;
+
+    OrStack:
+        accumulator |= m_valueStack.back();
+        m_valueStack.pop_back();
+        ++ip;
+        goto *ip->m_handler;
+
+    UpdateFlags:
+        m_zeroFlag = (m_valueStack.back() == 0);
+        ++ip;
+        goto *ip->m_handler;
+
+    Report:
+        if (accumulator != 0)
+        {
+            AddResult(accumulator, offset, base);
+        }
+        ++ip;
+        goto *ip->m_handler;
+
+    Call:
+        m_threadedCallStack.push_back(ip + 1);
+        ip = ip->m_target;
+        goto *ip->m_handler;
+
+    Jmp:
+        ip = ip->m_target;
+        goto *ip->m_handler;
+
+    Jnz:
+        ip = (accumulator != 0ull) ? ip->m_target : ip + 1;
+        goto *ip->m_handler;
+
+    Jz:
+        ip = (accumulator == 0ull) ? ip->m_target : ip + 1;
+        goto *ip->m_handler;
+
+    Return:
+        ip = m_threadedCallStack.back();
+        m_threadedCallStack.pop_back();
+        goto *ip->m_handler;
+
+    End:
+        return FinishIteration(base, sliceBuffer);
+    }
+#else
+    bool ByteCodeInterpreter::RunOneIterationThreaded(
+        void const * sliceBuffer,
+        size_t iteration)
+    {
+        // Direct-threaded dispatch is not available. Leaving m_threadedCode
+        // empty selects the switch statement in RunOneIteration().
+        if (sliceBuffer != nullptr)
+        {
+            return RunOneIteration(sliceBuffer, iteration);
+        }
+        return false;
+    }
+#endif
+
+
+    static const size_t c_quadwordsPerCacheLine =
+        c_bytesPerCacheLine / sizeof(uint64_t);
+
+
+    //
+    // SIMD helpers for block mode. Each helper processes two quadwords per
+    // SSE2 operation, followed by a scalar step for an odd final quadword.
+    //
+
+    static void AndBlock(uint64_t * accumulator,
+                         uint64_t const * values,
+                         size_t count,
+                         bool inverted)
+    {
+        size_t i = 0;
+        for (; i + 2 <= count; i += 2)
+        {
+            __m128i* a = reinterpret_cast<__m128i*>(accumulator + i);
+            const __m128i v =
+                _mm_loadu_si128(reinterpret_cast<__m128i const *>(values + i));
+            _mm_storeu_si128(a, inverted ?
+                                _mm_andnot_si128(v, _mm_loadu_si128(a)) :
+                                _mm_and_si128(v, _mm_loadu_si128(a)));
+        }
+        for (; i < count; ++i)
+        {
+            accumulator[i] &= (inverted ? ~values[i] : values[i]);
+        }
+    }
+
+
+    static void LoadBlock(uint64_t * accumulator,
+                          uint64_t const * values,
+                          size_t count,
+                          bool inverted)
+    {
+        const __m128i mask = inverted ? _mm_set1_epi32(-1) : _mm_setzero_si128();
+
+        size_t i = 0;
+        for (; i + 2 <= count; i += 2)
+        {
+            const __m128i v =
+                _mm_loadu_si128(reinterpret_cast<__m128i const *>(values + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(accumulator + i),
+                             _mm_xor_si128(v, mask));
+        }
+        for (; i < count; ++i)
+        {
+            accumulator[i] = (inverted ? ~values[i] : values[i]);
+        }
+    }
+
+
+    static void OrBlock(uint64_t * accumulator,
+                        uint64_t const * values,
+                        size_t count)
+    {
+        size_t i = 0;
+        for (; i + 2 <= count; i += 2)
+        {
+            __m128i* a = reinterpret_cast<__m128i*>(accumulator + i);
+            const __m128i v =
+                _mm_loadu_si128(reinterpret_cast<__m128i const *>(values + i));
+            _mm_storeu_si128(a, _mm_or_si128(v, _mm_loadu_si128(a)));
+        }
+        for (; i < count; ++i)
+        {
+            accumulator[i] |= values[i];
+        }
+    }
+
+
+    static void NotBlock(uint64_t * accumulator, size_t count)
+    {
+        const __m128i ones = _mm_set1_epi32(-1);
+
+        size_t i = 0;
+        for (; i + 2 <= count; i += 2)
+        {
+            __m128i* a = reinterpret_cast<__m128i*>(accumulator + i);
+            _mm_storeu_si128(a, _mm_xor_si128(_mm_loadu_si128(a), ones));
+        }
+        for (; i < count; ++i)
+        {
+            accumulator[i] = ~accumulator[i];
+        }
+    }
+
+
+    static bool IsZeroBlock(uint64_t const * accumulator, size_t count)
+    {
+        __m128i any = _mm_setzero_si128();
+
+        size_t i = 0;
+        for (; i + 2 <= count; i += 2)
+        {
+            any = _mm_or_si128(
+                any,
+                _mm_loadu_si128(reinterpret_cast<__m128i const *>(accumulator + i)));
+        }
+
+        const int zeroBytes =
+            _mm_movemask_epi8(_mm_cmpeq_epi8(any, _mm_setzero_si128()));
+        if (zeroBytes != 0xffff)
+        {
+            return false;
+        }
+
+        return (i == count) || (accumulator[i] == 0);
+    }
+
+
+    bool ByteCodeInterpreter::RunOneBlock(
+        void const * voidSliceBuffer,
+        size_t iteration,
+        size_t count)
+    {
+        char const * sliceBuffer =
+            reinterpret_cast<char const *>(voidSliceBuffer);
+
+        // Entry i holds the accumulator for iteration + i.
+        uint64_t accumulator[c_maxBlockSize];
+
+        // Holds row data for rows whose rank is above rank 0.
+        uint64_t expanded[c_maxBlockSize];
+
+        auto ip = m_code.data();
+
+        while (ip->GetOpcode() != Opcode::End)
+        {
+            const Opcode opcode = ip->GetOpcode();
+
+            switch (opcode)
+            {
+            case Opcode::AndRow:
+            case Opcode::LoadRow:
+                {
+                    m_instrumentation.IncrementQuadwordCount(count);
+                    uint64_t const * rowPtr =
+                        reinterpret_cast<uint64_t const *>(
+                            sliceBuffer + m_rowOffsets[ip->GetRow()]);
+
+                    const unsigned delta = ip->GetDelta();
+                    uint64_t const * values = rowPtr + iteration;
+                    if (delta != 0)
+                    {
+                        // Each quadword of a row at rank delta covers
+                        // 2^delta consecutive rank 0 quadwords.
+                        for (size_t i = 0; i < count; ++i)
+                        {
+                            expanded[i] = rowPtr[(iteration + i) >> delta];
+                        }
+                        values = expanded;
+                    }
+
+                    if (m_cacheLineRecorder != nullptr)
+                    {
+                        for (size_t i = 0; i < count; ++i)
+                        {
+                            m_cacheLineRecorder->RecordAccess(
+                                rowPtr + ((iteration + i) >> delta));
+                        }
+                    }
+
+                    if (m_prefetchDistance != 0)
+                    {
+                        // Prefetch each cache line touched by the block
+                        // m_prefetchDistance iterations ahead.
+                        const size_t first = iteration + m_prefetchDistance;
+                        const size_t last = (first + count - 1) >> delta;
+                        for (size_t q = first >> delta;
+                             q <= last;
+                             q = (q | (c_quadwordsPerCacheLine - 1)) + 1)
+                        {
+                            Prefetch(rowPtr + q);
+                        }
+                    }
+
+                    if (opcode == Opcode::AndRow)
+                    {
+                        AndBlock(accumulator, values, count, ip->IsInverted());
+                    }
+                    else
+                    {
+                        LoadBlock(accumulator, values, count, ip->IsInverted());
+                    }
+                    ip++;
+                }
+                break;
+            case Opcode::Push:
+                m_blockStack.insert(m_blockStack.end(),
+                                    accumulator,
+                                    accumulator + count);
+                ip++;
+                break;
+            case Opcode::Pop:
+                std::copy(m_blockStack.end() - static_cast<ptrdiff_t>(count),
+                          m_blockStack.end(),
+                          accumulator);
+                m_blockStack.resize(m_blockStack.size() - count);
+                ip++;
+                break;
+            case Opcode::AndStack:
+                AndBlock(accumulator,
+                         m_blockStack.data() + m_blockStack.size() - count,
+                         count,
+                         false);
+                m_blockStack.resize(m_blockStack.size() - count);
+                ip++;
+                break;
+            case Opcode::Not:
+                NotBlock(accumulator, count);
+                ip++;
+                break;
+            case Opcode::OrStack:
+                OrBlock(accumulator,
+                        m_blockStack.data() + m_blockStack.size() - count,
+                        count);
+                m_blockStack.resize(m_blockStack.size() - count);
+                ip++;
+                break;
+            case Opcode::UpdateFlags:
+                m_zeroFlag = IsZeroBlock(accumulator, count);
+                ip++;
+                break;
+            case Opcode::Report:
+                for (size_t i = 0; i < count; ++i)
+                {
+                    if (accumulator[i] != 0)
+                    {
+                        AddResult(accumulator[i], iteration + i, iteration);
+                    }
+                }
+                ip++;
+                break;
+            case Opcode::Jmp:
+                ip = m_jumpTable[ip->GetRow()];
+                break;
+            case Opcode::Jz:
+                // The branch is taken only when the entire block is zero.
+                // Falling through with some zero entries is safe because
+                // AndRow and AndStack keep them zero and Report skips them.
+                if (IsZeroBlock(accumulator, count))
+                {
+                    ip = m_jumpTable[ip->GetRow()];
+                }
+                else
+                {
+                    ip++;
+                }
+                break;
+            default:
+                RecoverableError error("ByteCodeInterpreter:: opcode not supported in block mode.");
+                throw error;
+            }  // switch
+        }  // while
+
+        return FinishIteration(iteration, sliceBuffer);
+    }
+
+
+    void ByteCodeInterpreter::Prefetch(uint64_t const * ptr)
+    {
+        _mm_prefetch(reinterpret_cast<char const *>(ptr), _MM_HINT_T0);
+        if (m_cacheLineRecorder != nullptr)
+        {
+            m_cacheLineRecorder->RecordPrefetch(ptr);
+        }
+    }
+
+
     void ByteCodeInterpreter::AddResult(uint64_t accumulator,
                                         size_t offset,
                                         size_t base)
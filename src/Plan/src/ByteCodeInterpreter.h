@@ -36,6 +36,7 @@ namespace BitFunnel
     class ByteCodeGenerator;
     class CacheLineRecorder;
     class IDiagnosticStream;
+    class MatchQuota;
     class QueryInstrumentation;
     class ResultsBuffer;
 
@@ -54,6 +55,24 @@ namespace BitFunnel
     //   4. Construct the ByteCodeInterpreter.
     //   5. Invoke the Run() method.
     //
+    // When constructed with a non-zero blockSize, the interpreter runs plans
+    // that start at rank 0 and never rank down a block of quadwords at a time.
+    // Each instruction is dispatched once per block instead of once per
+    // quadword, and the row and stack opcodes become SIMD loops over the
+    // block. Other plans run one quadword at a time.
+    //
+    // When constructed with threaded set to true, the one-quadword-at-a-time
+    // loop uses direct-threaded dispatch instead of a switch statement. The
+    // sealed instructions are translated into an array of handler addresses
+    // with pre-decoded operands, so that each handler jumps directly to the
+    // next one. This requires the labels-as-values extension of gcc and
+    // clang. Other compilers always use the switch statement.
+    //
+    // When constructed with a non-zero prefetchDistance, each row access is
+    // followed by a software prefetch of the row's quadword prefetchDistance
+    // iterations ahead. Prefetches are reported to the CacheLineRecorder so
+    // that their coverage can be measured.
+    //
     //*************************************************************************
     class ByteCodeInterpreter
     {
@@ -62,7 +81,14 @@ namespace BitFunnel
 
         // Constructs a ByteCodeInterpreter for the sequence of instructions
         // in a specific ByteCodeGenerator. This interpreter will run against
-        // the rows passed as that second parameter.
+        // the rows passed as that second parameter. If quota is not nullptr,
+        // the interpreter stops scanning slices once the quota is exhausted
+        // and marks the quota as truncated if any slices were left.
+        // If blockSize is not zero, the interpreter processes up to blockSize
+        // quadwords per dispatch when the plan allows it. The blockSize is
+        // capped at c_maxBlockSize. If threaded is true, the interpreter uses
+        // direct-threaded dispatch when it is available. The prefetchDistance
+        // is measured in iterations and zero disables prefetching.
         ByteCodeInterpreter(ByteCodeGenerator const & code,
                             ResultsBuffer & resultsBuffer,
                             size_t sliceCount,
@@ -72,7 +98,11 @@ namespace BitFunnel
                             ptrdiff_t const * rowOffsets,
                             IDiagnosticStream * diagnosticStream,
                             QueryInstrumentation & instrumentation,
-                            CacheLineRecorder * cacheLineRecorder);
+                            CacheLineRecorder * cacheLineRecorder,
+                            MatchQuota * quota,
+                            size_t blockSize,
+                            bool threaded,
+                            size_t prefetchDistance);
 
         // Runs the instruction sequence for a specified number of iterations.
         // Each iteration processes a single quadword of row data at the
@@ -80,6 +110,19 @@ namespace BitFunnel
         // termination.
         bool Run();
 
+        // Returns true if the interpreter processes a block of quadwords per
+        // dispatch. This is the case when the constructor's blockSize was not
+        // zero and the plan starts at rank 0 and never ranks down.
+        bool IsBlockMode() const;
+
+        // Returns true if the interpreter uses direct-threaded dispatch. This
+        // is never the case in block mode.
+        bool IsThreaded() const;
+
+        // Largest number of quadwords processed per dispatch in block mode.
+        // Limited by the 64 entry dedupe buffer.
+        static const size_t c_maxBlockSize = 64;
+
         // Virtual machine opcodes. With the exception of the End opcode,
         // these values have a 1:1 correspondance with the ICodeGenerator
         // methods.
@@ -175,13 +218,57 @@ namespace BitFunnel
         };
 
     private:
-        //  Returns true to indicate early termination.
+        // Direct-threaded form of an Instruction. The handler is the address
+        // of the code that implements the instruction.
+        class ThreadedInstruction
+        {
+        public:
+            void * m_handler;
+
+            // Row offset and delta for AndRow and LoadRow. The row pointer
+            // is set from the row offset at the start of each slice.
+            ptrdiff_t m_rowOffset;
+            uint64_t const * m_row;
+            unsigned m_delta;
+
+            // Shift amount for LeftShiftOffset and RightShiftOffset.
+            unsigned m_shift;
+
+            // Target of Call, Jmp, Jnz, and Jz.
+            ThreadedInstruction const * m_target;
+        };
+
+        // Returns true to indicate early termination. This happens when the
+        // MatchQuota is exhausted after the slice has been processed.
         bool ProcessOneSlice(size_t slice);
 
         // Executes the instruction sequence for the specified iteration
         // number. Returns true to indicate early termination.
         bool RunOneIteration(void const * sliceBuffer, size_t iteration);
 
+        // Executes the instruction sequence once for the count consecutive
+        // iterations starting at iteration. Used in block mode. Returns true
+        // to indicate early termination.
+        bool RunOneBlock(void const * sliceBuffer,
+                         size_t iteration,
+                         size_t count);
+
+        // Same as RunOneIteration(), but runs m_threadedCode. When
+        // sliceBuffer is nullptr, translates m_code into m_threadedCode
+        // instead. The translation lives here because the handler addresses
+        // are only visible inside this method.
+        bool RunOneIterationThreaded(void const * sliceBuffer, size_t iteration);
+
+        // Returns true if code can run in block mode. This requires the plan
+        // to start at rank 0 and to have no opcodes that modify the offset or
+        // branch on a non-zero accumulator.
+        static bool IsBlockCompatible(std::vector<Instruction> const & code,
+                                      Rank initialRank);
+
+        // Issues a software prefetch of the cache line containing ptr and
+        // reports it to the CacheLineRecorder.
+        void Prefetch(uint64_t const * ptr);
+
         // The 'base' parameter has the rank0 quadword position for the start
         // of the current iteration. The accumulator corresponds to position
         // 'base + offset'.
@@ -209,6 +296,15 @@ namespace BitFunnel
 
         ptrdiff_t const * m_rowOffsets;
 
+        // Number of quadwords per block. Zero when not in block mode.
+        size_t m_blockSize;
+
+        // Number of iterations to prefetch ahead. Zero disables prefetching.
+        size_t m_prefetchDistance;
+
+        // Direct-threaded translation of m_code. Empty when not threaded.
+        std::vector<ThreadedInstruction> m_threadedCode;
+
 
         //
         // Virtual machine state.
@@ -217,9 +313,15 @@ namespace BitFunnel
         // Control flow call stack. Holds return addresses for calls.
         std::vector<Instruction const *> m_callStack;
 
+        // Control flow call stack for direct-threaded dispatch.
+        std::vector<ThreadedInstruction const *> m_threadedCallStack;
+
         // 64-bit value stack for Rank0 methods.
         std::vector<uint64_t> m_valueStack;
 
+        // Value stack for block mode. Each Push adds a block of values.
+        std::vector<uint64_t> m_blockStack;
+
         // TODO: Formalize definition and usage of zero flag.
         bool m_zeroFlag;
 
@@ -230,6 +332,7 @@ namespace BitFunnel
         IDiagnosticStream* m_diagnosticStream;
         QueryInstrumentation& m_instrumentation;
         CacheLineRecorder * m_cacheLineRecorder;
+        MatchQuota * m_quota;
     };
 
 
@@ -20,6 +20,7 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
+#include <algorithm>    // std::min().
 #include <cstring>      // memset().
 
 #include "BitFunnel/BitFunnelTypes.h"
@@ -46,13 +47,15 @@ namespace BitFunnel
         // : m_sliceBufferSize(sliceBufferSize),
         : m_base(nullptr)
     {
-        size_t cacheLineCount =
+        m_cacheLineCount =
             RoundUp(sliceBufferSize, c_bytesPerCacheLine) / c_bytesPerCacheLine;
 
         m_bitArraySize =
-            RoundUp(cacheLineCount, c_bitsPerByte) / c_bitsPerByte;
+            RoundUp(m_cacheLineCount, c_bitsPerByte) / c_bitsPerByte;
 
         m_bitArray.reset(new uint8_t[m_bitArraySize]);
+        m_prefetchArray.reset(new uint8_t[m_bitArraySize]());
+        m_coveredArray.reset(new uint8_t[m_bitArraySize]());
     }
 
 
@@ -68,23 +71,69 @@ namespace BitFunnel
         const size_t cacheLineNumber = offset / c_bytesPerCacheLine;
         const size_t byteIndex = cacheLineNumber / c_bitsPerByte;
         const uint8_t bitMask = 1ull << (cacheLineNumber % c_bitsPerByte);
+
+        // A line counts as covered by a prefetch only if the prefetch
+        // happened before the first access.
+        if ((m_bitArray[byteIndex] & bitMask) == 0 &&
+            (m_prefetchArray[byteIndex] & bitMask) != 0)
+        {
+            m_coveredArray[byteIndex] |= bitMask;
+        }
         m_bitArray[byteIndex] |= bitMask;
     }
 
 
-    size_t CacheLineRecorder::GetCacheLinesAccessed() const
+    void CacheLineRecorder::RecordPrefetch(void const * ptr)
     {
-        size_t count = 0;
-        for (size_t i = 0; i < m_bitArraySize; ++i)
+        const size_t cacheLineNumber = GetCacheLineNumber(ptr);
+        if (cacheLineNumber < m_cacheLineCount)
         {
-            count += g_bitsSetTable256[m_bitArray[i]];
+            const size_t byteIndex = cacheLineNumber / c_bitsPerByte;
+            const uint8_t bitMask = 1ull << (cacheLineNumber % c_bitsPerByte);
+            m_prefetchArray[byteIndex] |= bitMask;
         }
-        return count;
+    }
+
+
+    size_t CacheLineRecorder::GetCacheLinesAccessed() const
+    {
+        return CountBits(m_bitArray.get(), m_bitArraySize);
+    }
+
+
+    size_t CacheLineRecorder::GetCacheLinesPrefetched() const
+    {
+        return CountBits(m_coveredArray.get(), m_bitArraySize);
     }
 
 
     void CacheLineRecorder::Reset()
     {
         memset(m_bitArray.get(), 0ull, m_bitArraySize);
+        memset(m_prefetchArray.get(), 0ull, m_bitArraySize);
+        memset(m_coveredArray.get(), 0ull, m_bitArraySize);
+    }
+
+
+    size_t CacheLineRecorder::GetCacheLineNumber(void const * ptr) const
+    {
+        char const * p = static_cast<char const *>(ptr);
+        if (p < m_base)
+        {
+            return m_cacheLineCount;
+        }
+        return std::min(static_cast<size_t>(p - m_base) / c_bytesPerCacheLine,
+                        m_cacheLineCount);
+    }
+
+
+    size_t CacheLineRecorder::CountBits(uint8_t const * bitArray, size_t size)
+    {
+        size_t count = 0;
+        for (size_t i = 0; i < size; ++i)
+        {
+            count += g_bitsSetTable256[bitArray[i]];
+        }
+        return count;
     }
 }
@@ -36,14 +36,38 @@ namespace BitFunnel
         void SetBase(void const * base);
         void RecordAccess(void const * ptr);
 
+        // Records a software prefetch of the cache line containing ptr.
+        // Prefetches outside of the slice buffer are ignored, since the
+        // matcher may prefetch past the end of the last iteration.
+        void RecordPrefetch(void const * ptr);
+
         size_t GetCacheLinesAccessed() const;
 
+        // Returns the number of accessed cache lines that were prefetched
+        // before their first access.
+        size_t GetCacheLinesPrefetched() const;
+
         void Reset();
 
     private:
+        // Returns the index of the cache line containing ptr, relative to
+        // the base. Returns m_cacheLineCount if ptr is outside of the slice
+        // buffer.
+        size_t GetCacheLineNumber(void const * ptr) const;
+
+        static size_t CountBits(uint8_t const * bitArray, size_t size);
+
         // size_t m_sliceBufferSize;
+        size_t m_cacheLineCount;
         size_t m_bitArraySize;
         std::unique_ptr<uint8_t[]> m_bitArray;
+
+        // Lines prefetched since the last Reset().
+        std::unique_ptr<uint8_t[]> m_prefetchArray;
+
+        // Lines whose first access followed a prefetch.
+        std::unique_ptr<uint8_t[]> m_coveredArray;
+
         char const * m_base;
     };
 }
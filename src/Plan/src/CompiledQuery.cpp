@@ -0,0 +1,356 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <algorithm>     // std::min.
+
+#include "BitFunnel/Index/IIndexSnapshot.h"
+#include "BitFunnel/Index/IIngestor.h"
+#include "BitFunnel/Index/ISimpleIndex.h"
+#include "BitFunnel/Index/IShard.h"
+#include "BitFunnel/Index/Token.h"
+#include "BitFunnel/Plan/QueryInstrumentation.h"
+#include "CompiledQuery.h"
+#include "CompileNode.h"
+#include "MatchQuota.h"
+#include "MatchTreeCompiler.h"
+#include "NativeJIT/CodeGen/ExecutionBuffer.h"
+#include "NativeJIT/CodeGen/FunctionBuffer.h"
+#include "ParallelMatcher.h"
+#include "QueryResources.h"
+#include "RegisterAllocator.h"
+#include "ResultsBuffer.h"
+#include "TopKCollector.h"
+
+
+namespace BitFunnel
+{
+    //*************************************************************************
+    //
+    // CompiledQuery
+    //
+    //*************************************************************************
+    CompiledQuery::CompiledQuery(RowMatchNode const & matchTree,
+                                 CompileNode const & compileTree,
+                                 Rank initialRank,
+                                 IRowSet const & rowSet,
+                                 bool useNativeCode,
+                                 bool ownsCode,
+                                 QueryResources & resources)
+      : m_initialRank(initialRank),
+        m_useNativeCode(useNativeCode),
+        m_rowOffsets(rowSet),
+        m_sliceFilter(matchTree)
+    {
+        if (useNativeCode)
+        {
+            // Perform register allocation on the compile tree.
+            RegisterAllocator const registers(compileTree,
+                                              rowSet.GetRowCount(),
+                                              c_registerBase,
+                                              c_registerCount,
+                                              resources.GetMatchTreeAllocator());
+
+            if (ownsCode)
+            {
+                m_codeAllocator.reset(
+                    new NativeJIT::ExecutionBuffer(c_codeAllocatorBytes));
+                m_codeBuffer.reset(
+                    new NativeJIT::FunctionBuffer(*m_codeAllocator,
+                                                  static_cast<unsigned>(c_codeAllocatorBytes)));
+                m_compiler.reset(
+                    new MatchTreeCompiler(resources.GetExpressionTreeAllocator(),
+                                          *m_codeBuffer,
+                                          compileTree,
+                                          registers,
+                                          initialRank,
+                                          resources.GetVectorIsa(),
+                                          resources.GetPrefetchDistance()));
+            }
+            else
+            {
+                m_compiler.reset(new MatchTreeCompiler(resources,
+                                                       compileTree,
+                                                       registers,
+                                                       initialRank));
+            }
+        }
+        else
+        {
+            compileTree.Compile(m_code);
+            m_code.Seal();
+        }
+    }
+
+
+    CompiledQuery::~CompiledQuery()
+    {
+    }
+
+
+    void CompiledQuery::Run(ISimpleIndex const & index,
+                            QueryResources & resources,
+                            QueryInstrumentation & instrumentation,
+                            ResultsBuffer & results) const
+    {
+        TopKCollector * topK = resources.GetTopK();
+        if (topK != nullptr)
+        {
+            topK->Reset();
+        }
+
+        MatchQuota * quota = resources.GetMatchQuota();
+        if (quota != nullptr)
+        {
+            quota->Start();
+        }
+
+        // Get token before we GetSnapshot.
+        {
+            auto token = index.GetIngestor().GetTokenManager().RequestToken();
+
+            // All shards are matched against the same view of the index.
+            IIndexSnapshot const & snapshot = index.GetIngestor().GetSnapshot();
+
+            // Matches from all shards accumulate in results.
+            results.Reset();
+
+            // Skip the slices where the query's required rows are empty.
+            SliceFilter const * filter =
+                (resources.IsSliceFilteringEnabled() && !m_sliceFilter.IsTrivial()) ?
+                &m_sliceFilter : nullptr;
+
+            size_t matchCount = 0;
+            if (UseParallelMatcher(resources))
+            {
+                ParallelMatcher matcher(index,
+                                        snapshot,
+                                        m_initialRank,
+                                        m_rowOffsets,
+                                        filter,
+                                        resources.GetMatcherThreadCount());
+                if (m_useNativeCode)
+                {
+                    matchCount = matcher.Run(*m_compiler, instrumentation, results, topK, quota);
+                }
+                else
+                {
+                    matchCount = matcher.Run(m_code,
+                                             resources.GetInterpreterBlockSize(),
+                                             resources.IsInterpreterThreaded(),
+                                             resources.GetPrefetchDistance(),
+                                             instrumentation,
+                                             results,
+                                             topK,
+                                             quota);
+                }
+            }
+            else
+            {
+                for (ShardId shardId = 0; shardId < index.GetIngestor().GetShardCount(); ++shardId)
+                {
+                    auto & shard = index.GetIngestor().GetShard(shardId);
+
+                    std::vector<void*> candidates;
+                    if (filter != nullptr)
+                    {
+                        filter->Filter(shard,
+                                       snapshot.GetSliceBuffers(shardId),
+                                       m_rowOffsets.GetRowOffsets(shardId),
+                                       candidates);
+                    }
+                    auto & sliceBuffers =
+                        (filter == nullptr) ? snapshot.GetSliceBuffers(shardId) : candidates;
+
+                    // Shards with no slices to scan don't truncate the query.
+                    if (quota != nullptr && quota->IsExhausted())
+                    {
+                        if (!sliceBuffers.empty())
+                        {
+                            quota->MarkTruncated();
+                            break;
+                        }
+                        continue;
+                    }
+
+                    // Iterations per slice calculation.
+                    auto iterationsPerSlice = shard.GetSliceCapacity() >> 6 >> m_initialRank;
+
+                    // When scoring, match a few slices at a time so that the
+                    // ResultsBuffer never holds every match in the shard.
+                    const size_t batchSize =
+                        (topK == nullptr) ? sliceBuffers.size() : c_scoringBatchSliceCount;
+
+                    for (size_t start = 0; start < sliceBuffers.size(); start += batchSize)
+                    {
+                        bool terminated =
+                            RunSlices(shardId,
+                                      std::min(batchSize, sliceBuffers.size() - start),
+                                      sliceBuffers.data() + start,
+                                      iterationsPerSlice,
+                                      resources,
+                                      instrumentation,
+                                      results);
+
+                        if (topK != nullptr)
+                        {
+                            matchCount += results.size();
+                            topK->AddResults(results);
+                            results.Reset();
+                        }
+
+                        if (terminated)
+                        {
+                            if (start + batchSize < sliceBuffers.size())
+                            {
+                                quota->MarkTruncated();
+                            }
+                            break;
+                        }
+                    }
+                }
+
+                if (topK == nullptr)
+                {
+                    matchCount = results.size();
+                }
+            }
+
+            instrumentation.FinishMatching();
+            instrumentation.SetMatchCount(matchCount);
+            instrumentation.SetTruncated(quota != nullptr && quota->IsTruncated());
+        } // End of token lifetime.
+    }
+
+
+    bool CompiledQuery::RunSlices(ShardId shardId,
+                                  size_t sliceCount,
+                                  void * const * sliceBuffers,
+                                  size_t iterationsPerSlice,
+                                  QueryResources & resources,
+                                  QueryInstrumentation & instrumentation,
+                                  ResultsBuffer & results) const
+    {
+        MatchQuota * quota = resources.GetMatchQuota();
+
+        if (m_useNativeCode)
+        {
+            size_t quadwordCount =
+                m_compiler->Run(sliceCount,
+                                sliceBuffers,
+                                iterationsPerSlice,
+                                m_rowOffsets.GetRowOffsets(shardId),
+                                results,
+                                quota);
+
+            instrumentation.IncrementQuadwordCount(quadwordCount);
+
+            return quota != nullptr && quota->IsExhausted();
+        }
+        else
+        {
+            ByteCodeInterpreter intepreter(m_code,
+                                           results,
+                                           sliceCount,
+                                           sliceBuffers,
+                                           iterationsPerSlice,
+                                           m_initialRank,
+                                           m_rowOffsets.GetRowOffsets(shardId),
+                                           nullptr,
+                                           instrumentation,
+                                           resources.GetCacheLineRecorder(),
+                                           quota,
+                                           resources.GetInterpreterBlockSize(),
+                                           resources.IsInterpreterThreaded(),
+                                           resources.GetPrefetchDistance());
+
+            return intepreter.Run();
+        }
+    }
+
+
+    Rank CompiledQuery::GetInitialRank() const
+    {
+        return m_initialRank;
+    }
+
+
+    unsigned CompiledQuery::GetRowCount() const
+    {
+        return m_rowOffsets.GetRowCount();
+    }
+
+
+    bool CompiledQuery::UsesNativeCode() const
+    {
+        return m_useNativeCode;
+    }
+
+
+    bool CompiledQuery::UseParallelMatcher(QueryResources const & resources)
+    {
+        // CacheLineRecorder is not thread safe, so cache line counting always
+        // runs the matcher on the query thread.
+        return resources.GetMatcherThreadCount() > 1 &&
+               resources.GetCacheLineRecorder() == nullptr;
+    }
+
+
+    //*************************************************************************
+    //
+    // CompiledQuery::RowOffsets
+    //
+    //*************************************************************************
+    CompiledQuery::RowOffsets::RowOffsets(IRowSet const & rowSet)
+      : m_shardCount(rowSet.GetShardCount()),
+        m_rowCount(rowSet.GetRowCount())
+    {
+        for (ShardId shard = 0; shard < m_shardCount; ++shard)
+        {
+            ptrdiff_t const * offsets = rowSet.GetRowOffsets(shard);
+            m_offsets.insert(m_offsets.end(), offsets, offsets + m_rowCount);
+        }
+    }
+
+
+    void CompiledQuery::RowOffsets::LoadRows()
+    {
+        // Offsets were copied from a RowSet that was already loaded.
+    }
+
+
+    ShardId CompiledQuery::RowOffsets::GetShardCount() const
+    {
+        return m_shardCount;
+    }
+
+
+    unsigned CompiledQuery::RowOffsets::GetRowCount() const
+    {
+        return m_rowCount;
+    }
+
+
+    ptrdiff_t const * CompiledQuery::RowOffsets::GetRowOffsets(ShardId shard) const
+    {
+        return m_offsets.data() + shard * m_rowCount;
+    }
+}
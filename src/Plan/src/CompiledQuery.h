@@ -0,0 +1,168 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <memory>                           // std::unique_ptr embedded.
+#include <stddef.h>                         // ptrdiff_t embedded.
+#include <vector>                           // std::vector embedded.
+
+#include "BitFunnel/BitFunnelTypes.h"       // Rank embedded.
+#include "BitFunnel/NonCopyable.h"          // Base class.
+#include "ByteCodeInterpreter.h"            // ByteCodeGenerator embedded.
+#include "IRowSet.h"                        // Base class.
+#include "SliceFilter.h"                    // SliceFilter embedded.
+
+
+namespace NativeJIT
+{
+    class ExecutionBuffer;
+    class FunctionBuffer;
+}
+
+
+namespace BitFunnel
+{
+    class CompileNode;
+    class ISimpleIndex;
+    class MatchTreeCompiler;
+    class QueryInstrumentation;
+    class QueryResources;
+    class ResultsBuffer;
+    class RowMatchNode;
+
+    //*************************************************************************
+    //
+    // CompiledQuery
+    //
+    // The output of the query planning pipeline: either a sealed
+    // ByteCodeGenerator program or a NativeJIT function, together with the
+    // row offsets for each shard. A CompiledQuery can be run any number of
+    // times against the index it was planned for.
+    //
+    // When ownsCode is false, native code is compiled into the
+    // FunctionBuffer supplied by QueryResources and the CompiledQuery is
+    // only valid until QueryResources::Reset(). When ownsCode is true, the
+    // CompiledQuery has its own code buffer and does not reference
+    // QueryResources after construction. This makes it suitable for the
+    // QueryPlanCache.
+    //
+    // The rewritten match tree is used to build a SliceFilter, which lets
+    // Run() skip slices whose row summaries show that the query's required
+    // rows are empty.
+    //
+    //*************************************************************************
+    class CompiledQuery : NonCopyable
+    {
+    public:
+        CompiledQuery(RowMatchNode const & matchTree,
+                      CompileNode const & compileTree,
+                      Rank initialRank,
+                      IRowSet const & rowSet,
+                      bool useNativeCode,
+                      bool ownsCode,
+                      QueryResources & resources);
+
+        ~CompiledQuery();
+
+        // Runs the matcher over every shard in the index, replacing the
+        // contents of results with the matches. If top-k scoring is enabled
+        // in resources, the matches are scored into resources.GetTopK()
+        // instead and results is left empty. The QueryResources also provide
+        // the CacheLineRecorder and matcher thread count. Run() may be called
+        // concurrently from multiple threads as long as each thread supplies
+        // its own QueryResources, QueryInstrumentation and ResultsBuffer.
+        void Run(ISimpleIndex const & index,
+                 QueryResources & resources,
+                 QueryInstrumentation & instrumentation,
+                 ResultsBuffer & results) const;
+
+        Rank GetInitialRank() const;
+        unsigned GetRowCount() const;
+        bool UsesNativeCode() const;
+
+    private:
+        //*********************************************************************
+        //
+        // RowOffsets
+        //
+        // IRowSet holding a private copy of the row offsets for each shard.
+        //
+        //*********************************************************************
+        class RowOffsets : public IRowSet
+        {
+        public:
+            RowOffsets(IRowSet const & rowSet);
+
+            virtual void LoadRows() override;
+            virtual ShardId GetShardCount() const override;
+            virtual unsigned GetRowCount() const override;
+            virtual ptrdiff_t const * GetRowOffsets(ShardId shard) const override;
+
+        private:
+            const ShardId m_shardCount;
+            const unsigned m_rowCount;
+            std::vector<ptrdiff_t> m_offsets;
+        };
+
+        // Runs the matcher over a range of slices from one shard, appending
+        // matches to results. Returns true to indicate early termination.
+        bool RunSlices(ShardId shardId,
+                       size_t sliceCount,
+                       void * const * sliceBuffers,
+                       size_t iterationsPerSlice,
+                       QueryResources & resources,
+                       QueryInstrumentation & instrumentation,
+                       ResultsBuffer & results) const;
+
+        // Returns true if the matcher should be run across multiple threads
+        // with the ParallelMatcher.
+        static bool UseParallelMatcher(QueryResources const & resources);
+
+        const Rank m_initialRank;
+        const bool m_useNativeCode;
+        RowOffsets m_rowOffsets;
+        SliceFilter m_sliceFilter;
+
+        ByteCodeGenerator m_code;
+
+        std::unique_ptr<NativeJIT::ExecutionBuffer> m_codeAllocator;
+        std::unique_ptr<NativeJIT::FunctionBuffer> m_codeBuffer;
+        std::unique_ptr<MatchTreeCompiler> m_compiler;
+
+        // Number of slices matched between scoring passes when top-k scoring
+        // is enabled on the sequential matcher.
+        static const size_t c_scoringBatchSliceCount = 16;
+
+        // Size of the code buffer for CompiledQueries that own their code.
+        // Matches the QueryResources default.
+        static const size_t c_codeAllocatorBytes = 1ull << 16;
+
+        // First available row pointer register is R8.
+        // TODO: is this valid on all platforms or only on Windows?
+        static const unsigned c_registerBase = 8;
+
+        // Row pointers stored in the eight registers R8..R15.
+        // TODO: is this valid on all platforms or only on Windows?
+        static const unsigned c_registerCount = 8;
+    };
+}
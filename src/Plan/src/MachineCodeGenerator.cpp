@@ -20,6 +20,8 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
+#include <limits>       // std::numeric_limits.
+
 #include "LoggerInterfaces/Check.h"
 #include "MachineCodeGenerator.h"
 #include "NativeCodeGenerator.h"
@@ -47,10 +49,13 @@ namespace BitFunnel
 
 
     MachineCodeGenerator::MachineCodeGenerator(RegisterAllocator const & registers,
-                                               FunctionBuffer & code)
+                                               FunctionBuffer & code,
+                                               size_t prefetchDistance)
       : m_registers(registers),
         m_code(code),
-        m_pushCount(0)
+        m_pushCount(0),
+        m_prefetchDistance(prefetchDistance),
+        m_rankShift(0)
     {
     }
 
@@ -89,12 +94,14 @@ namespace BitFunnel
                     // Case 1: rankDelta > 0 && !inverted && IsRegister
                     m_code.Emit<OpCode::Add>(rax, rdx);
                     unsigned reg = m_registers.GetRegister(id);
+                    Prefetch(rax.GetId(), reg, rankDelta);
                     m_code.Emit<OpCode::And>(rbx, rax, Register<8u, false>(reg), SIB::Scale1, 0);
                 }
                 else
                 {
                     // Case 2: rankDelta > 0 && !inverted && !IsRegister
                     m_code.Emit<OpCode::Add>(rax, rsi, id * 8);
+                    Prefetch(rax.GetId(), rdx.GetId(), rankDelta);
                     m_code.Emit<OpCode::And>(rbx, rax, rdx, SIB::Scale1, 0);
                 }
             }
@@ -105,12 +112,14 @@ namespace BitFunnel
                     // Case 3: rankDelta > 0 && inverted && IsRegister
                     m_code.Emit<OpCode::Add>(rax, rdx);
                     unsigned reg = m_registers.GetRegister(id);
+                    Prefetch(rax.GetId(), reg, rankDelta);
                     m_code.Emit<OpCode::Mov>(rax, rax, Register<8u, false>(reg), SIB::Scale1, 0);
                 }
                 else
                 {
                     // Case 4: rankDelta > 0 && inverted && !IsRegister
                     m_code.Emit<OpCode::Add>(rax, rsi, id * 8);
+                    Prefetch(rax.GetId(), rdx.GetId(), rankDelta);
                     m_code.Emit<OpCode::Mov>(rax, rax, rdx, SIB::Scale1, 0);
                 }
 
@@ -127,6 +136,7 @@ namespace BitFunnel
                 {
                     // Case 5: rankDelta == 0 && !inverted && IsRegister
                     unsigned reg = m_registers.GetRegister(id);
+                    Prefetch(rcx.GetId(), reg, 0);
                     m_code.Emit<OpCode::And>(rbx, rcx, Register<8u, false>(reg), SIB::Scale1, 0);
                 }
                 else
@@ -134,6 +144,7 @@ namespace BitFunnel
                     // Case 6: rankDelta == 0 && !inverted && !IsRegister
                     m_code.Emit<OpCode::Mov>(rax, rcx);
                     m_code.Emit<OpCode::Add>(rax, rsi, id * 8);
+                    Prefetch(rax.GetId(), rsp.GetId(), 0);
                     m_code.Emit<OpCode::And>(rbx, rax, 0);
                 }
             }
@@ -144,6 +155,7 @@ namespace BitFunnel
                 {
                     // Case 7: rankDelta == 0 && inverted && IsRegister
                     unsigned reg = m_registers.GetRegister(id);
+                    Prefetch(rcx.GetId(), reg, 0);
                     m_code.Emit<OpCode::Mov>(rax, rcx, Register<8u, false>(reg), SIB::Scale1, 0);
                 }
                 else
@@ -151,6 +163,7 @@ namespace BitFunnel
                     // Case 8: rankDelta == 0 && inverted && !IsRegister
                     m_code.Emit<OpCode::Mov>(rax, rcx);
                     m_code.Emit<OpCode::Add>(rax, rsi, id * 8);
+                    Prefetch(rax.GetId(), rsp.GetId(), 0);
                     m_code.Emit<OpCode::Mov>(rax, rax, 0);
                 }
 
@@ -189,12 +202,14 @@ namespace BitFunnel
                 // Case 1: rankDelta > 0, IsRegister
                 m_code.Emit<OpCode::Add>(rax, rdx);
                 unsigned reg = m_registers.GetRegister(id);
+                Prefetch(rax.GetId(), reg, rankDelta);
                 m_code.Emit<OpCode::Mov>(rbx, rax, Register<8u, false>(reg), SIB::Scale1, 0);
             }
             else
             {
                 // Case 2: rankDelta > 0, !IsRegister
                 m_code.Emit<OpCode::Add>(rax, rsi, id * 8);
+                Prefetch(rax.GetId(), rdx.GetId(), rankDelta);
                 m_code.Emit<OpCode::Mov>(rbx, rax, rdx, SIB::Scale1, 0);
             }
         }
@@ -204,6 +219,7 @@ namespace BitFunnel
             {
                 // Case 3: rankDelta == 0, IsRegister
                 unsigned reg = m_registers.GetRegister(id);
+                Prefetch(rcx.GetId(), reg, 0);
                 m_code.Emit<OpCode::Mov>(rbx, rcx, Register<8u, false>(reg), SIB::Scale1, 0);
             }
             else
@@ -211,6 +227,7 @@ namespace BitFunnel
                 // Case 4: rankDelta == 0, !IsRegister
                 m_code.Emit<OpCode::Mov>(rax, rcx);
                 m_code.Emit<OpCode::Add>(rax, rsi, id * 8);
+                Prefetch(rax.GetId(), rsp.GetId(), 0);
                 m_code.Emit<OpCode::Mov>(rbx, rax, 0);
             }
         }
@@ -229,6 +246,8 @@ namespace BitFunnel
 
     void MachineCodeGenerator::LeftShiftOffset(size_t shift)
     {
+        m_rankShift += shift;
+
         // Decode the offset into RCX, adjust for the shift and then encode it back.
         m_code.Emit<OpCode::Sub>(rcx, rdx);
         m_code.EmitImmediate<OpCode::Shl>(rcx, static_cast<uint8_t>(shift));
@@ -238,6 +257,8 @@ namespace BitFunnel
 
     void MachineCodeGenerator::RightShiftOffset(size_t shift)
     {
+        m_rankShift -= shift;
+
         // Decode the offset into RCX, adjust for the shift and then encode it back.
         m_code.Emit<OpCode::Sub>(rcx, rdx);
         m_code.EmitImmediate<OpCode::Shr>(rcx, static_cast<uint8_t>(shift + 3));
@@ -391,4 +412,43 @@ namespace BitFunnel
     {
         return c_slotCount;
     }
+
+
+    void MachineCodeGenerator::EmitPrefetch(FunctionBuffer & code,
+                                            unsigned base,
+                                            unsigned index,
+                                            int32_t displacement)
+    {
+        // REX prefix is needed only for R8..R15.
+        const uint8_t rex = static_cast<uint8_t>(0x40 |
+                                                 ((index >> 3) & 1) << 1 |
+                                                 ((base >> 3) & 1));
+        if (rex != 0x40)
+        {
+            code.Emit8(rex);
+        }
+
+        // 0F 18 /1 with mod = 10 (32-bit displacement) and a SIB byte with
+        // scale 1. An index of 100 (RSP) means no index.
+        code.Emit8(0x0f);
+        code.Emit8(0x18);
+        code.Emit8(static_cast<uint8_t>(0x80 | (1 << 3) | 4));
+        code.Emit8(static_cast<uint8_t>(((index & 7) << 3) | (base & 7)));
+        code.Emit32(static_cast<uint32_t>(displacement));
+    }
+
+
+    void MachineCodeGenerator::Prefetch(unsigned base,
+                                        unsigned index,
+                                        size_t rankDelta)
+    {
+        const size_t quadwords = (m_prefetchDistance << m_rankShift) >> rankDelta;
+        if (quadwords == 0 ||
+            quadwords > static_cast<size_t>(std::numeric_limits<int32_t>::max()) / 8)
+        {
+            return;
+        }
+
+        EmitPrefetch(m_code, base, index, static_cast<int32_t>(quadwords * 8));
+    }
 }
@@ -54,8 +54,11 @@ namespace BitFunnel
         // Constructs a MachineCodeGenerator which generates X64 code using the
         // supplied X64FunctionGenerator. The registers parameter supplies a
         // RegisterAllocator that provides register assignments for some rows.
+        // When prefetchDistance is not zero, each row access is preceded by a
+        // prefetch of the row's quadword prefetchDistance iterations ahead.
         MachineCodeGenerator(RegisterAllocator const & registers,
-                             FunctionBuffer & code);
+                             FunctionBuffer & code,
+                             size_t prefetchDistance);
 
         //
         // ICodeGenerator methods
@@ -111,6 +114,13 @@ namespace BitFunnel
         // FinishIterationHelper() methods.
         static unsigned GetSlotCount();
 
+        // Emits prefetcht0 [base + index + displacement]. Pass rsp as the
+        // index for an address without an index register.
+        static void EmitPrefetch(FunctionBuffer & code,
+                                 unsigned base,
+                                 unsigned index,
+                                 int32_t displacement);
+
     protected:
         //
         // Constructor parameters
@@ -128,6 +138,20 @@ namespace BitFunnel
         // more information.
         unsigned m_pushCount;
 
+        // Number of iterations to prefetch ahead. Zero disables prefetching.
+        const size_t m_prefetchDistance;
+
+        // Number of ranks the offset in RCX is currently shifted below the
+        // plan's initial rank. Tracked statically because the RankDown
+        // compiler emits each LeftShiftOffset() before the code it applies to
+        // and the matching RightShiftOffset() after it.
+        size_t m_rankShift;
+
+        // Emits a prefetch of [base + index] advanced by m_prefetchDistance
+        // iterations for a row at rankDelta. Emits nothing if prefetching is
+        // disabled or the distance rounds down to zero quadwords.
+        void Prefetch(unsigned base, unsigned index, size_t rankDelta);
+
         // First available row pointer register is R8.
         static const unsigned c_registerBase = 8;
 
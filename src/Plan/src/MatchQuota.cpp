@@ -0,0 +1,111 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <limits>
+
+#include "MatchQuota.h"
+
+
+namespace BitFunnel
+{
+    //*************************************************************************
+    //
+    // MatchQuota
+    //
+    //*************************************************************************
+    MatchQuota::MatchQuota(size_t maxMatchCount, double timeBudget)
+      : m_maxMatchCount(maxMatchCount),
+        m_timeBudget(timeBudget),
+        m_matchCount(0),
+        m_exhausted(false),
+        m_truncated(false)
+    {
+    }
+
+
+    void MatchQuota::Start()
+    {
+        m_stopwatch.Reset();
+        m_matchCount = 0;
+        m_exhausted = false;
+        m_truncated = false;
+    }
+
+
+    bool MatchQuota::Add(size_t matchCount)
+    {
+        m_matchCount += matchCount;
+        return IsExhausted();
+    }
+
+
+    bool MatchQuota::IsExhausted()
+    {
+        if (m_exhausted)
+        {
+            return true;
+        }
+
+        if ((m_maxMatchCount > 0 && m_matchCount >= m_maxMatchCount) ||
+            (m_timeBudget > 0.0 && m_stopwatch.ElapsedTime() >= m_timeBudget))
+        {
+            m_exhausted = true;
+        }
+
+        return m_exhausted;
+    }
+
+
+    void MatchQuota::MarkTruncated()
+    {
+        m_truncated = true;
+    }
+
+
+    bool MatchQuota::IsTruncated() const
+    {
+        return m_truncated;
+    }
+
+
+    size_t MatchQuota::GetRemainingMatchCount() const
+    {
+        if (m_maxMatchCount == 0)
+        {
+            return std::numeric_limits<size_t>::max();
+        }
+
+        const size_t matchCount = m_matchCount;
+        return (matchCount >= m_maxMatchCount) ? 0 : m_maxMatchCount - matchCount;
+    }
+
+
+    size_t MatchQuota::GetMaxMatchCount() const
+    {
+        return m_maxMatchCount;
+    }
+
+
+    double MatchQuota::GetTimeBudget() const
+    {
+        return m_timeBudget;
+    }
+}
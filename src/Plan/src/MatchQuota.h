@@ -0,0 +1,95 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+
+#include <atomic>                               // std::atomic embedded.
+#include <stddef.h>                             // size_t embedded.
+
+#include "BitFunnel/NonCopyable.h"              // Base class.
+#include "BitFunnel/Utilities/Stopwatch.h"      // Stopwatch embedded.
+
+
+namespace BitFunnel
+{
+    //*************************************************************************
+    //
+    // MatchQuota
+    //
+    // Early termination policy for the matcher. Matching stops once the
+    // query has produced maxMatchCount matches or has spent timeBudget
+    // seconds matching, whichever comes first. A value of zero disables the
+    // corresponding limit.
+    //
+    // The quota is checked between slices, so a query may overshoot
+    // maxMatchCount by up to one slice's worth of matches per matcher
+    // thread. Matches from every slice that was scanned are kept.
+    //
+    // A query is truncated only if matching stopped with slices still left
+    // to scan. The matchers report this by calling MarkTruncated(), so a
+    // query whose last slice brings the match count to exactly
+    // maxMatchCount is not truncated.
+    //
+    // Add(), IsExhausted() and MarkTruncated() are thread safe so that the
+    // workers of a ParallelMatcher can share a single quota.
+    //
+    //*************************************************************************
+    class MatchQuota : NonCopyable
+    {
+    public:
+        MatchQuota(size_t maxMatchCount, double timeBudget);
+
+        // Clears the match count and the truncated flag and restarts the
+        // time budget. Call before matching each query.
+        void Start();
+
+        // Records matchCount new matches. Returns true if matching should
+        // stop.
+        bool Add(size_t matchCount);
+
+        // Returns true if matching should stop. Once this returns true, it
+        // keeps returning true until the next call to Start().
+        bool IsExhausted();
+
+        // Records that matching stopped early, leaving slices unscanned.
+        void MarkTruncated();
+
+        // Returns true if MarkTruncated() was called during the current
+        // query.
+        bool IsTruncated() const;
+
+        // Returns the number of matches remaining before the match count
+        // limit is reached.
+        size_t GetRemainingMatchCount() const;
+
+        size_t GetMaxMatchCount() const;
+        double GetTimeBudget() const;
+
+    private:
+        const size_t m_maxMatchCount;
+        const double m_timeBudget;
+
+        Stopwatch m_stopwatch;
+        std::atomic<size_t> m_matchCount;
+        std::atomic<bool> m_exhausted;
+        std::atomic<bool> m_truncated;
+    };
+}
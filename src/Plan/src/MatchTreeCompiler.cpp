@@ -21,7 +21,11 @@
 // THE SOFTWARE.
 
 
+#include <algorithm>     // std::min.
+#include <limits>        // std::numeric_limits.
+
 #include "BitFunnel/Utilities/Allocator.h"
+#include "MatchQuota.h"
 #include "MatchTreeCompiler.h"
 #include "NativeJIT/CodeGen/ExecutionBuffer.h"
 #include "QueryResources.h"
@@ -37,13 +41,34 @@ namespace BitFunnel
     // MatchTreeCompiler
     //
     //*************************************************************************
+    const size_t MatchTreeCompiler::c_quotaBatchSliceCount;
+
+
     MatchTreeCompiler::MatchTreeCompiler(QueryResources & resources,
                                          CompileNode const & tree,
                                          RegisterAllocator const & registers,
                                          Rank initialRank)
+      : MatchTreeCompiler(resources.GetExpressionTreeAllocator(),
+                          resources.GetCode(),
+                          tree,
+                          registers,
+                          initialRank,
+                          resources.GetVectorIsa(),
+                          resources.GetPrefetchDistance())
+    {
+    }
+
+
+    MatchTreeCompiler::MatchTreeCompiler(NativeJIT::Allocator & expressionTreeAllocator,
+                                         NativeJIT::FunctionBuffer & code,
+                                         CompileNode const & tree,
+                                         RegisterAllocator const & registers,
+                                         Rank initialRank,
+                                         VectorIsa vectorIsa,
+                                         size_t prefetchDistance)
+      : m_initialRank(initialRank)
     {
-        NativeCodeGenerator::Prototype expression(resources.GetExpressionTreeAllocator(),
-                                                  resources.GetCode());
+        NativeCodeGenerator::Prototype expression(expressionTreeAllocator, code);
         // TODO: Remove temporary debugging output.
         //expression.EnableDiagnostics(std::cout);
 
@@ -51,8 +76,17 @@ namespace BitFunnel
             expression.PlacementConstruct<NativeCodeGenerator>(expression,
                                                                tree,
                                                                registers,
-                                                               initialRank);
+                                                               initialRank,
+                                                               vectorIsa,
+                                                               prefetchDistance);
         m_function = expression.Compile(node);
+        m_vectorIsa = node.GetVectorIsa();
+    }
+
+
+    VectorIsa MatchTreeCompiler::GetVectorIsa() const
+    {
+        return m_vectorIsa;
     }
 
 
@@ -60,7 +94,76 @@ namespace BitFunnel
                                   void * const * sliceBuffers,
                                   size_t iterationsPerSlice,
                                   ptrdiff_t const * rowOffsets,
-                                  ResultsBuffer & results)
+                                  ResultsBuffer & results,
+                                  MatchQuota * quota) const
+    {
+        // Upper bound on the number of matches in a single slice.
+        const size_t matchesPerSlice = iterationsPerSlice << 6 << m_initialRank;
+
+        size_t quadwordCount = 0;
+        while (sliceCount > 0)
+        {
+            if (quota != nullptr && quota->IsExhausted())
+            {
+                quota->MarkTruncated();
+                break;
+            }
+
+            size_t batchSize = (results.m_capacity - results.m_size) / matchesPerSlice;
+            if (batchSize == 0)
+            {
+                results.Reserve(results.m_size + matchesPerSlice);
+                batchSize = (results.m_capacity - results.m_size) / matchesPerSlice;
+            }
+            batchSize = std::min(batchSize, sliceCount);
+
+            // The native code checks the match limit after each slice. The
+            // time budget can only be checked here, between batches.
+            size_t matchLimit = std::numeric_limits<size_t>::max();
+            if (quota != nullptr)
+            {
+                batchSize = std::min(batchSize, c_quotaBatchSliceCount);
+                const size_t remaining = quota->GetRemainingMatchCount();
+                if (remaining < matchLimit - results.m_size)
+                {
+                    matchLimit = results.m_size + remaining;
+                }
+            }
+
+            const size_t initialMatchCount = results.m_size;
+            size_t unscannedSliceCount = 0;
+            quadwordCount += RunBatch(batchSize,
+                                      sliceBuffers,
+                                      iterationsPerSlice,
+                                      rowOffsets,
+                                      matchLimit,
+                                      results,
+                                      unscannedSliceCount);
+
+            sliceCount -= batchSize;
+            sliceBuffers += batchSize;
+
+            if (quota != nullptr && quota->Add(results.m_size - initialMatchCount))
+            {
+                if (sliceCount + unscannedSliceCount > 0)
+                {
+                    quota->MarkTruncated();
+                }
+                break;
+            }
+        }
+
+        return quadwordCount;
+    }
+
+
+    size_t MatchTreeCompiler::RunBatch(size_t sliceCount,
+                                       void * const * sliceBuffers,
+                                       size_t iterationsPerSlice,
+                                       ptrdiff_t const * rowOffsets,
+                                       size_t matchLimit,
+                                       ResultsBuffer & results,
+                                       size_t & unscannedSliceCount) const
     {
         NativeCodeGenerator::Parameters parameters = {
             sliceCount,
@@ -70,8 +173,10 @@ namespace BitFunnel
             0,
             { 0 },
             results.m_capacity,
-            0,
+            // Append to any matches already in the results buffer.
+            results.m_size,
             results.m_buffer,
+            matchLimit,
             0
         };
 
@@ -98,6 +203,10 @@ namespace BitFunnel
 
         results.m_size = parameters.m_matchCount;
 
+        // The native code counts m_sliceCount down as it scans and leaves
+        // the remainder there if it reaches the match limit.
+        unscannedSliceCount = parameters.m_sliceCount;
+
         return parameters.m_quadwordCount;
     }
 }
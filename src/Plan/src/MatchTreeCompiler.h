@@ -39,6 +39,7 @@ namespace NativeJIT
 namespace BitFunnel
 {
     class CompileNode;
+    class MatchQuota;
     class QueryResources;
     class RegisterAllocator;
     class ResultsBuffer;
@@ -51,18 +52,66 @@ namespace BitFunnel
     class MatchTreeCompiler
     {
     public:
+        // Compiles into the FunctionBuffer provided by resources, using the
+        // VectorIsa and prefetch distance selected in resources. The compiled
+        // code is valid until resources is Reset().
         MatchTreeCompiler(QueryResources & resources,
                           CompileNode const & tree,
                           RegisterAllocator const & registers,
                           Rank initialRank);
 
+        // Compiles into a caller-supplied FunctionBuffer. The compiled code
+        // is valid for the lifetime of the FunctionBuffer. The expression
+        // tree allocator is only used during construction. Plans with an
+        // initial rank of 0 are vectorized with vectorIsa. Rows are
+        // prefetched prefetchDistance iterations ahead when prefetchDistance
+        // is not zero.
+        MatchTreeCompiler(NativeJIT::Allocator & expressionTreeAllocator,
+                          NativeJIT::FunctionBuffer & code,
+                          CompileNode const & tree,
+                          RegisterAllocator const & registers,
+                          Rank initialRank,
+                          VectorIsa vectorIsa,
+                          size_t prefetchDistance);
+
+        // Runs the compiled matcher over the slices, appending matches to
+        // results. The native code cannot grow the ResultsBuffer, so slices
+        // are processed in batches small enough that every document in the
+        // batch could match without overflowing the buffer. The buffer is
+        // grown between batches as needed. If quota is not nullptr, matching
+        // stops after the slice in which the quota is exhausted, and the
+        // quota is marked as truncated if any slices were left. Returns the
+        // number of quadwords processed.
         size_t Run(size_t slicecount,
                    void * const * slicebuffers,
                    size_t iterationsperslice,
                    ptrdiff_t const * rowoffsets,
-                   ResultsBuffer & results);
+                   ResultsBuffer & results,
+                   MatchQuota * quota) const;
+
+        // Returns the instruction set used by the compiled code.
+        VectorIsa GetVectorIsa() const;
 
     private:
+        // Runs the compiled matcher over one batch of slices. The native
+        // code stops after the slice in which the match count reaches
+        // matchLimit, leaving the number of slices it did not scan in
+        // unscannedSliceCount.
+        size_t RunBatch(size_t sliceCount,
+                        void * const * sliceBuffers,
+                        size_t iterationsPerSlice,
+                        ptrdiff_t const * rowOffsets,
+                        size_t matchLimit,
+                        ResultsBuffer & results,
+                        size_t & unscannedSliceCount) const;
+
+        // Number of slices per batch when a quota is in effect. Time budgets
+        // are checked between batches, so this bounds how far a query can
+        // overrun its budget.
+        static const size_t c_quotaBatchSliceCount = 4;
+
         NativeCodeGenerator::Prototype::FunctionType m_function;
+        const Rank m_initialRank;
+        VectorIsa m_vectorIsa;
     };
 }
@@ -33,6 +33,7 @@
 #include "NativeCodeGenerator.h"
 #include "RegisterAllocator.h"
 #include "Temporary/Allocator.h"
+#include "VectorMachineCodeGenerator.h"
 
 
 namespace BitFunnel
@@ -46,15 +47,27 @@ namespace BitFunnel
         Prototype& expression,
         CompileNode const & compileNodeTree,
         RegisterAllocator const & registers,
-        Rank initialRank)
+        Rank initialRank,
+        VectorIsa vectorIsa,
+        size_t prefetchDistance)
       : Node(expression),
         m_compileNodeTree(compileNodeTree),
         m_registers(registers),
-        m_initialRank(initialRank)
+        m_initialRank(initialRank),
+        m_vectorIsa((initialRank == 0 &&
+                     VectorMachineCodeGenerator::IsSupported(compileNodeTree)) ?
+                    vectorIsa : VectorIsa::Scalar),
+        m_prefetchDistance(prefetchDistance)
     {
     }
 
 
+    VectorIsa NativeCodeGenerator::GetVectorIsa() const
+    {
+        return m_vectorIsa;
+    }
+
+
     ExpressionTree::Storage<size_t> NativeCodeGenerator::CodeGenValue(
         ExpressionTree& tree)
     {
@@ -77,11 +90,22 @@ namespace BitFunnel
             }
         }
 
+        auto & code = tree.GetCodeGenerator();
+
         EmitRegisterInitialization(tree);
+        if (m_vectorIsa != VectorIsa::Scalar)
+        {
+            VectorMachineCodeGenerator(m_registers, code, m_vectorIsa, 0).EmitPrologue();
+        }
+
         EmitOuterLoop(tree);
 
+        if (m_vectorIsa != VectorIsa::Scalar)
+        {
+            VectorMachineCodeGenerator(m_registers, code, m_vectorIsa, 0).EmitEpilogue();
+        }
+
         auto result = Storage<size_t>::ForFreeRegister(tree, rax);
-        auto & code = tree.GetCodeGenerator();
 #ifdef QUADWORDCOUNT
         code.Emit<OpCode::Mov>(rax, rdi, NativeCodeGenerator::m_quadwordCount);
 #else
@@ -162,6 +186,11 @@ namespace BitFunnel
         code.EmitImmediate<OpCode::Mov>(rax, 8);
         code.Emit<OpCode::Add>(rdi, m_sliceBuffers, rax);
 
+        // Stop scanning slices once the match limit has been reached.
+        code.Emit<OpCode::Mov>(rax, rdi, m_matchCount);
+        code.Emit<OpCode::Cmp>(rax, rdi, m_matchLimit);
+        code.EmitConditionalJump<JccType::JAE>(bottomOfLoop);
+
         code.Jmp(topOfLoop);
 
         //
@@ -175,20 +204,45 @@ namespace BitFunnel
     {
         auto & code = tree.GetCodeGenerator();
 
+        // rdx: current slice buffer pointer.
+        // rcx: loop counter starts at the current slice buffer pointer.
+        code.Emit<OpCode::Mov>(rdx, rdi, m_sliceBuffers);
+        code.Emit<OpCode::Mov>(rdx, rdx, 0);
+        code.Emit<OpCode::Mov>(rcx, rdx);
+
+        // The vector loop covers as many whole vectors as fit in the row.
+        // The scalar loop then picks up any remaining quadwords.
+        if (m_vectorIsa != VectorIsa::Scalar)
+        {
+            EmitIterationLoop(tree, GetQuadwordsPerVector(m_vectorIsa));
+        }
+        EmitIterationLoop(tree, 1);
+    }
+
+
+    void NativeCodeGenerator::EmitIterationLoop(ExpressionTree& tree,
+                                                size_t quadwordsPerIteration)
+    {
+        auto & code = tree.GetCodeGenerator();
+
         auto topOfLoop = code.AllocateLabel();
         auto bottomOfLoop = code.AllocateLabel();
         auto exitLoop = code.AllocateLabel();
 
-        // Initialize loop counter and limit.
-        //   rcx: loop counter starts at the current slice buffer pointer.
-        //   m_innerLoopLimit: slice buffer pointer + bytes in starting row.
-        code.Emit<OpCode::Mov>(rdx, rdi, m_sliceBuffers);
-        code.Emit<OpCode::Mov>(rdx, rdx, 0);
+        // Initialize loop limit. The loop counter in rcx continues from
+        // where the previous loop left off.
+        //   m_innerLoopLimit: slice buffer pointer + bytes in starting row,
+        //   rounded down to a multiple of the bytes per iteration.
         code.Emit<OpCode::Mov>(rax, rdi, m_iterationsPerSlice);
+        if (quadwordsPerIteration > 1)
+        {
+            code.EmitImmediate<OpCode::And>(
+                rax,
+                -static_cast<int32_t>(quadwordsPerIteration));
+        }
         code.EmitImmediate<OpCode::Shl>(rax, static_cast<uint8_t>(3));
         code.Emit<OpCode::Add>(rax, rdx);
         CodeGenHelpers::Emit<OpCode::Mov>(code, m_innerLoopLimit, rax);
-        code.Emit<OpCode::Mov>(rcx, rdx);
 
 
         //
@@ -216,8 +270,19 @@ namespace BitFunnel
         code.Emit<OpCode::Mov>(rdi, m_base, rax);
         code.Emit<OpCode::Pop>(rcx);
 
+        if (quadwordsPerIteration > 1)
+        {
+            VectorMachineCodeGenerator generator(m_registers,
+                                                 tree.GetCodeGenerator(),
+                                                 m_vectorIsa,
+                                                 m_prefetchDistance);
+            m_compileNodeTree.Compile(generator);
+        }
+        else
         {
-            MachineCodeGenerator generator(m_registers, tree.GetCodeGenerator());
+            MachineCodeGenerator generator(m_registers,
+                                           tree.GetCodeGenerator(),
+                                           m_prefetchDistance);
             m_compileNodeTree.Compile(generator);
         }
 
@@ -227,7 +292,8 @@ namespace BitFunnel
         // Bottom of loop
         //
         code.PlaceLabel(bottomOfLoop);
-        code.EmitImmediate<OpCode::Add>(rcx, 8);    // Increment current offset.
+        // Increment current offset.
+        code.EmitImmediate<OpCode::Add>(rcx, static_cast<int32_t>(8 * quadwordsPerIteration));
         code.Jmp(topOfLoop);
 
 
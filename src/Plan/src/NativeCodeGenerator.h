@@ -28,6 +28,7 @@
 #include "NativeJIT/CodeGen/FunctionBuffer.h"   // FunctionBuffer embedded.
 #include "NativeJIT/Function.h"                 // Function in typedef.
 #include "ResultsBuffer.h"                      // ResultsBuffer::Result type.
+#include "VectorIsa.h"                          // VectorIsa embedded.
 
 
 namespace NativeJIT
@@ -63,6 +64,12 @@ static_cast<int32_t>(reinterpret_cast<uint64_t>(&((static_cast<object*>(nullptr)
     //
     // A NativeJIT::Node that implements the BitFunnel matching algorithm.
     //
+    // Plans with an initial rank of 0 and no rank down are compiled for the
+    // vectorIsa passed to the constructor. Each iteration then processes four (AVX2) or eight
+    // (AVX-512) quadwords of every row, and a scalar loop handles any
+    // quadwords left over at the end of the slice. Other plans always run
+    // the scalar loop.
+    //
     //*************************************************************************
     class NativeCodeGenerator : public NativeJIT::Node<size_t>
     {
@@ -85,6 +92,10 @@ static_cast<int32_t>(reinterpret_cast<uint64_t>(&((static_cast<object*>(nullptr)
             size_t m_matchCount;
             ResultsBuffer::Result* m_matches;
 
+            // Early termination. The outer loop stops scanning slices once
+            // m_matchCount reaches m_matchLimit.
+            size_t m_matchLimit;
+
             size_t m_quadwordCount;
         };
         static_assert(std::is_standard_layout<Parameters>::value,
@@ -96,7 +107,12 @@ static_cast<int32_t>(reinterpret_cast<uint64_t>(&((static_cast<object*>(nullptr)
         NativeCodeGenerator(Prototype& expression,
                             CompileNode const & compileNodeTree,
                             RegisterAllocator const & registers,
-                            Rank initialRank);
+                            Rank initialRank,
+                            VectorIsa vectorIsa,
+                            size_t prefetchDistance);
+
+        // Returns the instruction set actually used by the generated code.
+        VectorIsa GetVectorIsa() const;
 
         virtual ExpressionTree::Storage<size_t>
             CodeGenValue(ExpressionTree& tree) override;
@@ -112,6 +128,7 @@ static_cast<int32_t>(reinterpret_cast<uint64_t>(&((static_cast<object*>(nullptr)
         static const int32_t m_capacity = OFFSET_OF(Parameters, m_capacity);
         static const int32_t m_matchCount = OFFSET_OF(Parameters, m_matchCount);
         static const int32_t m_matches = OFFSET_OF(Parameters, m_matches);
+        static const int32_t m_matchLimit = OFFSET_OF(Parameters, m_matchLimit);
         static const int32_t m_quadwordCount = OFFSET_OF(Parameters, m_quadwordCount);
 
 
@@ -119,12 +136,15 @@ static_cast<int32_t>(reinterpret_cast<uint64_t>(&((static_cast<object*>(nullptr)
         void EmitRegisterInitialization(ExpressionTree& tree);
         void EmitOuterLoop(ExpressionTree& tree);
         void EmitInnerLoop(ExpressionTree& tree);
+        void EmitIterationLoop(ExpressionTree& tree, size_t quadwordsPerIteration);
         void EmitFinishIteration(ExpressionTree& tree);
         void EmitStoreMatch(ExpressionTree & tree);
 
         CompileNode const & m_compileNodeTree;
         RegisterAllocator const & m_registers;
         const Rank m_initialRank;
+        const VectorIsa m_vectorIsa;
+        const size_t m_prefetchDistance;
 
         Register<8u, false> m_param1;
         Register<8u, false> m_return;
@@ -0,0 +1,383 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <algorithm>                            // std::max, std::min.
+#include <atomic>                               // std::atomic.
+#include <memory>                               // std::unique_ptr.
+
+#include "BitFunnel/Index/IIndexSnapshot.h"
+#include "BitFunnel/Index/IIngestor.h"
+#include "BitFunnel/Index/ISimpleIndex.h"
+#include "BitFunnel/Index/IShard.h"
+#include "BitFunnel/Plan/QueryInstrumentation.h"
+#include "BitFunnel/Utilities/Factories.h"
+#include "BitFunnel/Utilities/ITaskDistributor.h"
+#include "BitFunnel/Utilities/ITaskProcessor.h"
+#include "ByteCodeInterpreter.h"
+#include "IRowSet.h"
+#include "LoggerInterfaces/Check.h"
+#include "MatchQuota.h"
+#include "MatchTreeCompiler.h"
+#include "ParallelMatcher.h"
+#include "ResultsBuffer.h"
+#include "SliceFilter.h"
+#include "TopKCollector.h"
+
+
+namespace BitFunnel
+{
+    //*************************************************************************
+    //
+    // ParallelMatcher::Worker
+    //
+    // ITaskProcessor that runs the matcher over the WorkUnit whose index is
+    // passed to ProcessTask().
+    //
+    //*************************************************************************
+    class ParallelMatcher::Worker : public ITaskProcessor, NonCopyable
+    {
+    public:
+        Worker(ParallelMatcher const & matcher,
+               ByteCodeGenerator const * code,
+               size_t blockSize,
+               bool threaded,
+               size_t prefetchDistance,
+               MatchTreeCompiler const * compiler,
+               size_t capacity,
+               TopKCollector const * topK,
+               MatchQuota * quota)
+          : m_matcher(matcher),
+            m_code(code),
+            m_blockSize(blockSize),
+            m_threaded(threaded),
+            m_prefetchDistance(prefetchDistance),
+            m_compiler(compiler),
+            m_quota(quota),
+            m_results(capacity),
+            m_matchCount(0)
+        {
+            if (topK != nullptr)
+            {
+                m_topK.reset(new TopKCollector(topK->GetK(),
+                                               topK->GetStaticRankBlob()));
+            }
+        }
+
+        //
+        // ITaskProcessor methods.
+        //
+
+        virtual void ProcessTask(size_t taskId) override
+        {
+            WorkUnit const & unit = m_matcher.m_workUnits[taskId];
+
+            // Skip the remaining WorkUnits once any worker has exhausted
+            // the quota.
+            if (m_quota != nullptr && m_quota->IsExhausted())
+            {
+                if (unit.m_sliceCount > 0)
+                {
+                    m_quota->MarkTruncated();
+                }
+                return;
+            }
+
+            ptrdiff_t const * rowOffsets =
+                m_matcher.m_rowSet.GetRowOffsets(unit.m_shard);
+
+            if (m_code != nullptr)
+            {
+                ByteCodeInterpreter interpreter(*m_code,
+                                                m_results,
+                                                unit.m_sliceCount,
+                                                unit.m_sliceBuffers,
+                                                unit.m_iterationsPerSlice,
+                                                m_matcher.m_initialRank,
+                                                rowOffsets,
+                                                nullptr,
+                                                m_instrumentation,
+                                                nullptr,
+                                                m_quota,
+                                                m_blockSize,
+                                                m_threaded,
+                                                m_prefetchDistance);
+                interpreter.Run();
+            }
+            else
+            {
+                size_t quadwordCount = m_compiler->Run(unit.m_sliceCount,
+                                                       unit.m_sliceBuffers,
+                                                       unit.m_iterationsPerSlice,
+                                                       rowOffsets,
+                                                       m_results,
+                                                       m_quota);
+                m_instrumentation.IncrementQuadwordCount(quadwordCount);
+            }
+
+            if (m_topK != nullptr)
+            {
+                // Score this WorkUnit's matches now so that the worker never
+                // holds more than one WorkUnit's worth of matches.
+                m_matchCount += m_results.size();
+                m_topK->AddResults(m_results);
+                m_results.Reset();
+            }
+        }
+
+
+        virtual void Finished() override
+        {
+        }
+
+
+        ResultsBuffer const & GetResults() const
+        {
+            return m_results;
+        }
+
+
+        // Returns nullptr if top-k scoring is not enabled.
+        TopKCollector const * GetTopK() const
+        {
+            return m_topK.get();
+        }
+
+
+        size_t GetMatchCount() const
+        {
+            return m_matchCount + m_results.size();
+        }
+
+
+        QueryInstrumentation & GetInstrumentation()
+        {
+            return m_instrumentation;
+        }
+
+    private:
+        ParallelMatcher const & m_matcher;
+        ByteCodeGenerator const * m_code;
+        size_t m_blockSize;
+        bool m_threaded;
+        size_t m_prefetchDistance;
+        MatchTreeCompiler const * m_compiler;
+        MatchQuota * m_quota;
+
+        ResultsBuffer m_results;
+        std::unique_ptr<TopKCollector> m_topK;
+        size_t m_matchCount;
+        QueryInstrumentation m_instrumentation;
+    };
+
+
+    //*************************************************************************
+    //
+    // ParallelMatcher
+    //
+    //*************************************************************************
+    ParallelMatcher::ParallelMatcher(ISimpleIndex const & index,
+                                     IIndexSnapshot const & snapshot,
+                                     Rank initialRank,
+                                     IRowSet const & rowSet,
+                                     SliceFilter const * sliceFilter,
+                                     size_t threadCount)
+      : m_initialRank(initialRank),
+        m_rowSet(rowSet),
+        m_threadCount(std::max(threadCount, static_cast<size_t>(1))),
+        m_candidates(index.GetIngestor().GetShardCount()),
+        m_workerResultsCapacity(1)
+    {
+        IIngestor const & ingestor = index.GetIngestor();
+
+        size_t totalSliceCount = 0;
+        for (ShardId shardId = 0; shardId < ingestor.GetShardCount(); ++shardId)
+        {
+            IShard & shard = ingestor.GetShard(shardId);
+            if (sliceFilter == nullptr)
+            {
+                m_candidates[shardId] = snapshot.GetSliceBuffers(shardId);
+            }
+            else
+            {
+                sliceFilter->Filter(shard,
+                                    snapshot.GetSliceBuffers(shardId),
+                                    rowSet.GetRowOffsets(shardId),
+                                    m_candidates[shardId]);
+            }
+            totalSliceCount += m_candidates[shardId].size();
+        }
+
+        const size_t targetUnitCount = m_threadCount * c_workUnitsPerThread;
+        const size_t slicesPerUnit =
+            std::max((totalSliceCount + targetUnitCount - 1) / targetUnitCount,
+                     static_cast<size_t>(1));
+
+        for (ShardId shardId = 0; shardId < ingestor.GetShardCount(); ++shardId)
+        {
+            IShard & shard = ingestor.GetShard(shardId);
+            std::vector<void*> const & sliceBuffers = m_candidates[shardId];
+            const size_t iterationsPerSlice =
+                shard.GetSliceCapacity() >> 6 >> initialRank;
+            m_workerResultsCapacity =
+                std::max(m_workerResultsCapacity,
+                         static_cast<size_t>(shard.GetSliceCapacity()));
+
+            for (size_t start = 0; start < sliceBuffers.size(); start += slicesPerUnit)
+            {
+                WorkUnit unit;
+                unit.m_shard = shardId;
+                unit.m_sliceBuffers = sliceBuffers.data() + start;
+                unit.m_sliceCount = std::min(slicesPerUnit, sliceBuffers.size() - start);
+                unit.m_iterationsPerSlice = iterationsPerSlice;
+                m_workUnits.push_back(unit);
+            }
+        }
+    }
+
+
+    size_t ParallelMatcher::Run(ByteCodeGenerator const & code,
+                                size_t blockSize,
+                                bool threaded,
+                                size_t prefetchDistance,
+                                QueryInstrumentation & instrumentation,
+                                ResultsBuffer & results,
+                                TopKCollector * topK,
+                                MatchQuota * quota)
+    {
+        return Run(&code,
+                   blockSize,
+                   threaded,
+                   prefetchDistance,
+                   nullptr,
+                   instrumentation,
+                   results,
+                   topK,
+                   quota);
+    }
+
+
+    size_t ParallelMatcher::Run(MatchTreeCompiler const & compiler,
+                                QueryInstrumentation & instrumentation,
+                                ResultsBuffer & results,
+                                TopKCollector * topK,
+                                MatchQuota * quota)
+    {
+        return Run(nullptr,
+                   0,
+                   false,
+                   0,
+                   &compiler,
+                   instrumentation,
+                   results,
+                   topK,
+                   quota);
+    }
+
+
+    std::vector<ParallelMatcher::WorkUnit> const &
+        ParallelMatcher::GetWorkUnits() const
+    {
+        return m_workUnits;
+    }
+
+
+    size_t ParallelMatcher::Run(ByteCodeGenerator const * code,
+                                size_t blockSize,
+                                bool threaded,
+                                size_t prefetchDistance,
+                                MatchTreeCompiler const * compiler,
+                                QueryInstrumentation & instrumentation,
+                                ResultsBuffer & results,
+                                TopKCollector * topK,
+                                MatchQuota * quota)
+    {
+        if (m_workUnits.size() == 0)
+        {
+            return 0;
+        }
+
+        // No point in starting more threads than there are WorkUnits.
+        const size_t workerCount = std::min(m_threadCount, m_workUnits.size());
+
+        std::vector<std::unique_ptr<ITaskProcessor>> workers;
+        for (size_t i = 0; i < workerCount; ++i)
+        {
+            workers.push_back(std::unique_ptr<ITaskProcessor>(
+                new Worker(*this,
+                           code,
+                           blockSize,
+                           threaded,
+                           prefetchDistance,
+                           compiler,
+                           m_workerResultsCapacity,
+                           topK,
+                           quota)));
+        }
+
+        ITaskDistributor* current = ITaskDistributor::GetCurrent();
+        if (current != nullptr)
+        {
+            // Already running on a task thread, e.g. one of QueryRunner's.
+            // Run the workers as subtasks of that thread's distributor,
+            // whose idle threads will steal them, rather than starting
+            // threads for this query.
+            std::atomic<size_t> nextWorkUnit(0);
+            current->RunSubtasks(
+                workerCount,
+                [&](size_t workerId)
+                {
+                    ITaskProcessor & worker = *workers[workerId];
+                    size_t workUnit;
+                    while ((workUnit = nextWorkUnit++) < m_workUnits.size())
+                    {
+                        worker.ProcessTask(workUnit);
+                    }
+                });
+        }
+        else
+        {
+            std::unique_ptr<ITaskDistributor> distributor(
+                Factories::CreateTaskDistributor(workers, m_workUnits.size()));
+            distributor->WaitForCompletion();
+        }
+
+        // Merge per-worker results and statistics.
+        size_t matchCount = 0;
+        for (auto & processor : workers)
+        {
+            Worker & worker = dynamic_cast<Worker &>(*processor);
+            if (topK != nullptr)
+            {
+                topK->Merge(*worker.GetTopK());
+            }
+            else
+            {
+                results.Append(worker.GetResults());
+            }
+            matchCount += worker.GetMatchCount();
+            instrumentation.IncrementQuadwordCount(
+                worker.GetInstrumentation().GetData().GetQuadwordCount());
+        }
+
+        return matchCount;
+    }
+}
@@ -0,0 +1,161 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <stddef.h>                     // size_t parameter.
+#include <vector>                       // std::vector embedded.
+
+#include "BitFunnel/BitFunnelTypes.h"   // Rank, ShardId embedded.
+#include "BitFunnel/NonCopyable.h"      // Base class.
+
+
+namespace BitFunnel
+{
+    class ByteCodeGenerator;
+    class IIndexSnapshot;
+    class IRowSet;
+    class ISimpleIndex;
+    class MatchQuota;
+    class MatchTreeCompiler;
+    class QueryInstrumentation;
+    class ResultsBuffer;
+    class SliceFilter;
+    class TopKCollector;
+
+    //*************************************************************************
+    //
+    // ParallelMatcher
+    //
+    // Runs a single query's matcher across a pool of worker threads. The
+    // slice buffer vectors of every shard are split into WorkUnits, each of
+    // which is a contiguous range of slices from a single shard. Workers run
+    // either the sealed ByteCodeGenerator program or the NativeJIT function
+    // compiled by MatchTreeCompiler over their WorkUnits, collecting matches
+    // in their own ResultsBuffer. When all WorkUnits have been processed, the
+    // per-worker ResultsBuffers are merged into the caller's ResultsBuffer.
+    // When called from a thread owned by an ITaskDistributor, such as a
+    // QueryRunner thread, the workers run as subtasks of that distributor
+    // instead of on threads of their own.
+    //
+    // The caller must hold a Token for the duration of the Run() methods. The
+    // slice buffer vectors are captured from an IIndexSnapshot in the
+    // constructor, so all workers see the same set of slices in every shard.
+    //
+    // DESIGN NOTE: the compiled NativeJIT function and the ByteCodeGenerator
+    // are read-only during matching and are shared across workers. All
+    // mutable matcher state (ByteCodeInterpreter instances, the NativeJIT
+    // Parameters block, ResultsBuffers and QueryInstrumentation counters) is
+    // owned by individual workers.
+    //
+    //*************************************************************************
+    class ParallelMatcher : NonCopyable
+    {
+    public:
+        // A contiguous range of slice buffers from a single shard.
+        class WorkUnit
+        {
+        public:
+            ShardId m_shard;
+            void * const * m_sliceBuffers;
+            size_t m_sliceCount;
+            size_t m_iterationsPerSlice;
+        };
+
+        // Captures the slice buffers of every shard in snapshot, drops those
+        // that sliceFilter rules out when it is not nullptr, and splits the
+        // remainder into WorkUnits sized so that each of the threadCount
+        // workers has several WorkUnits to process. The caller must hold the
+        // Token under which snapshot was obtained.
+        ParallelMatcher(ISimpleIndex const & index,
+                        IIndexSnapshot const & snapshot,
+                        Rank initialRank,
+                        IRowSet const & rowSet,
+                        SliceFilter const * sliceFilter,
+                        size_t threadCount);
+
+        // Runs the ByteCodeInterpreter over all WorkUnits, using blocks of
+        // blockSize quadwords when blockSize is not zero and direct-threaded
+        // dispatch when threaded is true. Rows are prefetched prefetchDistance
+        // iterations ahead when prefetchDistance is not zero. If topK is
+        // nullptr, the matches are appended to results. Otherwise each worker
+        // scores its matches into its own TopKCollector after each WorkUnit
+        // and the workers' collectors are merged into topK. If quota is not
+        // nullptr, it is shared by all workers and no further slices are
+        // scanned once it is exhausted. Returns the number of matches.
+        size_t Run(ByteCodeGenerator const & code,
+                   size_t blockSize,
+                   bool threaded,
+                   size_t prefetchDistance,
+                   QueryInstrumentation & instrumentation,
+                   ResultsBuffer & results,
+                   TopKCollector * topK,
+                   MatchQuota * quota);
+
+        // Same as above, but runs the native code compiled by compiler.
+        size_t Run(MatchTreeCompiler const & compiler,
+                   QueryInstrumentation & instrumentation,
+                   ResultsBuffer & results,
+                   TopKCollector * topK,
+                   MatchQuota * quota);
+
+        std::vector<WorkUnit> const & GetWorkUnits() const;
+
+    private:
+        class Worker;
+
+        size_t Run(ByteCodeGenerator const * code,
+                   size_t blockSize,
+                   bool threaded,
+                   size_t prefetchDistance,
+                   MatchTreeCompiler const * compiler,
+                   QueryInstrumentation & instrumentation,
+                   ResultsBuffer & results,
+                   TopKCollector * topK,
+                   MatchQuota * quota);
+
+        //
+        // Constructor parameters.
+        //
+
+        const Rank m_initialRank;
+        IRowSet const & m_rowSet;
+        const size_t m_threadCount;
+
+        // Slice buffers of each shard which passed the SliceFilter. The
+        // WorkUnits point into these vectors.
+        std::vector<std::vector<void*>> m_candidates;
+
+        std::vector<WorkUnit> m_workUnits;
+
+        // Initial capacity of each worker's ResultsBuffer. Enough for every
+        // document in one slice. The buffers grow as needed, so per-query
+        // memory doesn't scale with the thread count times the size of the
+        // caller's ResultsBuffer.
+        size_t m_workerResultsCapacity;
+
+        // Target number of WorkUnits per worker thread. Having more than one
+        // WorkUnit per worker evens out the load when some slices are more
+        // expensive to match than others.
+        static const size_t c_workUnitsPerThread = 4;
+    };
+}
@@ -22,6 +22,7 @@
 
 
 #include "BitFunnel/Allocators/IAllocator.h"
+#include "BitFunnel/Index/IIngestor.h"
 #include "BitFunnel/Index/ISimpleIndex.h"
 #include "BitFunnel/Utilities/StreamUtilities.h"
 #include "BitFunnel/Plan/Factories.h"
@@ -68,9 +69,7 @@ namespace BitFunnel
 
     ShardId PlanRows::GetShardCount() const
     {
-        // TODO: must eventually support multiple shards.
-        // return static_cast<unsigned>(m_index.GetShardCount());
-        return 1;
+        return static_cast<ShardId>(m_index.GetIngestor().GetShardCount());
     }
 
 
@@ -80,11 +79,9 @@ namespace BitFunnel
     }
 
 
-    const ITermTable& PlanRows::GetTermTable(ShardId /*shard*/) const
+    const ITermTable& PlanRows::GetTermTable(ShardId shard) const
     {
-        // TODO: may need to support multiple term tables.
-        // return *m_index.GetTermTables().GetTermTable(shard);
-        return m_index.GetTermTable0();
+        return m_index.GetTermTable(shard);
     }
 
 
@@ -34,6 +34,8 @@ namespace BitFunnel
         formatter.WriteField("matches");
         formatter.WriteField("quadwords");
         formatter.WriteField("cachelines");
+        formatter.WriteField("prefetched");
+        formatter.WriteField("truncated");
         formatter.WriteField("parse");
         formatter.WriteField("plan");
         formatter.WriteField("match");
@@ -48,6 +50,8 @@ namespace BitFunnel
         formatter.WriteField(m_matchCount);
         formatter.WriteField(m_quadwordCount);
         formatter.WriteField(m_cacheLineCount);
+        formatter.WriteField(m_prefetchedCacheLineCount);
+        formatter.WriteField(m_truncated);
         formatter.WriteField(m_parsingTime);
         formatter.WriteField(m_planningTime);
         formatter.WriteField(m_matchingTime);
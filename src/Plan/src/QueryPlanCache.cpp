@@ -0,0 +1,205 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "BitFunnel/Index/IIngestor.h"
+#include "BitFunnel/Index/ISimpleIndex.h"
+#include "BitFunnel/Index/ITermTable.h"
+#include "BitFunnel/Utilities/IsSpace.h"
+#include "CompiledQuery.h"
+#include "LoggerInterfaces/Check.h"
+#include "QueryPlanCache.h"
+#include "QueryResources.h"
+
+
+namespace BitFunnel
+{
+    //*************************************************************************
+    //
+    // QueryPlanCache
+    //
+    //*************************************************************************
+    QueryPlanCache::QueryPlanCache(ISimpleIndex const & index, size_t capacity)
+      : m_index(index),
+        m_capacity(capacity),
+        m_hitCount(0),
+        m_missCount(0)
+    {
+        CHECK_GT(capacity, 0u)
+            << "QueryPlanCache capacity must be positive.";
+
+        std::lock_guard<std::mutex> lock(m_lock);
+        ValidateTermTables();
+    }
+
+
+    std::string QueryPlanCache::NormalizeQuery(char const * query)
+    {
+        std::string normalized;
+        bool pendingSpace = false;
+
+        while (*query != '\0')
+        {
+            char c = *query++;
+            if (IsSpace(c))
+            {
+                pendingSpace = !normalized.empty();
+            }
+            else
+            {
+                if (pendingSpace)
+                {
+                    normalized.push_back(' ');
+                    pendingSpace = false;
+                }
+                normalized.push_back(c);
+
+                // Escaped characters, including escaped whitespace, are part
+                // of a token and must be preserved.
+                if (c == '\\' && *query != '\0')
+                {
+                    normalized.push_back(*query++);
+                }
+            }
+        }
+
+        return normalized;
+    }
+
+
+    std::shared_ptr<CompiledQuery const>
+        QueryPlanCache::Find(std::string const & query,
+                             bool useNativeCode,
+                             QueryResources const & resources)
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        ValidateTermTables();
+
+        auto it = m_entries.find(query);
+        if (it == m_entries.end() ||
+            it->second.m_compiledQuery->UsesNativeCode() != useNativeCode ||
+            it->second.m_vectorIsa != resources.GetVectorIsa() ||
+            it->second.m_prefetchDistance != resources.GetPrefetchDistance())
+        {
+            ++m_missCount;
+            return nullptr;
+        }
+
+        // Move to the front of the LRU list.
+        m_lru.splice(m_lru.begin(), m_lru, it->second.m_position);
+        ++m_hitCount;
+
+        return it->second.m_compiledQuery;
+    }
+
+
+    void QueryPlanCache::Add(std::string const & query,
+                             std::shared_ptr<CompiledQuery const> compiledQuery,
+                             QueryResources const & resources)
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        ValidateTermTables();
+
+        auto it = m_entries.find(query);
+        if (it != m_entries.end())
+        {
+            // Another thread may have compiled the same query concurrently.
+            // Keep the newer plan.
+            it->second.m_compiledQuery = compiledQuery;
+            it->second.m_vectorIsa = resources.GetVectorIsa();
+            it->second.m_prefetchDistance = resources.GetPrefetchDistance();
+            m_lru.splice(m_lru.begin(), m_lru, it->second.m_position);
+            return;
+        }
+
+        if (m_entries.size() == m_capacity)
+        {
+            m_entries.erase(m_lru.back());
+            m_lru.pop_back();
+        }
+
+        m_lru.push_front(query);
+        Entry & entry = m_entries[query];
+        entry.m_compiledQuery = compiledQuery;
+        entry.m_vectorIsa = resources.GetVectorIsa();
+        entry.m_prefetchDistance = resources.GetPrefetchDistance();
+        entry.m_position = m_lru.begin();
+    }
+
+
+    void QueryPlanCache::Clear()
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        ClearInternal();
+    }
+
+
+    size_t QueryPlanCache::GetSize() const
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_entries.size();
+    }
+
+
+    size_t QueryPlanCache::GetHitCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_hitCount;
+    }
+
+
+    size_t QueryPlanCache::GetMissCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_missCount;
+    }
+
+
+    void QueryPlanCache::ValidateTermTables()
+    {
+        const size_t shardCount = m_index.GetIngestor().GetShardCount();
+
+        bool changed = (m_termTableVersions.size() != shardCount);
+        for (ShardId shard = 0; !changed && shard < shardCount; ++shard)
+        {
+            changed = (m_termTableVersions[shard] !=
+                       m_index.GetTermTable(shard).GetVersion());
+        }
+
+        if (changed)
+        {
+            ClearInternal();
+            m_termTableVersions.clear();
+            for (ShardId shard = 0; shard < shardCount; ++shard)
+            {
+                m_termTableVersions.push_back(
+                    m_index.GetTermTable(shard).GetVersion());
+            }
+        }
+    }
+
+
+    void QueryPlanCache::ClearInternal()
+    {
+        m_entries.clear();
+        m_lru.clear();
+    }
+}
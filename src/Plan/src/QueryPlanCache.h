@@ -0,0 +1,128 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <list>                             // std::list embedded.
+#include <memory>                           // std::shared_ptr embedded.
+#include <mutex>                            // std::mutex embedded.
+#include <stddef.h>                         // size_t embedded.
+#include <stdint.h>                         // uint64_t embedded.
+#include <string>                           // std::string embedded.
+#include <unordered_map>                    // std::unordered_map embedded.
+#include <vector>                           // std::vector embedded.
+
+#include "BitFunnel/NonCopyable.h"          // Base class.
+#include "VectorIsa.h"                      // VectorIsa embedded.
+
+
+namespace BitFunnel
+{
+    class CompiledQuery;
+    class ISimpleIndex;
+    class QueryResources;
+
+    //*************************************************************************
+    //
+    // QueryPlanCache
+    //
+    // Thread-safe, least-recently-used cache of CompiledQueries keyed by
+    // normalized query text. Caching a CompiledQuery skips parsing, planning,
+    // register allocation and code generation for repeated queries.
+    //
+    // CompiledQueries embed row offsets that were resolved through the index's
+    // TermTables. The cache records the version of each shard's TermTable
+    // when it is constructed and discards every entry if it later finds that
+    // a TermTable has been modified, reloaded or replaced. Clear() may be
+    // used to invalidate the cache explicitly.
+    //
+    //*************************************************************************
+    class QueryPlanCache : NonCopyable
+    {
+    public:
+        QueryPlanCache(ISimpleIndex const & index, size_t capacity);
+
+        // Returns the canonical form of a query used as the cache key.
+        // Leading and trailing whitespace is removed and each run of
+        // unescaped whitespace is replaced with a single space.
+        static std::string NormalizeQuery(char const * query);
+
+        // Returns the CompiledQuery for the normalized query text, or nullptr
+        // if the query is not in the cache or was compiled for a different
+        // matcher, VectorIsa or prefetch distance than the one selected in
+        // resources.
+        std::shared_ptr<CompiledQuery const>
+            Find(std::string const & query,
+                 bool useNativeCode,
+                 QueryResources const & resources);
+
+        // Adds a CompiledQuery for the normalized query text, evicting the
+        // least recently used entry if the cache is full. The CompiledQuery
+        // must own its code and must have been compiled with resources.
+        void Add(std::string const & query,
+                 std::shared_ptr<CompiledQuery const> compiledQuery,
+                 QueryResources const & resources);
+
+        // Removes all entries.
+        void Clear();
+
+        size_t GetSize() const;
+        size_t GetHitCount() const;
+        size_t GetMissCount() const;
+
+    private:
+        // Clears the cache if the version of any of the index's TermTables
+        // has changed since the cache was last validated. Caller must hold
+        // m_lock.
+        void ValidateTermTables();
+
+        void ClearInternal();
+
+        typedef std::list<std::string> LruList;
+
+        class Entry
+        {
+        public:
+            std::shared_ptr<CompiledQuery const> m_compiledQuery;
+
+            // Code generation settings baked into m_compiledQuery.
+            VectorIsa m_vectorIsa;
+            size_t m_prefetchDistance;
+
+            LruList::iterator m_position;
+        };
+
+        ISimpleIndex const & m_index;
+        const size_t m_capacity;
+
+        mutable std::mutex m_lock;
+
+        std::vector<uint64_t> m_termTableVersions;
+        std::unordered_map<std::string, Entry> m_entries;
+
+        // Most recently used query is at the front.
+        LruList m_lru;
+
+        size_t m_hitCount;
+        size_t m_missCount;
+    };
+}
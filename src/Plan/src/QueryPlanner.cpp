@@ -25,25 +25,20 @@
 #include "BitFunnel/Index/IIngestor.h"
 #include "BitFunnel/Index/ISimpleIndex.h"
 #include "BitFunnel/Index/IShard.h"
-#include "BitFunnel/Index/Token.h"
 #include "BitFunnel/Plan/Factories.h"
 #include "BitFunnel/Plan/QueryInstrumentation.h"
 #include "BitFunnel/Plan/TermMatchNode.h"
 #include "BitFunnel/Utilities/Allocator.h"
 #include "BitFunnel/Utilities/Factories.h"
 #include "BitFunnel/Utilities/IObjectFormatter.h"
-#include "ByteCodeInterpreter.h"
+#include "CompiledQuery.h"
 #include "CompileNode.h"
 #include "IPlanRows.h"
 #include "LoggerInterfaces/Logging.h"
-#include "MatchTreeCompiler.h"
 #include "MatchTreeRewriter.h"
-#include "NativeJIT/CodeGen/ExecutionBuffer.h"
 #include "QueryPlanner.h"
 #include "QueryResources.h"
 #include "RankDownCompiler.h"
-#include "RegisterAllocator.h"
-#include "ResultsBuffer.h"
 #include "RowPlan.h"
 #include "RowSet.h"
 #include "TermPlan.h"
@@ -70,7 +65,8 @@ namespace BitFunnel
                              diagnosticStream,
                              instrumentation,
                              resultsBuffer,
-                             useNativeCode);
+                             useNativeCode,
+                             false);
     }
 
 
@@ -85,8 +81,8 @@ namespace BitFunnel
                                IDiagnosticStream & diagnosticStream,
                                QueryInstrumentation & instrumentation,
                                ResultsBuffer & resultsBuffer,
-                               bool useNativeCode)
-      : m_resultsBuffer(resultsBuffer)
+                               bool useNativeCode,
+                               bool cacheable)
     {
         if (diagnosticStream.IsEnabled("planning/term"))
         {
@@ -184,132 +180,28 @@ namespace BitFunnel
         rowSet.LoadRows();
         instrumentation.SetRowCount(rowSet.GetRowCount());
 
-        if (useNativeCode)
-        {
-            RunNativeCode(index,
-                          resources,
-                          instrumentation,
-                          compileTree,
-                          initialRank,
-                          rowSet);
-        }
-        else
-        {
-            RunByteCodeInterpreter(index,
-                                   resources,
-                                   instrumentation,
-                                   compileTree,
-                                   initialRank,
-                                   rowSet);
-        }
-    }
-
-
-    void QueryPlanner::RunByteCodeInterpreter(ISimpleIndex const & index,
-                                              QueryResources & resources,
-                                              QueryInstrumentation & instrumentation,
-                                              CompileNode const & compileTree,
-                                              Rank initialRank,
-                                              RowSet const & rowSet)
-    {
-        // TODO: Clear results buffer here?
-        compileTree.Compile(m_code);
-        m_code.Seal();
+        m_compiledQuery.reset(new CompiledQuery(rewritten,
+                                                compileTree,
+                                                initialRank,
+                                                rowSet,
+                                                useNativeCode,
+                                                cacheable,
+                                                resources));
 
         instrumentation.FinishPlanning();
 
-        // Get token before we GetSliceBuffers.
-        {
-            auto token = index.GetIngestor().GetTokenManager().RequestToken();
-
-            for (ShardId shardId = 0; shardId < index.GetIngestor().GetShardCount(); ++shardId)
-            {
-                auto & shard = index.GetIngestor().GetShard(shardId);
-                auto & sliceBuffers = shard.GetSliceBuffers();
-
-                // Iterations per slice calculation.
-                auto iterationsPerSlice = shard.GetSliceCapacity() >> 6 >> initialRank;
-
-                m_resultsBuffer.Reset();
-
-                ByteCodeInterpreter intepreter(m_code,
-                                               m_resultsBuffer,
-                                               sliceBuffers.size(),
-                                               sliceBuffers.data(),
-                                               iterationsPerSlice,
-                                               initialRank,
-                                               rowSet.GetRowOffsets(shardId),
-                                               nullptr,
-                                               instrumentation,
-                                               resources.GetCacheLineRecorder());
-
-                intepreter.Run();
-            }
-
-            instrumentation.FinishMatching();
-            instrumentation.SetMatchCount(m_resultsBuffer.size());
-        } // End of token lifetime.
+        m_compiledQuery->Run(index, resources, instrumentation, resultsBuffer);
     }
 
 
-    void QueryPlanner::RunNativeCode(ISimpleIndex const & index,
-                                     QueryResources & resources,
-                                     QueryInstrumentation & instrumentation,
-                                     CompileNode const & compileTree,
-                                     Rank initialRank,
-                                     RowSet const & rowSet)
+    IPlanRows const & QueryPlanner::GetPlanRows() const
     {
-         // Perform register allocation on the compile tree.
-         RegisterAllocator const registers(compileTree,
-                                           rowSet.GetRowCount(),
-                                           c_registerBase,
-                                           c_registerCount,
-                                           resources.GetMatchTreeAllocator());
-
-         MatchTreeCompiler compiler(resources,
-                                    compileTree,
-                                    registers,
-                                    initialRank);
-
-
-         // TODO: Clear results buffer here?
-        compileTree.Compile(m_code);
-        m_code.Seal();
-
-        instrumentation.FinishPlanning();
-
-        // Get token before we GetSliceBuffers.
-        {
-            auto token = index.GetIngestor().GetTokenManager().RequestToken();
-
-            for (ShardId shardId = 0; shardId < index.GetIngestor().GetShardCount(); ++shardId)
-            {
-                auto & shard = index.GetIngestor().GetShard(shardId);
-                auto & sliceBuffers = shard.GetSliceBuffers();
-
-                // Iterations per slice calculation.
-                auto iterationsPerSlice = shard.GetSliceCapacity() >> 6 >> initialRank;
-
-
-                m_resultsBuffer.Reset();
-
-                size_t quadwordCount = compiler.Run(sliceBuffers.size(),
-                                                    sliceBuffers.data(),
-                                                    iterationsPerSlice,
-                                                    rowSet.GetRowOffsets(shardId),
-                                                    m_resultsBuffer);
-
-                instrumentation.IncrementQuadwordCount(quadwordCount);
-            }
-
-            instrumentation.FinishMatching();
-            instrumentation.SetMatchCount(m_resultsBuffer.size());
-        } // End of token lifetime.
+        return *m_planRows;
     }
 
 
-    IPlanRows const & QueryPlanner::GetPlanRows() const
+    std::shared_ptr<CompiledQuery const> QueryPlanner::GetCompiledQuery() const
     {
-        return *m_planRows;
+        return m_compiledQuery;
     }
 }
@@ -22,25 +22,30 @@
 
 #pragma once
 
+#include <memory>                         // std::shared_ptr embedded.
+
 #include "BitFunnel/NonCopyable.h"        // Inherits from NonCopyable.
-#include "ByteCodeInterpreter.h"
 
 
 namespace BitFunnel
 {
+    class CompiledQuery;
+    class IDiagnosticStream;
     class IPlanRows;
     class ISimpleIndex;
     class IThreadResources;
     class QueryInstrumentation;
     class QueryResources;
     class ResultsBuffer;
-    class RowSet;
     class TermMatchNode;
 
     class QueryPlanner : public NonCopyable
     {
     public:
-        // Constructs a QueryPlanner with the specified resources.
+        // Plans and compiles the query, then runs the matcher against the
+        // index, leaving the matches in resultsBuffer. If cacheable is true,
+        // the CompiledQuery owns its code and remains valid after resources
+        // is Reset(), so that it can be stored in a QueryPlanCache.
         QueryPlanner(TermMatchNode const & tree,
                      unsigned targetRowCount,
                      ISimpleIndex const & index,
@@ -49,41 +54,20 @@ namespace BitFunnel
                      IDiagnosticStream& diagnosticStream,
                      QueryInstrumentation & instrumentation,
                      ResultsBuffer & resultsBuffer,
-                     bool useNativeCode);
+                     bool useNativeCode,
+                     bool cacheable);
 
         IPlanRows const & GetPlanRows() const;
 
-    private:
-        void RunByteCodeInterpreter(ISimpleIndex const & index,
-                                    QueryResources & resources,
-                                    QueryInstrumentation & instrumentation,
-                                    CompileNode const & compileTree,
-                                    Rank maxRank,
-                                    RowSet const & rowSet);
-
-        void RunNativeCode(ISimpleIndex const & index,
-                           QueryResources & resources,
-                           QueryInstrumentation & instrumentation,
-                           CompileNode const & compileTree,
-                           Rank maxRank,
-                           RowSet const & rowSet);
+        std::shared_ptr<CompiledQuery const> GetCompiledQuery() const;
 
+    private:
         IPlanRows const * m_planRows;
 
         // The maximum number of iterations that can be performed before a termination
         // check is mandatory. Details can be found in the MatchTreeCodeGenerator.
         // const unsigned m_maxIterationsScannedBetweenTerminationChecks;
 
-        // First available row pointer register is R8.
-        // TODO: is this valid on all platforms or only on Windows?
-        static const unsigned c_registerBase = 8;
-
-        // Row pointers stored in the eight registers R8..R15.
-        // TODO: is this valid on all platforms or only on Windows?
-        static const unsigned c_registerCount = 8;
-
-        ByteCodeGenerator m_code;
-
-        ResultsBuffer& m_resultsBuffer;
+        std::shared_ptr<CompiledQuery> m_compiledQuery;
     };
 }
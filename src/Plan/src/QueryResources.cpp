@@ -21,6 +21,8 @@
 // THE SOFTWARE.
 
 
+#include <algorithm>    // std::min.
+
 #include "BitFunnel/Index/IIngestor.h"
 #include "BitFunnel/Index/IShard.h"
 #include "BitFunnel/Index/ISimpleIndex.h"
@@ -34,7 +36,13 @@ namespace BitFunnel
                                    size_t codeAllocatorBytes)
       : m_matchTreeAllocator(new BitFunnel::Allocator(treeAllocatorBytes)),
         m_expressionTreeAllocator(new NativeJIT::Allocator(treeAllocatorBytes)),
-        m_codeAllocator(new NativeJIT::ExecutionBuffer(codeAllocatorBytes))
+        m_codeAllocator(new NativeJIT::ExecutionBuffer(codeAllocatorBytes)),
+        m_matcherThreadCount(1),
+        m_vectorIsa(GetSupportedVectorIsa()),
+        m_interpreterBlockSize(0),
+        m_interpreterThreaded(false),
+        m_prefetchDistance(0),
+        m_sliceFiltering(true)
     {
         m_code.reset(new NativeJIT::FunctionBuffer(*m_codeAllocator,
                                                    static_cast<unsigned>(codeAllocatorBytes)));
@@ -48,6 +56,55 @@ namespace BitFunnel
     }
 
 
+    void QueryResources::EnableParallelMatching(size_t threadCount)
+    {
+        m_matcherThreadCount = (threadCount == 0) ? 1 : threadCount;
+    }
+
+
+    void QueryResources::EnableTopK(size_t k, FixedSizeBlobId staticRankBlob)
+    {
+        m_topK.reset(new TopKCollector(k, staticRankBlob));
+    }
+
+
+    void QueryResources::EnableEarlyTermination(size_t maxMatchCount,
+                                                double timeBudget)
+    {
+        m_matchQuota.reset(new MatchQuota(maxMatchCount, timeBudget));
+    }
+
+
+    void QueryResources::SetVectorIsa(VectorIsa isa)
+    {
+        m_vectorIsa = std::min(isa, GetSupportedVectorIsa());
+    }
+
+
+    void QueryResources::SetInterpreterBlockSize(size_t quadwordCount)
+    {
+        m_interpreterBlockSize = quadwordCount;
+    }
+
+
+    void QueryResources::SetInterpreterThreading(bool threaded)
+    {
+        m_interpreterThreaded = threaded;
+    }
+
+
+    void QueryResources::SetPrefetchDistance(size_t distance)
+    {
+        m_prefetchDistance = distance;
+    }
+
+
+    void QueryResources::SetSliceFiltering(bool enabled)
+    {
+        m_sliceFiltering = enabled;
+    }
+
+
     void QueryResources::Reset()
     {
         m_matchTreeAllocator->Reset();
@@ -58,5 +115,9 @@ namespace BitFunnel
         {
             m_cacheLineRecorder->Reset();
         }
+        if (m_topK != nullptr)
+        {
+            m_topK->Reset();
+        }
     }
 }
@@ -26,9 +26,12 @@
 
 #include "BitFunnel/Allocators/IAllocator.h"    // Template parameter.
 #include "CacheLineRecorder.h"                  // Template parameter.
+#include "MatchQuota.h"                         // Template parameter.
 #include "NativeJIT/CodeGen/ExecutionBuffer.h"  // Template parameter.
 #include "NativeJIT/CodeGen/FunctionBuffer.h"   // Template parameter.
 #include "Temporary/Allocator.h"                // Template parameter.
+#include "TopKCollector.h"                      // Template parameter.
+#include "VectorIsa.h"                          // VectorIsa embedded.
 
 
 namespace BitFunnel
@@ -43,6 +46,51 @@ namespace BitFunnel
 
         void EnableCacheLineCounting(ISimpleIndex const & index);
 
+        // Splits the matching phase of each query across threadCount worker
+        // threads. A threadCount of 1 runs the matcher on the query thread.
+        // Parallel matching is not used when cache line counting is enabled.
+        void EnableParallelMatching(size_t threadCount);
+
+        // Replaces the flat list of matches with the k matches that have the
+        // highest static rank. After a query runs, the matches are available
+        // from GetTopK() and the ResultsBuffer is empty. Pass
+        // TopKCollector::c_noStaticRank if the schema has no static rank blob.
+        void EnableTopK(size_t k, FixedSizeBlobId staticRankBlob);
+
+        // Stops matching once a query has produced maxMatchCount matches or
+        // spent timeBudget seconds in the matcher. Pass zero to disable
+        // either limit. Queries that stop early are reported as truncated by
+        // QueryInstrumentation.
+        void EnableEarlyTermination(size_t maxMatchCount, double timeBudget);
+
+        // Selects the vector instruction set used by the native matcher for
+        // plans that start at rank 0. Defaults to the widest instruction set
+        // reported by CPUID. Requests for an instruction set the CPU does not
+        // support fall back to the widest one it does.
+        void SetVectorIsa(VectorIsa isa);
+
+        // Runs the ByteCodeInterpreter over blocks of up to quadwordCount
+        // quadwords per instruction dispatch for plans that allow it. A
+        // quadwordCount of zero, the default, interprets one quadword at a
+        // time. See ByteCodeInterpreter for details.
+        void SetInterpreterBlockSize(size_t quadwordCount);
+
+        // Selects direct-threaded dispatch for the ByteCodeInterpreter
+        // instead of the default switch statement. Has no effect in block
+        // mode or on compilers without the labels-as-values extension.
+        void SetInterpreterThreading(bool threaded);
+
+        // Prefetches each row's quadwords distance iterations ahead of the
+        // iteration being matched. The distance is measured in quadwords at
+        // the plan's initial rank. A distance of zero, the default, disables
+        // prefetching. Applies to both the native matcher and the
+        // ByteCodeInterpreter.
+        void SetPrefetchDistance(size_t distance);
+
+        // Enables or disables skipping slices whose row summaries show that
+        // the query cannot match. Slice filtering is enabled by default.
+        void SetSliceFiltering(bool enabled);
+
         virtual void Reset();
 
         IAllocator & GetMatchTreeAllocator() const
@@ -70,11 +118,61 @@ namespace BitFunnel
             return m_cacheLineRecorder.get();
         }
 
+        size_t GetMatcherThreadCount() const
+        {
+            return m_matcherThreadCount;
+        }
+
+        VectorIsa GetVectorIsa() const
+        {
+            return m_vectorIsa;
+        }
+
+        size_t GetInterpreterBlockSize() const
+        {
+            return m_interpreterBlockSize;
+        }
+
+        bool IsInterpreterThreaded() const
+        {
+            return m_interpreterThreaded;
+        }
+
+        size_t GetPrefetchDistance() const
+        {
+            return m_prefetchDistance;
+        }
+
+        bool IsSliceFilteringEnabled() const
+        {
+            return m_sliceFiltering;
+        }
+
+        // Returns nullptr if top-k scoring is not enabled.
+        TopKCollector* GetTopK() const
+        {
+            return m_topK.get();
+        }
+
+        // Returns nullptr if early termination is not enabled.
+        MatchQuota* GetMatchQuota() const
+        {
+            return m_matchQuota.get();
+        }
+
     private:
         std::unique_ptr<IAllocator> m_matchTreeAllocator;
         std::unique_ptr<NativeJIT::Allocator> m_expressionTreeAllocator;
         std::unique_ptr<NativeJIT::ExecutionBuffer> m_codeAllocator;
         std::unique_ptr<NativeJIT::FunctionBuffer> m_code;
         std::unique_ptr<CacheLineRecorder> m_cacheLineRecorder;
+        size_t m_matcherThreadCount;
+        VectorIsa m_vectorIsa;
+        size_t m_interpreterBlockSize;
+        bool m_interpreterThreaded;
+        size_t m_prefetchDistance;
+        bool m_sliceFiltering;
+        std::unique_ptr<TopKCollector> m_topK;
+        std::unique_ptr<MatchQuota> m_matchQuota;
     };
 }
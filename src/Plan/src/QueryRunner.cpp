@@ -25,10 +25,13 @@
 #include <memory>               // Used for std::unique_ptr of diagnosticStream. Probably temporary.
 #include <mutex>
 #include <ostream>
+#include <string>
 
 #include "BitFunnel/Configuration/Factories.h"
 #include "BitFunnel/Configuration/IStreamConfiguration.h"
+#include "BitFunnel/Exceptions.h"
 #include "BitFunnel/IDiagnosticStream.h"
+#include "BitFunnel/Index/IDocumentDataSchema.h"
 #include "BitFunnel/Index/IIngestor.h"
 #include "BitFunnel/Index/ISimpleIndex.h"
 #include "BitFunnel/Plan/Factories.h"
@@ -40,8 +43,12 @@
 #include "BitFunnel/Utilities/ITaskDistributor.h"
 #include "BitFunnel/Utilities/Stopwatch.h"
 #include "CsvTsv/Csv.h"
+#include "CompiledQuery.h"
+#include "QueryPlanCache.h"
+#include "QueryPlanner.h"
 #include "QueryResources.h"
 #include "ResultsBuffer.h"
+#include "TopKCollector.h"
 
 
 namespace BitFunnel
@@ -147,6 +154,12 @@ namespace BitFunnel
                        size_t maxResultCount,
                        bool useNativeCode,
                        bool countCacheLines,
+                       size_t matcherThreadCount,
+                       size_t topK,
+                       FixedSizeBlobId staticRankBlob,
+                       size_t maxMatchCount,
+                       double timeBudget,
+                       QueryPlanCache * planCache,
                        ThreadSynchronizer& synchronizer);
 
         //
@@ -156,6 +169,9 @@ namespace BitFunnel
         virtual void ProcessTask(size_t taskId) override;
         virtual void Finished() override;
 
+        // Returns nullptr if top-k scoring is not enabled.
+        TopKCollector const * GetTopK() const;
+
     private:
         //
         // constructor parameters
@@ -165,6 +181,7 @@ namespace BitFunnel
         std::vector<std::string> const & m_queries;
         std::vector<QueryInstrumentation::Data> & m_results;
         bool m_useNativeCode;
+        QueryPlanCache * m_planCache;
         ThreadSynchronizer& m_synchronizer;
 
         std::vector<ResultsBuffer::Result> m_matches;
@@ -176,6 +193,9 @@ namespace BitFunnel
         size_t m_queriesProcessed;
 
         static const size_t c_allocatorSize = 1ull << 16;
+
+        // Same row count target as Factories::RunQueryPlanner().
+        static const unsigned c_targetRowCount = 500;
     };
 
 
@@ -186,12 +206,19 @@ namespace BitFunnel
                                    size_t maxResultCount,
                                    bool useNativeCode,
                                    bool countCacheLines,
+                                   size_t matcherThreadCount,
+                                   size_t topK,
+                                   FixedSizeBlobId staticRankBlob,
+                                   size_t maxMatchCount,
+                                   double timeBudget,
+                                   QueryPlanCache * planCache,
                                    ThreadSynchronizer& synchronizer)
       : m_index(index),
         m_config(config),
         m_queries(queries),
         m_results(results),
         m_useNativeCode(useNativeCode),
+        m_planCache(planCache),
         m_synchronizer(synchronizer),
         m_matches(maxResultCount, {nullptr, 0}),
         m_resultsBuffer(index.GetIngestor().GetDocumentCount()),
@@ -202,6 +229,15 @@ namespace BitFunnel
         {
             m_resources.EnableCacheLineCounting(index);
         }
+        m_resources.EnableParallelMatching(matcherThreadCount);
+        if (topK > 0)
+        {
+            m_resources.EnableTopK(topK, staticRankBlob);
+        }
+        if (maxMatchCount > 0 || timeBudget > 0.0)
+        {
+            m_resources.EnableEarlyTermination(maxMatchCount, timeBudget);
+        }
     }
 
 
@@ -219,23 +255,52 @@ namespace BitFunnel
 
         size_t queryId = taskId % m_queries.size();
 
-        QueryParser parser(m_queries[queryId].c_str(),
-                           m_config,
-                           m_resources.GetMatchTreeAllocator());
-        auto tree = parser.Parse();
-        instrumentation.FinishParsing();
+        std::string key;
+        std::shared_ptr<CompiledQuery const> compiledQuery;
+        if (m_planCache != nullptr)
+        {
+            key = QueryPlanCache::NormalizeQuery(m_queries[queryId].c_str());
+            compiledQuery = m_planCache->Find(key, m_useNativeCode, m_resources);
+        }
 
-        // TODO: remove diagnosticStream and replace with nullable.
-        auto diagnosticStream = Factories::CreateDiagnosticStream(std::cout);
-        if (tree != nullptr)
+        if (compiledQuery != nullptr)
         {
-            Factories::RunQueryPlanner(*tree,
-                                       m_index,
-                                       m_resources,
-                                       *diagnosticStream,
-                                       instrumentation,
-                                       m_resultsBuffer,
-                                       m_useNativeCode);
+            // Cache hit. Skip parsing, planning and compilation.
+            instrumentation.FinishParsing();
+            instrumentation.SetRowCount(compiledQuery->GetRowCount());
+            instrumentation.FinishPlanning();
+            compiledQuery->Run(m_index,
+                               m_resources,
+                               instrumentation,
+                               m_resultsBuffer);
+        }
+        else
+        {
+            QueryParser parser(m_queries[queryId].c_str(),
+                               m_config,
+                               m_resources.GetMatchTreeAllocator());
+            auto tree = parser.Parse();
+            instrumentation.FinishParsing();
+
+            // TODO: remove diagnosticStream and replace with nullable.
+            auto diagnosticStream = Factories::CreateDiagnosticStream(std::cout);
+            if (tree != nullptr)
+            {
+                QueryPlanner planner(*tree,
+                                     c_targetRowCount,
+                                     m_index,
+                                     m_resources,
+                                     *diagnosticStream,
+                                     instrumentation,
+                                     m_resultsBuffer,
+                                     m_useNativeCode,
+                                     m_planCache != nullptr);
+
+                if (m_planCache != nullptr)
+                {
+                    m_planCache->Add(key, planner.GetCompiledQuery(), m_resources);
+                }
+            }
         }
 
         m_results[taskId] = instrumentation.GetData();
@@ -246,17 +311,50 @@ namespace BitFunnel
     {
     }
 
+
+    TopKCollector const * QueryProcessor::GetTopK() const
+    {
+        return m_resources.GetTopK();
+    }
+
     //*************************************************************************
     //
     // QueryRunner
     //
     //*************************************************************************
+    // Maximum number of CompiledQueries retained while running a query log.
+    // Each native code CompiledQuery owns a 64KB code buffer.
+    static const size_t c_planCacheCapacity = 256;
+
+    static_assert(QueryRunner::c_noStaticRank == TopKCollector::c_noStaticRank,
+                  "QueryRunner and TopKCollector disagree on c_noStaticRank.");
+
+
     QueryInstrumentation::Data QueryRunner::Run(
         char const * query,
         ISimpleIndex const & index,
         bool useNativeCode,
-        bool countCacheLines)
+        bool countCacheLines,
+        size_t matcherThreadCount,
+        size_t topK,
+        FixedSizeBlobId staticRankBlob,
+        size_t maxMatchCount,
+        double timeBudget,
+        std::vector<ScoredMatch> & topMatches)
     {
+        if (staticRankBlob != c_noStaticRank)
+        {
+            auto const & blobSizes =
+                index.GetDocumentDataSchema().GetFixedSizeBlobSizes();
+            if (staticRankBlob >= blobSizes.size() ||
+                blobSizes[staticRankBlob] < sizeof(float))
+            {
+                RecoverableError
+                    error("QueryRunner::Run: staticRankBlob is not a float blob in the schema.");
+                throw error;
+            }
+        }
+
         std::vector<std::string> queries;
         queries.push_back(std::string(query));
 
@@ -276,10 +374,21 @@ namespace BitFunnel
                       maxResultCount,
                       useNativeCode,
                       countCacheLines,
+                      matcherThreadCount,
+                      topK,
+                      staticRankBlob,
+                      maxMatchCount,
+                      timeBudget,
+                      nullptr,
                       synchronizer);
         processor.ProcessTask(0);
         processor.Finished();
 
+        if (processor.GetTopK() != nullptr)
+        {
+            topMatches = processor.GetTopK()->GetMatches();
+        }
+
         return results[0];
     }
 
@@ -291,7 +400,9 @@ namespace BitFunnel
         std::vector<std::string> const & queries,
         size_t iterations,
         bool useNativeCode,
-        bool countCacheLines)
+        bool countCacheLines,
+        size_t maxMatchCount,
+        double timeBudget)
     {
         std::vector<QueryInstrumentation::Data> results(queries.size() * iterations);
 
@@ -301,6 +412,10 @@ namespace BitFunnel
 
         ThreadSynchronizer synchronizer(threadCount);
 
+        // Query logs repeat head queries many times, so compiled plans are
+        // shared across all threads.
+        QueryPlanCache planCache(index, c_planCacheCapacity);
+
         std::vector<std::unique_ptr<ITaskProcessor>> processors;
         for (size_t i = 0; i < threadCount; ++i) {
             processors.push_back(
@@ -312,6 +427,14 @@ namespace BitFunnel
                                        maxResultCount,
                                        useNativeCode,
                                        countCacheLines,
+                                       // Queries already run in parallel, so
+                                       // each one is matched on its own thread.
+                                       1,
+                                       0,
+                                       c_noStaticRank,
+                                       maxMatchCount,
+                                       timeBudget,
+                                       &planCache,
                                        synchronizer)));
         }
 
@@ -22,8 +22,10 @@
 
 #pragma once
 
+#include <algorithm>    // std::copy, std::max
 #include <iterator>
 #include <memory>       // std::unique_ptr
+#include <utility>      // std::move
 #include <type_traits>
 #include <stddef.h>     // size_t embedded.
 #include <vector>       // Inline method.
@@ -78,15 +80,40 @@ namespace BitFunnel
         {
             m_size = 0;
         }
-        
+
+        // Ensures there is space for at least capacity Results, preserving
+        // the Results already in the buffer. Grows geometrically so that a
+        // sequence of push_back() calls runs in amortized constant time.
+        void Reserve(size_t capacity)
+        {
+            if (capacity > m_capacity)
+            {
+                Grow(capacity);
+            }
+        }
+
         void push_back(Slice* slice, size_t index)
         {
-            // TODO: add overflow check
+            if (m_size == m_capacity)
+            {
+                Grow(m_size + 1);
+            }
             m_buffer[m_size].m_slice = slice;
             m_buffer[m_size].m_index = index;
             m_size++;
         }
 
+        // Appends the contents of another ResultsBuffer. Used to merge the
+        // results of matchers running in parallel.
+        void Append(ResultsBuffer const & other)
+        {
+            Reserve(m_size + other.m_size);
+            std::copy(other.m_buffer,
+                      other.m_buffer + other.m_size,
+                      m_buffer + m_size);
+            m_size += other.m_size;
+        }
+
         class const_iterator
             : public std::iterator<std::input_iterator_tag, Result>
         {
@@ -135,6 +162,18 @@ namespace BitFunnel
         size_t m_capacity;
         size_t m_size;
         Result * m_buffer;
+
+    private:
+        void Grow(size_t minCapacity)
+        {
+            size_t capacity = std::max(minCapacity, 2 * m_capacity);
+            std::unique_ptr<Result[]> buffer(new Result[capacity]);
+            std::copy(m_buffer, m_buffer + m_size, buffer.get());
+
+            m_bufferOwner = std::move(buffer);
+            m_buffer = m_bufferOwner.get();
+            m_capacity = capacity;
+        }
     };
     static_assert(std::is_standard_layout<ResultsBuffer>::value,
                   "Generated code requires standard layout for ResultsBuffer.");
@@ -0,0 +1,173 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "BitFunnel/Index/IShard.h"
+#include "LoggerInterfaces/Logging.h"
+#include "RowMatchNode.h"
+#include "SliceFilter.h"
+
+
+namespace BitFunnel
+{
+    SliceFilter::SliceFilter(RowMatchNode const & tree)
+    {
+        Append(tree);
+    }
+
+
+    bool SliceFilter::IsTrivial() const
+    {
+        return m_nodes.empty();
+    }
+
+
+    bool SliceFilter::CanMatch(IShard const & shard,
+                               void const * sliceBuffer,
+                               ptrdiff_t const * rowOffsets) const
+    {
+        if (IsTrivial())
+        {
+            return true;
+        }
+
+        size_t position = 0;
+        return Evaluate(position, shard, sliceBuffer, rowOffsets);
+    }
+
+
+    void SliceFilter::Filter(IShard const & shard,
+                             std::vector<void*> const & sliceBuffers,
+                             ptrdiff_t const * rowOffsets,
+                             std::vector<void*> & candidates) const
+    {
+        for (auto sliceBuffer : sliceBuffers)
+        {
+            if (CanMatch(shard, sliceBuffer, rowOffsets))
+            {
+                candidates.push_back(sliceBuffer);
+            }
+        }
+    }
+
+
+    bool SliceFilter::Append(RowMatchNode const & node)
+    {
+        switch (node.GetType())
+        {
+        case RowMatchNode::AndMatch:
+            {
+                RowMatchNode::And const & andNode =
+                    dynamic_cast<RowMatchNode::And const &>(node);
+
+                const size_t position = m_nodes.size();
+                m_nodes.push_back({ And, 0 });
+
+                const bool left = Append(andNode.GetLeft());
+                const bool right = Append(andNode.GetRight());
+
+                if (!left && !right)
+                {
+                    m_nodes.resize(position);
+                    return false;
+                }
+                else if (!left || !right)
+                {
+                    // Only one child constrains the slice, so it replaces
+                    // the And.
+                    m_nodes.erase(m_nodes.begin() + static_cast<ptrdiff_t>(position));
+                }
+                return true;
+            }
+        case RowMatchNode::OrMatch:
+            {
+                RowMatchNode::Or const & orNode =
+                    dynamic_cast<RowMatchNode::Or const &>(node);
+
+                const size_t position = m_nodes.size();
+                m_nodes.push_back({ Or, 0 });
+
+                if (!Append(orNode.GetLeft()) || !Append(orNode.GetRight()))
+                {
+                    m_nodes.resize(position);
+                    return false;
+                }
+                return true;
+            }
+        case RowMatchNode::NotMatch:
+            return false;
+        case RowMatchNode::ReportMatch:
+            {
+                RowMatchNode const * child =
+                    dynamic_cast<RowMatchNode::Report const &>(node).GetChild();
+                return (child == nullptr) ? false : Append(*child);
+            }
+        case RowMatchNode::RowMatch:
+            {
+                AbstractRow const & row =
+                    dynamic_cast<RowMatchNode::Row const &>(node).GetRow();
+                if (row.IsInverted())
+                {
+                    return false;
+                }
+                m_nodes.push_back({ Row, row.GetId() });
+                return true;
+            }
+        default:
+            LogAbortB("SliceFilter: invalid node type.");
+        }
+
+        return false;
+    }
+
+
+    bool SliceFilter::Evaluate(size_t & position,
+                               IShard const & shard,
+                               void const * sliceBuffer,
+                               ptrdiff_t const * rowOffsets) const
+    {
+        Node const & node = m_nodes[position++];
+
+        switch (node.m_opcode)
+        {
+        case And:
+            {
+                // Both children must be evaluated to advance position past
+                // the right subtree.
+                const bool left = Evaluate(position, shard, sliceBuffer, rowOffsets);
+                const bool right = Evaluate(position, shard, sliceBuffer, rowOffsets);
+                return left && right;
+            }
+        case Or:
+            {
+                const bool left = Evaluate(position, shard, sliceBuffer, rowOffsets);
+                const bool right = Evaluate(position, shard, sliceBuffer, rowOffsets);
+                return left || right;
+            }
+        case Row:
+            return !shard.IsRowEmpty(sliceBuffer, rowOffsets[node.m_id]);
+        default:
+            LogAbortB("SliceFilter: invalid opcode.");
+        }
+
+        return true;
+    }
+}
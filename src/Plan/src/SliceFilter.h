@@ -0,0 +1,106 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <stddef.h>                     // ptrdiff_t parameter.
+#include <vector>                       // std::vector embedded.
+
+#include "BitFunnel/NonCopyable.h"      // Base class.
+
+
+namespace BitFunnel
+{
+    class IShard;
+    class RowMatchNode;
+
+    //*************************************************************************
+    //
+    // SliceFilter
+    //
+    // Decides, before the matcher runs, which slices of a shard cannot
+    // contain a match for a query. The filter is a simplified copy of the
+    // rewritten RowMatchNode tree in which only the non-inverted rows
+    // remain. Each row is tested against the per-slice row summaries
+    // maintained by the RowTables during ingestion. A slice is skipped when
+    // the tree evaluates to false with every empty row treated as false and
+    // every other row treated as true.
+    //
+    // Not nodes and inverted rows can match in an empty slice, so they are
+    // treated as true. The filter is therefore conservative: it never skips
+    // a slice which has a match, but it may keep slices which have none.
+    //
+    //*************************************************************************
+    class SliceFilter : NonCopyable
+    {
+    public:
+        SliceFilter(RowMatchNode const & tree);
+
+        // Returns true if the filter keeps every slice. This happens when
+        // the query has no non-inverted row on a path that is required for
+        // a match.
+        bool IsTrivial() const;
+
+        // Returns false if the slice in sliceBuffer cannot contain a match.
+        // The rowOffsets are the shard's offsets for the query's rows,
+        // indexed by AbstractRow id.
+        bool CanMatch(IShard const & shard,
+                      void const * sliceBuffer,
+                      ptrdiff_t const * rowOffsets) const;
+
+        // Appends the members of sliceBuffers for which CanMatch() returns
+        // true to candidates.
+        void Filter(IShard const & shard,
+                    std::vector<void*> const & sliceBuffers,
+                    ptrdiff_t const * rowOffsets,
+                    std::vector<void*> & candidates) const;
+
+    private:
+        enum Opcode
+        {
+            And,
+            Or,
+            Row
+        };
+
+        class Node
+        {
+        public:
+            Opcode m_opcode;
+            unsigned m_id;
+        };
+
+        // Appends the prefix form of the simplified tree to m_nodes. Returns
+        // false, without appending anything, if node can match in every
+        // slice.
+        bool Append(RowMatchNode const & node);
+
+        // Evaluates the prefix subtree starting at m_nodes[position] and
+        // advances position past it.
+        bool Evaluate(size_t & position,
+                      IShard const & shard,
+                      void const * sliceBuffer,
+                      ptrdiff_t const * rowOffsets) const;
+
+        std::vector<Node> m_nodes;
+    };
+}
@@ -0,0 +1,126 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <algorithm>                // std::push_heap, std::pop_heap, std::sort_heap.
+#include <string.h>                 // memcpy.
+
+#include "BitFunnel/Index/DocumentHandle.h"
+#include "ResultsBuffer.h"
+#include "TopKCollector.h"
+
+
+namespace BitFunnel
+{
+    //*************************************************************************
+    //
+    // TopKCollector
+    //
+    //*************************************************************************
+    TopKCollector::TopKCollector(size_t k, FixedSizeBlobId staticRankBlob)
+      : m_k(k),
+        m_staticRankBlob(staticRankBlob)
+    {
+        m_heap.reserve(k);
+    }
+
+
+    void TopKCollector::AddResults(ResultsBuffer const & results)
+    {
+        for (auto result : results)
+        {
+            DocumentHandle handle = result.GetHandle();
+
+            ScoredMatch match;
+            match.m_id = handle.GetDocId();
+            match.m_score = 0.0f;
+            if (m_staticRankBlob != c_noStaticRank)
+            {
+                memcpy(&match.m_score,
+                       handle.GetFixedSizeBlob(m_staticRankBlob),
+                       sizeof(match.m_score));
+            }
+
+            Add(match);
+        }
+    }
+
+
+    void TopKCollector::Merge(TopKCollector const & other)
+    {
+        for (auto const & match : other.m_heap)
+        {
+            Add(match);
+        }
+    }
+
+
+    void TopKCollector::Reset()
+    {
+        m_heap.clear();
+    }
+
+
+    std::vector<ScoredMatch> TopKCollector::GetMatches() const
+    {
+        std::vector<ScoredMatch> matches(m_heap);
+        std::sort_heap(matches.begin(), matches.end(), IsBetter);
+        return matches;
+    }
+
+
+    size_t TopKCollector::GetK() const
+    {
+        return m_k;
+    }
+
+
+    FixedSizeBlobId TopKCollector::GetStaticRankBlob() const
+    {
+        return m_staticRankBlob;
+    }
+
+
+    void TopKCollector::Add(ScoredMatch const & match)
+    {
+        if (m_heap.size() < m_k)
+        {
+            m_heap.push_back(match);
+            std::push_heap(m_heap.begin(), m_heap.end(), IsBetter);
+        }
+        else if (m_k > 0 && IsBetter(match, m_heap.front()))
+        {
+            std::pop_heap(m_heap.begin(), m_heap.end(), IsBetter);
+            m_heap.back() = match;
+            std::push_heap(m_heap.begin(), m_heap.end(), IsBetter);
+        }
+    }
+
+
+    bool TopKCollector::IsBetter(ScoredMatch const & a, ScoredMatch const & b)
+    {
+        if (a.m_score != b.m_score)
+        {
+            return a.m_score > b.m_score;
+        }
+        return a.m_id < b.m_id;
+    }
+}
@@ -0,0 +1,90 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <stddef.h>                                 // size_t embedded.
+#include <vector>                                   // std::vector embedded.
+
+#include "BitFunnel/Index/IDocumentDataSchema.h"    // FixedSizeBlobId embedded.
+#include "BitFunnel/Plan/ScoredMatch.h"             // ScoredMatch embedded.
+
+
+namespace BitFunnel
+{
+    class ResultsBuffer;
+
+    //*************************************************************************
+    //
+    // TopKCollector
+    //
+    // Scoring stage that runs after matching. Each match is scored by the
+    // document's static rank, a float stored in a fixed-size blob in the
+    // DocTable. The collector keeps the k highest-scoring matches in a
+    // bounded heap, so memory use does not depend on the number of matches.
+    // Ties are broken in favor of the smaller DocId. If there is no static
+    // rank blob, every match scores 0 and the k smallest DocIds are kept.
+    //
+    // TopKCollector is not thread safe. Each matcher thread should use its
+    // own collector. The per-thread collectors can be combined with Merge().
+    //
+    // AddResults() reads the DocTable, so the caller must hold a Token.
+    //
+    //*************************************************************************
+    class TopKCollector
+    {
+    public:
+        // Value for staticRankBlob when the schema has no static rank.
+        static const FixedSizeBlobId c_noStaticRank = static_cast<FixedSizeBlobId>(-1);
+
+        TopKCollector(size_t k, FixedSizeBlobId staticRankBlob);
+
+        // Scores each match in results and retains it if it is among the
+        // top k seen so far.
+        void AddResults(ResultsBuffer const & results);
+
+        // Retains the entries from other that are among the top k.
+        void Merge(TopKCollector const & other);
+
+        // Removes all entries.
+        void Reset();
+
+        // Returns the retained matches, highest score first.
+        std::vector<ScoredMatch> GetMatches() const;
+
+        size_t GetK() const;
+        FixedSizeBlobId GetStaticRankBlob() const;
+
+    private:
+        void Add(ScoredMatch const & match);
+
+        // Returns true if a should be ranked ahead of b.
+        static bool IsBetter(ScoredMatch const & a, ScoredMatch const & b);
+
+        const size_t m_k;
+        const FixedSizeBlobId m_staticRankBlob;
+
+        // Heap ordered by IsBetter(), so the worst retained match is at the
+        // front.
+        std::vector<ScoredMatch> m_heap;
+    };
+}
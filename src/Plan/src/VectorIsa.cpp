@@ -0,0 +1,154 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <stdint.h>
+
+#ifdef _MSC_VER
+#include <immintrin.h>  // _xgetbv.
+#include <intrin.h>     // __cpuidex.
+#else
+#include <cpuid.h>      // __cpuid_count.
+#endif
+
+#include "BitFunnel/Exceptions.h"
+#include "VectorIsa.h"
+
+
+namespace BitFunnel
+{
+    static void CpuId(uint32_t leaf, uint32_t subleaf, uint32_t (&registers)[4])
+    {
+#ifdef _MSC_VER
+        int values[4];
+        __cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+        for (unsigned i = 0; i < 4; ++i)
+        {
+            registers[i] = static_cast<uint32_t>(values[i]);
+        }
+#else
+        __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+    }
+
+
+    // Returns the XCR0 register, which indicates the register state the
+    // operating system saves on context switches.
+    static uint64_t GetXcr0()
+    {
+#ifdef _MSC_VER
+        return _xgetbv(0);
+#else
+        uint32_t eax;
+        uint32_t edx;
+        __asm__ ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+        return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+    }
+
+
+    static VectorIsa DetectVectorIsa()
+    {
+        // Register indices in the CpuId() output.
+        const unsigned eax = 0;
+        const unsigned ebx = 1;
+        const unsigned ecx = 2;
+
+        uint32_t registers[4];
+        CpuId(0, 0, registers);
+        const uint32_t maxLeaf = registers[eax];
+        if (maxLeaf < 7)
+        {
+            return VectorIsa::Scalar;
+        }
+
+        // Leaf 1: ECX.OSXSAVE[bit 27], ECX.AVX[bit 28].
+        CpuId(1, 0, registers);
+        const bool osxsave = (registers[ecx] & (1u << 27)) != 0;
+        const bool avx = (registers[ecx] & (1u << 28)) != 0;
+        if (!osxsave || !avx)
+        {
+            return VectorIsa::Scalar;
+        }
+
+        // XCR0 bits 1 and 2 enable XMM and YMM state. Bits 5, 6, and 7
+        // enable the opmask and ZMM state.
+        const uint64_t xcr0 = GetXcr0();
+        const bool ymmState = (xcr0 & 0x6) == 0x6;
+        const bool zmmState = (xcr0 & 0xe6) == 0xe6;
+
+        // Leaf 7: EBX.AVX2[bit 5], EBX.AVX512F[bit 16].
+        CpuId(7, 0, registers);
+        const bool avx2 = (registers[ebx] & (1u << 5)) != 0;
+        const bool avx512f = (registers[ebx] & (1u << 16)) != 0;
+
+        if (avx512f && zmmState)
+        {
+            return VectorIsa::Avx512;
+        }
+        else if (avx2 && ymmState)
+        {
+            return VectorIsa::Avx2;
+        }
+
+        return VectorIsa::Scalar;
+    }
+
+
+    VectorIsa GetSupportedVectorIsa()
+    {
+        static const VectorIsa isa = DetectVectorIsa();
+        return isa;
+    }
+
+
+    size_t GetQuadwordsPerVector(VectorIsa isa)
+    {
+        switch (isa)
+        {
+        case VectorIsa::Scalar:
+            return 1;
+        case VectorIsa::Avx2:
+            return 4;
+        case VectorIsa::Avx512:
+            return 8;
+        default:
+            RecoverableError error("GetQuadwordsPerVector: unknown VectorIsa.");
+            throw error;
+        }
+    }
+
+
+    char const * GetVectorIsaName(VectorIsa isa)
+    {
+        switch (isa)
+        {
+        case VectorIsa::Scalar:
+            return "scalar";
+        case VectorIsa::Avx2:
+            return "avx2";
+        case VectorIsa::Avx512:
+            return "avx512";
+        default:
+            RecoverableError error("GetVectorIsaName: unknown VectorIsa.");
+            throw error;
+        }
+    }
+}
@@ -0,0 +1,57 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+
+#include <stddef.h>     // size_t return value.
+
+
+namespace BitFunnel
+{
+    //*************************************************************************
+    //
+    // VectorIsa identifies the vector instruction set used by the native
+    // matcher. Values are ordered from narrowest to widest.
+    //
+    //   Scalar: one quadword per iteration in general purpose registers.
+    //   Avx2:   four quadwords per iteration in YMM registers.
+    //   Avx512: eight quadwords per iteration in ZMM registers.
+    //
+    //*************************************************************************
+    enum class VectorIsa
+    {
+        Scalar,
+        Avx2,
+        Avx512
+    };
+
+
+    // Returns the widest VectorIsa supported by both the CPU and the
+    // operating system, as reported by CPUID and XGETBV. The result is
+    // computed once and cached.
+    VectorIsa GetSupportedVectorIsa();
+
+    // Returns the number of quadwords held in one vector register.
+    size_t GetQuadwordsPerVector(VectorIsa isa);
+
+    // Returns "scalar", "avx2", or "avx512".
+    char const * GetVectorIsaName(VectorIsa isa);
+}
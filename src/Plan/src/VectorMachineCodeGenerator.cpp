@@ -0,0 +1,590 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#include <limits>       // std::numeric_limits.
+
+#include "BitFunnel/Exceptions.h"
+#include "CompileNode.h"
+#include "MachineCodeGenerator.h"
+#include "NativeCodeGenerator.h"
+#include "NativeJIT/CodeGen/FunctionBuffer.h"
+#include "NativeJIT/CodeGen/X64CodeGenerator.h"
+#include "RegisterAllocator.h"
+#include "VectorMachineCodeGenerator.h"
+
+using namespace NativeJIT;
+
+
+namespace BitFunnel
+{
+    // Opcodes shared by the VEX (AVX2) and EVEX (AVX-512) encodings.
+    static const uint8_t c_vpand = 0xdb;
+    static const uint8_t c_vpandn = 0xdf;
+    static const uint8_t c_vpor = 0xeb;
+    static const uint8_t c_vpxor = 0xef;
+
+
+    //*************************************************************************
+    //
+    // SupportChecker
+    //
+    // ICodeGenerator that records whether a CompileNode tree uses any
+    // primitive that VectorMachineCodeGenerator cannot express.
+    //
+    //*************************************************************************
+    class SupportChecker : public ICodeGenerator
+    {
+    public:
+        SupportChecker()
+          : m_isSupported(true),
+            m_labelCount(0)
+        {
+        }
+
+        bool IsSupported() const
+        {
+            return m_isSupported;
+        }
+
+        virtual void AndRow(size_t /*id*/, bool /*inverted*/, size_t rankDelta) override
+        {
+            m_isSupported &= (rankDelta == 0);
+        }
+
+        virtual void LoadRow(size_t /*id*/, bool /*inverted*/, size_t rankDelta) override
+        {
+            m_isSupported &= (rankDelta == 0);
+        }
+
+        virtual void LeftShiftOffset(size_t /*shift*/) override { m_isSupported = false; }
+        virtual void RightShiftOffset(size_t /*shift*/) override { m_isSupported = false; }
+        virtual void IncrementOffset() override { m_isSupported = false; }
+
+        virtual void Push() override {}
+        virtual void Pop() override {}
+
+        virtual void AndStack() override {}
+        virtual void Constant(int /*value*/) override {}
+        virtual void Not() override {}
+        virtual void OrStack() override {}
+        virtual void UpdateFlags() override {}
+
+        virtual void Report() override {}
+
+        virtual Label AllocateLabel() override { return m_labelCount++; }
+        virtual void PlaceLabel(Label /*label*/) override {}
+        virtual void Call(Label /*label*/) override { m_isSupported = false; }
+        virtual void Jmp(Label /*label*/) override {}
+        virtual void Jnz(Label /*label*/) override {}
+        virtual void Jz(Label /*label*/) override {}
+        virtual void Return() override { m_isSupported = false; }
+
+    private:
+        bool m_isSupported;
+        Label m_labelCount;
+    };
+
+
+    //*************************************************************************
+    //
+    // VectorMachineCodeGenerator
+    //
+    //*************************************************************************
+    VectorMachineCodeGenerator::VectorMachineCodeGenerator(
+        RegisterAllocator const & registers,
+        FunctionBuffer & code,
+        VectorIsa isa,
+        size_t prefetchDistance)
+      : m_registers(registers),
+        m_code(code),
+        m_isa(isa),
+        m_vectorBytes(static_cast<uint8_t>(GetQuadwordsPerVector(isa) * 8)),
+        m_prefetchDistance(prefetchDistance)
+    {
+        if (isa == VectorIsa::Scalar)
+        {
+            RecoverableError error("VectorMachineCodeGenerator requires a vector instruction set.");
+            throw error;
+        }
+    }
+
+
+    bool VectorMachineCodeGenerator::IsSupported(CompileNode const & tree)
+    {
+        SupportChecker checker;
+        tree.Compile(checker);
+        return checker.IsSupported();
+    }
+
+
+    void VectorMachineCodeGenerator::EmitPrologue()
+    {
+        if (m_isa == VectorIsa::Avx512)
+        {
+            // vpternlogq zmm2, zmm2, zmm2, 0xff
+            EmitRegisterForm(ImpliedPrefix::P66, OpcodeMap::Map0F3A, true, 0x25,
+                             c_allOnes, c_allOnes, c_allOnes);
+            m_code.Emit8(0xff);
+        }
+        else
+        {
+            // vpcmpeqd ymm2, ymm2, ymm2
+            EmitRegisterForm(ImpliedPrefix::P66, OpcodeMap::Map0F, false, 0x76,
+                             c_allOnes, c_allOnes, c_allOnes);
+        }
+    }
+
+
+    void VectorMachineCodeGenerator::EmitEpilogue()
+    {
+        // vzeroupper avoids the transition penalty when the caller next
+        // executes SSE code.
+        m_code.Emit8(0xc5);
+        m_code.Emit8(0xf8);
+        m_code.Emit8(0x77);
+    }
+
+
+    //
+    // ICodeGenerator methods
+    //
+
+    //
+    // RankDown compiler primitives
+    //
+    void VectorMachineCodeGenerator::AndRow(size_t row,
+                                            bool inverted,
+                                            size_t rankDelta)
+    {
+#ifdef QUADWORDCOUNT
+        m_code.EmitImmediate<OpCode::Mov>(rax, static_cast<int32_t>(GetQuadwordsPerVector(m_isa)));
+        m_code.Emit<OpCode::Add>(rdi, NativeCodeGenerator::m_quadwordCount, rax);
+#endif
+
+        Address address = RowAddress(row, rankDelta);
+        EmitPrefetch(address);
+        if (!inverted)
+        {
+            EmitLogical(c_vpand, c_accumulator, c_accumulator, address);
+        }
+        else
+        {
+            // vpandn computes ~left & right, so the row must be in a
+            // register.
+            EmitLoad(c_temporary, address);
+            EmitLogical(c_vpandn, c_accumulator, c_temporary, c_accumulator);
+        }
+
+        EmitTestAccumulator();
+    }
+
+
+    void VectorMachineCodeGenerator::LoadRow(size_t row,
+                                             bool inverted,
+                                             size_t rankDelta)
+    {
+#ifdef QUADWORDCOUNT
+        m_code.EmitImmediate<OpCode::Mov>(rax, static_cast<int32_t>(GetQuadwordsPerVector(m_isa)));
+        m_code.Emit<OpCode::Add>(rdi, NativeCodeGenerator::m_quadwordCount, rax);
+#endif
+
+        Address address = RowAddress(row, rankDelta);
+        EmitPrefetch(address);
+        EmitLoad(c_accumulator, address);
+        if (inverted)
+        {
+            EmitLogical(c_vpxor, c_accumulator, c_accumulator, c_allOnes);
+        }
+
+        EmitTestAccumulator();
+    }
+
+
+    void VectorMachineCodeGenerator::LeftShiftOffset(size_t /*shift*/)
+    {
+        throw NotImplemented("VectorMachineCodeGenerator does not support rank down.");
+    }
+
+
+    void VectorMachineCodeGenerator::RightShiftOffset(size_t /*shift*/)
+    {
+        throw NotImplemented("VectorMachineCodeGenerator does not support rank down.");
+    }
+
+
+    void VectorMachineCodeGenerator::IncrementOffset()
+    {
+        throw NotImplemented("VectorMachineCodeGenerator does not support rank down.");
+    }
+
+
+    void VectorMachineCodeGenerator::Push()
+    {
+        m_code.EmitImmediate<OpCode::Sub>(rsp, static_cast<int32_t>(m_vectorBytes));
+        EmitStore(Address(rsp.GetId()), c_accumulator);
+    }
+
+
+    void VectorMachineCodeGenerator::Pop()
+    {
+        EmitLoad(c_accumulator, Address(rsp.GetId()));
+        m_code.EmitImmediate<OpCode::Add>(rsp, static_cast<int32_t>(m_vectorBytes));
+    }
+
+
+    //
+    // Stack machine primitives
+    //
+    void VectorMachineCodeGenerator::AndStack()
+    {
+        EmitLogical(c_vpand, c_accumulator, c_accumulator, Address(rsp.GetId()));
+        m_code.EmitImmediate<OpCode::Add>(rsp, static_cast<int32_t>(m_vectorBytes));
+        EmitTestAccumulator();
+    }
+
+
+    void VectorMachineCodeGenerator::Constant(int value)
+    {
+        m_code.EmitImmediate<OpCode::Mov>(rax, value);
+        if (m_isa == VectorIsa::Avx512)
+        {
+            // vpbroadcastq zmm0, rax
+            EmitRegisterForm(ImpliedPrefix::P66, OpcodeMap::Map0F38, true, 0x7c,
+                             c_accumulator, 0, rax.GetId());
+        }
+        else
+        {
+            // vmovq xmm0, rax
+            EmitPrefix(ImpliedPrefix::P66, OpcodeMap::Map0F, true, false,
+                       c_accumulator, 0, c_noIndex, rax.GetId());
+            m_code.Emit8(0x6e);
+            m_code.Emit8(static_cast<uint8_t>(0xc0 | (c_accumulator << 3) | rax.GetId8()));
+
+            // vpbroadcastq ymm0, xmm0
+            EmitRegisterForm(ImpliedPrefix::P66, OpcodeMap::Map0F38, false, 0x59,
+                             c_accumulator, 0, c_accumulator);
+        }
+    }
+
+
+    void VectorMachineCodeGenerator::Not()
+    {
+        EmitLogical(c_vpxor, c_accumulator, c_accumulator, c_allOnes);
+        EmitTestAccumulator();
+    }
+
+
+    void VectorMachineCodeGenerator::OrStack()
+    {
+        EmitLogical(c_vpor, c_accumulator, c_accumulator, Address(rsp.GetId()));
+        m_code.EmitImmediate<OpCode::Add>(rsp, static_cast<int32_t>(m_vectorBytes));
+        EmitTestAccumulator();
+    }
+
+
+    void VectorMachineCodeGenerator::UpdateFlags()
+    {
+        EmitTestAccumulator();
+    }
+
+
+    void VectorMachineCodeGenerator::Report()
+    {
+        // At rank 0 the iteration's quadwords start at dedupe offset 0, so
+        // the accumulator maps directly onto m_dedupe[1..n].
+        const Address dedupe(rdi.GetId(), NativeCodeGenerator::m_dedupe + 8);
+        EmitLogical(c_vpor, c_temporary, c_accumulator, dedupe);
+        EmitStore(dedupe, c_temporary);
+
+        // Mark every quadword in the iteration. EmitFinishIteration() skips
+        // quadwords whose accumulator is zero.
+        const size_t quadwords = GetQuadwordsPerVector(m_isa);
+        m_code.EmitImmediate<OpCode::Mov>(rax, static_cast<int32_t>((1u << quadwords) - 1));
+        m_code.Emit<OpCode::Or>(rdi, NativeCodeGenerator::m_dedupe, rax);
+    }
+
+
+    // Control flow primitives.
+    ICodeGenerator::Label VectorMachineCodeGenerator::AllocateLabel()
+    {
+        return m_code.AllocateLabel().GetId();
+    }
+
+
+    void VectorMachineCodeGenerator::PlaceLabel(Label label)
+    {
+        m_code.PlaceLabel(NativeJIT::Label(label));
+    }
+
+
+    void VectorMachineCodeGenerator::Call(Label /*label*/)
+    {
+        throw NotImplemented("VectorMachineCodeGenerator does not support rank down.");
+    }
+
+
+    void VectorMachineCodeGenerator::Jmp(Label label)
+    {
+        m_code.Jmp(NativeJIT::Label(label));
+    }
+
+
+    void VectorMachineCodeGenerator::Jnz(Label label)
+    {
+        m_code.EmitConditionalJump<JccType::JNZ>(NativeJIT::Label(label));
+    }
+
+
+    void VectorMachineCodeGenerator::Jz(Label label)
+    {
+        m_code.EmitConditionalJump<JccType::JZ>(NativeJIT::Label(label));
+    }
+
+
+    void VectorMachineCodeGenerator::Return()
+    {
+        throw NotImplemented("VectorMachineCodeGenerator does not support rank down.");
+    }
+
+
+    //
+    // Private methods
+    //
+
+    VectorMachineCodeGenerator::Address
+        VectorMachineCodeGenerator::RowAddress(size_t row, size_t rankDelta)
+    {
+        if (rankDelta != 0)
+        {
+            throw NotImplemented("VectorMachineCodeGenerator does not support rank down.");
+        }
+
+        unsigned id = static_cast<unsigned>(row);
+        if (m_registers.IsRegister(id))
+        {
+            return Address(rcx.GetId(), m_registers.GetRegister(id));
+        }
+        else
+        {
+            m_code.Emit<OpCode::Mov>(rax, rcx);
+            m_code.Emit<OpCode::Add>(rax, rsi, id * 8);
+            return Address(rax.GetId());
+        }
+    }
+
+
+    void VectorMachineCodeGenerator::EmitPrefetch(Address const & address)
+    {
+        if (m_prefetchDistance == 0 ||
+            m_prefetchDistance > static_cast<size_t>(std::numeric_limits<int32_t>::max()) / 8)
+        {
+            return;
+        }
+
+        MachineCodeGenerator::EmitPrefetch(
+            m_code,
+            address.m_base,
+            address.m_index,
+            address.m_displacement + static_cast<int32_t>(m_prefetchDistance * 8));
+    }
+
+
+    void VectorMachineCodeGenerator::EmitTestAccumulator()
+    {
+        if (m_isa == VectorIsa::Avx512)
+        {
+            // vptestmq k1, zmm0, zmm0
+            EmitRegisterForm(ImpliedPrefix::P66, OpcodeMap::Map0F38, true, 0x27,
+                             c_testMask, c_accumulator, c_accumulator);
+
+            // kortestw k1, k1
+            m_code.Emit8(0xc5);
+            m_code.Emit8(0xf8);
+            m_code.Emit8(0x98);
+            m_code.Emit8(static_cast<uint8_t>(0xc0 | (c_testMask << 3) | c_testMask));
+        }
+        else
+        {
+            // vptest ymm0, ymm0
+            EmitRegisterForm(ImpliedPrefix::P66, OpcodeMap::Map0F38, false, 0x17,
+                             c_accumulator, 0, c_accumulator);
+        }
+    }
+
+
+    void VectorMachineCodeGenerator::EmitLoad(unsigned dest, Address const & source)
+    {
+        // vmovdqu ymm, m256 or vmovdqu64 zmm, m512
+        EmitMemoryForm(ImpliedPrefix::PF3, OpcodeMap::Map0F,
+                       m_isa == VectorIsa::Avx512, 0x6f,
+                       dest, 0, source);
+    }
+
+
+    void VectorMachineCodeGenerator::EmitStore(Address const & dest, unsigned source)
+    {
+        // vmovdqu m256, ymm or vmovdqu64 m512, zmm
+        EmitMemoryForm(ImpliedPrefix::PF3, OpcodeMap::Map0F,
+                       m_isa == VectorIsa::Avx512, 0x7f,
+                       source, 0, dest);
+    }
+
+
+    void VectorMachineCodeGenerator::EmitLogical(uint8_t opcode,
+                                                 unsigned dest,
+                                                 unsigned left,
+                                                 unsigned right)
+    {
+        EmitRegisterForm(ImpliedPrefix::P66, OpcodeMap::Map0F,
+                         m_isa == VectorIsa::Avx512, opcode,
+                         dest, left, right);
+    }
+
+
+    void VectorMachineCodeGenerator::EmitLogical(uint8_t opcode,
+                                                 unsigned dest,
+                                                 unsigned left,
+                                                 Address const & right)
+    {
+        EmitMemoryForm(ImpliedPrefix::P66, OpcodeMap::Map0F,
+                       m_isa == VectorIsa::Avx512, opcode,
+                       dest, left, right);
+    }
+
+
+    // Emits a three byte VEX prefix for AVX2 or a four byte EVEX prefix for
+    // AVX-512. The fullWidth parameter selects 256-bit (VEX.L = 1) or
+    // 512-bit (EVEX.L'L = 2) operation. Otherwise the instruction operates
+    // on 128 bits. Register fields are stored inverted, as the encodings
+    // require.
+    void VectorMachineCodeGenerator::EmitPrefix(ImpliedPrefix prefix,
+                                                OpcodeMap map,
+                                                bool w,
+                                                bool fullWidth,
+                                                unsigned reg,
+                                                unsigned vvvv,
+                                                unsigned index,
+                                                unsigned base)
+    {
+        const uint8_t rxb = static_cast<uint8_t>(
+            ((~reg >> 3) & 1) << 7 |
+            ((~index >> 3) & 1) << 6 |
+            ((~base >> 3) & 1) << 5);
+        const uint8_t wvvvv = static_cast<uint8_t>(
+            (w ? 0x80 : 0) | ((~vvvv & 0xf) << 3));
+
+        if (m_isa == VectorIsa::Avx512)
+        {
+            m_code.Emit8(0x62);
+            // R X B R' 0 0 m m. R' is set because registers 16-31 are not
+            // used.
+            m_code.Emit8(static_cast<uint8_t>(rxb | 0x10 | static_cast<uint8_t>(map)));
+            // W v v v v 1 p p
+            m_code.Emit8(static_cast<uint8_t>(wvvvv | 0x04 | static_cast<uint8_t>(prefix)));
+            // z L' L b V' a a a. No masking, broadcast, or high registers.
+            m_code.Emit8(static_cast<uint8_t>((fullWidth ? 0x40 : 0x00) | 0x08));
+        }
+        else
+        {
+            m_code.Emit8(0xc4);
+            // R X B m m m m m
+            m_code.Emit8(static_cast<uint8_t>(rxb | static_cast<uint8_t>(map)));
+            // W v v v v L p p
+            m_code.Emit8(static_cast<uint8_t>(wvvvv |
+                                              (fullWidth ? 0x04 : 0x00) |
+                                              static_cast<uint8_t>(prefix)));
+        }
+    }
+
+
+    void VectorMachineCodeGenerator::EmitRegisterForm(ImpliedPrefix prefix,
+                                                      OpcodeMap map,
+                                                      bool w,
+                                                      uint8_t opcode,
+                                                      unsigned reg,
+                                                      unsigned vvvv,
+                                                      unsigned rm)
+    {
+        EmitPrefix(prefix, map, w, true, reg, vvvv, c_noIndex, rm);
+        m_code.Emit8(opcode);
+        m_code.Emit8(static_cast<uint8_t>(0xc0 | ((reg & 7) << 3) | (rm & 7)));
+    }
+
+
+    void VectorMachineCodeGenerator::EmitMemoryForm(ImpliedPrefix prefix,
+                                                    OpcodeMap map,
+                                                    bool w,
+                                                    uint8_t opcode,
+                                                    unsigned reg,
+                                                    unsigned vvvv,
+                                                    Address const & address)
+    {
+        EmitPrefix(prefix, map, w, true, reg, vvvv, address.m_index, address.m_base);
+        m_code.Emit8(opcode);
+
+        // Use mod = 00 (no displacement) where possible. RBP and R13 as a
+        // base require a displacement. Otherwise use a 32-bit displacement,
+        // which EVEX does not scale, unlike its compressed 8-bit form.
+        const bool noDisplacement =
+            address.m_displacement == 0 && (address.m_base & 7) != 5;
+        const uint8_t mod = noDisplacement ? 0x00 : 0x80;
+
+        // RSP and R12 as a base require a SIB byte.
+        const bool sib = address.m_index != c_noIndex || (address.m_base & 7) == 4;
+
+        m_code.Emit8(static_cast<uint8_t>(mod |
+                                          ((reg & 7) << 3) |
+                                          (sib ? 4 : (address.m_base & 7))));
+        if (sib)
+        {
+            // Scale 1.
+            m_code.Emit8(static_cast<uint8_t>(((address.m_index & 7) << 3) |
+                                              (address.m_base & 7)));
+        }
+        if (!noDisplacement)
+        {
+            m_code.Emit32(static_cast<uint32_t>(address.m_displacement));
+        }
+    }
+
+
+    //*************************************************************************
+    //
+    // VectorMachineCodeGenerator::Address
+    //
+    //*************************************************************************
+    VectorMachineCodeGenerator::Address::Address(unsigned base,
+                                                 int32_t displacement)
+      : m_base(base),
+        m_index(c_noIndex),
+        m_displacement(displacement)
+    {
+    }
+
+
+    VectorMachineCodeGenerator::Address::Address(unsigned base,
+                                                 unsigned index)
+      : m_base(base),
+        m_index(index),
+        m_displacement(0)
+    {
+    }
+}
@@ -0,0 +1,223 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+#pragma once
+
+#include <stdint.h>                     // uint8_t, int32_t parameters.
+
+#include "BitFunnel/NonCopyable.h"      // Base class.
+#include "ICodeGenerator.h"             // Base class.
+#include "VectorIsa.h"                  // VectorIsa embedded.
+
+
+namespace NativeJIT
+{
+    class FunctionBuffer;
+}
+
+using namespace NativeJIT;
+
+
+namespace BitFunnel
+{
+    class CompileNode;
+    class RegisterAllocator;
+
+
+    //*************************************************************************
+    //
+    // VectorMachineCodeGenerator is an ICodeGenerator that translates
+    // CompileNode trees into AVX2 or AVX-512 code which processes four or
+    // eight rank 0 quadwords of each row per iteration.
+    //
+    // The accumulator is held in YMM0/ZMM0 and the value stack lives on the
+    // X64 stack. The Z flag is set when every quadword in the accumulator is
+    // zero, so the short-circuit jumps emitted by CompileNode skip work only
+    // when no document in the iteration can match.
+    //
+    // Only plans whose initial rank is 0 can be vectorized. Rank down
+    // requires per-quadword control flow, so LeftShiftOffset(),
+    // RightShiftOffset(), IncrementOffset(), Call() and Return() throw, as
+    // do row accesses with a non-zero rank delta. Use IsSupported() to check
+    // a tree before compiling it.
+    //
+    // NativeJIT has no vector instruction encoder, so the VEX and EVEX
+    // encodings are emitted byte by byte.
+    //
+    // Register usage is the same as MachineCodeGenerator:
+    //   rax: scratch register
+    //   rcx: slice + iteration
+    //   rdx: slice
+    //   rsi: pointer to array of row offsets
+    //   rdi: pointer to parameters data structure
+    //   r8-r15: row offset pointers
+    //
+    //*************************************************************************
+    class VectorMachineCodeGenerator : public ICodeGenerator, NonCopyable
+    {
+    public:
+        // The isa parameter must be VectorIsa::Avx2 or VectorIsa::Avx512.
+        // When prefetchDistance is not zero, each row access is preceded by a
+        // prefetch of the row prefetchDistance quadwords ahead.
+        VectorMachineCodeGenerator(RegisterAllocator const & registers,
+                                   FunctionBuffer & code,
+                                   VectorIsa isa,
+                                   size_t prefetchDistance);
+
+        // Returns true if tree uses only the primitives supported by
+        // VectorMachineCodeGenerator.
+        static bool IsSupported(CompileNode const & tree);
+
+        // Emits code that must run once before the first iteration.
+        void EmitPrologue();
+
+        // Emits code that must run after the last iteration, before
+        // returning to non-vector code.
+        void EmitEpilogue();
+
+        //
+        // ICodeGenerator methods
+        //
+
+        // RankDown compiler primitives
+        virtual void AndRow(size_t id, bool inverted, size_t rankDelta) override;
+        virtual void LoadRow(size_t id, bool inverted, size_t rankDelta) override;
+
+        virtual void LeftShiftOffset(size_t shift) override;
+        virtual void RightShiftOffset(size_t shift) override;
+        virtual void IncrementOffset() override;
+
+        virtual void Push() override;
+        virtual void Pop() override;
+
+        // Stack machine primitives
+        virtual void AndStack() override;
+        virtual void Constant(int value) override;
+        virtual void Not() override;
+        virtual void OrStack() override;
+        virtual void UpdateFlags() override;
+
+        virtual void Report() override;
+
+        // Constrol flow primitives.
+        virtual Label AllocateLabel() override;
+        virtual void PlaceLabel(Label label) override;
+        virtual void Call(Label label) override;
+        virtual void Jmp(Label label) override;
+        virtual void Jnz(Label label) override;
+        virtual void Jz(Label label) override;
+        virtual void Return() override;
+
+    private:
+        // Opcode maps selected by the VEX/EVEX mm field.
+        enum class OpcodeMap : uint8_t
+        {
+            Map0F = 1,
+            Map0F38 = 2,
+            Map0F3A = 3
+        };
+
+        // Implied legacy prefixes selected by the VEX/EVEX pp field.
+        enum class ImpliedPrefix : uint8_t
+        {
+            None = 0,
+            P66 = 1,
+            PF3 = 2,
+            PF2 = 3
+        };
+
+        // Memory operand [base + index + displacement].
+        class Address
+        {
+        public:
+            Address(unsigned base, int32_t displacement = 0);
+            Address(unsigned base, unsigned index);
+
+            unsigned m_base;
+            unsigned m_index;
+            int32_t m_displacement;
+        };
+
+        // Marks an Address with no index register.
+        static const unsigned c_noIndex = 4;
+
+        // Returns the address of the current quadword of row id and may
+        // clobber rax.
+        Address RowAddress(size_t id, size_t rankDelta);
+
+        // Emits a prefetch of address advanced by m_prefetchDistance
+        // quadwords. Emits nothing if prefetching is disabled.
+        void EmitPrefetch(Address const & address);
+
+        // Sets the Z flag if every quadword in the accumulator is zero.
+        void EmitTestAccumulator();
+
+        // Vector instructions. Logical operations use the quadword variants
+        // under AVX-512.
+        void EmitLoad(unsigned dest, Address const & source);
+        void EmitStore(Address const & dest, unsigned source);
+        void EmitLogical(uint8_t opcode, unsigned dest, unsigned left, unsigned right);
+        void EmitLogical(uint8_t opcode, unsigned dest, unsigned left, Address const & right);
+
+        // Instruction encoding helpers.
+        void EmitPrefix(ImpliedPrefix prefix,
+                        OpcodeMap map,
+                        bool w,
+                        bool fullWidth,
+                        unsigned reg,
+                        unsigned vvvv,
+                        unsigned index,
+                        unsigned base);
+        void EmitRegisterForm(ImpliedPrefix prefix,
+                              OpcodeMap map,
+                              bool w,
+                              uint8_t opcode,
+                              unsigned reg,
+                              unsigned vvvv,
+                              unsigned rm);
+        void EmitMemoryForm(ImpliedPrefix prefix,
+                            OpcodeMap map,
+                            bool w,
+                            uint8_t opcode,
+                            unsigned reg,
+                            unsigned vvvv,
+                            Address const & address);
+
+        RegisterAllocator const & m_registers;
+        FunctionBuffer & m_code;
+        const VectorIsa m_isa;
+
+        // Size of the vector registers in bytes.
+        const uint8_t m_vectorBytes;
+
+        // Number of quadwords to prefetch ahead. Zero disables prefetching.
+        const size_t m_prefetchDistance;
+
+        // Vector register assignments. These are volatile under both the
+        // Windows and System V calling conventions.
+        static const unsigned c_accumulator = 0;
+        static const unsigned c_temporary = 1;
+        static const unsigned c_allOnes = 2;
+
+        // Opmask register used to test the accumulator under AVX-512.
+        static const unsigned c_testMask = 1;
+    };
+}
@@ -0,0 +1,96 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// ByteCodeDispatchBenchmark compares the ByteCodeInterpreter's switch
+// dispatch with its direct-threaded dispatch. The plan ranks down, so that
+// neither run uses block mode. The correctness of both dispatch methods is
+// checked by the ByteCodeInterpreter tests in PlanTest.
+//
+// Usage: ByteCodeDispatchBenchmark [runCount] [maxDocId]
+
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "BitFunnel/Configuration/Factories.h"
+#include "BitFunnel/Configuration/IFileSystem.h"
+#include "BitFunnel/Index/ISimpleIndex.h"
+#include "BitFunnel/Mocks/Factories.h"
+#include "BitFunnel/Term.h"
+#include "ByteCodeVerifier.h"
+
+
+int main(int argc, char** argv)
+{
+    using namespace BitFunnel;
+
+    const size_t runCount =
+        (argc > 1) ? std::stoul(argv[1]) : 2000;
+    const DocId maxDocId =
+        (argc > 2) ? std::stoull(argv[2]) : 1664;
+
+    const Term::StreamId streamId = 0;
+    auto fileSystem = Factories::CreateRAMFileSystem();
+    auto index = Factories::CreatePrimeFactorsIndex(*fileSystem,
+                                                    maxDocId,
+                                                    streamId);
+
+    char const * text =
+        "RankDown {"
+        "  Delta: 2,"
+        "  Child: Or {"
+        "    Children: ["
+        "      LoadRowJz {"
+        "        Row: Row(0, 0, 0, false),"
+        "        Child: AndRowJz {"
+        "          Row: Row(1, 0, 1, true),"
+        "          Child: Report {"
+        "            Child: "
+        "          }"
+        "        }"
+        "      },"
+        "      LoadRowJz {"
+        "        Row: Row(2, 0, 2, false),"
+        "        Child: Report {"
+        "          Child: "
+        "        }"
+        "      }"
+        "    ]"
+        "  }"
+        "}";
+
+    const Rank initialRank = 2;
+    ByteCodeVerifier verifier(*index, initialRank);
+    verifier.DeclareRow("3");
+    verifier.DeclareRow("5");
+    verifier.DeclareRow("7");
+
+    const double switchTime = verifier.Benchmark(text, false, runCount);
+    const double threadedTime = verifier.Benchmark(text, true, runCount);
+
+    std::cout
+        << "Switch dispatch: " << switchTime << "s, "
+        << "threaded dispatch: " << threadedTime << "s "
+        << "(" << runCount << " runs)" << std::endl;
+
+    return 0;
+}
@@ -20,8 +20,10 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -31,8 +33,12 @@
 #include "BitFunnel/Index/ISimpleIndex.h"
 #include "BitFunnel/Mocks/Factories.h"
 #include "BitFunnel/Term.h"                     // Only needed for streamId
+#include "BitFunnel/Plan/QueryInstrumentation.h"
+#include "ByteCodeInterpreter.h"
 #include "ByteCodeVerifier.h"
+#include "CacheLineRecorder.h"
 #include "Primes.h"
+#include "ResultsBuffer.h"
 
 
 namespace BitFunnel
@@ -586,6 +592,58 @@ namespace BitFunnel
     }
 
 
+    //*************************************************************************
+    //
+    // Report expression test cases
+    //
+    //*************************************************************************
+
+    TEST(ByteCodeInterpreter, ReportExpression)
+    {
+        char const * text =
+            "LoadRowJz {"
+            "  Row: Row(0, 0, 0, false),"
+            "  Child: Report {"
+            "    Child: OrTree {"
+            "      Children: ["
+            "        AndTree {"
+            "          Children: ["
+            "            LoadRow(1, 0, 0, false),"
+            "            LoadRow(2, 0, 0, false)"
+            "          ]"
+            "        },"
+            "        Not {"
+            "          Child: LoadRow(3, 0, 0, false)"
+            "        }"
+            "      ]"
+            "    }"
+            "  }"
+            "}";
+
+        const Rank initialRank = 0;
+        ByteCodeVerifier verifier(GetIndex(), initialRank);
+
+        verifier.DeclareRow("2");
+        verifier.DeclareRow("3");
+        verifier.DeclareRow("5");
+        verifier.DeclareRow("7");
+
+        for (auto iteration : verifier.GetIterations())
+        {
+            const size_t slice = verifier.GetSliceNumber(iteration);
+            const size_t offset = verifier.GetOffset(iteration);
+
+            const uint64_t row0 = verifier.GetRowData(0, offset, slice);
+            const uint64_t row1 = verifier.GetRowData(1, offset, slice);
+            const uint64_t row2 = verifier.GetRowData(2, offset, slice);
+            const uint64_t row3 = verifier.GetRowData(3, offset, slice);
+            verifier.ExpectResult(row0 & ((row1 & row2) | ~row3), offset, slice);
+        }
+
+        verifier.Verify(text);
+    }
+
+
     //*************************************************************************
     //
     // Out-of-order test cases
@@ -677,4 +735,175 @@ namespace BitFunnel
 
         verifier.Verify(text);
     }
+
+
+    //*************************************************************************
+    //
+    // Dispatch methods
+    //
+    //*************************************************************************
+
+    // Checks switch dispatch and direct-threaded dispatch on a plan that ranks
+    // down, so that neither run uses block mode. Verify() runs the plan with
+    // both dispatch methods. See ByteCodeDispatchBenchmark for timings.
+    TEST(ByteCodeInterpreter, Dispatch)
+    {
+        char const * text =
+            "RankDown {"
+            "  Delta: 2,"
+            "  Child: Or {"
+            "    Children: ["
+            "      LoadRowJz {"
+            "        Row: Row(0, 0, 0, false),"
+            "        Child: AndRowJz {"
+            "          Row: Row(1, 0, 1, true),"
+            "          Child: Report {"
+            "            Child: "
+            "          }"
+            "        }"
+            "      },"
+            "      LoadRowJz {"
+            "        Row: Row(2, 0, 2, false),"
+            "        Child: Report {"
+            "          Child: "
+            "        }"
+            "      }"
+            "    ]"
+            "  }"
+            "}";
+
+        const Rank initialRank = 2;
+        ByteCodeVerifier verifier(GetIndex(), initialRank);
+
+        verifier.DeclareRow("3");
+        verifier.DeclareRow("5");
+        verifier.DeclareRow("7");
+
+        for (auto iteration : verifier.GetIterations())
+        {
+            const size_t slice = verifier.GetSliceNumber(iteration);
+            const size_t offset = verifier.GetOffset(iteration);
+
+            for (size_t i = 0; i < 4; ++i)
+            {
+                const uint64_t row0 = verifier.GetRowData(0, offset * 4 + i, slice);
+                const uint64_t row1 = verifier.GetRowData(1, (offset * 4 + i) >> 1, slice);
+                const uint64_t row2 = verifier.GetRowData(2, (offset * 4 + i) >> 2, slice);
+
+                verifier.ExpectResult(row0 & ~row1, offset * 4 + i, slice);
+                verifier.ExpectResult(row2, offset * 4 + i, slice);
+            }
+        }
+
+        verifier.Verify(text);
+    }
+
+
+    //*************************************************************************
+    //
+    // Prefetching
+    //
+    //*************************************************************************
+
+    // Checks with a CacheLineRecorder that prefetching covers the cache lines
+    // the interpreter touches. The test uses a synthetic slice because the
+    // rows in the shared index are shorter than a cache line.
+    TEST(ByteCodeInterpreter, PrefetchCoverage)
+    {
+        const size_t c_quadwordsPerCacheLine = c_bytesPerCacheLine / sizeof(uint64_t);
+        const size_t c_quadwordsPerRow = 8 * c_quadwordsPerCacheLine;
+        const size_t c_rowCount = 2;
+
+        // The first cache line holds the Slice pointer, which the interpreter
+        // reads but never dereferences. Row 0 is all ones and row 1 is all
+        // zeros, so every quadword of both rows is accessed and nothing
+        // matches.
+        struct alignas(c_bytesPerCacheLine) SliceBuffer
+        {
+            uint64_t m_data[c_quadwordsPerCacheLine + c_rowCount * c_quadwordsPerRow];
+        } buffer;
+        std::fill(std::begin(buffer.m_data), std::end(buffer.m_data), 0ull);
+        std::fill(buffer.m_data + c_quadwordsPerCacheLine,
+                  buffer.m_data + c_quadwordsPerCacheLine + c_quadwordsPerRow,
+                  ~0ull);
+
+        void * sliceBuffers[] = { &buffer };
+        const ptrdiff_t rowOffsets[] = {
+            c_bytesPerCacheLine,
+            c_bytesPerCacheLine + c_quadwordsPerRow * sizeof(uint64_t)
+        };
+
+        ByteCodeGenerator code;
+        auto done = code.AllocateLabel();
+        code.LoadRow(0, false, 0);
+        code.Jz(done);
+        code.AndRow(1, false, 0);
+        code.Jz(done);
+        code.Report();
+        code.PlaceLabel(done);
+        code.Seal();
+
+        struct Mode
+        {
+            size_t m_blockSize;
+            bool m_threaded;
+        };
+        const Mode modes[] = {
+            { 0, false },
+            { 0, true },
+            { 16, false }
+        };
+        for (auto const & mode : modes)
+        {
+            SCOPED_TRACE(mode.m_blockSize);
+            SCOPED_TRACE(mode.m_threaded);
+
+            // Prefetch far enough ahead that each block's lines have been
+            // prefetched by an earlier block.
+            const size_t distance =
+                std::max(c_quadwordsPerCacheLine, mode.m_blockSize);
+
+            size_t accessed[2];
+            size_t prefetched[2];
+            for (size_t enabled = 0; enabled < 2; ++enabled)
+            {
+                CacheLineRecorder recorder(sizeof(buffer));
+                recorder.Reset();
+
+                QueryInstrumentation instrumentation;
+                ResultsBuffer results(c_quadwordsPerRow * 64);
+                ByteCodeInterpreter interpreter(code,
+                                                results,
+                                                1,
+                                                sliceBuffers,
+                                                c_quadwordsPerRow,
+                                                0,
+                                                rowOffsets,
+                                                nullptr,
+                                                instrumentation,
+                                                &recorder,
+                                                nullptr,
+                                                mode.m_blockSize,
+                                                mode.m_threaded,
+                                                enabled ? distance : 0);
+                interpreter.Run();
+                EXPECT_EQ(results.size(), 0u);
+
+                accessed[enabled] =
+                    instrumentation.GetData().GetCacheLineCount();
+                prefetched[enabled] =
+                    instrumentation.GetData().GetPrefetchedCacheLineCount();
+            }
+
+            const size_t rowLines = c_quadwordsPerRow / c_quadwordsPerCacheLine;
+            EXPECT_EQ(accessed[0], c_rowCount * rowLines);
+            EXPECT_EQ(prefetched[0], 0u);
+
+            // Only the lines within distance of the start of each row are
+            // accessed before they have been prefetched.
+            EXPECT_EQ(accessed[1], accessed[0]);
+            EXPECT_EQ(prefetched[1],
+                      c_rowCount * (rowLines - distance / c_quadwordsPerCacheLine));
+        }
+    }
 }
@@ -34,6 +34,7 @@
 #include "BitFunnel/Term.h"
 #include "BitFunnel/Utilities/Allocator.h"
 #include "BitFunnel/Utilities/Factories.h"  // TODO: only for diagnosticStream. Remove.
+#include "BitFunnel/Utilities/Stopwatch.h"
 #include "ByteCodeInterpreter.h"
 #include "ByteCodeVerifier.h"
 #include "CompileNode.h"
@@ -53,11 +54,10 @@ namespace BitFunnel
     }
 
 
-    void ByteCodeVerifier::Verify(char const * codeText)
+    static void CompileText(char const * codeText,
+                            Allocator & allocator,
+                            ByteCodeGenerator & code)
     {
-        Allocator allocator(c_allocatorBufferSize);
-        ByteCodeGenerator code;
-
         std::stringstream input(codeText);
 
         TextObjectParser parser(input, allocator, &CompileNode::GetType);
@@ -65,24 +65,108 @@ namespace BitFunnel
 
         node.Compile(code);
         code.Seal();
+    }
 
-        QueryInstrumentation instrumentation;
 
+    void ByteCodeVerifier::Verify(char const * codeText)
+    {
+        Allocator allocator(c_allocatorBufferSize);
+        ByteCodeGenerator code;
+        CompileText(codeText, allocator, code);
+
+        // Run the code one quadword at a time with switch and with
+        // direct-threaded dispatch, and then in block mode with a block size
+        // that leaves a partial final block, and with the largest block size.
+        // Prefetching must not change the results in any of these modes.
+        struct Mode
+        {
+            size_t m_blockSize;
+            bool m_threaded;
+            size_t m_prefetchDistance;
+        };
+        const Mode modes[] = {
+            { 0, false, 0 },
+            { 0, true, 0 },
+            { 5, false, 0 },
+            { ByteCodeInterpreter::c_maxBlockSize, false, 0 },
+            { 0, false, 3 },
+            { 0, true, 3 },
+            { 5, false, 3 }
+        };
+        for (auto const & mode : modes)
+        {
+            const size_t blockSize = mode.m_blockSize;
+            SCOPED_TRACE(blockSize);
+            SCOPED_TRACE(mode.m_threaded);
+            SCOPED_TRACE(mode.m_prefetchDistance);
+
+            QueryInstrumentation instrumentation;
+
+            ResultsBuffer results(m_index.GetIngestor().GetDocumentCount());
+            ByteCodeInterpreter interpreter(
+                code,
+                results,
+                m_slices.size(),
+                m_slices.data(),
+                GetIterationsPerSlice(),
+                m_initialRank,
+                m_rowOffsets.data(),
+                nullptr,
+                instrumentation,
+                nullptr,
+                nullptr,
+                blockSize,
+                mode.m_threaded,
+                mode.m_prefetchDistance);
+
+            // Plans that start at rank 0 have no RankDown nodes.
+            EXPECT_EQ(interpreter.IsBlockMode(),
+                      blockSize != 0 && m_initialRank == 0);
+#ifdef __GNUC__
+            EXPECT_EQ(interpreter.IsThreaded(), mode.m_threaded);
+#endif
+
+            interpreter.Run();
+
+            m_observed.clear();
+            CheckResults(results);
+        }
+    }
+
+
+    double ByteCodeVerifier::Benchmark(char const * codeText,
+                                       bool threaded,
+                                       size_t runCount)
+    {
+        Allocator allocator(c_allocatorBufferSize);
+        ByteCodeGenerator code;
+        CompileText(codeText, allocator, code);
+
+        QueryInstrumentation instrumentation;
         ResultsBuffer results(m_index.GetIngestor().GetDocumentCount());
-        ByteCodeInterpreter interpreter(
-            code,
-            results,
-            m_slices.size(),
-            m_slices.data(),
-            GetIterationsPerSlice(),
-            m_initialRank,
-            m_rowOffsets.data(),
-            nullptr,
-            instrumentation,
-            nullptr);
-
-        interpreter.Run();
-
-        CheckResults(results);
+
+        Stopwatch stopwatch;
+        for (size_t i = 0; i < runCount; ++i)
+        {
+            results.Reset();
+            ByteCodeInterpreter interpreter(
+                code,
+                results,
+                m_slices.size(),
+                m_slices.data(),
+                GetIterationsPerSlice(),
+                m_initialRank,
+                m_rowOffsets.data(),
+                nullptr,
+                instrumentation,
+                nullptr,
+                nullptr,
+                0,
+                threaded,
+                0);
+            interpreter.Run();
+        }
+
+        return stopwatch.ElapsedTime();
     }
 }
@@ -45,5 +45,10 @@ namespace BitFunnel
         ByteCodeVerifier(ISimpleIndex const & index, Rank initialRank);
 
         virtual void Verify(char const * codeText) override;
+
+        // Runs the code runCount times over the declared rows and returns
+        // the elapsed time in seconds. Each run constructs a new
+        // ByteCodeInterpreter with the specified dispatch method.
+        double Benchmark(char const * codeText, bool threaded, size_t runCount);
     };
 }
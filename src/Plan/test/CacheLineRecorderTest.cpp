@@ -57,4 +57,43 @@ namespace BitFunnel
             }
         }
     }
+
+
+    TEST(CacheLineRecorder, Prefetch)
+    {
+        const int c_lineSize = 8;
+        const int c_vectorSize = 128;
+        std::vector<uint64_t> tinyVector(c_vectorSize);
+
+        CacheLineRecorder recorder(c_vectorSize * sizeof(uint64_t));
+        recorder.Reset();
+
+        recorder.SetBase(&tinyVector[0]);
+
+        // A prefetch alone does not count as an access.
+        recorder.RecordPrefetch(&tinyVector[c_lineSize]);
+        ASSERT_EQ(recorder.GetCacheLinesAccessed(), 0u);
+        ASSERT_EQ(recorder.GetCacheLinesPrefetched(), 0u);
+
+        // Line 1 was prefetched before its first access.
+        recorder.RecordAccess(&tinyVector[c_lineSize + 1]);
+        ASSERT_EQ(recorder.GetCacheLinesAccessed(), 1u);
+        ASSERT_EQ(recorder.GetCacheLinesPrefetched(), 1u);
+
+        // Line 0 was prefetched after its first access.
+        recorder.RecordAccess(&tinyVector[0]);
+        recorder.RecordPrefetch(&tinyVector[1]);
+        recorder.RecordAccess(&tinyVector[2]);
+        ASSERT_EQ(recorder.GetCacheLinesAccessed(), 2u);
+        ASSERT_EQ(recorder.GetCacheLinesPrefetched(), 1u);
+
+        // Prefetches outside of the buffer are ignored.
+        recorder.RecordPrefetch(&tinyVector[0] + c_vectorSize);
+        ASSERT_EQ(recorder.GetCacheLinesPrefetched(), 1u);
+
+        recorder.Reset();
+        recorder.RecordAccess(&tinyVector[c_lineSize]);
+        ASSERT_EQ(recorder.GetCacheLinesAccessed(), 1u);
+        ASSERT_EQ(recorder.GetCacheLinesPrefetched(), 0u);
+    }
 }
@@ -22,6 +22,7 @@
 
 #pragma once
 
+#include <set>                          // std::set embedded.
 #include <stddef.h>                     // size_t parameter.
 #include <vector>                       // std::vector embedded.
 
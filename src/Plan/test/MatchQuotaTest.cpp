@@ -0,0 +1,179 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "BitFunnel/Configuration/Factories.h"
+#include "BitFunnel/Configuration/IFileSystem.h"
+#include "BitFunnel/Index/IIngestor.h"
+#include "BitFunnel/Index/ISimpleIndex.h"
+#include "BitFunnel/Plan/QueryInstrumentation.h"
+#include "BitFunnel/Plan/QueryRunner.h"
+#include "MatchQuota.h"
+#include "PlanTestUtils.h"
+#include "QueryResources.h"
+#include "ResultsBuffer.h"
+
+
+namespace BitFunnel
+{
+    namespace MatchQuotaTest
+    {
+        using PlanTestUtils::c_maxDocId;
+
+
+        void RunQuery(ISimpleIndex const & index,
+                      char const * query,
+                      bool useNativeCode,
+                      size_t threadCount,
+                      size_t maxMatchCount,
+                      double timeBudget,
+                      QueryInstrumentation::Data & data)
+        {
+            QueryResources resources;
+            resources.EnableParallelMatching(threadCount);
+            if (maxMatchCount > 0 || timeBudget > 0.0)
+            {
+                resources.EnableEarlyTermination(maxMatchCount, timeBudget);
+            }
+
+            ResultsBuffer results(index.GetIngestor().GetDocumentCount());
+            QueryInstrumentation instrumentation;
+
+            PlanTestUtils::RunQuery(index,
+                                    resources,
+                                    query,
+                                    useNativeCode,
+                                    instrumentation,
+                                    results);
+
+            EXPECT_EQ(instrumentation.GetData().GetMatchCount(), results.size());
+
+            data = instrumentation.GetData();
+        }
+
+
+        TEST(MatchQuota, Basic)
+        {
+            MatchQuota quota(10, 0.0);
+            quota.Start();
+
+            EXPECT_FALSE(quota.IsTruncated());
+            EXPECT_EQ(quota.GetRemainingMatchCount(), 10u);
+
+            EXPECT_FALSE(quota.Add(4));
+            EXPECT_EQ(quota.GetRemainingMatchCount(), 6u);
+            EXPECT_FALSE(quota.IsTruncated());
+
+            EXPECT_TRUE(quota.Add(7));
+            EXPECT_EQ(quota.GetRemainingMatchCount(), 0u);
+            EXPECT_TRUE(quota.IsExhausted());
+
+            // Reaching the quota does not truncate the query unless the
+            // matcher skips slices.
+            EXPECT_FALSE(quota.IsTruncated());
+            quota.MarkTruncated();
+            EXPECT_TRUE(quota.IsTruncated());
+
+            // Start() readies the quota for the next query.
+            quota.Start();
+            EXPECT_FALSE(quota.IsTruncated());
+            EXPECT_FALSE(quota.IsExhausted());
+            EXPECT_EQ(quota.GetRemainingMatchCount(), 10u);
+
+            // No limits.
+            MatchQuota unlimited(0, 0.0);
+            unlimited.Start();
+            EXPECT_FALSE(unlimited.Add(1000000));
+            EXPECT_FALSE(unlimited.IsTruncated());
+        }
+
+
+        TEST(MatchQuota, EarlyTermination)
+        {
+            auto fileSystem = Factories::CreateRAMFileSystem();
+            auto index = PlanTestUtils::CreateIndex(*fileSystem);
+
+            for (int native = 0; native < 2; ++native)
+            {
+                const bool useNativeCode = (native == 1);
+
+                QueryInstrumentation::Data full;
+                RunQuery(*index, "2", useNativeCode, 1, 0, 0.0, full);
+                EXPECT_FALSE(full.IsTruncated());
+                EXPECT_EQ(full.GetMatchCount(), c_maxDocId / 2);
+
+                // A quota larger than the result set does not truncate.
+                QueryInstrumentation::Data large;
+                RunQuery(*index, "2", useNativeCode, 1, c_maxDocId, 0.0, large);
+                EXPECT_FALSE(large.IsTruncated());
+                EXPECT_EQ(large.GetMatchCount(), full.GetMatchCount());
+
+                // Neither does a quota reached exactly on the last slice.
+                QueryInstrumentation::Data exact;
+                RunQuery(*index, "2", useNativeCode, 1, full.GetMatchCount(), 0.0, exact);
+                EXPECT_FALSE(exact.IsTruncated());
+                EXPECT_EQ(exact.GetMatchCount(), full.GetMatchCount());
+
+                // Matching stops after the first slice.
+                QueryInstrumentation::Data limited;
+                RunQuery(*index, "2", useNativeCode, 1, 1, 0.0, limited);
+                EXPECT_TRUE(limited.IsTruncated());
+                EXPECT_GE(limited.GetMatchCount(), 1u);
+                EXPECT_LT(limited.GetMatchCount(), full.GetMatchCount());
+
+                // An expired time budget also stops after the first slice.
+                QueryInstrumentation::Data timed;
+                RunQuery(*index, "2", useNativeCode, 1, 0, 1e-12, timed);
+                EXPECT_TRUE(timed.IsTruncated());
+                EXPECT_LT(timed.GetMatchCount(), full.GetMatchCount());
+
+                // Parallel workers share the quota. Each worker may finish
+                // the slices it has already started.
+                QueryInstrumentation::Data parallel;
+                RunQuery(*index, "2", useNativeCode, 4, 1, 0.0, parallel);
+                EXPECT_TRUE(parallel.IsTruncated());
+                EXPECT_GE(parallel.GetMatchCount(), 1u);
+                EXPECT_LE(parallel.GetMatchCount(), full.GetMatchCount());
+            }
+        }
+
+
+        TEST(MatchQuota, QueryRunner)
+        {
+            auto fileSystem = Factories::CreateRAMFileSystem();
+            auto index = PlanTestUtils::CreateIndex(*fileSystem);
+
+            std::vector<ScoredMatch> topMatches;
+            auto full = QueryRunner::Run("2", *index, false, false, 1, 0, QueryRunner::c_noStaticRank, 0, 0.0, topMatches);
+            EXPECT_FALSE(full.IsTruncated());
+            EXPECT_EQ(full.GetMatchCount(), c_maxDocId / 2);
+
+            auto limited = QueryRunner::Run("2", *index, false, false, 1, 0, QueryRunner::c_noStaticRank, 1, 0.0, topMatches);
+            EXPECT_TRUE(limited.IsTruncated());
+            EXPECT_LT(limited.GetMatchCount(), full.GetMatchCount());
+        }
+    }
+}
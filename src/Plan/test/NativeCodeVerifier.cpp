@@ -46,8 +46,10 @@
 namespace BitFunnel
 {
     NativeCodeVerifier::NativeCodeVerifier(ISimpleIndex const & index,
-                                           Rank initialRank)
-      : CodeVerifierBase(index, initialRank)
+                                           Rank initialRank,
+                                           VectorIsa vectorIsa)
+      : CodeVerifierBase(index, initialRank),
+        m_vectorIsa(vectorIsa)
     {
     }
 
@@ -72,21 +74,32 @@ namespace BitFunnel
                                     7,
                                     allocator);
 
-        QueryResources resources;
-
-        MatchTreeCompiler compiler(resources,
-                                   compileNodeTree,
-                                   registers,
-                                   m_initialRank);
-
-        ResultsBuffer results(m_index.GetIngestor().GetDocumentCount());
-
-        compiler.Run(m_slices.size(),
-                     m_slices.data(),
-                     GetIterationsPerSlice(),
-                     m_rowOffsets.data(),
-                     results);
-
-        CheckResults(results);
+        // Prefetching must not change the results.
+        const size_t prefetchDistances[] = { 0, 3 };
+        for (auto prefetchDistance : prefetchDistances)
+        {
+            SCOPED_TRACE(prefetchDistance);
+
+            QueryResources resources;
+            resources.SetVectorIsa(m_vectorIsa);
+            resources.SetPrefetchDistance(prefetchDistance);
+
+            MatchTreeCompiler compiler(resources,
+                                       compileNodeTree,
+                                       registers,
+                                       m_initialRank);
+
+            ResultsBuffer results(m_index.GetIngestor().GetDocumentCount());
+
+            compiler.Run(m_slices.size(),
+                         m_slices.data(),
+                         GetIterationsPerSlice(),
+                         m_rowOffsets.data(),
+                         results,
+                         nullptr);
+
+            m_observed.clear();
+            CheckResults(results);
+        }
     }
 }
@@ -24,6 +24,7 @@
 
 #include "BitFunnel/BitFunnelTypes.h"   // DocId, Rank parameter.
 #include "CodeVerifierBase.h"           // Base class.
+#include "VectorIsa.h"                  // VectorIsa parameter.
 
 
 namespace BitFunnel
@@ -41,8 +42,13 @@ namespace BitFunnel
     class NativeCodeVerifier : public CodeVerifierBase
     {
     public:
-        NativeCodeVerifier(ISimpleIndex const & index, Rank initialRank);
+        NativeCodeVerifier(ISimpleIndex const & index,
+                           Rank initialRank,
+                           VectorIsa vectorIsa = GetSupportedVectorIsa());
 
         virtual void Verify(char const * codeText) override;
+
+    private:
+        VectorIsa m_vectorIsa;
     };
 }
@@ -0,0 +1,161 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "BitFunnel/Configuration/Factories.h"
+#include "BitFunnel/Configuration/IFileSystem.h"
+#include "BitFunnel/Index/IIngestor.h"
+#include "BitFunnel/Index/ISimpleIndex.h"
+#include "BitFunnel/Plan/QueryInstrumentation.h"
+#include "BitFunnel/Utilities/Factories.h"
+#include "BitFunnel/Utilities/ITaskProcessor.h"
+#include "PlanTestUtils.h"
+#include "QueryResources.h"
+#include "ResultsBuffer.h"
+
+
+namespace BitFunnel
+{
+    namespace ParallelMatcherTest
+    {
+        std::vector<DocId> RunQuery(ISimpleIndex const & index,
+                                    char const * query,
+                                    bool useNativeCode,
+                                    size_t threadCount,
+                                    QueryInstrumentation::Data & data)
+        {
+            QueryResources resources;
+            resources.EnableParallelMatching(threadCount);
+
+            ResultsBuffer results(index.GetIngestor().GetDocumentCount());
+            QueryInstrumentation instrumentation;
+
+            PlanTestUtils::RunQuery(index,
+                                    resources,
+                                    query,
+                                    useNativeCode,
+                                    instrumentation,
+                                    results);
+
+            data = instrumentation.GetData();
+
+            return PlanTestUtils::GetDocIds(results);
+        }
+
+
+        void VerifyQuery(ISimpleIndex const & index,
+                         char const * query,
+                         DocId divisor,
+                         bool useNativeCode)
+        {
+            QueryInstrumentation::Data expectedData;
+            auto expected = RunQuery(index, query, useNativeCode, 1, expectedData);
+
+            EXPECT_GT(expected.size(), 0u);
+            for (auto id : expected)
+            {
+                EXPECT_EQ(id % divisor, 0u);
+            }
+
+            for (size_t threadCount = 2; threadCount <= 8; threadCount *= 2)
+            {
+                QueryInstrumentation::Data data;
+                auto observed = RunQuery(index, query, useNativeCode, threadCount, data);
+
+                EXPECT_EQ(expected, observed);
+                EXPECT_EQ(expectedData.GetMatchCount(), data.GetMatchCount());
+                EXPECT_EQ(expectedData.GetQuadwordCount(), data.GetQuadwordCount());
+            }
+        }
+
+
+        TEST(ParallelMatcher, MatchesSequential)
+        {
+            auto fileSystem = Factories::CreateRAMFileSystem();
+            auto index = PlanTestUtils::CreateIndex(*fileSystem);
+
+            VerifyQuery(*index, "2 3", 6, false);
+            VerifyQuery(*index, "2 3", 6, true);
+            VerifyQuery(*index, "5 7 11", 385, false);
+            VerifyQuery(*index, "5 7 11", 385, true);
+
+            // Workers start with room for one slice's documents and must
+            // grow their ResultsBuffers when they match more.
+            VerifyQuery(*index, "2", 2, false);
+            VerifyQuery(*index, "2", 2, true);
+        }
+
+
+        // ITaskProcessor which runs the same action for every task.
+        class ActionProcessor : public ITaskProcessor
+        {
+        public:
+            ActionProcessor(std::function<void()> const & action)
+              : m_action(action)
+            {
+            }
+
+            void ProcessTask(size_t /*taskId*/) override
+            {
+                m_action();
+            }
+
+            void Finished() override
+            {
+            }
+
+        private:
+            std::function<void()> const & m_action;
+        };
+
+
+        // Runs the queries from a task thread, as QueryRunner does, so that
+        // the matcher's workers run as subtasks of the task's distributor.
+        TEST(ParallelMatcher, MatchesSequentialInTask)
+        {
+            auto fileSystem = Factories::CreateRAMFileSystem();
+            auto index = PlanTestUtils::CreateIndex(*fileSystem);
+
+            std::function<void()> const action = [&]()
+            {
+                VerifyQuery(*index, "2 3", 6, false);
+                VerifyQuery(*index, "5 7 11", 385, true);
+            };
+
+            const size_t threadCount = 4;
+            std::vector<std::unique_ptr<ITaskProcessor>> processors;
+            for (size_t i = 0; i < threadCount; ++i)
+            {
+                processors.push_back(std::unique_ptr<ITaskProcessor>(
+                    new ActionProcessor(action)));
+            }
+
+            auto distributor = Factories::CreateTaskDistributor(processors, 2);
+            distributor->WaitForCompletion();
+        }
+    }
+}
@@ -0,0 +1,99 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <algorithm>
+
+#include "gtest/gtest.h"
+
+#include "BitFunnel/Configuration/Factories.h"
+#include "BitFunnel/Configuration/IFileSystem.h"
+#include "BitFunnel/Configuration/IStreamConfiguration.h"
+#include "BitFunnel/IDiagnosticStream.h"
+#include "BitFunnel/Index/DocumentHandle.h"
+#include "BitFunnel/Index/IIngestor.h"
+#include "BitFunnel/Index/IShard.h"
+#include "BitFunnel/Index/ISimpleIndex.h"
+#include "BitFunnel/Mocks/Factories.h"
+#include "BitFunnel/Plan/Factories.h"
+#include "BitFunnel/Plan/QueryInstrumentation.h"
+#include "BitFunnel/Plan/QueryParser.h"
+#include "BitFunnel/Utilities/Factories.h"
+#include "PlanTestUtils.h"
+#include "QueryResources.h"
+#include "ResultsBuffer.h"
+
+
+namespace BitFunnel
+{
+    namespace PlanTestUtils
+    {
+        std::unique_ptr<ISimpleIndex> CreateIndex(IFileSystem & fileSystem)
+        {
+            auto index = Factories::CreatePrimeFactorsIndex(fileSystem,
+                                                            c_maxDocId,
+                                                            c_streamId);
+
+            // Tests require an index with multiple slices in shard 0.
+            EXPECT_GT(index->GetIngestor().GetShard(0).GetSliceBuffers().size(),
+                      1u);
+
+            return index;
+        }
+
+
+        void RunQuery(ISimpleIndex const & index,
+                      QueryResources & resources,
+                      char const * query,
+                      bool useNativeCode,
+                      QueryInstrumentation & instrumentation,
+                      ResultsBuffer & results)
+        {
+            auto config = Factories::CreateStreamConfiguration();
+            auto diagnosticStream = Factories::CreateDiagnosticStream(std::cout);
+
+            QueryParser parser(query, *config, resources.GetMatchTreeAllocator());
+            auto tree = parser.Parse();
+            ASSERT_NE(tree, nullptr);
+
+            Factories::RunQueryPlanner(*tree,
+                                       index,
+                                       resources,
+                                       *diagnosticStream,
+                                       instrumentation,
+                                       results,
+                                       useNativeCode);
+        }
+
+
+        std::vector<DocId> GetDocIds(ResultsBuffer const & results)
+        {
+            std::vector<DocId> ids;
+            for (auto result : results)
+            {
+                ids.push_back(result.GetHandle().GetDocId());
+            }
+            std::sort(ids.begin(), ids.end());
+
+            return ids;
+        }
+    }
+}
@@ -0,0 +1,74 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <memory>                       // std::unique_ptr return value.
+#include <vector>                       // std::vector return value.
+
+#include "BitFunnel/BitFunnelTypes.h"   // DocId template parameter.
+#include "BitFunnel/Term.h"             // Term::StreamId embedded.
+
+
+namespace BitFunnel
+{
+    class IFileSystem;
+    class ISimpleIndex;
+    class QueryInstrumentation;
+    class QueryResources;
+    class ResultsBuffer;
+
+    //*************************************************************************
+    //
+    // PlanTestUtils
+    //
+    // Helpers for the Plan tests which parse, plan and match queries end to
+    // end against a PrimeFactorsIndex.
+    //
+    //*************************************************************************
+    namespace PlanTestUtils
+    {
+        static const Term::StreamId c_streamId = 0;
+
+        // Large enough that shard 0 has several slices, so the matchers have
+        // more than one slice and more than one WorkUnit to work with. Primes
+        // above c_maxDocId / 2 appear in a single document.
+        static const DocId c_maxDocId = 1664;
+
+        // Creates a PrimeFactorsIndex of documents 0..c_maxDocId in
+        // fileSystem.
+        std::unique_ptr<ISimpleIndex> CreateIndex(IFileSystem & fileSystem);
+
+        // Parses query and runs it through the QueryPlanner using resources.
+        // The matches are left in results and the statistics in
+        // instrumentation.
+        void RunQuery(ISimpleIndex const & index,
+                      QueryResources & resources,
+                      char const * query,
+                      bool useNativeCode,
+                      QueryInstrumentation & instrumentation,
+                      ResultsBuffer & results);
+
+        // Returns the DocIds of the matches in results in ascending order.
+        std::vector<DocId> GetDocIds(ResultsBuffer const & results);
+    }
+}
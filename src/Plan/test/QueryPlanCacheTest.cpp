@@ -0,0 +1,197 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "BitFunnel/Configuration/Factories.h"
+#include "BitFunnel/Configuration/IFileSystem.h"
+#include "BitFunnel/Configuration/IStreamConfiguration.h"
+#include "BitFunnel/IDiagnosticStream.h"
+#include "BitFunnel/Index/IIngestor.h"
+#include "BitFunnel/Index/ISimpleIndex.h"
+#include "BitFunnel/Plan/QueryInstrumentation.h"
+#include "BitFunnel/Plan/QueryParser.h"
+#include "BitFunnel/Utilities/Factories.h"
+#include "CompiledQuery.h"
+#include "PlanTestUtils.h"
+#include "QueryPlanCache.h"
+#include "QueryPlanner.h"
+#include "QueryResources.h"
+#include "ResultsBuffer.h"
+
+
+namespace BitFunnel
+{
+    namespace QueryPlanCacheTest
+    {
+        static const unsigned c_targetRowCount = 500;
+
+
+        std::shared_ptr<CompiledQuery const>
+            Compile(ISimpleIndex const & index,
+                    QueryResources & resources,
+                    char const * query,
+                    bool useNativeCode,
+                    std::vector<DocId> & matches)
+        {
+            resources.Reset();
+
+            auto config = Factories::CreateStreamConfiguration();
+            auto diagnosticStream = Factories::CreateDiagnosticStream(std::cout);
+
+            QueryParser parser(query, *config, resources.GetMatchTreeAllocator());
+            auto tree = parser.Parse();
+            EXPECT_NE(tree, nullptr);
+
+            QueryInstrumentation instrumentation;
+            ResultsBuffer results(index.GetIngestor().GetDocumentCount());
+            QueryPlanner planner(*tree,
+                                 c_targetRowCount,
+                                 index,
+                                 resources,
+                                 *diagnosticStream,
+                                 instrumentation,
+                                 results,
+                                 useNativeCode,
+                                 true);
+
+            matches = PlanTestUtils::GetDocIds(results);
+            return planner.GetCompiledQuery();
+        }
+
+
+        TEST(QueryPlanCache, NormalizeQuery)
+        {
+            EXPECT_EQ(QueryPlanCache::NormalizeQuery(""), "");
+            EXPECT_EQ(QueryPlanCache::NormalizeQuery("   "), "");
+            EXPECT_EQ(QueryPlanCache::NormalizeQuery("a"), "a");
+            EXPECT_EQ(QueryPlanCache::NormalizeQuery("  a \t b\n"), "a b");
+            EXPECT_EQ(QueryPlanCache::NormalizeQuery("\"a   b\" |  c"), "\"a b\" | c");
+
+            // Escaped whitespace is part of a token.
+            EXPECT_EQ(QueryPlanCache::NormalizeQuery("a\\  b"), "a\\  b");
+            EXPECT_EQ(QueryPlanCache::NormalizeQuery("a\\ \\ b"), "a\\ \\ b");
+        }
+
+
+        TEST(QueryPlanCache, ReuseAfterReset)
+        {
+            auto fileSystem = Factories::CreateRAMFileSystem();
+            auto index = PlanTestUtils::CreateIndex(*fileSystem);
+
+            for (int native = 0; native < 2; ++native)
+            {
+                const bool useNativeCode = (native == 1);
+
+                QueryPlanCache cache(*index, 10);
+                QueryResources resources;
+
+                std::vector<DocId> expected;
+                cache.Add(QueryPlanCache::NormalizeQuery("2 3"),
+                          Compile(*index, resources, "2 3", useNativeCode, expected),
+                          resources);
+                ASSERT_GT(expected.size(), 0u);
+
+                // Cached CompiledQueries must not depend on QueryResources.
+                resources.Reset();
+
+                auto compiledQuery = cache.Find("2 3", useNativeCode, resources);
+                ASSERT_NE(compiledQuery, nullptr);
+
+                QueryInstrumentation instrumentation;
+                ResultsBuffer results(1);
+                compiledQuery->Run(*index, resources, instrumentation, results);
+
+                EXPECT_EQ(PlanTestUtils::GetDocIds(results), expected);
+                EXPECT_EQ(instrumentation.GetData().GetMatchCount(), expected.size());
+
+                // Entries are specific to one matcher.
+                EXPECT_EQ(cache.Find("2 3", !useNativeCode, resources), nullptr);
+
+                EXPECT_EQ(cache.GetHitCount(), 1u);
+                EXPECT_EQ(cache.GetMissCount(), 1u);
+            }
+        }
+
+
+        TEST(QueryPlanCache, EvictLeastRecentlyUsed)
+        {
+            auto fileSystem = Factories::CreateRAMFileSystem();
+            auto index = PlanTestUtils::CreateIndex(*fileSystem);
+
+            QueryPlanCache cache(*index, 2);
+            QueryResources resources;
+            std::vector<DocId> matches;
+
+            cache.Add("2", Compile(*index, resources, "2", false, matches), resources);
+            cache.Add("3", Compile(*index, resources, "3", false, matches), resources);
+            EXPECT_EQ(cache.GetSize(), 2u);
+
+            // Touch "2" so that "3" becomes least recently used.
+            EXPECT_NE(cache.Find("2", false, resources), nullptr);
+
+            cache.Add("5", Compile(*index, resources, "5", false, matches), resources);
+            EXPECT_EQ(cache.GetSize(), 2u);
+            EXPECT_NE(cache.Find("2", false, resources), nullptr);
+            EXPECT_EQ(cache.Find("3", false, resources), nullptr);
+            EXPECT_NE(cache.Find("5", false, resources), nullptr);
+
+            cache.Clear();
+            EXPECT_EQ(cache.GetSize(), 0u);
+            EXPECT_EQ(cache.Find("2", false, resources), nullptr);
+        }
+
+
+        TEST(QueryPlanCache, CodeGenerationSettings)
+        {
+            auto fileSystem = Factories::CreateRAMFileSystem();
+            auto index = PlanTestUtils::CreateIndex(*fileSystem);
+
+            QueryPlanCache cache(*index, 10);
+            QueryResources resources;
+            std::vector<DocId> matches;
+
+            resources.SetPrefetchDistance(0);
+            cache.Add("2 3", Compile(*index, resources, "2 3", true, matches), resources);
+            EXPECT_NE(cache.Find("2 3", true, resources), nullptr);
+
+            // Native code embeds the prefetch distance.
+            resources.SetPrefetchDistance(4);
+            EXPECT_EQ(cache.Find("2 3", true, resources), nullptr);
+            resources.SetPrefetchDistance(0);
+            EXPECT_NE(cache.Find("2 3", true, resources), nullptr);
+
+            // Native code embeds the VectorIsa.
+            const VectorIsa isa = resources.GetVectorIsa();
+            resources.SetVectorIsa(VectorIsa::Scalar);
+            if (isa != VectorIsa::Scalar)
+            {
+                EXPECT_EQ(cache.Find("2 3", true, resources), nullptr);
+            }
+            resources.SetVectorIsa(isa);
+            EXPECT_NE(cache.Find("2 3", true, resources), nullptr);
+        }
+    }
+}
@@ -0,0 +1,172 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "BitFunnel/Configuration/Factories.h"
+#include "BitFunnel/Configuration/IFileSystem.h"
+#include "BitFunnel/Configuration/IShardDefinition.h"
+#include "BitFunnel/Index/Factories.h"
+#include "BitFunnel/Index/IDocument.h"
+#include "BitFunnel/Index/IIngestor.h"
+#include "BitFunnel/Index/ISimpleIndex.h"
+#include "BitFunnel/Index/ISliceBufferAllocator.h"
+#include "BitFunnel/Index/ITermTable.h"
+#include "BitFunnel/Index/ITermTableCollection.h"
+#include "BitFunnel/Mocks/Factories.h"
+#include "BitFunnel/Plan/QueryInstrumentation.h"
+#include "BitFunnel/Term.h"
+#include "PlanTestUtils.h"
+#include "QueryResources.h"
+#include "ResultsBuffer.h"
+
+
+namespace BitFunnel
+{
+    namespace QueryPlannerTest
+    {
+        using PlanTestUtils::c_maxDocId;
+        using PlanTestUtils::c_streamId;
+
+
+        //
+        // Creates a PrimeFactors index with two shards. Documents with one or
+        // two distinct prime factors go to shard 0. The rest go to shard 1.
+        //
+        std::unique_ptr<ISimpleIndex> CreateTwoShardIndex(IFileSystem & fileSystem)
+        {
+            auto shardDefinition = Factories::CreateShardDefinition();
+            shardDefinition->AddShard(2);
+
+            auto termTables = Factories::CreateTermTableCollection();
+            for (ShardId shard = 0; shard < shardDefinition->GetShardCount(); ++shard)
+            {
+                termTables->AddTermTable(
+                    Factories::CreatePrimeFactorsTermTable(c_maxDocId, c_streamId));
+            }
+
+            auto index = Factories::CreateSimpleIndex(fileSystem);
+            index->SetShardDefinition(std::move(shardDefinition));
+            index->SetTermTableCollection(std::move(termTables));
+            index->SetSliceBufferAllocator(
+                Factories::CreateSliceBufferAllocator(20000, 512));
+
+            const Term::GramSize gramSize = 1;
+            const bool generateTermToText = false;
+            index->ConfigureAsMock(gramSize, generateTermToText);
+            index->StartIndex();
+
+            for (DocId docId = 0; docId <= c_maxDocId; ++docId)
+            {
+                auto document =
+                    Factories::CreatePrimeFactorsDocument(index->GetConfiguration(),
+                                                          docId,
+                                                          c_maxDocId,
+                                                          c_streamId);
+                index->GetIngestor().Add(docId, *document);
+            }
+
+            return index;
+        }
+
+
+        std::vector<DocId> RunQuery(ISimpleIndex const & index,
+                                    char const * query,
+                                    bool useNativeCode,
+                                    ResultsBuffer & results)
+        {
+            QueryResources resources;
+            QueryInstrumentation instrumentation;
+
+            PlanTestUtils::RunQuery(index,
+                                    resources,
+                                    query,
+                                    useNativeCode,
+                                    instrumentation,
+                                    results);
+
+            EXPECT_EQ(instrumentation.GetData().GetMatchCount(), results.size());
+
+            return PlanTestUtils::GetDocIds(results);
+        }
+
+
+        TEST(ResultsBuffer, Grow)
+        {
+            ResultsBuffer results(2);
+
+            const size_t c_count = 100;
+            for (size_t i = 0; i < c_count; ++i)
+            {
+                results.push_back(nullptr, i);
+            }
+            ASSERT_EQ(results.size(), c_count);
+            EXPECT_GE(results.m_capacity, c_count);
+
+            ResultsBuffer merged(1);
+            merged.push_back(nullptr, c_count);
+            merged.Append(results);
+            ASSERT_EQ(merged.size(), c_count + 1);
+
+            size_t expected = c_count;
+            for (auto result : merged)
+            {
+                EXPECT_EQ(result.m_index, expected);
+                expected = (expected + 1) % (c_count + 1);
+            }
+        }
+
+
+        TEST(QueryPlanner, AccumulateAcrossShards)
+        {
+            auto fileSystem = Factories::CreateRAMFileSystem();
+            auto index = CreateTwoShardIndex(*fileSystem);
+            ASSERT_EQ(index->GetIngestor().GetShardCount(), 2u);
+
+            // Documents containing both 2 and 3 are spread across both shards.
+            std::vector<DocId> expected;
+            for (DocId docId = 6; docId <= c_maxDocId; docId += 6)
+            {
+                expected.push_back(docId);
+            }
+
+            for (int native = 0; native < 2; ++native)
+            {
+                const bool useNativeCode = (native == 1);
+
+                // Buffer large enough for all matches.
+                ResultsBuffer large(index->GetIngestor().GetDocumentCount());
+                EXPECT_EQ(RunQuery(*index, "2 3", useNativeCode, large), expected);
+
+                // Buffer that must grow while matching.
+                ResultsBuffer small(1);
+                EXPECT_EQ(RunQuery(*index, "2 3", useNativeCode, small), expected);
+
+                // Results from a previous query must not leak into the next.
+                EXPECT_EQ(RunQuery(*index, "2 3", useNativeCode, small), expected);
+            }
+        }
+    }
+}
@@ -0,0 +1,114 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "BitFunnel/Configuration/Factories.h"
+#include "BitFunnel/Configuration/IFileSystem.h"
+#include "BitFunnel/Index/IIngestor.h"
+#include "BitFunnel/Index/ISimpleIndex.h"
+#include "BitFunnel/Plan/QueryInstrumentation.h"
+#include "PlanTestUtils.h"
+#include "QueryResources.h"
+#include "ResultsBuffer.h"
+
+
+namespace BitFunnel
+{
+    namespace SliceFilterTest
+    {
+        std::vector<DocId> RunQuery(ISimpleIndex const & index,
+                                    char const * query,
+                                    size_t threadCount,
+                                    bool filterSlices,
+                                    size_t & quadwordCount)
+        {
+            QueryResources resources;
+            resources.EnableParallelMatching(threadCount);
+            resources.SetSliceFiltering(filterSlices);
+
+            ResultsBuffer results(index.GetIngestor().GetDocumentCount());
+            QueryInstrumentation instrumentation;
+
+            PlanTestUtils::RunQuery(index,
+                                    resources,
+                                    query,
+                                    false,
+                                    instrumentation,
+                                    results);
+
+            quadwordCount = instrumentation.GetData().GetQuadwordCount();
+
+            return PlanTestUtils::GetDocIds(results);
+        }
+
+
+        // Runs query with and without slice filtering. Verifies that the
+        // results are the same and returns the quadword counts.
+        void VerifyQuery(ISimpleIndex const & index,
+                         char const * query,
+                         size_t threadCount,
+                         size_t & filteredCount,
+                         size_t & fullScanCount)
+        {
+            auto expected = RunQuery(index, query, threadCount, false, fullScanCount);
+            auto observed = RunQuery(index, query, threadCount, true, filteredCount);
+
+            EXPECT_GT(expected.size(), 0u);
+            EXPECT_EQ(expected, observed);
+        }
+
+
+        TEST(SliceFilter, SkipsEmptySlices)
+        {
+            auto fileSystem = Factories::CreateRAMFileSystem();
+            auto index = PlanTestUtils::CreateIndex(*fileSystem);
+
+            for (size_t threadCount = 1; threadCount <= 4; threadCount *= 4)
+            {
+                size_t filteredCount = 0;
+                size_t fullScanCount = 0;
+
+                // Every slice has a multiple of 2, so no slice is skipped.
+                VerifyQuery(*index, "2", threadCount, filteredCount, fullScanCount);
+                EXPECT_EQ(filteredCount, fullScanCount);
+
+                // 1009 and 1013 each appear in one document and 829 in two,
+                // so their rows are empty in most slices.
+                VerifyQuery(*index, "1009", threadCount, filteredCount, fullScanCount);
+                EXPECT_LT(filteredCount, fullScanCount);
+
+                VerifyQuery(*index, "1009|1013", threadCount, filteredCount, fullScanCount);
+                EXPECT_LT(filteredCount, fullScanCount);
+
+                VerifyQuery(*index, "2 829", threadCount, filteredCount, fullScanCount);
+                EXPECT_LT(filteredCount, fullScanCount);
+
+                // An empty row under a Not does not rule out a slice.
+                VerifyQuery(*index, "2 -1009", threadCount, filteredCount, fullScanCount);
+                EXPECT_EQ(filteredCount, fullScanCount);
+            }
+        }
+    }
+}
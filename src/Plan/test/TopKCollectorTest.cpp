@@ -0,0 +1,224 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "BitFunnel/Configuration/Factories.h"
+#include "BitFunnel/Configuration/IFileSystem.h"
+#include "BitFunnel/Index/DocumentHandle.h"
+#include "BitFunnel/Index/Factories.h"
+#include "BitFunnel/Index/IDocument.h"
+#include "BitFunnel/Index/IDocumentDataSchema.h"
+#include "BitFunnel/Index/IIngestor.h"
+#include "BitFunnel/Index/ISimpleIndex.h"
+#include "BitFunnel/Index/ISliceBufferAllocator.h"
+#include "BitFunnel/Index/ITermTable.h"
+#include "BitFunnel/Index/ITermTableCollection.h"
+#include "BitFunnel/Mocks/Factories.h"
+#include "BitFunnel/Plan/QueryInstrumentation.h"
+#include "BitFunnel/Plan/QueryRunner.h"
+#include "BitFunnel/Plan/ScoredMatch.h"
+#include "BitFunnel/Term.h"
+#include "PlanTestUtils.h"
+#include "QueryResources.h"
+#include "ResultsBuffer.h"
+#include "TopKCollector.h"
+
+
+namespace BitFunnel
+{
+    namespace TopKCollectorTest
+    {
+        using PlanTestUtils::c_maxDocId;
+        using PlanTestUtils::c_streamId;
+
+
+        // Static rank assigned to each document. Scrambles the DocId order
+        // and produces ties, so the tie breaking rule is exercised.
+        float StaticRank(DocId docId)
+        {
+            return static_cast<float>((docId * 37) % 101);
+        }
+
+
+        // PrimeFactors index whose schema has a static rank blob.
+        std::unique_ptr<ISimpleIndex> CreateRankedIndex(IFileSystem & fileSystem,
+                                                        FixedSizeBlobId & staticRankBlob)
+        {
+            auto termTables = Factories::CreateTermTableCollection();
+            termTables->AddTermTable(
+                Factories::CreatePrimeFactorsTermTable(c_maxDocId, c_streamId));
+
+            auto schema = Factories::CreateDocumentDataSchema();
+            staticRankBlob = schema->RegisterFixedSizeBlob(sizeof(float));
+
+            auto index = Factories::CreateSimpleIndex(fileSystem);
+            index->SetSchema(std::move(schema));
+            index->SetTermTableCollection(std::move(termTables));
+            index->SetSliceBufferAllocator(
+                Factories::CreateSliceBufferAllocator(20000, 512));
+
+            const Term::GramSize gramSize = 1;
+            const bool generateTermToText = false;
+            index->ConfigureAsMock(gramSize, generateTermToText);
+            index->StartIndex();
+
+            for (DocId docId = 0; docId <= c_maxDocId; ++docId)
+            {
+                auto document =
+                    Factories::CreatePrimeFactorsDocument(index->GetConfiguration(),
+                                                          docId,
+                                                          c_maxDocId,
+                                                          c_streamId);
+                index->GetIngestor().Add(docId, *document);
+
+                const float rank = StaticRank(docId);
+                auto handle = index->GetIngestor().GetHandle(docId);
+                std::memcpy(handle.GetFixedSizeBlob(staticRankBlob),
+                            &rank,
+                            sizeof(rank));
+            }
+
+            return index;
+        }
+
+
+        // Returns the k best matches for documents divisible by divisor,
+        // ranked by brute force.
+        std::vector<ScoredMatch> Expected(DocId divisor,
+                                          size_t k,
+                                          bool hasStaticRank)
+        {
+            std::vector<ScoredMatch> matches;
+            for (DocId docId = divisor; docId <= c_maxDocId; docId += divisor)
+            {
+                matches.push_back({ docId, hasStaticRank ? StaticRank(docId) : 0.0f });
+            }
+
+            std::sort(matches.begin(),
+                      matches.end(),
+                      [](ScoredMatch const & a, ScoredMatch const & b)
+                      {
+                          return (a.m_score > b.m_score) ||
+                              (a.m_score == b.m_score && a.m_id < b.m_id);
+                      });
+            if (matches.size() > k)
+            {
+                matches.resize(k);
+            }
+
+            return matches;
+        }
+
+
+        void VerifyTopK(ISimpleIndex const & index,
+                        char const * query,
+                        DocId divisor,
+                        size_t k,
+                        FixedSizeBlobId staticRankBlob,
+                        bool useNativeCode,
+                        size_t threadCount)
+        {
+            QueryResources resources;
+            resources.EnableParallelMatching(threadCount);
+            resources.EnableTopK(k, staticRankBlob);
+
+            ResultsBuffer results(1);
+            QueryInstrumentation instrumentation;
+
+            PlanTestUtils::RunQuery(index,
+                                    resources,
+                                    query,
+                                    useNativeCode,
+                                    instrumentation,
+                                    results);
+
+            auto expected =
+                Expected(divisor,
+                         k,
+                         staticRankBlob != TopKCollector::c_noStaticRank);
+            auto observed = resources.GetTopK()->GetMatches();
+
+            ASSERT_EQ(expected.size(), observed.size());
+            for (size_t i = 0; i < expected.size(); ++i)
+            {
+                EXPECT_EQ(expected[i].m_id, observed[i].m_id);
+                EXPECT_EQ(expected[i].m_score, observed[i].m_score);
+            }
+
+            // Every match is counted even though only k are retained.
+            EXPECT_EQ(instrumentation.GetData().GetMatchCount(),
+                      c_maxDocId / divisor);
+        }
+
+
+        TEST(TopKCollector, MatchesBruteForce)
+        {
+            auto fileSystem = Factories::CreateRAMFileSystem();
+            FixedSizeBlobId staticRankBlob;
+            auto index = CreateRankedIndex(*fileSystem, staticRankBlob);
+
+            for (int native = 0; native < 2; ++native)
+            {
+                const bool useNativeCode = (native == 1);
+                for (size_t threadCount = 1; threadCount <= 4; threadCount *= 2)
+                {
+                    VerifyTopK(*index, "2", 2, 10, staticRankBlob, useNativeCode, threadCount);
+                    VerifyTopK(*index, "2 3", 6, 25, staticRankBlob, useNativeCode, threadCount);
+
+                    // Fewer matches than k.
+                    VerifyTopK(*index, "5 7 11", 385, 10, staticRankBlob, useNativeCode, threadCount);
+
+                    // No static rank ranks by DocId.
+                    VerifyTopK(*index, "2 3", 6, 25, TopKCollector::c_noStaticRank, useNativeCode, threadCount);
+                }
+            }
+        }
+
+
+        TEST(TopKCollector, QueryRunner)
+        {
+            auto fileSystem = Factories::CreateRAMFileSystem();
+            FixedSizeBlobId staticRankBlob;
+            auto index = CreateRankedIndex(*fileSystem, staticRankBlob);
+
+            std::vector<ScoredMatch> observed;
+            QueryRunner::Run("2 3", *index, false, false, 1, 25, staticRankBlob, 0, 0.0, observed);
+
+            auto expected = Expected(6, 25, true);
+            ASSERT_EQ(expected.size(), observed.size());
+            for (size_t i = 0; i < expected.size(); ++i)
+            {
+                EXPECT_EQ(expected[i].m_id, observed[i].m_id);
+                EXPECT_EQ(expected[i].m_score, observed[i].m_score);
+            }
+
+            // Blob ids must name a blob in the schema.
+            EXPECT_ANY_THROW(QueryRunner::Run("2 3", *index, false, false, 1, 25, staticRankBlob + 1, 0, 0.0, observed));
+        }
+    }
+}
@@ -0,0 +1,254 @@
+// The MIT License (MIT)
+
+// Copyright (c) 2016, Microsoft
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include <functional>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "BitFunnel/Index/ISimpleIndex.h"
+#include "BitFunnel/Term.h"                     // Only needed for CodeVerifierBase.h.
+#include "NativeCodeVerifier.h"
+#include "VectorIsa.h"
+
+
+namespace BitFunnel
+{
+    // TODO: This should come from a shared header.
+    extern ISimpleIndex const & GetIndex();
+
+
+    namespace VectorMatcherTest
+    {
+        typedef std::function<uint64_t(std::vector<uint64_t> const &)> Expected;
+
+
+        // Runs the CompileNode tree in codeText once for each VectorIsa
+        // supported by this machine and checks the matches against the
+        // expected value of each quadword computed from the declared rows.
+        void VerifyAllIsas(char const * codeText,
+                           std::vector<char const *> const & rows,
+                           Expected expected)
+        {
+            for (auto isa : { VectorIsa::Scalar, VectorIsa::Avx2, VectorIsa::Avx512 })
+            {
+                if (isa > GetSupportedVectorIsa())
+                {
+                    continue;
+                }
+
+                SCOPED_TRACE(GetVectorIsaName(isa));
+
+                const Rank initialRank = 0;
+                NativeCodeVerifier verifier(GetIndex(), initialRank, isa);
+
+                for (auto row : rows)
+                {
+                    verifier.DeclareRow(row);
+                }
+
+                std::vector<uint64_t> values(rows.size());
+                for (auto iteration : verifier.GetIterations())
+                {
+                    const size_t slice = verifier.GetSliceNumber(iteration);
+                    const size_t offset = verifier.GetOffset(iteration);
+
+                    for (size_t i = 0; i < rows.size(); ++i)
+                    {
+                        values[i] = verifier.GetRowData(i, offset, slice);
+                    }
+                    verifier.ExpectResult(expected(values), offset, slice);
+                }
+
+                verifier.Verify(codeText);
+            }
+        }
+
+
+        TEST(VectorMatcher, GetQuadwordsPerVector)
+        {
+            EXPECT_EQ(GetQuadwordsPerVector(VectorIsa::Scalar), 1u);
+            EXPECT_EQ(GetQuadwordsPerVector(VectorIsa::Avx2), 4u);
+            EXPECT_EQ(GetQuadwordsPerVector(VectorIsa::Avx512), 8u);
+        }
+
+
+        TEST(VectorMatcher, AndRows)
+        {
+            char const * text =
+                "LoadRowJz {"
+                "  Row: Row(0, 0, 0, false),"
+                "  Child: AndRowJz {"
+                "    Row: Row(1, 0, 0, true),"
+                "    Child: AndRowJz {"
+                "      Row: Row(2, 0, 0, false),"
+                "      Child: Report {"
+                "        Child: "
+                "      }"
+                "    }"
+                "  }"
+                "}";
+
+            VerifyAllIsas(text,
+                          { "2", "3", "5" },
+                          [](std::vector<uint64_t> const & r)
+                          {
+                              return r[0] & ~r[1] & r[2];
+                          });
+        }
+
+
+        TEST(VectorMatcher, InvertedLoad)
+        {
+            char const * text =
+                "LoadRowJz {"
+                "  Row: Row(0, 0, 0, true),"
+                "  Child: AndRowJz {"
+                "    Row: Row(1, 0, 0, false),"
+                "    Child: Report {"
+                "      Child: "
+                "    }"
+                "  }"
+                "}";
+
+            VerifyAllIsas(text,
+                          { "2", "3" },
+                          [](std::vector<uint64_t> const & r)
+                          {
+                              return ~r[0] & r[1];
+                          });
+        }
+
+
+        TEST(VectorMatcher, OrReports)
+        {
+            char const * text =
+                "Or {"
+                "  Children: ["
+                "    LoadRowJz {"
+                "      Row: Row(0, 0, 0, false),"
+                "      Child: Report {"
+                "        Child: "
+                "      }"
+                "    },"
+                "    LoadRowJz {"
+                "      Row: Row(1, 0, 0, false),"
+                "      Child: AndRowJz {"
+                "        Row: Row(2, 0, 0, false),"
+                "        Child: Report {"
+                "          Child: "
+                "        }"
+                "      }"
+                "    }"
+                "  ]"
+                "}";
+
+            VerifyAllIsas(text,
+                          { "7", "3", "5" },
+                          [](std::vector<uint64_t> const & r)
+                          {
+                              return r[0] | (r[1] & r[2]);
+                          });
+        }
+
+
+        // Exercises Push, AndStack, OrStack and Not through the expression
+        // tree attached to a Report node.
+        TEST(VectorMatcher, ReportExpression)
+        {
+            char const * text =
+                "LoadRowJz {"
+                "  Row: Row(0, 0, 0, false),"
+                "  Child: Report {"
+                "    Child: OrTree {"
+                "      Children: ["
+                "        AndTree {"
+                "          Children: ["
+                "            LoadRow(1, 0, 0, false),"
+                "            LoadRow(2, 0, 0, false)"
+                "          ]"
+                "        },"
+                "        Not {"
+                "          Child: LoadRow(3, 0, 0, false)"
+                "        }"
+                "      ]"
+                "    }"
+                "  }"
+                "}";
+
+            VerifyAllIsas(text,
+                          { "2", "3", "5", "7" },
+                          [](std::vector<uint64_t> const & r)
+                          {
+                              return r[0] & ((r[1] & r[2]) | ~r[3]);
+                          });
+        }
+
+
+        // Uses more rows than NativeCodeVerifier allocates row offset
+        // registers so that the last row is addressed through the row offset
+        // array.
+        TEST(VectorMatcher, ManyRows)
+        {
+            char const * text =
+                "LoadRowJz {"
+                "  Row: Row(0, 0, 0, false),"
+                "  Child: AndRowJz {"
+                "    Row: Row(1, 0, 0, true),"
+                "    Child: AndRowJz {"
+                "      Row: Row(2, 0, 0, true),"
+                "      Child: AndRowJz {"
+                "        Row: Row(3, 0, 0, true),"
+                "        Child: AndRowJz {"
+                "          Row: Row(4, 0, 0, true),"
+                "          Child: AndRowJz {"
+                "            Row: Row(5, 0, 0, true),"
+                "            Child: AndRowJz {"
+                "              Row: Row(6, 0, 0, true),"
+                "              Child: AndRowJz {"
+                "                Row: Row(7, 0, 0, true),"
+                "                Child: Report {"
+                "                  Child: "
+                "                }"
+                "              }"
+                "            }"
+                "          }"
+                "        }"
+                "      }"
+                "    }"
+                "  }"
+                "}";
+
+            VerifyAllIsas(text,
+                          { "2", "3", "5", "7", "11", "13", "17", "19" },
+                          [](std::vector<uint64_t> const & r)
+                          {
+                              uint64_t value = r[0];
+                              for (size_t i = 1; i < r.size(); ++i)
+                              {
+                                  value &= ~r[i];
+                              }
+                              return value;
+                          });
+        }
+    }
+}
@@ -21,6 +21,7 @@
 // THE SOFTWARE.
 
 #include <iostream>
+#include <vector>
 
 #include "BitFunnel/Configuration/Factories.h"
 #include "BitFunnel/Configuration/IFileSystem.h"
@@ -44,20 +45,67 @@ namespace BitFunnel
     Query::Query(Environment & environment,
                  Id id,
                  char const * parameters)
-        : TaskBase(environment, id, Type::Synchronous)
+        : TaskBase(environment, id, Type::Synchronous),
+          m_topK(0),
+          m_staticRankBlob(QueryRunner::c_noStaticRank),
+          m_maxMatchCount(0),
+          m_timeBudget(0.0)
     {
         auto command = TaskFactory::GetNextToken(parameters);
+
+        // Options precede the query form.
+        for (;;)
+        {
+            if (command.compare("rank") == 0)
+            {
+                auto token = TaskFactory::GetNextToken(parameters);
+                m_staticRankBlob = static_cast<FixedSizeBlobId>(stoul(token));
+            }
+            else if (command.compare("max") == 0)
+            {
+                auto token = TaskFactory::GetNextToken(parameters);
+                m_maxMatchCount = stoull(token);
+            }
+            else if (command.compare("budget") == 0)
+            {
+                auto token = TaskFactory::GetNextToken(parameters);
+                m_timeBudget = stod(token);
+                if (m_timeBudget < 0.0)
+                {
+                    std::cout << "expected non-negative time budget" << std::endl;
+                    throw RecoverableError();
+                }
+            }
+            else
+            {
+                break;
+            }
+            command = TaskFactory::GetNextToken(parameters);
+        }
+
         if (command.compare("one") == 0)
         {
             m_isSingleQuery = true;
             m_query = parameters;
         }
+        else if (command.compare("top") == 0)
+        {
+            m_isSingleQuery = true;
+            auto token = TaskFactory::GetNextToken(parameters);
+            m_topK = stoull(token);
+            if (m_topK == 0)
+            {
+                std::cout << "expected top k greater than zero" << std::endl;
+                throw RecoverableError();
+            }
+            m_query = parameters;
+        }
         else
         {
             m_isSingleQuery = false;
             if (command.compare("log") != 0)
             {
-                std::cout << "expected log or one" << std::endl;
+                std::cout << "expected log, one, or top" << std::endl;
                 throw RecoverableError();
             }
             m_query = TaskFactory::GetNextToken(parameters);
@@ -73,16 +121,44 @@ namespace BitFunnel
                 << "Processing query \""
                 << m_query
                 << "\"" << std::endl;
+            std::vector<ScoredMatch> topMatches;
             auto instrumentation =
                 QueryRunner::Run(m_query.c_str(),
                                  GetEnvironment().GetSimpleIndex(),
                                  GetEnvironment().GetCompilerMode(),
-                                 GetEnvironment().GetCacheLineCountMode());
+                                 GetEnvironment().GetCacheLineCountMode(),
+                                 GetEnvironment().GetThreadCount(),
+                                 m_topK,
+                                 m_staticRankBlob,
+                                 m_maxMatchCount,
+                                 m_timeBudget,
+                                 topMatches);
 
             std::cout << "Results:" << std::endl;
             CsvTsv::CsvTableFormatter formatter(std::cout);
             QueryInstrumentation::Data::FormatHeader(formatter);
             instrumentation.Format(formatter);
+
+            if (instrumentation.IsTruncated())
+            {
+                std::cout
+                    << "Matching stopped early. Some slices were not scanned."
+                    << std::endl;
+            }
+
+            if (m_topK > 0)
+            {
+                std::cout
+                    << std::endl
+                    << "Top " << m_topK << " matches:" << std::endl
+                    << "DocId, score" << std::endl;
+                for (auto const & match : topMatches)
+                {
+                    std::cout
+                        << match.m_id << ", "
+                        << match.m_score << std::endl;
+                }
+            }
         }
         else
         {
@@ -108,7 +184,9 @@ namespace BitFunnel
                                  queries,
                                  c_iterations,
                                  GetEnvironment().GetCompilerMode(),
-                                 GetEnvironment().GetCacheLineCountMode());
+                                 GetEnvironment().GetCacheLineCountMode(),
+                                 m_maxMatchCount,
+                                 m_timeBudget);
             std::cout << "Results:" << std::endl;
             statistics.Print(std::cout);
 
@@ -131,9 +209,18 @@ namespace BitFunnel
         return Documentation(
             "query",
             "Process a single query or list of queries.",
-            "query (one <expression>) | (log <file>)\n"
+            "query [rank <blob>] [max <n>] [budget <seconds>]\n"
+            "      (one <expression>) | (top <k> <expression>) | (log <file>)\n"
             "  Processes a single query or a list of queries\n"
-            "  specified by a file.\n"
+            "  specified by a file. The top form also prints the\n"
+            "  k best scoring matches for the query. Matches are\n"
+            "  scored by the float static rank in fixed-size blob\n"
+            "  <blob> of the document data schema, or ranked by\n"
+            "  DocId if there is no rank option. The max and\n"
+            "  budget options stop matching each query once it\n"
+            "  has n matches or has matched for the given number\n"
+            "  of seconds. Results report whether a query was\n"
+            "  truncated.\n"
         );
     }
 }
@@ -22,9 +22,10 @@
 
 #pragma once
 
-#include <string>       // std::string embedded.
+#include <string>                                   // std::string embedded.
 
-#include "TaskBase.h"   // TaskBase base class.
+#include "BitFunnel/Index/IDocumentDataSchema.h"    // FixedSizeBlobId embedded.
+#include "TaskBase.h"                               // TaskBase base class.
 
 
 namespace BitFunnel
@@ -41,6 +42,19 @@ namespace BitFunnel
 
     private:
         bool m_isSingleQuery;
+
+        // Number of best scoring matches to print for a single query. Zero
+        // disables scoring.
+        size_t m_topK;
+
+        // Fixed-size blob holding each document's static rank.
+        // QueryRunner::c_noStaticRank if matches are ranked by DocId.
+        FixedSizeBlobId m_staticRankBlob;
+
+        // Limits on each query's matching. Zero disables a limit.
+        size_t m_maxMatchCount;
+        double m_timeBudget;
+
         std::string m_query;
     };
 }
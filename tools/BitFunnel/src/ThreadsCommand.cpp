@@ -64,7 +64,9 @@ namespace BitFunnel
             "threads",
             "Set the number of threads for query processing.",
             "threads <count>\n"
-            "  Set the number of threads for query processing."
+            "  Set the number of threads for query processing.\n"
+            "  'query log' runs one query per thread.\n"
+            "  'query one' splits matching across threads."
         );
     }
 }